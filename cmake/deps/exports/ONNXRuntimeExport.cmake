@@ -0,0 +1,45 @@
+include_guard(GLOBAL)
+
+set(ONNXRUNTIME_POSSIBLE_PATHS
+    "${DEPENDENCY_ROOT_DIR}/onnxruntime/onnxruntime-linux-x64"
+    "${DEPENDENCY_ROOT_DIR}/onnxruntime/build"
+    "${DEPENDENCY_ROOT_DIR}/onnxruntime/install"
+    "${DEPENDENCY_ROOT_DIR}/onnxruntime"
+)
+
+# Release tarballs ship headers and a shared library, newer ones also a
+# CMake config; either layout ends up as ONNXRuntime::ONNXRuntime.
+foreach(path ${ONNXRUNTIME_POSSIBLE_PATHS})
+    set(config_path "${path}/lib/cmake/onnxruntime")
+    if (EXISTS "${config_path}/onnxruntimeConfig.cmake")
+        pretty_message_kv(SUCCESS "Found ONNXRuntime config at" "${config_path}")
+        list(APPEND CMAKE_PREFIX_PATH ${path})
+        find_package(onnxruntime QUIET CONFIG PATHS ${path} NO_DEFAULT_PATH)
+        if (onnxruntime_FOUND)
+            add_library(ONNXRuntime::ONNXRuntime INTERFACE IMPORTED GLOBAL)
+            target_link_libraries(ONNXRuntime::ONNXRuntime INTERFACE onnxruntime::onnxruntime)
+            set(ONNXRuntime_FOUND TRUE)
+            pretty_message_kv(SUCCESS "ONNXRuntime loaded from" "${path}")
+            pretty_message_kv(SUCCESS "ONNXRuntime version" "${onnxruntime_VERSION}")
+            break()
+        endif()
+    endif()
+
+    if (EXISTS "${path}/include/onnxruntime_cxx_api.h")
+        find_library(ONNXRUNTIME_LIBRARY NAMES onnxruntime PATHS "${path}/lib" NO_DEFAULT_PATH)
+        if (ONNXRUNTIME_LIBRARY)
+            add_library(ONNXRuntime::ONNXRuntime SHARED IMPORTED GLOBAL)
+            set_target_properties(ONNXRuntime::ONNXRuntime PROPERTIES
+                IMPORTED_LOCATION "${ONNXRUNTIME_LIBRARY}"
+                INTERFACE_INCLUDE_DIRECTORIES "${path}/include"
+            )
+            set(ONNXRuntime_FOUND TRUE)
+            pretty_message_kv(SUCCESS "ONNXRuntime loaded from" "${path}")
+            break()
+        endif()
+    endif()
+endforeach()
+
+if (NOT ONNXRuntime_FOUND)
+    pretty_message(OPTIONAL "onnxruntime not found in local paths")
+endif()
@@ -0,0 +1,26 @@
+include_guard(GLOBAL)
+
+set(OPENCV_POSSIBLE_PATHS
+    "${DEPENDENCY_ROOT_DIR}/opencv/opencv_linux-x86_64"
+    "${DEPENDENCY_ROOT_DIR}/opencv/build"
+    "${DEPENDENCY_ROOT_DIR}/opencv/install"
+    "${DEPENDENCY_ROOT_DIR}/opencv"
+)
+
+foreach(path ${OPENCV_POSSIBLE_PATHS})
+    set(config_path "${path}/lib/cmake/opencv4")
+    if (EXISTS "${config_path}/OpenCVConfig.cmake")
+        pretty_message_kv(SUCCESS "Found OpenCV config at" "${config_path}")
+        list(APPEND CMAKE_PREFIX_PATH ${path})
+        find_package(OpenCV QUIET CONFIG PATHS ${path} NO_DEFAULT_PATH COMPONENTS core imgproc imgcodecs)
+        if (OpenCV_FOUND)
+            pretty_message_kv(SUCCESS "OpenCV loaded from" "${path}")
+            pretty_message_kv(SUCCESS "OpenCV version" "${OpenCV_VERSION}")
+            break()
+        endif()
+    endif()
+endforeach()
+
+if (NOT OpenCV_FOUND)
+    pretty_message(OPTIONAL "opencv not found in local paths")
+endif()
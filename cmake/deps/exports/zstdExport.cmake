@@ -0,0 +1,42 @@
+include_guard(GLOBAL)
+
+set(ZSTD_POSSIBLE_PATHS
+    "${DEPENDENCY_ROOT_DIR}/zstd/zstd_linux-x86_64"
+    "${DEPENDENCY_ROOT_DIR}/zstd/build"
+    "${DEPENDENCY_ROOT_DIR}/zstd/install"
+    "${DEPENDENCY_ROOT_DIR}/zstd"
+)
+
+# Builds installed with CMake ship a config, `make install` ones only the
+# header and library; either layout ends up as zstd::libzstd.
+foreach(path ${ZSTD_POSSIBLE_PATHS})
+    set(config_path "${path}/lib/cmake/zstd")
+    if (EXISTS "${config_path}/zstdConfig.cmake")
+        pretty_message_kv(SUCCESS "Found zstd config at" "${config_path}")
+        list(APPEND CMAKE_PREFIX_PATH ${path})
+        find_package(zstd QUIET CONFIG PATHS ${path} NO_DEFAULT_PATH)
+        if (zstd_FOUND)
+            pretty_message_kv(SUCCESS "zstd loaded from" "${path}")
+            pretty_message_kv(SUCCESS "zstd version" "${zstd_VERSION}")
+            break()
+        endif()
+    endif()
+
+    if (EXISTS "${path}/include/zstd.h")
+        find_library(ZSTD_LIBRARY NAMES zstd PATHS "${path}/lib" NO_DEFAULT_PATH)
+        if (ZSTD_LIBRARY)
+            add_library(zstd::libzstd UNKNOWN IMPORTED GLOBAL)
+            set_target_properties(zstd::libzstd PROPERTIES
+                IMPORTED_LOCATION "${ZSTD_LIBRARY}"
+                INTERFACE_INCLUDE_DIRECTORIES "${path}/include"
+            )
+            set(zstd_FOUND TRUE)
+            pretty_message_kv(SUCCESS "zstd loaded from" "${path}")
+            break()
+        endif()
+    endif()
+endforeach()
+
+if (NOT zstd_FOUND)
+    pretty_message(OPTIONAL "zstd not found in local paths")
+endif()
@@ -22,6 +22,12 @@ async def load_model_on_startup():
         model = None
         print(f"CRITICAL ERROR: Failed to load PaddleX model '{MODEL_NAME_OR_PATH}': {e}")
 
+@app.get("/health")
+async def health():
+    if model is None:
+        raise HTTPException(status_code=503, detail="Model not loaded")
+    return {"status": "ok", "model": MODEL_NAME_OR_PATH}
+
 @app.post("/recognize_formula")
 async def recognize_formula_from_image(image_file: UploadFile = File(...)):
     if model is None:
@@ -0,0 +1,463 @@
+#ifndef BOOK_CATALOG_HPP
+#define BOOK_CATALOG_HPP
+
+#include <catalog/keyset_cursor.hpp>
+#include <database/db_async.hpp>
+#include <database/db_ops.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <pqxx/pqxx>
+#include <spdlog/spdlog.h>
+
+namespace geecodex::catalog {
+namespace net = boost::asio;
+
+struct book_catalog_config {
+    std::chrono::seconds refresh_interval{30};
+    std::chrono::seconds full_reload_interval{3600};   // picks up deleted rows
+    // Incremental refreshes re-read rows this far behind the newest updated_at
+    // seen, so a transaction that committed late with an older NOW() is not missed.
+    std::chrono::seconds overlap{5};
+    std::size_t max_page_size = 50;                     // books per listing page
+
+    // GEECODEX_CATALOG_REFRESH_SECONDS, GEECODEX_CATALOG_FULL_RELOAD_SECONDS and
+    // GEECODEX_BOOKS_PAGE_MAX.
+    static book_catalog_config from_env() {
+        book_catalog_config config;
+        config.max_page_size = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_BOOKS_PAGE_MAX", static_cast<long long>(config.max_page_size))));
+        config.refresh_interval = std::chrono::seconds{std::max(1LL, utils::env_int("GEECODEX_CATALOG_REFRESH_SECONDS", config.refresh_interval.count()))};
+        config.full_reload_interval = std::chrono::seconds{std::max(1LL, utils::env_int("GEECODEX_CATALOG_FULL_RELOAD_SECONDS", config.full_reload_interval.count()))};
+        return config;
+    }
+};
+
+// One `codex_books` row, decoded once when the catalog is built.
+struct book {
+    int id = 0;
+    std::string title;
+    std::optional<std::string> author;
+    std::optional<std::string> isbn;
+    std::optional<std::string> publisher;
+    std::optional<std::string> publish_date;
+    std::optional<std::string> language;
+    std::optional<int> page_count;
+    std::optional<std::string> description;
+    std::optional<std::string> cover_path;
+    std::optional<std::string> pdf_path;
+    std::optional<std::int64_t> file_size_bytes;
+    std::vector<std::string> tags;
+    std::optional<std::string> category;
+    int access_level = 0;
+    int download_count = 0;
+    std::optional<std::string> created_at;
+    bool is_active = false;
+
+    std::int64_t created_us = 0;    // epoch microseconds, for ordering
+    std::int64_t updated_us = 0;
+    std::string safe_filename;      // Content-Disposition name of the PDF
+};
+
+// "C++ Primer (5th Ed.)" -> "C_Primer_5th_Ed.pdf": keeps [A-Za-z0-9_- ],
+// then turns each run of spaces into one underscore.
+inline std::string make_safe_filename(std::string_view title) {
+    std::string out;
+    out.reserve(title.size() + 4);
+    bool in_space = false;
+    for (char c: title) {
+        const auto u = static_cast<unsigned char>(c);
+        if (u < 0x80 && (std::isalnum(u) || c == '_' || c == '-')) {
+            if (in_space) out.push_back('_');
+            in_space = false;
+            out.push_back(c);
+        } else if (c == ' ') {
+            in_space = true;
+        }
+    }
+    if (in_space) out.push_back('_');
+    out += ".pdf";
+    return out;
+}
+
+// Immutable snapshot of the catalog. Readers keep a shared_ptr for as long as
+// they use it; refreshes build a new snapshot and swap it in.
+class catalog {
+public:
+    [[nodiscard]] std::shared_ptr<const book> find(int id) const {
+        auto it = m_by_id.find(id);
+        return it == m_by_id.end() ? nullptr : it->second;
+    }
+
+    // Active books, newest created_at first (ties: higher id first).
+    [[nodiscard]] const std::vector<std::shared_ptr<const book>>& newest() const { return m_newest; }
+
+    // Up to `limit` books of newest() that come after `after`, or from the
+    // start without one. The start is found by binary search on the key, so
+    // every page costs the same and books added meanwhile do not shift it.
+    [[nodiscard]] std::span<const std::shared_ptr<const book>> page_after(const std::optional<book_key>& after, std::size_t limit) const {
+        auto first = m_newest.begin();
+        if (after) {
+            first = std::partition_point(m_newest.begin(), m_newest.end(), [&](const auto& b) {
+                return !comes_after(key_of(*b), *after);
+            });
+        }
+        const auto count = std::min<std::size_t>(limit, static_cast<std::size_t>(m_newest.end() - first));
+        return {first, count};
+    }
+
+    static book_key key_of(const book& b) { return {b.created_us, b.id}; }
+
+    // Newest-first order on (created_at, id).
+    static bool comes_after(const book_key& x, const book_key& y) {
+        if (x.created_us != y.created_us) return x.created_us < y.created_us;
+        return x.id < y.id;
+    }
+
+    [[nodiscard]] std::size_t size() const { return m_by_id.size(); }
+    [[nodiscard]] std::uint64_t version() const { return m_version; }
+    // Newest updated_at or deleted_at seen, in epoch microseconds. Unlike
+    // version() it means the same on every server and across restarts.
+    [[nodiscard]] std::int64_t high_water_us() const { return m_high_water_us; }
+
+    // Every book, active or not, by id.
+    [[nodiscard]] const std::unordered_map<int, std::shared_ptr<const book>>& all() const { return m_by_id; }
+
+    // Ids of deleted books and when they were deleted (epoch microseconds),
+    // from `codex_books_deleted`. Only kept when deletions_tracked().
+    [[nodiscard]] const std::unordered_map<int, std::int64_t>& deleted() const { return m_deleted; }
+    [[nodiscard]] bool deletions_tracked() const { return m_deletions_tracked; }
+
+private:
+    friend class book_catalog;
+
+    std::unordered_map<int, std::shared_ptr<const book>> m_by_id;
+    std::vector<std::shared_ptr<const book>> m_newest;
+    std::unordered_map<int, std::int64_t> m_deleted;
+    std::uint64_t m_version = 0;
+    std::int64_t m_high_water_us = 0;
+    bool m_deletions_tracked = false;
+};
+
+// Process-wide catalog of `codex_books`. Lookups are one atomic load and one
+// hash probe; the database is only read by the refresh, which fetches rows
+// whose updated_at moved past the last one seen (the table's trigger bumps it
+// on every UPDATE) and merges them into a copy of the current snapshot.
+// Every download also UPDATEs its row, so a row whose only change is
+// download_count is not an edit: it publishes nothing and keeps its old
+// updated_us, which versions the snapshot. Counts catch up on full reloads.
+// When the `codex_books_deleted` log exists (checked on every full reload),
+// deletions recorded there since the last refresh are applied too; without
+// it they only show on the next full reload.
+class book_catalog {
+public:
+    explicit book_catalog(book_catalog_config config = book_catalog_config::from_env())
+        : m_config{config} {}
+
+    using listener = std::function<void(const std::shared_ptr<const catalog>&)>;
+
+    // Called with every snapshot published from now on, on the thread that
+    // published it (the caller of load() or the database worker).
+    void on_publish(listener notify) {
+        std::lock_guard<std::mutex> lock(m_listeners_mutex);
+        m_listeners.push_back(std::move(notify));
+    }
+
+    [[nodiscard]] const book_catalog_config& config() const { return m_config; }
+
+    // Current snapshot; null until the first load succeeded.
+    [[nodiscard]] std::shared_ptr<const catalog> snapshot() const {
+        return m_current.load(std::memory_order_acquire);
+    }
+
+    // Blocking full load, for startup before the server accepts requests.
+    void load() {
+        const auto started = std::chrono::steady_clock::now();
+        auto present = database::execute_query(std::string{deleted_log_present_sql} + ";");
+        m_track_deletions = !present.empty() && present[0]["present"].as<bool>();
+        if (!m_track_deletions) SPDLOG_WARN("Table codex_books_deleted is missing; deleted books are only noticed by full reloads");
+
+        auto rows = database::execute_query(std::string{select_sql} + ";");
+        note_scanned(rows);
+        pqxx::result deleted;
+        if (m_track_deletions) deleted = database::execute_query(std::string{deleted_sql} + ";");
+        publish(build(snapshot().get(), rows, deleted, false, m_track_deletions), true, started);
+    }
+
+    // Refreshes on `executor`'s timer from now on. Call once.
+    void start(net::any_io_executor executor) {
+        m_executor = executor;
+        m_timer = std::make_unique<net::steady_timer>(executor);
+        arm();
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        auto current = snapshot();
+        out["loaded"] = current != nullptr;
+        out["books"] = current ? current->size() : 0;
+        out["active"] = current ? current->newest().size() : 0;
+        out["version"] = current ? current->version() : 0;
+        out["deleted"] = current ? current->deleted().size() : 0;
+        out["deletions_tracked"] = m_track_deletions.load(std::memory_order_relaxed);
+        out["refresh_interval_seconds"] = m_config.refresh_interval.count();
+        out["full_reload_interval_seconds"] = m_config.full_reload_interval.count();
+        out["refreshes"] = m_refreshes.load(std::memory_order_relaxed);
+        out["full_reloads"] = m_full_reloads.load(std::memory_order_relaxed);
+        out["rows_fetched"] = m_rows_fetched.load(std::memory_order_relaxed);
+        out["failures"] = m_failures.load(std::memory_order_relaxed);
+        out["last_refresh_ms"] = static_cast<double>(m_last_refresh_us.load(std::memory_order_relaxed)) / 1000.0;
+        return out;
+    }
+
+private:
+    static constexpr std::string_view select_sql =
+        "SELECT id, title, author, isbn, publisher, publish_date, language, page_count, "
+        "       description, cover_path, pdf_path, file_size_bytes, tags, category, "
+        "       access_level, download_count, created_at, is_active, "
+        "       (EXTRACT(EPOCH FROM created_at) * 1000000)::BIGINT AS created_us, "
+        "       (EXTRACT(EPOCH FROM updated_at) * 1000000)::BIGINT AS updated_us "
+        "FROM codex_books";
+
+    static constexpr std::string_view deleted_sql =
+        "SELECT book_id, (EXTRACT(EPOCH FROM deleted_at) * 1000000)::BIGINT AS deleted_us "
+        "FROM codex_books_deleted";
+
+    static constexpr std::string_view deleted_log_present_sql =
+        "SELECT to_regclass('codex_books_deleted') IS NOT NULL AS present";
+
+    book_catalog_config m_config;
+    std::atomic<std::shared_ptr<const catalog>> m_current;
+    std::atomic<bool> m_track_deletions{false};     // set by load() and full reloads
+    std::atomic<std::int64_t> m_scanned_us{0};      // newest raw updated_at fetched, counter bumps included
+
+    net::any_io_executor m_executor;
+    std::unique_ptr<net::steady_timer> m_timer;
+    std::chrono::steady_clock::time_point m_last_full{std::chrono::steady_clock::now()};   // timer thread only
+
+    std::mutex m_listeners_mutex;
+    std::vector<listener> m_listeners;
+
+    std::atomic<std::uint64_t> m_refreshes{0};
+    std::atomic<std::uint64_t> m_full_reloads{0};
+    std::atomic<std::uint64_t> m_rows_fetched{0};
+    std::atomic<std::uint64_t> m_failures{0};
+    std::atomic<std::uint64_t> m_last_refresh_us{0};
+
+    template <typename T>
+    static std::optional<T> optional_field(const pqxx::field& field) {
+        if (field.is_null()) return std::nullopt;
+        return field.as<T>();
+    }
+
+    static std::vector<std::string> parse_tags(const pqxx::field& field) {
+        std::vector<std::string> tags;
+        if (field.is_null()) return tags;
+        pqxx::array_parser parser = field.as_array();
+        std::pair<pqxx::array_parser::juncture, std::string> elem;
+        do {
+            elem = parser.get_next();
+            if (elem.first == pqxx::array_parser::juncture::string_value) tags.push_back(std::move(elem.second));
+        } while (elem.first != pqxx::array_parser::juncture::done);
+        return tags;
+    }
+
+    static std::shared_ptr<book> book_from_row(const pqxx::row& row) {
+        auto b = std::make_shared<book>();
+        b->id = row["id"].as<int>();
+        b->title = row["title"].as<std::string>();
+        b->author = optional_field<std::string>(row["author"]);
+        b->isbn = optional_field<std::string>(row["isbn"]);
+        b->publisher = optional_field<std::string>(row["publisher"]);
+        b->publish_date = optional_field<std::string>(row["publish_date"]);
+        b->language = optional_field<std::string>(row["language"]);
+        b->page_count = optional_field<int>(row["page_count"]);
+        b->description = optional_field<std::string>(row["description"]);
+        b->cover_path = optional_field<std::string>(row["cover_path"]);
+        b->pdf_path = optional_field<std::string>(row["pdf_path"]);
+        b->file_size_bytes = optional_field<std::int64_t>(row["file_size_bytes"]);
+        b->tags = parse_tags(row["tags"]);
+        b->category = optional_field<std::string>(row["category"]);
+        b->access_level = optional_field<int>(row["access_level"]).value_or(0);
+        b->download_count = optional_field<int>(row["download_count"]).value_or(0);
+        b->created_at = optional_field<std::string>(row["created_at"]);
+        b->is_active = optional_field<bool>(row["is_active"]).value_or(false);
+        b->created_us = optional_field<std::int64_t>(row["created_us"]).value_or(0);
+        b->updated_us = optional_field<std::int64_t>(row["updated_us"]).value_or(0);
+        b->safe_filename = make_safe_filename(b->title);
+        return b;
+    }
+
+    // New snapshot: `rows` and `deleted` merged over `base`, or replacing it
+    // when `merge` is false. Versions keep counting up across full reloads.
+    static std::shared_ptr<const catalog> build(const catalog* base, const pqxx::result& rows,
+                                                const pqxx::result& deleted, bool merge, bool deletions_tracked) {
+        auto next = std::make_shared<catalog>();
+        if (base) {
+            next->m_version = base->m_version;
+            if (merge) {
+                next->m_by_id = base->m_by_id;
+                next->m_deleted = base->m_deleted;
+                next->m_high_water_us = base->m_high_water_us;
+            }
+        }
+        ++next->m_version;
+        next->m_deletions_tracked = deletions_tracked;
+        for (const auto& row: rows) {
+            auto b = book_from_row(row);
+            if (auto known = base ? base->find(b->id) : nullptr; known && same_except_counters(*known, *b)) {
+                // Only downloads happened: merging keeps the published copy,
+                // a full reload takes the new count but not the new version.
+                if (merge) continue;
+                b->updated_us = known->updated_us;
+            }
+            next->m_high_water_us = std::max(next->m_high_water_us, b->updated_us);
+            next->m_deleted.erase(b->id);
+            next->m_by_id[b->id] = std::move(b);
+        }
+        for (const auto& row: deleted) {
+            const int id = row["book_id"].as<int>();
+            const auto deleted_us = optional_field<std::int64_t>(row["deleted_us"]).value_or(0);
+            // A row written after the deletion means the id was inserted again.
+            if (auto it = next->m_by_id.find(id); it != next->m_by_id.end()) {
+                if (it->second->updated_us > deleted_us) continue;
+                next->m_by_id.erase(it);
+            }
+            next->m_deleted[id] = deleted_us;
+            next->m_high_water_us = std::max(next->m_high_water_us, deleted_us);
+        }
+        next->m_newest.reserve(next->m_by_id.size());
+        for (const auto& [id, b]: next->m_by_id)
+            if (b->is_active) next->m_newest.push_back(b);
+        std::sort(next->m_newest.begin(), next->m_newest.end(), [](const auto& a, const auto& b) {
+            return catalog::comes_after(catalog::key_of(*b), catalog::key_of(*a));
+        });
+        return next;
+    }
+
+    void publish(std::shared_ptr<const catalog> next, bool full, std::chrono::steady_clock::time_point started) {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        SPDLOG_INFO("Book catalog v{}: {} books ({} refresh in {} us)",
+                    next->version(), next->size(), full ? "full" : "incremental", elapsed.count());
+        m_current.store(next, std::memory_order_release);
+        m_last_refresh_us.store(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+        (full ? m_full_reloads : m_refreshes).fetch_add(1, std::memory_order_relaxed);
+
+        std::vector<listener> listeners;
+        {
+            std::lock_guard<std::mutex> lock(m_listeners_mutex);
+            listeners = m_listeners;
+        }
+        for (const auto& notify: listeners) notify(next);
+    }
+
+    void arm() {
+        m_timer->expires_after(m_config.refresh_interval);
+        m_timer->async_wait([this](boost::system::error_code ec) {
+            if (ec) return;
+            refresh();
+        });
+    }
+
+    // Runs on the timer's executor. The query and the merge both happen on
+    // the database worker; the timer is re-armed back here once they finish.
+    void refresh() {
+        auto base = snapshot();
+        const auto now = std::chrono::steady_clock::now();
+        const bool full = !base || now - m_last_full >= m_config.full_reload_interval;
+        if (full) m_last_full = now;
+        const long long since_us = base ? std::max(base->high_water_us(), m_scanned_us.load(std::memory_order_relaxed))
+                                              - std::chrono::duration_cast<std::chrono::microseconds>(m_config.overlap).count()
+                                        : 0;
+        auto track_deletions = std::make_shared<bool>(m_track_deletions.load(std::memory_order_relaxed));
+        auto deleted = std::make_shared<pqxx::result>();
+
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [full, since_us, track_deletions, deleted](pqxx::work& txn) {
+                if (full) *track_deletions = txn.exec(std::string{deleted_log_present_sql})[0]["present"].as<bool>();
+                if (*track_deletions) {
+                    *deleted = full ? txn.exec(std::string{deleted_sql})
+                                    : txn.exec_params(std::string{deleted_sql} + " WHERE deleted_at > to_timestamp($1::double precision / 1000000)", since_us);
+                }
+                if (full) return txn.exec(std::string{select_sql});
+                return txn.exec_params(std::string{select_sql} + " WHERE updated_at > to_timestamp($1::double precision / 1000000)", since_us);
+            },
+            [this, base, full, track_deletions, deleted, started = now](std::exception_ptr error, pqxx::result rows) {
+                if (error) {
+                    m_failures.fetch_add(1, std::memory_order_relaxed);
+                    try { std::rethrow_exception(error); }
+                    catch (const std::exception& e) { SPDLOG_WARN("Book catalog refresh failed: {}", e.what()); }
+                } else {
+                    m_rows_fetched.fetch_add(rows.size(), std::memory_order_relaxed);
+                    note_scanned(rows);
+                    m_track_deletions.store(*track_deletions, std::memory_order_relaxed);
+                    // Only the overlap window came back unchanged: keep the snapshot.
+                    if (full || !base || rows_changed(*base, rows) || deletions_changed(*base, *deleted))
+                        publish(build(base.get(), rows, *deleted, !full, *track_deletions), full, started);
+                    else m_refreshes.fetch_add(1, std::memory_order_relaxed);
+                }
+                net::post(m_executor, [this] { arm(); });
+            });
+    }
+
+    static bool rows_changed(const catalog& base, const pqxx::result& rows) {
+        for (const auto& row: rows) {
+            auto known = base.find(row["id"].as<int>());
+            if (!known || !same_except_counters(*known, *book_from_row(row))) return true;
+        }
+        return false;
+    }
+
+    // Equal but for download_count and the updated_at its UPDATE bumps.
+    static bool same_except_counters(const book& x, const book& y) {
+        return x.id == y.id && x.title == y.title && x.author == y.author && x.isbn == y.isbn
+            && x.publisher == y.publisher && x.publish_date == y.publish_date && x.language == y.language
+            && x.page_count == y.page_count && x.description == y.description && x.cover_path == y.cover_path
+            && x.pdf_path == y.pdf_path && x.file_size_bytes == y.file_size_bytes && x.tags == y.tags
+            && x.category == y.category && x.access_level == y.access_level && x.created_at == y.created_at
+            && x.is_active == y.is_active && x.created_us == y.created_us;
+    }
+
+    // Counter-only rows do not move the snapshot's high-water mark; this keeps
+    // incremental refreshes from fetching them again and again.
+    void note_scanned(const pqxx::result& rows) {
+        std::int64_t newest = m_scanned_us.load(std::memory_order_relaxed);
+        for (const auto& row: rows) newest = std::max(newest, optional_field<std::int64_t>(row["updated_us"]).value_or(0));
+        m_scanned_us.store(newest, std::memory_order_relaxed);
+    }
+
+    static bool deletions_changed(const catalog& base, const pqxx::result& deleted) {
+        for (const auto& row: deleted) {
+            auto known = base.deleted().find(row["book_id"].as<int>());
+            if (known == base.deleted().end() || known->second != optional_field<std::int64_t>(row["deleted_us"]).value_or(0)) return true;
+        }
+        return false;
+    }
+};
+
+inline book_catalog& get_book_catalog() {
+    static book_catalog instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // BOOK_CATALOG_HPP
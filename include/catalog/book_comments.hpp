@@ -0,0 +1,406 @@
+#ifndef BOOK_COMMENTS_HPP
+#define BOOK_COMMENTS_HPP
+
+#include <catalog/keyset_cursor.hpp>
+#include <database/db_async.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pqxx/pqxx>
+#include <spdlog/spdlog.h>
+
+namespace geecodex::catalog {
+namespace net = boost::asio;
+
+struct book_comments_config {
+    std::size_t page_size = 20;             // comments per page unless ?limit= says otherwise
+    std::size_t max_page_size = 50;
+    std::size_t commit_batch = 200;         // comments per group commit
+    std::size_t max_queue = 5000;           // posts waiting for a commit before new ones get 503
+    std::size_t cached_books = 2000;        // first pages kept in memory
+
+    // GEECODEX_COMMENTS_PAGE_SIZE, GEECODEX_COMMENTS_COMMIT_BATCH,
+    // GEECODEX_COMMENTS_QUEUE_MAX and GEECODEX_COMMENTS_CACHED_BOOKS.
+    static book_comments_config from_env() {
+        book_comments_config config;
+        config.page_size = static_cast<std::size_t>(std::clamp<long long>(utils::env_int("GEECODEX_COMMENTS_PAGE_SIZE", static_cast<long long>(config.page_size)), 1, static_cast<long long>(config.max_page_size)));
+        config.commit_batch = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_COMMENTS_COMMIT_BATCH", static_cast<long long>(config.commit_batch))));
+        config.max_queue = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_COMMENTS_QUEUE_MAX", static_cast<long long>(config.max_queue))));
+        config.cached_books = static_cast<std::size_t>(std::max(0LL, utils::env_int("GEECODEX_COMMENTS_CACHED_BOOKS", static_cast<long long>(config.cached_books))));
+        return config;
+    }
+};
+
+// Handed to a post's handler when its book was deleted before the batch
+// committed; the other posts in the batch are unaffected.
+class comment_book_missing: public std::runtime_error {
+public:
+    comment_book_missing(): std::runtime_error{"the book no longer exists"} {}
+};
+
+struct book_comment {
+    int id = 0;
+    int book_id = 0;
+    std::optional<std::string> name;
+    std::string content;
+    std::string created_at;
+    std::int64_t created_us = 0;
+};
+
+// Comments on books, stored in `book_comments` and listed newest first.
+//
+// Reads: the first page of a book is kept as a ready-to-send JSON body and
+// dropped whenever a comment on that book commits, so a popular book costs
+// one query per change rather than one per view; concurrent misses share
+// that query. Later pages use the same (created_at, id) cursor as the book
+// listings and always go to the database.
+//
+// Writes: posts queue up (bounded) and are inserted by one statement per
+// batch. While a batch commits, the next one collects, so under load many
+// comments share a commit and idle posts are not delayed at all. Callers
+// are answered once their batch committed. A post whose book was deleted
+// meanwhile is left out of the insert rather than failing its batch.
+class book_comments {
+public:
+    using post_handler = std::function<void(std::exception_ptr, const book_comment&)>;
+    using page_handler = std::function<void(std::exception_ptr, std::shared_ptr<const std::string>)>;
+
+    explicit book_comments(book_comments_config config = book_comments_config::from_env())
+        : m_config{config} {}
+
+    [[nodiscard]] const book_comments_config& config() const { return m_config; }
+
+    // False (and `done` dropped) when the queue is full. `done` runs on the
+    // database worker.
+    bool post(int book_id, std::optional<std::string> name, std::string content, post_handler done) {
+        bool start = false;
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            if (m_queue.size() >= m_config.max_queue) {
+                ++m_rejected;
+                return false;
+            }
+            m_queue.push_back({book_id, std::move(name), std::move(content), std::move(done)});
+            start = !std::exchange(m_committing, true);
+        }
+        if (start) net::post(database::get_db_thread_pool(), [this] { commit_next(); });
+        return true;
+    }
+
+    // One page as the JSON reply body. Without a cursor and at the default
+    // page size the first page comes from the cache. `done` runs on the
+    // database worker, or right here on a cache hit.
+    void page(int book_id, std::optional<book_key> after, std::size_t limit, page_handler done) {
+        if (after || limit != m_config.page_size || m_config.cached_books == 0) {
+            load_page(book_id, after, limit, std::move(done));
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_cache_mutex);
+        auto [it, inserted] = m_cache.try_emplace(book_id);
+        auto& entry = it->second;
+        if (inserted) entry.lru = m_lru.insert(m_lru.begin(), book_id);
+        else m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+
+        if (entry.body) {
+            ++m_hits;
+            auto body = entry.body;
+            lock.unlock();
+            done(nullptr, std::move(body));
+            return;
+        }
+        entry.waiters.push_back(std::move(done));
+        if (entry.loading) {
+            ++m_coalesced;
+            return;
+        }
+        ++m_misses;
+        entry.loading = true;
+        const auto generation = entry.generation;
+        lock.unlock();
+
+        load_page(book_id, std::nullopt, limit, [this, book_id, generation](std::exception_ptr error, std::shared_ptr<const std::string> body) {
+            std::vector<page_handler> waiters;
+            {
+                std::lock_guard<std::mutex> guard(m_cache_mutex);
+                auto& loaded = m_cache.at(book_id);         // loading entries are never evicted
+                loaded.loading = false;
+                waiters.swap(loaded.waiters);
+                // A comment committed meanwhile: answer the waiters, cache nothing.
+                if (!error && loaded.generation == generation) loaded.body = body;
+                evict();
+            }
+            for (auto& waiter: waiters) waiter(error, body);
+        });
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            out["queued"] = m_queue.size();
+            out["commits"] = m_commits;
+            out["committed"] = m_committed;
+            out["commit_failures"] = m_commit_failures;
+            out["book_missing"] = m_book_missing;
+            out["rejected"] = m_rejected;
+            out["largest_batch"] = m_largest_batch;
+        }
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        out["cached_books"] = m_cache.size();
+        out["first_page_hits"] = m_hits;
+        out["first_page_misses"] = m_misses;
+        out["first_page_coalesced"] = m_coalesced;
+        return out;
+    }
+
+private:
+    struct pending_post {
+        int book_id = 0;
+        std::optional<std::string> name;
+        std::string content;
+        post_handler done;
+    };
+
+    struct cache_entry {
+        std::shared_ptr<const std::string> body;
+        bool loading = false;
+        std::uint64_t generation = 0;           // bumped by every committed comment
+        std::vector<page_handler> waiters;
+        std::list<int>::iterator lru;
+    };
+
+    book_comments_config m_config;
+
+    mutable std::mutex m_queue_mutex;
+    std::deque<pending_post> m_queue;
+    bool m_committing = false;
+    std::uint64_t m_commits = 0;
+    std::uint64_t m_committed = 0;
+    std::uint64_t m_commit_failures = 0;
+    std::uint64_t m_book_missing = 0;
+    std::uint64_t m_rejected = 0;
+    std::size_t m_largest_batch = 0;
+
+    mutable std::mutex m_cache_mutex;
+    std::unordered_map<int, cache_entry> m_cache;
+    std::list<int> m_lru;                       // most recently used first
+    std::uint64_t m_hits = 0;
+    std::uint64_t m_misses = 0;
+    std::uint64_t m_coalesced = 0;
+
+    static book_comment from_row(const pqxx::row& row, int book_id) {
+        book_comment out;
+        out.id = row["id"].as<int>();
+        out.book_id = book_id;
+        if (!row["user_name"].is_null()) out.name = row["user_name"].as<std::string>();
+        out.content = row["content"].as<std::string>();
+        out.created_at = row["created_at"].as<std::string>();
+        out.created_us = row["created_us"].as<std::int64_t>();
+        return out;
+    }
+
+    // Appends `value` to a Postgres array literal, NULL when empty.
+    static void append_array_element(std::string& out, const std::optional<std::string>& value) {
+        if (out.size() > 1) out += ',';
+        if (!value) {
+            out += "NULL";
+            return;
+        }
+        out += '"';
+        for (char c: *value) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        out += '"';
+    }
+
+    // Runs on the database worker, so one statement at a time anyway. The
+    // batch's books are locked against deletion (FOR KEY SHARE) and posts
+    // on the ones that are gone are answered with comment_book_missing;
+    // the rest go in with one INSERT. Ids are drawn from the sequence first
+    // so the returned rows can be matched back to their posts.
+    void commit_next() {
+        auto batch = std::make_shared<std::vector<pending_post>>();
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            if (m_queue.empty()) {
+                m_committing = false;
+                return;
+            }
+            const auto take = std::min(m_queue.size(), m_config.commit_batch);
+            for (std::size_t i = 0; i < take; ++i) {
+                batch->push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+            m_largest_batch = std::max(m_largest_batch, take);
+        }
+
+        // Parallel to `batch`; posts whose book is gone stay empty.
+        auto committed = std::make_shared<std::vector<std::optional<book_comment>>>(batch->size());
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [batch, committed](pqxx::work& txn) {
+                std::string books = "{";
+                for (const auto& p: *batch) books += (books.size() > 1 ? "," : "") + std::to_string(p.book_id);
+                books += '}';
+                std::unordered_map<int, bool> present;
+                for (const auto& row: txn.exec_params("SELECT id FROM codex_books WHERE id = ANY($1::int[]) ORDER BY id FOR KEY SHARE", books))
+                    present[row["id"].as<int>()] = true;
+
+                std::vector<std::size_t> writing;
+                for (std::size_t i = 0; i < batch->size(); ++i)
+                    if (present.contains((*batch)[i].book_id)) writing.push_back(i);
+                if (writing.empty()) return pqxx::result{};
+
+                auto reserved = txn.exec_params(
+                    "SELECT nextval(pg_get_serial_sequence('book_comments', 'id'))::INT AS id FROM generate_series(1, $1)",
+                    static_cast<int>(writing.size()));
+                std::unordered_map<int, std::size_t> post_of;
+                std::string ids = "{", book_ids = "{", names = "{", contents = "{";
+                for (std::size_t k = 0; k < writing.size(); ++k) {
+                    const auto& p = (*batch)[writing[k]];
+                    const int id = reserved[static_cast<int>(k)]["id"].as<int>();
+                    post_of[id] = writing[k];
+                    ids += (ids.size() > 1 ? "," : "") + std::to_string(id);
+                    book_ids += (book_ids.size() > 1 ? "," : "") + std::to_string(p.book_id);
+                    append_array_element(names, p.name);
+                    append_array_element(contents, p.content);
+                }
+                ids += '}';
+                book_ids += '}';
+                names += '}';
+                contents += '}';
+
+                auto inserted = txn.exec_params(
+                    "INSERT INTO book_comments (id, book_id, user_name, content) "
+                    "SELECT * FROM unnest($1::int[], $2::int[], $3::text[], $4::text[]) "
+                    "RETURNING id, book_id, user_name, content, created_at, "
+                    "          (EXTRACT(EPOCH FROM created_at) * 1000000)::BIGINT AS created_us",
+                    ids, book_ids, names, contents);
+                for (const auto& row: inserted) {
+                    const auto at = post_of.at(row["id"].as<int>());
+                    (*committed)[at] = from_row(row, (*batch)[at].book_id);
+                }
+                return inserted;
+            },
+            [this, batch, committed](std::exception_ptr error, pqxx::result) {
+                if (error) {
+                    {
+                        std::lock_guard<std::mutex> lock(m_queue_mutex);
+                        ++m_commit_failures;
+                    }
+                    try { std::rethrow_exception(error); }
+                    catch (const std::exception& e) { SPDLOG_WARN("Committing {} book comments failed: {}", batch->size(), e.what()); }
+                    for (auto& p: *batch) p.done(error, {});
+                } else {
+                    std::size_t written = 0;
+                    for (const auto& c: *committed) written += c ? 1 : 0;
+                    {
+                        std::lock_guard<std::mutex> lock(m_queue_mutex);
+                        ++m_commits;
+                        m_committed += written;
+                        m_book_missing += batch->size() - written;
+                    }
+                    for (const auto& p: *batch) invalidate(p.book_id);
+                    for (std::size_t i = 0; i < batch->size(); ++i) {
+                        if ((*committed)[i]) (*batch)[i].done(nullptr, *(*committed)[i]);
+                        else (*batch)[i].done(std::make_exception_ptr(comment_book_missing{}), {});
+                    }
+                }
+                commit_next();
+            });
+    }
+
+    void invalidate(int book_id) {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        auto it = m_cache.find(book_id);
+        if (it == m_cache.end()) return;
+        it->second.body.reset();
+        ++it->second.generation;
+    }
+
+    // Drops least recently used first pages beyond the limit; entries
+    // with a query in flight stay.
+    void evict() {
+        auto it = m_lru.end();
+        while (m_cache.size() > m_config.cached_books && it != m_lru.begin()) {
+            --it;
+            auto found = m_cache.find(*it);
+            if (found->second.loading) continue;
+            it = m_lru.erase(it);
+            m_cache.erase(found);
+        }
+    }
+
+    void load_page(int book_id, std::optional<book_key> after, std::size_t limit, page_handler done) {
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [book_id, after, limit](pqxx::work& txn) {
+                static constexpr std::string_view columns =
+                    "SELECT id, user_name, content, created_at, "
+                    "       (EXTRACT(EPOCH FROM created_at) * 1000000)::BIGINT AS created_us "
+                    "FROM book_comments WHERE book_id = $1 ";
+                static constexpr std::string_view order = " ORDER BY created_at DESC, id DESC LIMIT ";
+                // One row past the page tells whether another page follows.
+                const auto fetch = static_cast<long long>(limit) + 1;
+                if (!after) return txn.exec_params(std::string{columns} + std::string{order} + "$2", book_id, fetch);
+                return txn.exec_params(
+                    std::string{columns} +
+                    "AND (created_at, id) < ('epoch'::timestamptz + $2::bigint * INTERVAL '1 microsecond', $3)" +
+                    std::string{order} + "$4",
+                    book_id, after->created_us, after->id, fetch);
+            },
+            [book_id, limit, done = std::move(done)](std::exception_ptr error, pqxx::result rows) {
+                if (error) return done(error, nullptr);
+                try {
+                    nlohmann::json comments = nlohmann::json::array();
+                    std::optional<book_key> last;
+                    for (const auto& row: rows) {
+                        if (comments.size() >= limit) break;
+                        auto c = from_row(row, book_id);
+                        nlohmann::json item;
+                        item["id"] = c.id;
+                        item["name"] = c.name ? nlohmann::json(*c.name) : nlohmann::json(nullptr);
+                        item["content"] = c.content;
+                        item["created_at"] = c.created_at;
+                        comments.push_back(std::move(item));
+                        last = book_key{c.created_us, c.id};
+                    }
+                    nlohmann::json body;
+                    body["book_id"] = book_id;
+                    body["comments"] = std::move(comments);
+                    body["next_cursor"] = rows.size() > limit && last ? nlohmann::json(keyset_cursor::encode(*last)) : nlohmann::json(nullptr);
+                    done(nullptr, std::make_shared<const std::string>(body.dump()));
+                } catch (...) {
+                    done(std::current_exception(), nullptr);
+                }
+            });
+    }
+};
+
+inline book_comments& get_book_comments() {
+    static book_comments instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // BOOK_COMMENTS_HPP
@@ -0,0 +1,356 @@
+#ifndef BOOK_RATINGS_HPP
+#define BOOK_RATINGS_HPP
+
+#include <database/db_async.hpp>
+#include <database/db_ops.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <pqxx/pqxx>
+#include <spdlog/spdlog.h>
+
+namespace geecodex::catalog {
+namespace net = boost::asio;
+
+struct book_ratings_config {
+    std::chrono::milliseconds flush_interval{500};
+    std::size_t flush_batch = 500;          // flush early once this many ratings wait
+    std::size_t max_pending = 50000;        // refuse new ratings while this many are unwritten
+
+    // GEECODEX_RATINGS_FLUSH_MS, GEECODEX_RATINGS_FLUSH_BATCH and
+    // GEECODEX_RATINGS_PENDING_MAX.
+    static book_ratings_config from_env() {
+        book_ratings_config config;
+        config.flush_interval = std::chrono::milliseconds{std::max(10LL, utils::env_int("GEECODEX_RATINGS_FLUSH_MS", config.flush_interval.count()))};
+        config.flush_batch = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_RATINGS_FLUSH_BATCH", static_cast<long long>(config.flush_batch))));
+        config.max_pending = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_RATINGS_PENDING_MAX", static_cast<long long>(config.max_pending))));
+        return config;
+    }
+};
+
+struct rating_summary {
+    std::uint32_t count = 0;
+    std::uint64_t sum = 0;
+    std::array<std::uint32_t, 5> histogram{};       // [0] is the number of 1-star ratings
+
+    [[nodiscard]] double average() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+};
+
+enum class rating_outcome { added, changed, unchanged, rejected };
+
+// 1-5 star ratings, one per user and book, aggregated in memory.
+//
+// Reads never lock: count and sum share one atomic word, so an average is
+// never torn, and the histogram is atomics too. Writers to one book
+// serialize on that book's mutex, which also guards its set of raters:
+// 8 bytes per rating, the user's hash with the score in the low bits.
+// Every accepted change is queued and written behind to `book_ratings`
+// by a single multi-row upsert per flush; repeated ratings by the same user
+// in between collapse into one row. Aggregates are rebuilt from that table
+// at startup, so a crash loses at most one flush interval.
+class book_ratings {
+public:
+    static constexpr int max_book_id = 1 << 20;     // ids at or above are not rated
+
+    explicit book_ratings(book_ratings_config config = book_ratings_config::from_env())
+        : m_config{config} {}
+
+    ~book_ratings() {
+        for (auto& c: m_chunks) delete c.load(std::memory_order_relaxed);
+    }
+
+    book_ratings(const book_ratings&) = delete;
+    book_ratings& operator=(const book_ratings&) = delete;
+
+    [[nodiscard]] const book_ratings_config& config() const { return m_config; }
+
+    // Stable across restarts: the key stored in book_ratings.user_hash.
+    static std::uint64_t user_key(std::string_view user) {
+        std::uint64_t h = 1469598103934665603ull;      // FNV-1a
+        for (unsigned char c: user) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    // `score` must be 1-5. Rejected when the write-behind queue is full.
+    rating_outcome rate(int book_id, std::string_view user, int score) {
+        if (book_id <= 0 || book_id >= max_book_id || score < 1 || score > 5) return rating_outcome::rejected;
+        const auto key = user_key(user);
+        {
+            std::lock_guard<std::mutex> lock(m_pending_mutex);
+            if (m_pending.size() >= m_config.max_pending) {
+                ++m_rejected;
+                return rating_outcome::rejected;
+            }
+        }
+
+        const auto outcome = apply(slot(book_id), key, score);
+        if (outcome == rating_outcome::unchanged) return outcome;
+
+        bool flush_now = false;
+        {
+            std::lock_guard<std::mutex> lock(m_pending_mutex);
+            m_pending[{book_id, key}] = static_cast<std::uint8_t>(score);
+            flush_now = m_pending.size() >= m_config.flush_batch && !m_flushing && m_started;
+        }
+        if (flush_now) net::post(m_executor, [this] { flush(); });
+        return outcome;
+    }
+
+    // Nullopt when nobody rated the book.
+    [[nodiscard]] std::optional<rating_summary> summary(int book_id) const {
+        if (book_id <= 0 || book_id >= max_book_id) return std::nullopt;
+        const auto* chunk = m_chunks[static_cast<std::size_t>(book_id) / chunk_size].load(std::memory_order_acquire);
+        if (chunk == nullptr) return std::nullopt;
+        const auto& a = (*chunk)[static_cast<std::size_t>(book_id) % chunk_size];
+        const auto totals = a.totals.load(std::memory_order_relaxed);
+        if (totals == 0) return std::nullopt;
+
+        rating_summary out;
+        out.count = static_cast<std::uint32_t>(totals >> 32);
+        out.sum = totals & 0xffffffffu;
+        for (std::size_t i = 0; i < out.histogram.size(); ++i) out.histogram[i] = a.histogram[i].load(std::memory_order_relaxed);
+        return out;
+    }
+
+    // Blocking load of the persisted ratings, for startup.
+    void load() {
+        const auto started = std::chrono::steady_clock::now();
+        auto rows = database::execute_query("SELECT book_id, user_hash, score FROM book_ratings;");
+        std::size_t loaded = 0;
+        for (const auto& row: rows) {
+            const int book_id = row["book_id"].as<int>();
+            const int score = row["score"].as<int>();
+            if (book_id <= 0 || book_id >= max_book_id || score < 1 || score > 5) continue;
+            apply(slot(book_id), static_cast<std::uint64_t>(row["user_hash"].as<std::int64_t>()), score);
+            ++loaded;
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        SPDLOG_INFO("Loaded {} book ratings in {} ms", loaded, elapsed.count());
+    }
+
+    // Flushes on `executor`'s timer from now on. Call once.
+    void start(net::any_io_executor executor) {
+        {
+            std::lock_guard<std::mutex> lock(m_pending_mutex);
+            m_executor = executor;
+            m_started = true;
+        }
+        m_timer = std::make_unique<net::steady_timer>(executor);
+        arm();
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        std::lock_guard<std::mutex> lock(m_pending_mutex);
+        out["pending"] = m_pending.size();
+        out["flushing"] = m_flushing;
+        out["flushes"] = m_flushes;
+        out["flush_failures"] = m_flush_failures;
+        out["written"] = m_written;
+        out["discarded"] = m_discarded;
+        out["rejected"] = m_rejected;
+        out["flush_interval_ms"] = m_config.flush_interval.count();
+        return out;
+    }
+
+private:
+    // Open addressing over (user hash with the low 3 bits replaced by the
+    // score); 0 marks a free slot, which a score of 1-5 never produces.
+    class rater_set {
+    public:
+        // Stores the user's score; returns the previous one, 0 for a new user.
+        int set(std::uint64_t user, int score) {
+            if ((m_size + 1) * 4 > m_slots.size() * 3) grow();
+            const std::uint64_t id = user & ~std::uint64_t{7};
+            for (std::size_t at = index_of(id);; at = (at + 1) & (m_slots.size() - 1)) {
+                auto& entry = m_slots[at];
+                if (entry == 0) {
+                    entry = id | static_cast<std::uint64_t>(score);
+                    ++m_size;
+                    return 0;
+                }
+                if ((entry & ~std::uint64_t{7}) == id) {
+                    const int previous = static_cast<int>(entry & 7);
+                    entry = id | static_cast<std::uint64_t>(score);
+                    return previous;
+                }
+            }
+        }
+
+    private:
+        std::vector<std::uint64_t> m_slots;
+        std::size_t m_size = 0;
+
+        [[nodiscard]] std::size_t index_of(std::uint64_t id) const {
+            return static_cast<std::size_t>((id * 0x9e3779b97f4a7c15ull) >> 32) & (m_slots.size() - 1);
+        }
+
+        void grow() {
+            std::vector<std::uint64_t> old(std::max<std::size_t>(8, m_slots.size() * 2), 0);
+            old.swap(m_slots);
+            for (auto entry: old) {
+                if (entry == 0) continue;
+                std::size_t at = index_of(entry & ~std::uint64_t{7});
+                while (m_slots[at] != 0) at = (at + 1) & (m_slots.size() - 1);
+                m_slots[at] = entry;
+            }
+        }
+    };
+
+    struct aggregate {
+        std::atomic<std::uint64_t> totals{0};          // count << 32 | sum of scores
+        std::array<std::atomic<std::uint32_t>, 5> histogram{};
+        std::mutex mutex;
+        rater_set raters;
+    };
+
+    static constexpr std::size_t chunk_size = 1024;
+    using chunk = std::array<aggregate, chunk_size>;
+
+    struct pending_key {
+        int book_id = 0;
+        std::uint64_t user = 0;
+        bool operator==(const pending_key&) const = default;
+    };
+    struct pending_key_hash {
+        std::size_t operator()(const pending_key& k) const {
+            return static_cast<std::size_t>(k.user ^ (static_cast<std::uint64_t>(k.book_id) * 0x9e3779b97f4a7c15ull));
+        }
+    };
+
+    book_ratings_config m_config;
+    // Aggregates by book id, in chunks allocated on first use and never
+    // moved, so summary() needs no lock.
+    std::array<std::atomic<chunk*>, max_book_id / chunk_size> m_chunks{};
+
+    mutable std::mutex m_pending_mutex;
+    std::unordered_map<pending_key, std::uint8_t, pending_key_hash> m_pending;
+    bool m_flushing = false;
+    bool m_started = false;
+    net::any_io_executor m_executor;
+    std::unique_ptr<net::steady_timer> m_timer;
+    std::uint64_t m_flushes = 0;
+    std::uint64_t m_flush_failures = 0;
+    std::uint64_t m_written = 0;
+    std::uint64_t m_discarded = 0;          // ratings of deleted books
+    std::uint64_t m_rejected = 0;
+
+    aggregate& slot(int book_id) {
+        auto& entry = m_chunks[static_cast<std::size_t>(book_id) / chunk_size];
+        chunk* current = entry.load(std::memory_order_acquire);
+        if (current == nullptr) {
+            auto fresh = std::make_unique<chunk>();
+            if (entry.compare_exchange_strong(current, fresh.get(), std::memory_order_acq_rel)) current = fresh.release();
+        }
+        return (*current)[static_cast<std::size_t>(book_id) % chunk_size];
+    }
+
+    static rating_outcome apply(aggregate& a, std::uint64_t user, int score) {
+        std::lock_guard<std::mutex> lock(a.mutex);
+        const int previous = a.raters.set(user, score);
+        if (previous == score) return rating_outcome::unchanged;
+
+        if (previous == 0) {
+            a.totals.fetch_add((std::uint64_t{1} << 32) + static_cast<std::uint64_t>(score), std::memory_order_relaxed);
+        } else {
+            // sum >= previous, so the low word never borrows from the count.
+            a.totals.fetch_add(static_cast<std::uint64_t>(static_cast<std::int64_t>(score - previous)), std::memory_order_relaxed);
+            a.histogram[static_cast<std::size_t>(previous - 1)].fetch_sub(1, std::memory_order_relaxed);
+        }
+        a.histogram[static_cast<std::size_t>(score - 1)].fetch_add(1, std::memory_order_relaxed);
+        return previous == 0 ? rating_outcome::added : rating_outcome::changed;
+    }
+
+    void arm() {
+        m_timer->expires_after(m_config.flush_interval);
+        m_timer->async_wait([this](boost::system::error_code ec) {
+            if (ec) return;
+            flush();
+            arm();
+        });
+    }
+
+    // One upsert for everything queued; one flush in flight at a time.
+    // Ratings of books no longer in codex_books are skipped by the join
+    // rather than failing the batch on the foreign key. A failed batch goes
+    // back into the queue unless the user rated again.
+    void flush() {
+        std::unordered_map<pending_key, std::uint8_t, pending_key_hash> batch;
+        {
+            std::lock_guard<std::mutex> lock(m_pending_mutex);
+            if (m_flushing || m_pending.empty()) return;
+            m_flushing = true;
+            batch.swap(m_pending);
+        }
+
+        std::string books = "{", users = "{", scores = "{";
+        for (const auto& [key, score]: batch) {
+            if (books.size() > 1) {
+                books += ',';
+                users += ',';
+                scores += ',';
+            }
+            books += std::to_string(key.book_id);
+            users += std::to_string(static_cast<std::int64_t>(key.user));
+            scores += std::to_string(score);
+        }
+        books += '}';
+        users += '}';
+        scores += '}';
+
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [books = std::move(books), users = std::move(users), scores = std::move(scores)](pqxx::work& txn) {
+                return txn.exec_params(
+                    "INSERT INTO book_ratings (book_id, user_hash, score) "
+                    "SELECT t.book_id, t.user_hash, t.score "
+                    "FROM unnest($1::int[], $2::bigint[], $3::smallint[]) AS t(book_id, user_hash, score) "
+                    "JOIN codex_books b ON b.id = t.book_id "
+                    "ON CONFLICT (book_id, user_hash) DO UPDATE SET score = EXCLUDED.score, updated_at = NOW()",
+                    books, users, scores);
+            },
+            [this, batch = std::move(batch)](std::exception_ptr error, pqxx::result result) {
+                std::lock_guard<std::mutex> lock(m_pending_mutex);
+                m_flushing = false;
+                if (!error) {
+                    const auto written = std::min(static_cast<std::size_t>(result.affected_rows()), batch.size());
+                    ++m_flushes;
+                    m_written += written;
+                    m_discarded += batch.size() - written;
+                    return;
+                }
+                ++m_flush_failures;
+                for (const auto& [key, score]: batch) m_pending.try_emplace(key, score);
+                try { std::rethrow_exception(error); }
+                catch (const std::exception& e) { SPDLOG_WARN("Writing {} book ratings failed: {}", batch.size(), e.what()); }
+            });
+    }
+};
+
+inline book_ratings& get_book_ratings() {
+    static book_ratings instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // BOOK_RATINGS_HPP
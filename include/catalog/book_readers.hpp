@@ -0,0 +1,314 @@
+#ifndef BOOK_READERS_HPP
+#define BOOK_READERS_HPP
+
+#include <catalog/hyperloglog.hpp>
+#include <database/db_async.hpp>
+#include <database/db_ops.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pqxx/pqxx>
+#include <spdlog/spdlog.h>
+
+namespace geecodex::catalog {
+namespace net = boost::asio;
+
+struct book_readers_config {
+    std::chrono::seconds flush_interval{60};
+    std::size_t flush_batch = 1000;         // sketches written per flush; the rest wait for the next one
+
+    // GEECODEX_READERS_FLUSH_SECONDS and GEECODEX_READERS_FLUSH_BATCH.
+    static book_readers_config from_env() {
+        book_readers_config config;
+        config.flush_interval = std::chrono::seconds{std::max(1LL, utils::env_int("GEECODEX_READERS_FLUSH_SECONDS", config.flush_interval.count()))};
+        config.flush_batch = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_READERS_FLUSH_BATCH", static_cast<long long>(config.flush_batch))));
+        return config;
+    }
+};
+
+// Approximate number of distinct readers per book: everyone who downloaded
+// the PDF or fetched the cover, identified by a hashed visitor key.
+//
+// Each book has one HyperLogLog sketch, so memory is at most 12 KiB a book
+// however much traffic it gets, and a repeat visit changes nothing. Sketches
+// live in lock-striped maps; recording is one register update under the
+// stripe's mutex. Sketches that changed are written to `book_readers` every
+// flush interval. The flush reads the stored sketch under a row lock and
+// merges it in first, then merges the result back into memory, so servers
+// sharing the table count each visitor once and all converge on the union.
+class book_readers {
+public:
+    explicit book_readers(book_readers_config config = book_readers_config::from_env())
+        : m_config{config} {}
+
+    book_readers(const book_readers&) = delete;
+    book_readers& operator=(const book_readers&) = delete;
+
+    // A device id or address becomes a well mixed 64-bit hash; only the
+    // hash's leading zeros and top bits reach a sketch.
+    static std::uint64_t visitor_hash(std::string_view key) {
+        std::uint64_t h = 1469598103934665603ull;       // FNV-1a, then the murmur3 finalizer
+        for (unsigned char c: key) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb93fe53ec26bull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    void record(int book_id, std::uint64_t visitor) {
+        m_recorded.fetch_add(1, std::memory_order_relaxed);
+        auto& s = stripe(book_id);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto& entry = s.books[book_id];
+        if (entry.sketch.add(visitor)) entry.dirty = true;
+    }
+
+    [[nodiscard]] std::uint64_t estimate(int book_id) const {
+        const auto& s = stripe(book_id);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.books.find(book_id);
+        return it == s.books.end() ? 0 : it->second.sketch.estimate();
+    }
+
+    // Blocking load of the persisted sketches, for startup.
+    void load() {
+        const auto started = std::chrono::steady_clock::now();
+        auto rows = database::execute_query("SELECT book_id, encode(sketch, 'hex') AS sketch FROM book_readers;");
+        std::size_t loaded = 0;
+        for (const auto& row: rows) {
+            auto sketch = from_hex(row["sketch"].as<std::string>());
+            if (!sketch) continue;
+            const int book_id = row["book_id"].as<int>();
+            auto& s = stripe(book_id);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.books[book_id].sketch.merge(*sketch);
+            ++loaded;
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        SPDLOG_INFO("Loaded {} book reader sketches in {} ms", loaded, elapsed.count());
+    }
+
+    // Flushes on `executor`'s timer from now on. Call once.
+    void start(net::any_io_executor executor) {
+        m_timer = std::make_unique<net::steady_timer>(executor);
+        arm();
+    }
+
+    nlohmann::json stats() const {
+        std::size_t books = 0, dirty = 0, bytes = 0;
+        for (const auto& s: m_stripes) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            books += s.books.size();
+            for (const auto& [id, entry]: s.books) {
+                if (entry.dirty) ++dirty;
+                bytes += entry.sketch.bytes();
+            }
+        }
+        nlohmann::json out;
+        out["books"] = books;
+        out["dirty"] = dirty;
+        out["sketch_bytes"] = bytes;
+        out["recorded"] = m_recorded.load(std::memory_order_relaxed);
+        out["flushing"] = m_flushing.load(std::memory_order_relaxed);
+        out["flushes"] = m_flushes.load(std::memory_order_relaxed);
+        out["flush_failures"] = m_flush_failures.load(std::memory_order_relaxed);
+        out["written"] = m_written.load(std::memory_order_relaxed);
+        out["dropped"] = m_dropped.load(std::memory_order_relaxed);     // sketches of deleted books
+        out["flush_interval_s"] = m_config.flush_interval.count();
+        return out;
+    }
+
+private:
+    static constexpr std::size_t stripe_count = 64;
+
+    struct entry {
+        hyperloglog sketch;
+        bool dirty = false;         // changed since it was last written
+    };
+
+    struct stripe_t {
+        mutable std::mutex mutex;
+        std::unordered_map<int, entry> books;
+    };
+
+    struct pending {
+        int book_id = 0;
+        hyperloglog sketch;
+        bool exists = false;        // the book is still in codex_books
+    };
+    using batch_t = std::vector<pending>;
+
+    book_readers_config m_config;
+    std::array<stripe_t, stripe_count> m_stripes;
+    std::unique_ptr<net::steady_timer> m_timer;
+    std::atomic<bool> m_flushing{false};
+    std::atomic<std::uint64_t> m_recorded{0};
+    std::atomic<std::uint64_t> m_flushes{0};
+    std::atomic<std::uint64_t> m_flush_failures{0};
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+
+    stripe_t& stripe(int book_id) { return m_stripes[static_cast<unsigned>(book_id) % stripe_count]; }
+    const stripe_t& stripe(int book_id) const { return m_stripes[static_cast<unsigned>(book_id) % stripe_count]; }
+
+    static std::string to_hex(std::string_view bytes) {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string out;
+        out.reserve(bytes.size() * 2);
+        for (unsigned char c: bytes) {
+            out.push_back(digits[c >> 4]);
+            out.push_back(digits[c & 0xf]);
+        }
+        return out;
+    }
+
+    static std::optional<hyperloglog> from_hex(std::string_view hex) {
+        auto nibble = [](char c) -> int {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+        if (hex.size() % 2 != 0) return std::nullopt;
+        std::string bytes;
+        bytes.reserve(hex.size() / 2);
+        for (std::size_t i = 0; i < hex.size(); i += 2) {
+            const int high = nibble(hex[i]), low = nibble(hex[i + 1]);
+            if (high < 0 || low < 0) return std::nullopt;
+            bytes.push_back(static_cast<char>(high << 4 | low));
+        }
+        return hyperloglog::deserialize(bytes);
+    }
+
+    void arm() {
+        m_timer->expires_after(m_config.flush_interval);
+        m_timer->async_wait([this](boost::system::error_code ec) {
+            if (ec) return;
+            flush();
+            arm();
+        });
+    }
+
+    // Copies up to flush_batch changed sketches and writes them in one
+    // transaction; one flush in flight at a time. Missing rows are seeded
+    // with an empty sketch first, so the row lock below also covers books
+    // no server has written yet. Only books still in codex_books are seeded,
+    // and sketches of deleted books are dropped instead of failing the
+    // batch. A failed batch is marked dirty again and retried on the next tick.
+    void flush() {
+        if (m_flushing.exchange(true)) return;
+
+        auto batch = std::make_shared<batch_t>();
+        for (auto& s: m_stripes) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (auto& [id, entry]: s.books) {
+                if (batch->size() >= m_config.flush_batch) break;
+                if (!entry.dirty) continue;
+                batch->push_back({id, entry.sketch});
+                entry.dirty = false;
+            }
+        }
+        if (batch->empty()) {
+            m_flushing = false;
+            return;
+        }
+        // Row locks are taken in id order, so concurrent servers cannot deadlock.
+        std::sort(batch->begin(), batch->end(), [](const auto& x, const auto& y) { return x.book_id < y.book_id; });
+
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [batch](pqxx::work& txn) {
+                std::string ids = "{";
+                for (const auto& item: *batch) ids += (ids.size() > 1 ? "," : "") + std::to_string(item.book_id);
+                ids += '}';
+
+                // A concurrent seed of the same row waits for the other
+                // transaction and then does nothing, so either way the row
+                // exists before it is locked.
+                txn.exec_params(
+                    "INSERT INTO book_readers (book_id, sketch) "
+                    "SELECT b.id, decode('01', 'hex') FROM codex_books b "
+                    "WHERE b.id = ANY($1::int[]) ORDER BY b.id "
+                    "ON CONFLICT (book_id) DO NOTHING", ids);
+                auto stored = txn.exec_params(
+                    "SELECT book_id, encode(sketch, 'hex') AS sketch FROM book_readers "
+                    "WHERE book_id = ANY($1::int[]) ORDER BY book_id FOR UPDATE", ids);
+                for (const auto& row: stored) {
+                    const int book_id = row["book_id"].as<int>();
+                    auto it = std::lower_bound(batch->begin(), batch->end(), book_id, [](const auto& item, int id) { return item.book_id < id; });
+                    if (it == batch->end() || it->book_id != book_id) continue;
+                    it->exists = true;
+                    if (auto theirs = from_hex(row["sketch"].as<std::string>())) it->sketch.merge(*theirs);
+                }
+
+                std::string write_ids = "{", sketches = "{";
+                for (const auto& item: *batch) {
+                    if (!item.exists) continue;
+                    write_ids += (write_ids.size() > 1 ? "," : "") + std::to_string(item.book_id);
+                    sketches += (sketches.size() > 1 ? "," : "") + to_hex(item.sketch.serialize());
+                }
+                write_ids += '}';
+                sketches += '}';
+                return txn.exec_params(
+                    "UPDATE book_readers r SET sketch = decode(t.hex, 'hex'), updated_at = NOW() "
+                    "FROM unnest($1::int[], $2::text[]) AS t(id, hex) WHERE r.book_id = t.id",
+                    write_ids, sketches);
+            },
+            [this, batch](std::exception_ptr error, pqxx::result) {
+                std::size_t written = 0, dropped = 0;
+                for (const auto& item: *batch) {
+                    auto& s = stripe(item.book_id);
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    if (error) {
+                        s.books[item.book_id].dirty = true;
+                    } else if (!item.exists) {
+                        s.books.erase(item.book_id);        // the book was deleted
+                        ++dropped;
+                    } else {
+                        s.books[item.book_id].sketch.merge(item.sketch);   // picks up readers other servers counted
+                        ++written;
+                    }
+                }
+                if (!error) {
+                    m_flushes.fetch_add(1, std::memory_order_relaxed);
+                    m_written.fetch_add(written, std::memory_order_relaxed);
+                    m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+                } else {
+                    m_flush_failures.fetch_add(1, std::memory_order_relaxed);
+                    try { std::rethrow_exception(error); }
+                    catch (const std::exception& e) { SPDLOG_WARN("Writing {} book reader sketches failed: {}", batch->size(), e.what()); }
+                }
+                m_flushing = false;
+            });
+    }
+};
+
+inline book_readers& get_book_readers() {
+    static book_readers instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // BOOK_READERS_HPP
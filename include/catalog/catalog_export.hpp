@@ -0,0 +1,187 @@
+#ifndef CATALOG_EXPORT_HPP
+#define CATALOG_EXPORT_HPP
+
+#include <catalog/book_catalog.hpp>
+#include <catalog/derived_index.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef GEECODEX_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::catalog {
+
+struct catalog_export_config {
+    int zstd_level = 6;
+    std::size_t max_changes = 1000;         // beyond this a client is told to take the snapshot
+
+    // GEECODEX_CATALOG_ZSTD_LEVEL and GEECODEX_SYNC_MAX_CHANGES.
+    static catalog_export_config from_env() {
+        catalog_export_config config;
+        config.zstd_level = static_cast<int>(std::clamp(utils::env_int("GEECODEX_CATALOG_ZSTD_LEVEL", config.zstd_level), 1LL, 19LL));
+        config.max_changes = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_SYNC_MAX_CHANGES", static_cast<long long>(config.max_changes))));
+        return config;
+    }
+};
+
+// A book as offline clients store it: the listing columns that only change
+// when the book is edited, so a client copy is current as of the export's
+// version. Counters such as download_count move with traffic, not with the
+// catalog, and are left to the listing endpoints.
+inline nlohmann::json sync_book_json(const book& b) {
+    auto optional_json = [](const auto& value) -> nlohmann::json {
+        if (value) return *value;
+        return nullptr;
+    };
+    nlohmann::json out;
+    out["id"] = b.id;
+    out["title"] = b.title;
+    out["author"] = optional_json(b.author);
+    out["isbn"] = optional_json(b.isbn);
+    out["publisher"] = optional_json(b.publisher);
+    out["publish_date"] = optional_json(b.publish_date);
+    out["language"] = optional_json(b.language);
+    out["page_count"] = optional_json(b.page_count);
+    out["description"] = optional_json(b.description);
+    out["created_at"] = optional_json(b.created_at);
+    out["tags"] = b.tags;
+    out["category"] = optional_json(b.category);
+    return out;
+}
+
+struct catalog_changes {
+    std::vector<std::shared_ptr<const book>> changed;   // active books to add or replace
+    std::vector<int> deleted;                           // ids to drop: deleted or deactivated
+};
+
+// Catalog export for offline clients, built once per catalog snapshot.
+//
+// The full snapshot is serialized once, {"version", "books"} with every
+// active book newest first, and compressed with zstd when the server is
+// built with it; responses share the blob. Its ETag is a hash of the
+// JSON. The version is the snapshot's high-water mark (epoch microseconds
+// of the newest update or deletion), so it compares across servers and
+// restarts. For deltas the books are also kept ordered by updated_at and
+// the deletions by deleted_at, and changes_since() is two binary searches.
+class catalog_export {
+public:
+    explicit catalog_export(const catalog& source)
+        : m_config{config()}
+        , m_version{source.high_water_us()}
+        , m_deletions_tracked{source.deletions_tracked()} {
+        nlohmann::json books = nlohmann::json::array();
+        for (const auto& b: source.newest()) books.push_back(sync_book_json(*b));
+        nlohmann::json body;
+        body["version"] = m_version;
+        body["books"] = std::move(books);
+        auto json = std::make_shared<std::string>(body.dump());
+        if (auto packed = compress(*json, m_config.zstd_level); !packed.empty())
+            m_zstd = std::make_shared<const std::string>(std::move(packed));
+
+        std::uint64_t h = 1469598103934665603ull;           // FNV-1a
+        for (unsigned char c: *json) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        char tag[24];
+        std::snprintf(tag, sizeof(tag), "%016llx", static_cast<unsigned long long>(h));
+        m_etag = tag;
+        m_json = std::move(json);
+
+        m_updates.reserve(source.all().size());
+        for (const auto& [id, b]: source.all()) m_updates.push_back(b);
+        std::sort(m_updates.begin(), m_updates.end(), [](const auto& x, const auto& y) { return x->updated_us < y->updated_us; });
+        m_deletions.assign(source.deleted().begin(), source.deleted().end());
+        std::sort(m_deletions.begin(), m_deletions.end(), [](const auto& x, const auto& y) { return x.second < y.second; });
+    }
+
+    [[nodiscard]] std::int64_t version() const { return m_version; }
+    // The blobs are shared, so responses can send them without a copy.
+    [[nodiscard]] std::shared_ptr<const std::string> json() const { return m_json; }
+    // Null when built without zstd or compression failed.
+    [[nodiscard]] std::shared_ptr<const std::string> zstd() const { return m_zstd; }
+    // Hex hash of json(); the HTTP layer quotes it and marks the encoding.
+    [[nodiscard]] const std::string& etag() const { return m_etag; }
+    // Without the deletion log a delta could miss deleted books.
+    [[nodiscard]] bool deletions_tracked() const { return m_deletions_tracked; }
+
+    // Books updated or deleted after `since_us`; nullopt when there are
+    // more than max_changes of them and the snapshot is the cheaper answer.
+    [[nodiscard]] std::optional<catalog_changes> changes_since(std::int64_t since_us) const {
+        auto first_update = std::partition_point(m_updates.begin(), m_updates.end(), [since_us](const auto& b) { return b->updated_us <= since_us; });
+        auto first_deletion = std::partition_point(m_deletions.begin(), m_deletions.end(), [since_us](const auto& d) { return d.second <= since_us; });
+        const auto total = static_cast<std::size_t>((m_updates.end() - first_update) + (m_deletions.end() - first_deletion));
+        if (total > m_config.max_changes) return std::nullopt;
+
+        catalog_changes out;
+        for (auto it = first_update; it != m_updates.end(); ++it) {
+            if ((*it)->is_active) out.changed.push_back(*it);
+            else out.deleted.push_back((*it)->id);
+        }
+        for (auto it = first_deletion; it != m_deletions.end(); ++it) out.deleted.push_back(it->first);
+        return out;
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        out["version"] = m_version;
+        out["books"] = m_updates.size();
+        out["deleted"] = m_deletions.size();
+        out["json_bytes"] = m_json->size();
+        out["zstd_bytes"] = m_zstd ? m_zstd->size() : 0;
+        out["zstd_level"] = m_config.zstd_level;
+        out["deletions_tracked"] = m_deletions_tracked;
+        return out;
+    }
+
+private:
+    catalog_export_config m_config;
+    std::int64_t m_version = 0;
+    bool m_deletions_tracked = false;
+    std::shared_ptr<const std::string> m_json;
+    std::shared_ptr<const std::string> m_zstd;
+    std::string m_etag;
+    std::vector<std::shared_ptr<const book>> m_updates;     // every book, oldest updated_at first
+    std::vector<std::pair<int, std::int64_t>> m_deletions;  // (id, deleted_us), oldest first
+
+    static const catalog_export_config& config() {
+        static const auto instance = catalog_export_config::from_env();
+        return instance;
+    }
+
+    static std::string compress([[maybe_unused]] const std::string& input, [[maybe_unused]] int level) {
+#ifdef GEECODEX_WITH_ZSTD
+        std::string out(ZSTD_compressBound(input.size()), '\0');
+        const auto written = ZSTD_compress(out.data(), out.size(), input.data(), input.size(), level);
+        if (ZSTD_isError(written)) {
+            SPDLOG_WARN("Compressing the catalog export failed: {}", ZSTD_getErrorName(written));
+            return {};
+        }
+        out.resize(written);
+        out.shrink_to_fit();
+        return out;
+#else
+        return {};
+#endif
+    }
+};
+
+inline derived_index<catalog_export>& get_catalog_export() {
+    static derived_index<catalog_export> instance{"catalog export"};
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // CATALOG_EXPORT_HPP
@@ -0,0 +1,92 @@
+#ifndef DERIVED_INDEX_HPP
+#define DERIVED_INDEX_HPP
+
+#include <catalog/book_catalog.hpp>
+#include <json.hpp>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::catalog {
+
+// Thread the derived indexes are built on, so neither the I/O threads nor
+// the database worker pay for a rebuild.
+inline net::thread_pool& get_index_thread_pool() {
+    static net::thread_pool pool{1};
+    return pool;
+}
+
+// Read-only structure computed from a catalog snapshot, e.g. the search
+// index. `Index` is constructed from `const catalog&` on the index thread
+// every time the catalog publishes a new snapshot and then swapped in whole;
+// publishes that arrive while a rebuild is queued are folded into it.
+template <typename Index>
+class derived_index {
+public:
+    explicit derived_index(std::string name, book_catalog& source = get_book_catalog())
+        : m_name{std::move(name)}
+        , m_source{source} {
+        m_source.on_publish([this](const std::shared_ptr<const catalog>&) { schedule(); });
+        if (m_source.snapshot()) schedule();
+    }
+
+    // Null until the first build finished.
+    [[nodiscard]] std::shared_ptr<const Index> get() const { return m_current.load(std::memory_order_acquire); }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        out["catalog_version"] = m_built_version.load(std::memory_order_relaxed);
+        out["builds"] = m_builds.load(std::memory_order_relaxed);
+        out["build_failures"] = m_failures.load(std::memory_order_relaxed);
+        out["last_build_ms"] = static_cast<double>(m_last_build_us.load(std::memory_order_relaxed)) / 1000.0;
+        return out;
+    }
+
+private:
+    std::string m_name;
+    book_catalog& m_source;
+    std::atomic<std::shared_ptr<const Index>> m_current;
+    std::atomic<bool> m_scheduled{false};
+
+    std::atomic<std::uint64_t> m_built_version{0};
+    std::atomic<std::uint64_t> m_builds{0};
+    std::atomic<std::uint64_t> m_failures{0};
+    std::atomic<std::uint64_t> m_last_build_us{0};
+
+    void schedule() {
+        if (m_scheduled.exchange(true)) return;
+        net::post(get_index_thread_pool(), [this] { rebuild(); });
+    }
+
+    void rebuild() {
+        m_scheduled = false;
+        auto snapshot = m_source.snapshot();
+        if (!snapshot || snapshot->version() == m_built_version.load(std::memory_order_relaxed)) return;
+
+        const auto started = std::chrono::steady_clock::now();
+        try {
+            m_current.store(std::make_shared<const Index>(*snapshot), std::memory_order_release);
+        } catch (const std::exception& e) {
+            m_failures.fetch_add(1, std::memory_order_relaxed);
+            SPDLOG_ERROR("Rebuilding {} for catalog v{} failed: {}", m_name, snapshot->version(), e.what());
+            return;
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        m_built_version.store(snapshot->version(), std::memory_order_relaxed);
+        m_last_build_us.store(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+        m_builds.fetch_add(1, std::memory_order_relaxed);
+        SPDLOG_INFO("Rebuilt {} for catalog v{} in {} us", m_name, snapshot->version(), elapsed.count());
+    }
+};
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // DERIVED_INDEX_HPP
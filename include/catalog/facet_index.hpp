@@ -0,0 +1,166 @@
+#ifndef FACET_INDEX_HPP
+#define FACET_INDEX_HPP
+
+#include <catalog/book_catalog.hpp>
+#include <catalog/derived_index.hpp>
+#include <catalog/roaring_bitmap.hpp>
+#include <json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace geecodex::catalog {
+
+enum class facet { category = 0, language, tag, access_level };
+
+inline constexpr std::array<std::string_view, 4> facet_names{"category", "language", "tag", "access_level"};
+
+inline std::optional<facet> parse_facet(std::string_view name) {
+    for (std::size_t i = 0; i < facet_names.size(); ++i)
+        if (facet_names[i] == name) return static_cast<facet>(i);
+    return std::nullopt;
+}
+
+// Values of one facet a request filters on; a book matches if it has any of them.
+struct facet_filter {
+    facet which = facet::category;
+    std::vector<std::string> values;
+};
+
+struct facet_count {
+    std::string value;
+    std::uint64_t count = 0;
+};
+
+struct facet_result {
+    std::uint64_t total = 0;
+    std::vector<std::shared_ptr<const book>> books;         // the requested page, newest first
+    std::array<std::vector<facet_count>, facet_names.size()> counts;
+};
+
+// One roaring bitmap per facet value over the active books of a snapshot,
+// addressed by dense ordinals (0 = newest book). Filters are ORed within a
+// facet and ANDed across facets. Each facet's counts ignore that facet's own
+// filter, so a client can show how many books the other values would give.
+// Values compare ASCII case-insensitively and are reported as first seen.
+class facet_index {
+public:
+    explicit facet_index(const catalog& source) {
+        const auto& books = source.newest();
+        m_books.assign(books.begin(), books.end());
+        m_all = roaring_bitmap::range(static_cast<std::uint32_t>(m_books.size()));
+        for (std::uint32_t ordinal = 0; ordinal < m_books.size(); ++ordinal) {
+            const auto& b = *m_books[ordinal];
+            if (b.category) add(facet::category, *b.category, ordinal);
+            if (b.language) add(facet::language, *b.language, ordinal);
+            for (const auto& tag: b.tags) add(facet::tag, tag, ordinal);
+            add(facet::access_level, std::to_string(b.access_level), ordinal);
+        }
+    }
+
+    [[nodiscard]] facet_result query(const std::vector<facet_filter>& filters, std::size_t offset, std::size_t limit,
+                                     std::size_t values_per_facet) const {
+        std::array<std::optional<roaring_bitmap>, facet_names.size()> selected;
+        for (const auto& filter: filters) {
+            auto& slot = selected[static_cast<std::size_t>(filter.which)];
+            if (!slot) slot.emplace();
+            for (const auto& value: filter.values)
+                if (const auto* members = find(filter.which, value)) *slot = *slot | *members;
+        }
+
+        facet_result result;
+        roaring_bitmap matching = m_all;
+        for (const auto& slot: selected)
+            if (slot) matching = matching & *slot;
+        result.total = matching.cardinality();
+
+        std::size_t skipped = 0;
+        matching.for_each([&](std::uint32_t ordinal) {
+            if (skipped < offset) { ++skipped; return true; }
+            if (result.books.size() >= limit) return false;
+            result.books.push_back(m_books[ordinal]);
+            return true;
+        });
+
+        for (std::size_t f = 0; f < facet_names.size() && values_per_facet > 0; ++f) {
+            // Without a filter on this facet, `matching` is already the base.
+            roaring_bitmap others_storage;
+            const roaring_bitmap* base = &matching;
+            if (selected[f]) {
+                others_storage = m_all;
+                for (std::size_t g = 0; g < selected.size(); ++g)
+                    if (g != f && selected[g]) others_storage = others_storage & *selected[g];
+                base = &others_storage;
+            }
+            auto& counts = result.counts[f];
+            for (const auto& [key, entry]: m_values[f]) {
+                const auto count = roaring_bitmap::and_cardinality(*base, entry.members);
+                if (count > 0) counts.push_back({entry.display, count});
+            }
+            const auto keep = std::min(counts.size(), values_per_facet);
+            std::partial_sort(counts.begin(), counts.begin() + static_cast<std::ptrdiff_t>(keep), counts.end(), [](const auto& x, const auto& y) {
+                if (x.count != y.count) return x.count > y.count;
+                return x.value < y.value;
+            });
+            counts.resize(keep);
+        }
+        return result;
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        std::size_t bytes = m_all.bytes();
+        out["books"] = m_books.size();
+        for (std::size_t f = 0; f < facet_names.size(); ++f) {
+            out["values"][std::string{facet_names[f]}] = m_values[f].size();
+            for (const auto& [key, entry]: m_values[f]) bytes += entry.members.bytes();
+        }
+        out["bitmap_bytes"] = bytes;
+        return out;
+    }
+
+private:
+    struct value_entry {
+        std::string display;
+        roaring_bitmap members;
+    };
+
+    std::vector<std::shared_ptr<const book>> m_books;       // by ordinal
+    roaring_bitmap m_all;
+    std::array<std::unordered_map<std::string, value_entry>, facet_names.size()> m_values;  // by folded value
+
+    static std::string fold(std::string_view value) {
+        std::string out{value};
+        for (auto& c: out)
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        return out;
+    }
+
+    void add(facet which, const std::string& value, std::uint32_t ordinal) {
+        if (value.empty()) return;
+        auto& entry = m_values[static_cast<std::size_t>(which)][fold(value)];
+        if (entry.display.empty()) entry.display = value;
+        entry.members.add(ordinal);
+    }
+
+    [[nodiscard]] const roaring_bitmap* find(facet which, std::string_view value) const {
+        const auto& values = m_values[static_cast<std::size_t>(which)];
+        auto it = values.find(fold(value));
+        return it == values.end() ? nullptr : &it->second.members;
+    }
+};
+
+inline derived_index<facet_index>& get_book_facets() {
+    static derived_index<facet_index> instance{"book facet index"};
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // FACET_INDEX_HPP
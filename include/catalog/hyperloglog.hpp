@@ -0,0 +1,166 @@
+#ifndef HYPERLOGLOG_HPP
+#define HYPERLOGLOG_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace geecodex::catalog {
+
+// HyperLogLog distinct counter with 2^14 registers (about 0.8% standard
+// error). Small sketches stay sparse, a sorted list of (register, rank);
+// past dense_threshold entries they switch to 6-bit registers packed into
+// 12 KiB. Sketches merge by register-wise maximum, so counts from several
+// threads or servers combine without double counting.
+//
+// Once dense, the sum of 2^-register and the number of empty registers are
+// kept up to date on every change, which makes estimate() O(1).
+class hyperloglog {
+public:
+    static constexpr unsigned precision = 14;
+    static constexpr std::size_t registers = std::size_t{1} << precision;
+    static constexpr std::size_t dense_bytes = registers * 6 / 8;          // 12288
+    static constexpr std::size_t dense_threshold = dense_bytes / 16;      // sparse entries are 4 bytes
+
+    // `hash` must be a well mixed 64-bit hash; returns whether a register grew.
+    bool add(std::uint64_t hash) {
+        const auto index = static_cast<std::uint32_t>(hash >> (64 - precision));
+        const std::uint64_t rest = hash << precision;
+        const auto rank = static_cast<std::uint8_t>(std::min<int>(std::countl_zero(rest), 64 - precision) + 1);
+        return raise(index, rank);
+    }
+
+    void merge(const hyperloglog& other) {
+        if (other.m_dense.empty()) {
+            for (auto entry: other.m_sparse) raise(entry >> 8, static_cast<std::uint8_t>(entry & 0xff));
+            return;
+        }
+        for (std::uint32_t i = 0; i < registers; ++i)
+            if (auto rank = other.get_dense(i)) raise(i, rank);
+    }
+
+    [[nodiscard]] std::uint64_t estimate() const {
+        constexpr double m = static_cast<double>(registers);
+        // A sparse sketch has at most dense_threshold registers set, far
+        // inside the range where linear counting is the better estimate.
+        if (m_dense.empty()) return linear_count(registers - m_sparse.size());
+        const double alpha = 0.7213 / (1.0 + 1.079 / m);
+        const double raw = alpha * m * m / m_inverse_sum;
+        // The raw estimate is biased upwards below 2.5m.
+        if (raw <= 2.5 * m && m_zeros > 0) return linear_count(m_zeros);
+        return static_cast<std::uint64_t>(std::llround(raw));
+    }
+
+    [[nodiscard]] bool empty() const { return m_sparse.empty() && m_dense.empty(); }
+    [[nodiscard]] std::size_t bytes() const { return m_sparse.capacity() * sizeof(std::uint32_t) + m_dense.capacity(); }
+
+    // Byte 0 says which form follows: 1 = sparse (big-endian uint32
+    // entries), 2 = dense (the packed registers).
+    [[nodiscard]] std::string serialize() const {
+        std::string out;
+        if (m_dense.empty()) {
+            out.reserve(1 + m_sparse.size() * 4);
+            out.push_back(static_cast<char>(1));
+            for (auto entry: m_sparse)
+                for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<char>((entry >> shift) & 0xff));
+        } else {
+            out.reserve(1 + dense_bytes);
+            out.push_back(static_cast<char>(2));
+            out.append(reinterpret_cast<const char*>(m_dense.data()), dense_bytes);
+        }
+        return out;
+    }
+
+    static std::optional<hyperloglog> deserialize(std::string_view data) {
+        hyperloglog out;
+        if (data.empty()) return std::nullopt;
+        const auto body = data.substr(1);
+        if (data[0] == 1 && body.size() % 4 == 0) {
+            for (std::size_t i = 0; i < body.size(); i += 4) {
+                std::uint32_t entry = 0;
+                for (std::size_t k = 0; k < 4; ++k) entry = (entry << 8) | static_cast<unsigned char>(body[i + k]);
+                const std::uint32_t index = entry >> 8;
+                const auto rank = static_cast<std::uint8_t>(entry & 0xff);
+                if (index >= registers || rank == 0 || rank > 64 - precision + 1) return std::nullopt;
+                out.raise(index, rank);
+            }
+            return out;
+        }
+        if (data[0] == 2 && body.size() == dense_bytes) {
+            hyperloglog packed;
+            packed.m_dense.assign(body.begin(), body.end());
+            for (std::uint32_t i = 0; i < registers; ++i)
+                if (auto rank = packed.get_dense(i)) out.raise(i, std::min<std::uint8_t>(rank, 64 - precision + 1));
+            return out;
+        }
+        return std::nullopt;
+    }
+
+private:
+    std::vector<std::uint32_t> m_sparse;        // index << 8 | rank, sorted by index
+    std::vector<std::uint8_t> m_dense;          // empty while sparse
+    double m_inverse_sum = 0.0;                 // dense only: sum of 2^-register
+    std::uint32_t m_zeros = 0;                  // dense only: registers still 0
+
+    [[nodiscard]] std::uint8_t get_dense(std::uint32_t index) const {
+        const std::size_t bit = std::size_t{index} * 6;
+        const std::size_t byte = bit / 8;
+        unsigned word = m_dense[byte];
+        if (byte + 1 < m_dense.size()) word |= static_cast<unsigned>(m_dense[byte + 1]) << 8;
+        return static_cast<std::uint8_t>((word >> (bit % 8)) & 0x3f);
+    }
+
+    void set_dense(std::uint32_t index, std::uint8_t rank) {
+        const std::size_t bit = std::size_t{index} * 6;
+        const std::size_t byte = bit / 8;
+        const unsigned shift = bit % 8;
+        unsigned word = m_dense[byte];
+        if (byte + 1 < m_dense.size()) word |= static_cast<unsigned>(m_dense[byte + 1]) << 8;
+        word = (word & ~(0x3fu << shift)) | (static_cast<unsigned>(rank) << shift);
+        m_dense[byte] = static_cast<std::uint8_t>(word);
+        if (byte + 1 < m_dense.size()) m_dense[byte + 1] = static_cast<std::uint8_t>(word >> 8);
+    }
+
+    static std::uint64_t linear_count(std::size_t zeros) {
+        constexpr double m = static_cast<double>(registers);
+        return static_cast<std::uint64_t>(std::llround(m * std::log(m / static_cast<double>(zeros))));
+    }
+
+    bool raise(std::uint32_t index, std::uint8_t rank) {
+        if (!m_dense.empty()) {
+            const auto current = get_dense(index);
+            if (rank <= current) return false;
+            set_dense(index, rank);
+            m_inverse_sum += std::ldexp(1.0, -static_cast<int>(rank)) - std::ldexp(1.0, -static_cast<int>(current));
+            if (current == 0) --m_zeros;
+            return true;
+        }
+
+        auto it = std::lower_bound(m_sparse.begin(), m_sparse.end(), index << 8);
+        if (it != m_sparse.end() && (*it >> 8) == index) {
+            if (rank <= (*it & 0xff)) return false;
+            *it = (index << 8) | rank;
+            return true;
+        }
+        m_sparse.insert(it, (index << 8) | rank);
+        if (m_sparse.size() > dense_threshold) densify();
+        return true;
+    }
+
+    void densify() {
+        m_dense.assign(dense_bytes, 0);
+        m_zeros = static_cast<std::uint32_t>(registers);
+        m_inverse_sum = static_cast<double>(registers);
+        std::vector<std::uint32_t> entries;
+        entries.swap(m_sparse);
+        for (auto entry: entries) raise(entry >> 8, static_cast<std::uint8_t>(entry & 0xff));
+    }
+};
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // HYPERLOGLOG_HPP
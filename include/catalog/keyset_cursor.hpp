@@ -0,0 +1,70 @@
+#ifndef KEYSET_CURSOR_HPP
+#define KEYSET_CURSOR_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace geecodex::catalog {
+
+// Position in the newest-first book order: (created_at, id) of the last
+// book a client has seen.
+struct book_key {
+    std::int64_t created_us = 0;
+    int id = 0;
+};
+
+// Cursors are opaque to clients: a version byte and the key, big-endian,
+// as unpadded base64url (18 characters). Anything else fails to decode.
+namespace keyset_cursor {
+
+inline constexpr std::uint8_t version = 1;
+inline constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+inline std::string encode(const book_key& key) {
+    std::array<std::uint8_t, 15> raw{};     // 13 bytes used, padded to a multiple of 3
+    raw[0] = version;
+    const auto created = static_cast<std::uint64_t>(key.created_us);
+    for (int i = 0; i < 8; ++i) raw[1 + i] = static_cast<std::uint8_t>(created >> (56 - 8 * i));
+    const auto id = static_cast<std::uint32_t>(key.id);
+    for (int i = 0; i < 4; ++i) raw[9 + i] = static_cast<std::uint8_t>(id >> (24 - 8 * i));
+
+    std::string out;
+    for (std::size_t i = 0; i < raw.size(); i += 3) {
+        const std::uint32_t group = (std::uint32_t{raw[i]} << 16) | (std::uint32_t{raw[i + 1]} << 8) | raw[i + 2];
+        for (int shift = 18; shift >= 0; shift -= 6) out.push_back(alphabet[(group >> shift) & 0x3f]);
+    }
+    out.resize(18);     // ceil(13 * 4 / 3)
+    return out;
+}
+
+inline std::optional<book_key> decode(std::string_view text) {
+    if (text.size() != 18) return std::nullopt;
+    std::array<std::uint8_t, 15> raw{};
+    std::uint32_t bits = 0;
+    int pending = 0;
+    std::size_t at = 0;
+    for (char c: text) {
+        const char* pos = std::char_traits<char>::find(alphabet, 64, c);
+        if (pos == nullptr) return std::nullopt;
+        bits = (bits << 6) | static_cast<std::uint32_t>(pos - alphabet);
+        pending += 6;
+        if (pending >= 8) {
+            pending -= 8;
+            raw[at++] = static_cast<std::uint8_t>(bits >> pending);
+        }
+    }
+    if (raw[0] != version) return std::nullopt;
+
+    std::uint64_t created = 0;
+    for (int i = 0; i < 8; ++i) created = (created << 8) | raw[1 + i];
+    std::uint32_t id = 0;
+    for (int i = 0; i < 4; ++i) id = (id << 8) | raw[9 + i];
+    return book_key{static_cast<std::int64_t>(created), static_cast<int>(id)};
+}
+
+}   // namespace keyset_cursor
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // KEYSET_CURSOR_HPP
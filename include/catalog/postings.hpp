@@ -0,0 +1,197 @@
+#ifndef POSTINGS_HPP
+#define POSTINGS_HPP
+
+#include <utils/simd.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Posting lists for the catalog search index: ascending book ordinals, each
+// with a small term frequency, delta + varint coded in blocks of 128 so a
+// lookup can skip whole blocks by their first/last ordinal and only decode
+// the ones that overlap its candidates.
+namespace geecodex::catalog {
+
+class posting_list {
+public:
+    static constexpr std::size_t block_size = 128;
+
+    struct block {
+        std::uint32_t first = 0;
+        std::uint32_t last = 0;
+        std::uint32_t offset = 0;       // into bytes()
+        std::uint32_t count = 0;
+    };
+
+    // Ordinals must be appended in strictly increasing order.
+    void add(std::uint32_t ordinal, std::uint16_t tf) {
+        if (m_blocks.empty() || m_blocks.back().count == block_size) {
+            m_blocks.push_back({ordinal, ordinal, static_cast<std::uint32_t>(m_bytes.size()), 0});
+            m_last = ordinal;
+        }
+        auto& current = m_blocks.back();
+        put_varint(ordinal - m_last);
+        put_varint(tf);
+        m_last = ordinal;
+        current.last = ordinal;
+        ++current.count;
+        ++m_size;
+    }
+
+    [[nodiscard]] std::size_t size() const { return m_size; }
+    [[nodiscard]] std::size_t bytes() const { return m_bytes.size() + m_blocks.size() * sizeof(block); }
+    [[nodiscard]] const std::vector<block>& blocks() const { return m_blocks; }
+
+    // Decodes block `index` into arrays of at least block_size entries.
+    std::size_t decode(std::size_t index, std::uint32_t* ordinals, std::uint16_t* tfs) const {
+        const auto& b = m_blocks[index];
+        const std::uint8_t* in = m_bytes.data() + b.offset;
+        std::uint32_t ordinal = b.first;
+        for (std::uint32_t i = 0; i < b.count; ++i) {
+            ordinal += get_varint(in);
+            ordinals[i] = ordinal;
+            tfs[i] = static_cast<std::uint16_t>(get_varint(in));
+        }
+        return b.count;
+    }
+
+    void decode_all(std::vector<std::uint32_t>& ordinals, std::vector<std::uint16_t>& tfs) const {
+        ordinals.resize(m_size);
+        tfs.resize(m_size);
+        std::size_t at = 0;
+        for (std::size_t i = 0; i < m_blocks.size(); ++i) at += decode(i, ordinals.data() + at, tfs.data() + at);
+    }
+
+    void shrink_to_fit() {
+        m_bytes.shrink_to_fit();
+        m_blocks.shrink_to_fit();
+    }
+
+private:
+    std::vector<std::uint8_t> m_bytes;
+    std::vector<block> m_blocks;
+    std::uint32_t m_size = 0;
+    std::uint32_t m_last = 0;
+
+    void put_varint(std::uint32_t value) {
+        while (value >= 0x80) {
+            m_bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        m_bytes.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    static std::uint32_t get_varint(const std::uint8_t*& in) {
+        std::uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            const std::uint8_t byte = *in++;
+            value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) return value;
+        }
+    }
+};
+
+// Sorted-set intersection of two ascending, duplicate-free ordinal arrays.
+// Writes the index into `a` and into `b` of every common value and returns
+// how many there are. `a` is expected to be the shorter side: the SIMD paths
+// compare each of its values against 8 (AVX2) or 4 (NEON) values of `b` at
+// a time.
+namespace postings {
+
+using utils::isa;
+using utils::active_isa;
+using utils::isa_name;
+
+namespace scalar {
+
+inline std::size_t intersect(const std::uint32_t* a, std::size_t na, const std::uint32_t* b, std::size_t nb,
+                             std::uint32_t* out_a, std::uint32_t* out_b) {
+    std::size_t i = 0, j = 0, n = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) ++i;
+        else if (b[j] < a[i]) ++j;
+        else { out_a[n] = static_cast<std::uint32_t>(i++); out_b[n++] = static_cast<std::uint32_t>(j++); }
+    }
+    return n;
+}
+
+}   // namespace scalar
+
+#if defined(GEECODEX_SIMD_X86)
+namespace avx2 {
+
+__attribute__((target("avx2")))
+inline std::size_t intersect(const std::uint32_t* a, std::size_t na, const std::uint32_t* b, std::size_t nb,
+                             std::uint32_t* out_a, std::uint32_t* out_b) {
+    std::size_t j = 0, n = 0;
+    for (std::size_t i = 0; i < na; ++i) {
+        const std::uint32_t value = a[i];
+        // Everything before j is below a previous, smaller value of `a`.
+        while (j + 8 <= nb && b[j + 7] < value) j += 8;
+        if (j + 8 <= nb) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+            const __m256i hit = _mm256_cmpeq_epi32(block, _mm256_set1_epi32(static_cast<int>(value)));
+            const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+            if (mask != 0) {
+                const std::size_t at = j + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+                out_a[n] = static_cast<std::uint32_t>(i);
+                out_b[n++] = static_cast<std::uint32_t>(at);
+                j = at + 1;
+            }
+            continue;
+        }
+        while (j < nb && b[j] < value) ++j;
+        if (j == nb) break;
+        if (b[j] == value) { out_a[n] = static_cast<std::uint32_t>(i); out_b[n++] = static_cast<std::uint32_t>(j++); }
+    }
+    return n;
+}
+
+}   // namespace avx2
+#endif
+
+#if defined(GEECODEX_SIMD_NEON)
+namespace neon {
+
+inline std::size_t intersect(const std::uint32_t* a, std::size_t na, const std::uint32_t* b, std::size_t nb,
+                             std::uint32_t* out_a, std::uint32_t* out_b) {
+    std::size_t j = 0, n = 0;
+    for (std::size_t i = 0; i < na; ++i) {
+        const std::uint32_t value = a[i];
+        while (j + 4 <= nb && b[j + 3] < value) j += 4;
+        if (j + 4 <= nb) {
+            const uint32x4_t hit = vceqq_u32(vld1q_u32(b + j), vdupq_n_u32(value));
+            if (vmaxvq_u32(hit) != 0) {
+                std::size_t at = j;
+                while (b[at] != value) ++at;
+                out_a[n] = static_cast<std::uint32_t>(i);
+                out_b[n++] = static_cast<std::uint32_t>(at);
+                j = at + 1;
+            }
+            continue;
+        }
+        while (j < nb && b[j] < value) ++j;
+        if (j == nb) break;
+        if (b[j] == value) { out_a[n] = static_cast<std::uint32_t>(i); out_b[n++] = static_cast<std::uint32_t>(j++); }
+    }
+    return n;
+}
+
+}   // namespace neon
+#endif
+
+inline std::size_t intersect(const std::uint32_t* a, std::size_t na, const std::uint32_t* b, std::size_t nb,
+                             std::uint32_t* out_a, std::uint32_t* out_b, isa which = active_isa()) {
+#if defined(GEECODEX_SIMD_X86)
+    if (which == isa::avx2) return avx2::intersect(a, na, b, nb, out_a, out_b);
+#elif defined(GEECODEX_SIMD_NEON)
+    if (which == isa::neon) return neon::intersect(a, na, b, nb, out_a, out_b);
+#endif
+    return scalar::intersect(a, na, b, nb, out_a, out_b);
+}
+
+}   // namespace postings
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // POSTINGS_HPP
@@ -0,0 +1,333 @@
+#ifndef ROARING_BITMAP_HPP
+#define ROARING_BITMAP_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace geecodex::catalog {
+
+// Word loops over bitmap containers. Without -mpopcnt std::popcount is a
+// bit-twiddling routine, so x86 switches to the POPCNT instruction at run
+// time (like the AVX2 kernels elsewhere, the default build stays portable).
+namespace roaring_words {
+
+// out[i] = x[i] & y[i] (out may be null); returns the number of set bits.
+inline std::uint32_t and_portable(const std::uint64_t* x, const std::uint64_t* y, std::uint64_t* out, std::size_t n) {
+    std::uint32_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::uint64_t word = x[i] & y[i];
+        if (out) out[i] = word;
+        count += static_cast<std::uint32_t>(std::popcount(word));
+    }
+    return count;
+}
+
+// out[i] = x[i] | y[i] (out may alias x); returns the number of set bits.
+inline std::uint32_t or_portable(const std::uint64_t* x, const std::uint64_t* y, std::uint64_t* out, std::size_t n) {
+    std::uint32_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = x[i] | y[i];
+        count += static_cast<std::uint32_t>(std::popcount(out[i]));
+    }
+    return count;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GEECODEX_ROARING_POPCNT 1
+
+__attribute__((target("popcnt")))
+inline std::uint32_t and_popcnt(const std::uint64_t* x, const std::uint64_t* y, std::uint64_t* out, std::size_t n) {
+    std::uint64_t count = 0;
+    if (out == nullptr) {
+        for (std::size_t i = 0; i < n; ++i) count += static_cast<std::uint64_t>(__builtin_popcountll(x[i] & y[i]));
+        return static_cast<std::uint32_t>(count);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = x[i] & y[i];
+        count += static_cast<std::uint64_t>(__builtin_popcountll(out[i]));
+    }
+    return static_cast<std::uint32_t>(count);
+}
+
+__attribute__((target("popcnt")))
+inline std::uint32_t or_popcnt(const std::uint64_t* x, const std::uint64_t* y, std::uint64_t* out, std::size_t n) {
+    std::uint64_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = x[i] | y[i];
+        count += static_cast<std::uint64_t>(__builtin_popcountll(out[i]));
+    }
+    return static_cast<std::uint32_t>(count);
+}
+
+inline bool has_popcnt() {
+    static const bool detected = __builtin_cpu_supports("popcnt");
+    return detected;
+}
+#endif
+
+inline std::uint32_t and_count(const std::uint64_t* x, const std::uint64_t* y, std::uint64_t* out, std::size_t n) {
+#if defined(GEECODEX_ROARING_POPCNT)
+    if (has_popcnt()) return and_popcnt(x, y, out, n);
+#endif
+    return and_portable(x, y, out, n);
+}
+
+inline std::uint32_t or_count(const std::uint64_t* x, const std::uint64_t* y, std::uint64_t* out, std::size_t n) {
+#if defined(GEECODEX_ROARING_POPCNT)
+    if (has_popcnt()) return or_popcnt(x, y, out, n);
+#endif
+    return or_portable(x, y, out, n);
+}
+
+}   // namespace roaring_words
+
+// Compressed set of 32-bit ordinals in the roaring layout: values are split
+// by their high 16 bits into containers, and each container is a sorted
+// array of low halves while it holds at most 4096 values, a 65536-bit bitmap
+// beyond that. Sparse facets stay small and dense ones intersect a word at a
+// time. (Run containers are left out; catalog ordinals are too short for
+// them to pay off.)
+class roaring_bitmap {
+public:
+    static constexpr std::size_t array_max = 4096;
+
+    roaring_bitmap() = default;
+
+    // {0, 1, ..., count - 1}.
+    static roaring_bitmap range(std::uint32_t count) {
+        roaring_bitmap out;
+        for (std::uint32_t base = 0; base < count; base += 0x10000) {
+            const std::uint32_t n = std::min<std::uint32_t>(count - base, 0x10000);
+            container c;
+            c.key = static_cast<std::uint16_t>(base >> 16);
+            if (n <= array_max) {
+                c.array.resize(n);
+                for (std::uint32_t i = 0; i < n; ++i) c.array[i] = static_cast<std::uint16_t>(i);
+            } else {
+                c.bits.assign(words, 0);
+                for (std::uint32_t i = 0; i < n / 64; ++i) c.bits[i] = ~std::uint64_t{0};
+                if (n % 64) c.bits[n / 64] = (std::uint64_t{1} << (n % 64)) - 1;
+            }
+            c.cardinality = n;
+            out.m_containers.push_back(std::move(c));
+        }
+        return out;
+    }
+
+    void add(std::uint32_t value) {
+        const auto key = static_cast<std::uint16_t>(value >> 16);
+        const auto low = static_cast<std::uint16_t>(value & 0xffff);
+        auto it = std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const container& c, std::uint16_t k) { return c.key < k; });
+        if (it == m_containers.end() || it->key != key) {
+            it = m_containers.insert(it, container{});
+            it->key = key;
+        }
+        it->add(low);
+    }
+
+    [[nodiscard]] bool contains(std::uint32_t value) const {
+        const auto* c = find(static_cast<std::uint16_t>(value >> 16));
+        return c && c->contains(static_cast<std::uint16_t>(value & 0xffff));
+    }
+
+    [[nodiscard]] std::uint64_t cardinality() const {
+        std::uint64_t total = 0;
+        for (const auto& c: m_containers) total += c.cardinality;
+        return total;
+    }
+
+    [[nodiscard]] bool empty() const { return m_containers.empty(); }
+
+    [[nodiscard]] std::size_t bytes() const {
+        std::size_t total = sizeof(*this);
+        for (const auto& c: m_containers) total += sizeof(container) + c.array.capacity() * 2 + c.bits.capacity() * 8;
+        return total;
+    }
+
+    friend roaring_bitmap operator&(const roaring_bitmap& a, const roaring_bitmap& b) {
+        roaring_bitmap out;
+        std::size_t i = 0, j = 0;
+        while (i < a.m_containers.size() && j < b.m_containers.size()) {
+            const auto& x = a.m_containers[i];
+            const auto& y = b.m_containers[j];
+            if (x.key < y.key) ++i;
+            else if (y.key < x.key) ++j;
+            else {
+                auto c = container::intersect(x, y);
+                if (c.cardinality > 0) out.m_containers.push_back(std::move(c));
+                ++i; ++j;
+            }
+        }
+        return out;
+    }
+
+    friend roaring_bitmap operator|(const roaring_bitmap& a, const roaring_bitmap& b) {
+        roaring_bitmap out;
+        std::size_t i = 0, j = 0;
+        while (i < a.m_containers.size() || j < b.m_containers.size()) {
+            if (j == b.m_containers.size() || (i < a.m_containers.size() && a.m_containers[i].key < b.m_containers[j].key)) out.m_containers.push_back(a.m_containers[i++]);
+            else if (i == a.m_containers.size() || b.m_containers[j].key < a.m_containers[i].key) out.m_containers.push_back(b.m_containers[j++]);
+            else out.m_containers.push_back(container::unite(a.m_containers[i++], b.m_containers[j++]));
+        }
+        return out;
+    }
+
+    // |a & b| without building the intersection.
+    static std::uint64_t and_cardinality(const roaring_bitmap& a, const roaring_bitmap& b) {
+        std::uint64_t total = 0;
+        std::size_t i = 0, j = 0;
+        while (i < a.m_containers.size() && j < b.m_containers.size()) {
+            const auto& x = a.m_containers[i];
+            const auto& y = b.m_containers[j];
+            if (x.key < y.key) ++i;
+            else if (y.key < x.key) ++j;
+            else { total += container::intersect_cardinality(x, y); ++i; ++j; }
+        }
+        return total;
+    }
+
+    // Calls `visit(std::uint32_t)` in ascending order until it returns false.
+    template <typename Visit>
+    void for_each(Visit&& visit) const {
+        for (const auto& c: m_containers) {
+            const std::uint32_t high = static_cast<std::uint32_t>(c.key) << 16;
+            if (!c.is_bitmap()) {
+                for (auto low: c.array)
+                    if (!visit(high | low)) return;
+                continue;
+            }
+            for (std::size_t w = 0; w < words; ++w) {
+                for (std::uint64_t word = c.bits[w]; word != 0; word &= word - 1) {
+                    const auto bit = static_cast<std::uint32_t>(std::countr_zero(word));
+                    if (!visit(high | static_cast<std::uint32_t>(w * 64) | bit)) return;
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr std::size_t words = 0x10000 / 64;
+
+    struct container {
+        std::uint16_t key = 0;
+        std::uint32_t cardinality = 0;
+        std::vector<std::uint16_t> array;       // used while bits is empty
+        std::vector<std::uint64_t> bits;
+
+        [[nodiscard]] bool is_bitmap() const { return !bits.empty(); }
+
+        [[nodiscard]] bool contains(std::uint16_t low) const {
+            if (is_bitmap()) return (bits[low >> 6] >> (low & 63)) & 1;
+            return std::binary_search(array.begin(), array.end(), low);
+        }
+
+        void add(std::uint16_t low) {
+            if (is_bitmap()) {
+                auto& word = bits[low >> 6];
+                const auto mask = std::uint64_t{1} << (low & 63);
+                if (!(word & mask)) { word |= mask; ++cardinality; }
+                return;
+            }
+            auto it = std::lower_bound(array.begin(), array.end(), low);
+            if (it != array.end() && *it == low) return;
+            array.insert(it, low);
+            ++cardinality;
+            if (array.size() > array_max) to_bitmap();
+        }
+
+        void to_bitmap() {
+            bits.assign(words, 0);
+            for (auto low: array) bits[low >> 6] |= std::uint64_t{1} << (low & 63);
+            array.clear();
+            array.shrink_to_fit();
+        }
+
+        void to_array() {
+            array.clear();
+            array.reserve(cardinality);
+            for (std::size_t w = 0; w < words; ++w)
+                for (std::uint64_t word = bits[w]; word != 0; word &= word - 1)
+                    array.push_back(static_cast<std::uint16_t>(w * 64 + static_cast<std::size_t>(std::countr_zero(word))));
+            bits.clear();
+            bits.shrink_to_fit();
+        }
+
+        static container intersect(const container& x, const container& y) {
+            container out;
+            out.key = x.key;
+            if (x.is_bitmap() && y.is_bitmap()) {
+                out.bits.resize(words);
+                out.cardinality = roaring_words::and_count(x.bits.data(), y.bits.data(), out.bits.data(), words);
+                if (out.cardinality <= array_max) out.to_array();
+                return out;
+            }
+            if (x.is_bitmap() || y.is_bitmap()) {
+                const auto& sparse = x.is_bitmap() ? y : x;
+                const auto& dense = x.is_bitmap() ? x : y;
+                for (auto low: sparse.array)
+                    if (dense.contains(low)) out.array.push_back(low);
+            } else {
+                std::set_intersection(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(), std::back_inserter(out.array));
+            }
+            out.cardinality = static_cast<std::uint32_t>(out.array.size());
+            return out;
+        }
+
+        static std::uint32_t intersect_cardinality(const container& x, const container& y) {
+            std::uint32_t count = 0;
+            if (x.is_bitmap() && y.is_bitmap()) return roaring_words::and_count(x.bits.data(), y.bits.data(), nullptr, words);
+            if (x.is_bitmap() || y.is_bitmap()) {
+                const auto& sparse = x.is_bitmap() ? y : x;
+                const auto& dense = x.is_bitmap() ? x : y;
+                for (auto low: sparse.array) count += dense.contains(low) ? 1 : 0;
+                return count;
+            }
+            std::size_t i = 0, j = 0;
+            while (i < x.array.size() && j < y.array.size()) {
+                if (x.array[i] < y.array[j]) ++i;
+                else if (y.array[j] < x.array[i]) ++j;
+                else { ++count; ++i; ++j; }
+            }
+            return count;
+        }
+
+        static container unite(const container& x, const container& y) {
+            container out;
+            out.key = x.key;
+            if (x.is_bitmap() || y.is_bitmap()) {
+                out.bits = x.is_bitmap() ? x.bits : y.bits;
+                const auto& other = x.is_bitmap() ? y : x;
+                if (other.is_bitmap()) {
+                    out.cardinality = roaring_words::or_count(out.bits.data(), other.bits.data(), out.bits.data(), words);
+                    return out;
+                }
+                out.cardinality = (x.is_bitmap() ? x : y).cardinality;
+                for (auto low: other.array) {
+                    auto& word = out.bits[low >> 6];
+                    const auto mask = std::uint64_t{1} << (low & 63);
+                    if (!(word & mask)) { word |= mask; ++out.cardinality; }
+                }
+                return out;
+            }
+            out.array.reserve(x.array.size() + y.array.size());
+            std::set_union(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(), std::back_inserter(out.array));
+            out.cardinality = static_cast<std::uint32_t>(out.array.size());
+            if (out.array.size() > array_max) out.to_bitmap();
+            return out;
+        }
+    };
+
+    std::vector<container> m_containers;        // ascending key
+
+    [[nodiscard]] const container* find(std::uint16_t key) const {
+        auto it = std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const container& c, std::uint16_t k) { return c.key < k; });
+        return it != m_containers.end() && it->key == key ? &*it : nullptr;
+    }
+};
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // ROARING_BITMAP_HPP
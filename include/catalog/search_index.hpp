@@ -0,0 +1,195 @@
+#ifndef SEARCH_INDEX_HPP
+#define SEARCH_INDEX_HPP
+
+#include <catalog/book_catalog.hpp>
+#include <catalog/derived_index.hpp>
+#include <catalog/postings.hpp>
+#include <catalog/text_tokenizer.hpp>
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace geecodex::catalog {
+
+struct search_hit {
+    std::shared_ptr<const book> entry;
+    float score = 0.0f;
+};
+
+struct search_result {
+    std::size_t total = 0;              // matching books, before offset/limit
+    std::vector<search_hit> hits;
+};
+
+// Inverted index over the active books of one catalog snapshot: title,
+// author, publisher, description and tags, tokenized by for_each_term.
+// Queries match books that contain every query term and rank them by BM25,
+// with title hits counting three times and author or tag hits twice.
+class search_index {
+public:
+    explicit search_index(const catalog& source) {
+        const auto& books = source.newest();        // ordinal 0 is the newest book
+        m_books.reserve(books.size());
+        m_length_norm.reserve(books.size());
+
+        std::unordered_map<std::string, std::uint32_t> tf;
+        std::vector<std::uint32_t> lengths;
+        lengths.reserve(books.size());
+        for (const auto& entry: books) {
+            tf.clear();
+            std::uint32_t length = 0;
+            auto add_field = [&](std::string_view text, std::uint32_t weight) {
+                for_each_term(text, [&](std::string_view term) {
+                    tf[std::string{term}] += weight;
+                    length += weight;
+                });
+            };
+            add_field(entry->title, title_weight);
+            if (entry->author) add_field(*entry->author, author_weight);
+            for (const auto& tag: entry->tags) add_field(tag, tag_weight);
+            if (entry->publisher) add_field(*entry->publisher, 1);
+            if (entry->description) add_field(*entry->description, 1);
+
+            const auto ordinal = static_cast<std::uint32_t>(m_books.size());
+            for (const auto& [term, count]: tf)
+                m_terms[term].add(ordinal, static_cast<std::uint16_t>(std::min<std::uint32_t>(count, std::numeric_limits<std::uint16_t>::max())));
+            m_books.push_back(entry);
+            lengths.push_back(length);
+        }
+
+        const double total_length = std::accumulate(lengths.begin(), lengths.end(), 0.0);
+        const double average = lengths.empty() || total_length == 0.0 ? 1.0 : total_length / static_cast<double>(lengths.size());
+        for (auto length: lengths)
+            m_length_norm.push_back(static_cast<float>(k1 * (1.0 - b + b * static_cast<double>(length) / average)));
+
+        for (auto& [term, list]: m_terms) {
+            list.shrink_to_fit();
+            m_postings += list.size();
+            m_posting_bytes += list.bytes();
+        }
+    }
+
+    [[nodiscard]] search_result search(std::string_view query, std::size_t offset, std::size_t limit) const {
+        search_result result;
+
+        std::vector<std::string> terms;
+        for_each_term(query, [&](std::string_view term) {
+            if (std::find(terms.begin(), terms.end(), term) == terms.end()) terms.emplace_back(term);
+        });
+        if (terms.empty()) return result;
+
+        std::vector<const posting_list*> lists;
+        for (const auto& term: terms) {
+            auto it = m_terms.find(term);
+            if (it == m_terms.end()) return result;
+            lists.push_back(&it->second);
+        }
+        std::sort(lists.begin(), lists.end(), [](const auto* x, const auto* y) { return x->size() < y->size(); });
+
+        // Candidates start as the rarest term's postings and shrink with each
+        // further term; only blocks overlapping the candidates get decoded.
+        std::vector<std::uint32_t> candidates;
+        std::vector<std::uint16_t> tfs;
+        lists.front()->decode_all(candidates, tfs);
+        std::vector<float> scores(candidates.size());
+        const float first_idf = idf(*lists.front());
+        for (std::size_t i = 0; i < candidates.size(); ++i) scores[i] = term_score(first_idf, tfs[i], candidates[i]);
+
+        std::uint32_t block_ordinals[posting_list::block_size];
+        std::uint16_t block_tfs[posting_list::block_size];
+        std::uint32_t match_a[posting_list::block_size];
+        std::uint32_t match_b[posting_list::block_size];
+        const auto which = postings::active_isa();
+
+        for (std::size_t l = 1; l < lists.size() && !candidates.empty(); ++l) {
+            const auto& list = *lists[l];
+            const float term_idf = idf(list);
+            std::size_t kept = 0, at = 0;
+            for (std::size_t bi = 0; bi < list.blocks().size() && at < candidates.size(); ++bi) {
+                const auto& blk = list.blocks()[bi];
+                if (blk.last < candidates[at]) continue;
+                at = static_cast<std::size_t>(std::lower_bound(candidates.begin() + static_cast<std::ptrdiff_t>(at), candidates.end(), blk.first) - candidates.begin());
+                const auto end = static_cast<std::size_t>(std::upper_bound(candidates.begin() + static_cast<std::ptrdiff_t>(at), candidates.end(), blk.last) - candidates.begin());
+                if (end == at) continue;
+
+                const auto count = list.decode(bi, block_ordinals, block_tfs);
+                // At most `count` matches, so the match buffers are one block long.
+                // Survivors are compacted in place: writes never pass the reads.
+                const auto n = postings::intersect(candidates.data() + at, end - at, block_ordinals, count, match_a, match_b, which);
+                for (std::size_t k = 0; k < n; ++k) {
+                    const auto ordinal = candidates[at + match_a[k]];
+                    scores[kept] = scores[at + match_a[k]] + term_score(term_idf, block_tfs[match_b[k]], ordinal);
+                    candidates[kept++] = ordinal;
+                }
+                at = end;
+            }
+            candidates.resize(kept);
+            scores.resize(kept);
+        }
+
+        result.total = candidates.size();
+        if (offset >= candidates.size()) return result;
+
+        std::vector<std::uint32_t> order(candidates.size());
+        std::iota(order.begin(), order.end(), 0u);
+        const auto wanted = std::min(candidates.size(), offset + limit);
+        std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(wanted), order.end(), [&](std::uint32_t x, std::uint32_t y) {
+            if (scores[x] != scores[y]) return scores[x] > scores[y];
+            return candidates[x] < candidates[y];
+        });
+        for (std::size_t i = offset; i < wanted; ++i)
+            result.hits.push_back({m_books[candidates[order[i]]], scores[order[i]]});
+        return result;
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        out["documents"] = m_books.size();
+        out["terms"] = m_terms.size();
+        out["postings"] = m_postings;
+        out["posting_bytes"] = m_posting_bytes;
+        out["simd"] = postings::isa_name();
+        return out;
+    }
+
+private:
+    static constexpr double k1 = 1.2;
+    static constexpr double b = 0.75;
+    static constexpr std::uint32_t title_weight = 3;
+    static constexpr std::uint32_t author_weight = 2;
+    static constexpr std::uint32_t tag_weight = 2;
+
+    std::vector<std::shared_ptr<const book>> m_books;       // by ordinal
+    std::vector<float> m_length_norm;                       // k1 * (1 - b + b * length / average)
+    std::unordered_map<std::string, posting_list> m_terms;
+    std::size_t m_postings = 0;
+    std::size_t m_posting_bytes = 0;
+
+    [[nodiscard]] float idf(const posting_list& list) const {
+        const double n = static_cast<double>(m_books.size());
+        const double df = static_cast<double>(list.size());
+        return static_cast<float>(std::log(1.0 + (n - df + 0.5) / (df + 0.5)));
+    }
+
+    [[nodiscard]] float term_score(float term_idf, std::uint16_t tf, std::uint32_t ordinal) const {
+        const float f = static_cast<float>(tf);
+        return term_idf * f * static_cast<float>(k1 + 1.0) / (f + m_length_norm[ordinal]);
+    }
+};
+
+inline derived_index<search_index>& get_book_search() {
+    static derived_index<search_index> instance{"book search index"};
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // SEARCH_INDEX_HPP
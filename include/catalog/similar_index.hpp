@@ -0,0 +1,206 @@
+#ifndef SIMILAR_INDEX_HPP
+#define SIMILAR_INDEX_HPP
+
+#include <catalog/book_catalog.hpp>
+#include <catalog/derived_index.hpp>
+#include <catalog/text_tokenizer.hpp>
+#include <json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace geecodex::catalog {
+
+struct similar_book {
+    std::shared_ptr<const book> entry;
+    float similarity = 0.0f;            // Jaccard similarity of the feature sets
+};
+
+// "More like this" for every active book, computed once per catalog snapshot.
+//
+// A book's features are its tags, its category and the terms (words and
+// CJK bigrams) of its title and description, hashed to 32 bits. Candidate
+// pairs come from MinHash signatures and LSH banding: books that agree on
+// all rows of at least one band share a bucket. Only candidates get their
+// exact Jaccard similarity computed, so the build never compares all pairs,
+// and the best `max_neighbours` per book are stored. A request is a lookup.
+class similar_index {
+public:
+    static constexpr std::size_t max_neighbours = 20;
+
+    explicit similar_index(const catalog& source) {
+        const auto& books = source.newest();
+        m_books.assign(books.begin(), books.end());
+        const auto n = m_books.size();
+
+        std::vector<std::vector<std::uint32_t>> features(n);
+        std::vector<signature> signatures(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            features[i] = features_of(*m_books[i]);
+            signatures[i] = minhash(features[i]);
+            m_ordinal.emplace(m_books[i]->id, static_cast<std::uint32_t>(i));
+        }
+
+        std::vector<std::unordered_map<std::uint64_t, std::vector<std::uint32_t>>> buckets(bands);
+        for (std::size_t band = 0; band < bands; ++band)
+            for (std::uint32_t i = 0; i < n; ++i)
+                if (!features[i].empty()) buckets[band][band_key(signatures[i], band)].push_back(i);
+
+        // Candidates are gathered one book at a time, so memory stays at one
+        // entry per book and band however the buckets are shaped.
+        m_neighbours.resize(n);
+        std::vector<std::uint32_t> mine;
+        for (std::uint32_t i = 0; i < n; ++i) {
+            if (features[i].empty()) continue;
+            mine.clear();
+            for (std::size_t band = 0; band < bands; ++band) {
+                const auto& members = buckets[band].find(band_key(signatures[i], band))->second;
+                // A bucket this large means a feature nearly everyone has;
+                // it says little and would make the build quadratic.
+                if (members.size() > max_bucket) continue;
+                for (auto other: members)
+                    if (other != i) mine.push_back(other);
+            }
+            std::sort(mine.begin(), mine.end());
+            mine.erase(std::unique(mine.begin(), mine.end()), mine.end());
+            m_candidates += mine.size();
+
+            auto& out = m_neighbours[i];
+            for (auto other: mine) {
+                const float similarity = jaccard(features[i], features[other]);
+                if (similarity >= min_similarity) out.push_back({other, similarity});
+            }
+            const auto keep = std::min(out.size(), max_neighbours);
+            std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(keep), out.end(), [](const auto& x, const auto& y) {
+                if (x.similarity != y.similarity) return x.similarity > y.similarity;
+                return x.ordinal < y.ordinal;       // newer book first
+            });
+            out.resize(keep);
+            out.shrink_to_fit();
+            m_pairs += keep;
+        }
+    }
+
+    // Most similar active books first; empty if `book_id` is not an active book.
+    [[nodiscard]] std::vector<similar_book> similar(int book_id, std::size_t limit) const {
+        std::vector<similar_book> out;
+        auto it = m_ordinal.find(book_id);
+        if (it == m_ordinal.end()) return out;
+        const auto& neighbours = m_neighbours[it->second];
+        for (std::size_t i = 0; i < neighbours.size() && i < limit; ++i)
+            out.push_back({m_books[neighbours[i].ordinal], neighbours[i].similarity});
+        return out;
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        out["books"] = m_books.size();
+        out["candidates"] = m_candidates;
+        out["neighbours"] = m_pairs;
+        out["minhash"] = {{"hashes", hashes}, {"bands", bands}, {"rows", rows}};
+        return out;
+    }
+
+private:
+    static constexpr std::size_t bands = 30;
+    static constexpr std::size_t rows = 2;              // pairs above ~0.2 Jaccard usually meet
+    static constexpr std::size_t hashes = bands * rows;
+    static constexpr std::size_t max_bucket = 100;
+    static constexpr std::size_t max_text_terms = 64;   // keeps long descriptions from drowning the tags
+    static constexpr float min_similarity = 0.1f;
+
+    using signature = std::array<std::uint32_t, hashes>;
+
+    struct neighbour {
+        std::uint32_t ordinal = 0;
+        float similarity = 0.0f;
+    };
+
+    std::vector<std::shared_ptr<const book>> m_books;       // by ordinal, newest first
+    std::unordered_map<int, std::uint32_t> m_ordinal;       // book id -> ordinal
+    std::vector<std::vector<neighbour>> m_neighbours;
+    std::size_t m_candidates = 0;
+    std::size_t m_pairs = 0;
+
+    static std::uint32_t hash_feature(char kind, std::string_view text) {
+        std::uint32_t h = 2166136261u ^ static_cast<unsigned char>(kind);     // FNV-1a
+        h *= 16777619u;
+        for (unsigned char c: text) {
+            h ^= c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    static std::uint32_t mix(std::uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // Sorted, distinct feature hashes. The kind byte keeps a tag and a
+    // title word with the same spelling apart.
+    static std::vector<std::uint32_t> features_of(const book& b) {
+        std::vector<std::uint32_t> out;
+        for (const auto& tag: b.tags) out.push_back(hash_feature('t', fold_for_prefix(tag)));
+        if (b.category) out.push_back(hash_feature('c', fold_for_prefix(*b.category)));
+        for_each_term(b.title, [&](std::string_view term) { out.push_back(hash_feature('w', term)); });
+        if (b.description) {
+            std::size_t taken = 0;
+            for_each_term(*b.description, [&](std::string_view term) {
+                if (taken++ < max_text_terms) out.push_back(hash_feature('w', term));
+            });
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+
+    // One cheap hash per row: the feature hash mixed with a per-row seed.
+    static signature minhash(std::span<const std::uint32_t> features) {
+        signature sig;
+        sig.fill(std::numeric_limits<std::uint32_t>::max());
+        for (auto f: features)
+            for (std::size_t k = 0; k < hashes; ++k)
+                sig[k] = std::min(sig[k], mix(f ^ static_cast<std::uint32_t>(0x9e3779b9u * (k + 1))));
+        return sig;
+    }
+
+    static std::uint64_t band_key(const signature& sig, std::size_t band) {
+        std::uint64_t key = 1469598103934665603ull ^ band;
+        for (std::size_t r = 0; r < rows; ++r) {
+            key ^= sig[band * rows + r];
+            key *= 1099511628211ull;
+        }
+        return key;
+    }
+
+    static float jaccard(std::span<const std::uint32_t> x, std::span<const std::uint32_t> y) {
+        std::size_t shared = 0, i = 0, j = 0;
+        while (i < x.size() && j < y.size()) {
+            if (x[i] < y[j]) ++i;
+            else if (y[j] < x[i]) ++j;
+            else { ++shared; ++i; ++j; }
+        }
+        const auto total = x.size() + y.size() - shared;
+        return total == 0 ? 0.0f : static_cast<float>(shared) / static_cast<float>(total);
+    }
+};
+
+inline derived_index<similar_index>& get_similar_books() {
+    static derived_index<similar_index> instance{"similar books index"};
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // SIMILAR_INDEX_HPP
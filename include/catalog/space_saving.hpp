@@ -0,0 +1,81 @@
+#ifndef SPACE_SAVING_HPP
+#define SPACE_SAVING_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace geecodex::catalog {
+
+// Heavy-hitters summary (Space-Saving, Metwally et al.) over weighted keys.
+// At most `capacity` keys are tracked; a new key takes over the smallest
+// counter and inherits its count as `error`. Any key whose true weight is
+// above total() / capacity is guaranteed to be tracked, and each estimate
+// `count` overstates the true weight by at most `error`.
+class space_saving {
+public:
+    struct counter {
+        std::uint32_t key = 0;
+        std::uint64_t count = 0;
+        std::uint64_t error = 0;
+    };
+
+    explicit space_saving(std::size_t capacity = 256)
+        : m_capacity{std::max<std::size_t>(1, capacity)} {
+        m_counters.reserve(m_capacity);
+        m_index.reserve(m_capacity);
+    }
+
+    void add(std::uint32_t key, std::uint64_t weight = 1) {
+        m_total += weight;
+        if (auto it = m_index.find(key); it != m_index.end()) {
+            m_counters[it->second].count += weight;
+            return;
+        }
+        if (m_counters.size() < m_capacity) {
+            m_index.emplace(key, static_cast<std::uint32_t>(m_counters.size()));
+            m_counters.push_back({key, weight, 0});
+            return;
+        }
+        // Evictions only happen once the summary is full, and then rarely:
+        // a linear scan for the minimum is cheaper to keep than a heap.
+        auto smallest = std::min_element(m_counters.begin(), m_counters.end(),
+                                         [](const auto& x, const auto& y) { return x.count < y.count; });
+        m_index.erase(smallest->key);
+        m_index.emplace(key, static_cast<std::uint32_t>(smallest - m_counters.begin()));
+        *smallest = {key, smallest->count + weight, smallest->count};
+    }
+
+    void clear() {
+        m_counters.clear();
+        m_index.clear();
+        m_total = 0;
+    }
+
+    [[nodiscard]] std::span<const counter> counters() const { return m_counters; }
+    [[nodiscard]] std::uint64_t total() const { return m_total; }
+    [[nodiscard]] bool full() const { return m_counters.size() >= m_capacity; }
+
+    // Upper bound on the weight of any key that is not tracked.
+    [[nodiscard]] std::uint64_t floor() const {
+        if (!full()) return 0;
+        return std::min_element(m_counters.begin(), m_counters.end(),
+                                [](const auto& x, const auto& y) { return x.count < y.count; })->count;
+    }
+
+    [[nodiscard]] std::size_t bytes() const {
+        return m_counters.capacity() * sizeof(counter) + m_index.size() * (sizeof(std::uint32_t) * 2 + sizeof(void*));
+    }
+
+private:
+    std::size_t m_capacity;
+    std::vector<counter> m_counters;
+    std::unordered_map<std::uint32_t, std::uint32_t> m_index;      // key -> position in m_counters
+    std::uint64_t m_total = 0;
+};
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // SPACE_SAVING_HPP
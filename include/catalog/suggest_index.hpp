@@ -0,0 +1,226 @@
+#ifndef SUGGEST_INDEX_HPP
+#define SUGGEST_INDEX_HPP
+
+#include <catalog/book_catalog.hpp>
+#include <catalog/derived_index.hpp>
+#include <catalog/text_tokenizer.hpp>
+#include <json.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace geecodex::catalog {
+
+struct suggestion {
+    enum class kind : std::uint8_t { title, author };
+
+    std::string text;
+    kind type = kind::title;
+    int book_id = 0;                // the title's book; an author's most downloaded book
+    std::uint64_t score = 0;        // download_count, summed over an author's books
+    std::uint32_t books = 1;
+};
+
+inline std::string_view to_string(suggestion::kind k) {
+    return k == suggestion::kind::author ? "author" : "title";
+}
+
+// Search-as-you-type over titles and authors of the active books.
+//
+// Every title and author is folded (fold_for_prefix) and inserted once per
+// word start, and once per CJK character, so "prim" finds "C++ Primer" and
+// "学习" finds "深度学习". The keys go into a path-compressed trie laid out
+// in flat arrays (children of a node are contiguous and sorted by their
+// first byte, labels live in one string pool). Each node stores its best
+// `max_results` suggestions, so a lookup is one walk down the prefix and a
+// copy; nothing is ranked per request.
+class suggest_index {
+public:
+    static constexpr std::size_t max_results = 10;
+    static constexpr std::size_t max_key_bytes = 64;        // longer prefixes only compare this much
+    static constexpr std::size_t max_starts_per_text = 16;
+
+    explicit suggest_index(const catalog& source) {
+        collect(source);
+        build();
+    }
+
+    [[nodiscard]] std::vector<const suggestion*> suggest(std::string_view prefix, std::size_t limit) const {
+        std::vector<const suggestion*> out;
+        std::string folded = fold_for_prefix(prefix);
+        truncate_key(folded);
+        if (folded.empty() || m_nodes.empty()) return out;
+
+        std::uint32_t current = 0;
+        std::size_t pos = 0;
+        while (pos < folded.size()) {
+            const auto& parent = m_nodes[current];
+            const auto* first = m_nodes.data() + parent.first_child;
+            const auto* last = first + parent.child_count;
+            const auto next = static_cast<unsigned char>(folded[pos]);
+            const auto* child = std::lower_bound(first, last, next, [this](const node& n, unsigned char c) {
+                return static_cast<unsigned char>(m_labels[n.label_offset]) < c;
+            });
+            if (child == last || static_cast<unsigned char>(m_labels[child->label_offset]) != next) return out;
+
+            const auto compare = std::min<std::size_t>(child->label_length, folded.size() - pos);
+            if (std::memcmp(m_labels.data() + child->label_offset, folded.data() + pos, compare) != 0) return out;
+            pos += compare;
+            current = static_cast<std::uint32_t>(child - m_nodes.data());
+        }
+
+        const auto& found = m_nodes[current];
+        const auto count = std::min<std::size_t>(found.top_count, limit);
+        out.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) out.push_back(&m_entries[m_top[found.top_offset + i]]);
+        return out;
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        out["suggestions"] = m_entries.size();
+        out["keys"] = m_keys;
+        out["nodes"] = m_nodes.size();
+        out["index_bytes"] = m_nodes.size() * sizeof(node) + m_labels.size() + m_top.size() * sizeof(std::uint32_t);
+        return out;
+    }
+
+private:
+    struct node {
+        std::uint32_t label_offset = 0;     // into m_labels; the root's label is empty
+        std::uint32_t label_length = 0;
+        std::uint32_t first_child = 0;
+        std::uint32_t child_count = 0;
+        std::uint32_t top_offset = 0;       // into m_top
+        std::uint32_t top_count = 0;
+    };
+
+    std::vector<suggestion> m_entries;      // best first; m_top holds indices into it
+    std::vector<node> m_nodes;              // breadth-first, root at 0
+    std::string m_labels;
+    std::vector<std::uint32_t> m_top;
+    std::size_t m_keys = 0;
+
+    // Cuts to max_key_bytes without splitting a UTF-8 sequence.
+    static void truncate_key(std::string& key) {
+        if (key.size() <= max_key_bytes) return;
+        std::size_t cut = max_key_bytes;
+        while (cut > 0 && (static_cast<unsigned char>(key[cut]) & 0xc0) == 0x80) --cut;
+        key.resize(cut);
+    }
+
+    void collect(const catalog& source) {
+        std::unordered_map<std::string, std::size_t> authors;   // folded name -> entry
+        for (const auto& b: source.newest()) {
+            const auto downloads = static_cast<std::uint64_t>(std::max(0, b->download_count));
+            m_entries.push_back({b->title, suggestion::kind::title, b->id, downloads, 1});
+            if (!b->author || b->author->empty()) continue;
+
+            auto [it, inserted] = authors.try_emplace(fold_for_prefix(*b->author), m_entries.size());
+            if (inserted) {
+                m_entries.push_back({*b->author, suggestion::kind::author, b->id, downloads, 1});
+                continue;
+            }
+            auto& author = m_entries[it->second];
+            if (downloads > 0 && author.score == 0) author.book_id = b->id;
+            author.score += downloads;
+            ++author.books;
+        }
+        std::sort(m_entries.begin(), m_entries.end(), [](const auto& x, const auto& y) {
+            if (x.score != y.score) return x.score > y.score;
+            if (x.type != y.type) return x.type < y.type;
+            return x.text < y.text;
+        });
+    }
+
+    void build() {
+        std::vector<std::pair<std::string, std::uint32_t>> keys;
+        std::vector<std::size_t> starts;
+        for (std::uint32_t rank = 0; rank < m_entries.size(); ++rank) {
+            starts.clear();
+            const std::string folded = fold_for_prefix(m_entries[rank].text, &starts);
+            for (std::size_t i = 0; i < starts.size() && i < max_starts_per_text; ++i) {
+                std::string key = folded.substr(starts[i]);
+                truncate_key(key);
+                keys.emplace_back(std::move(key), rank);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        m_keys = keys.size();
+
+        // Breadth-first over sorted key ranges: a node covers [lo, hi), which
+        // share their first `end` bytes; keys of exactly that length end here.
+        struct span_info { std::size_t lo, hi, depth, end, terminals_end; };
+        std::vector<span_info> spans;
+        m_nodes.push_back({});
+        spans.push_back({0, keys.size(), 0, 0, 0});
+
+        for (std::size_t index = 0; index < m_nodes.size(); ++index) {
+            auto info = spans[index];
+            if (index != 0) {
+                const auto& a = keys[info.lo].first;
+                const auto& z = keys[info.hi - 1].first;
+                std::size_t end = info.depth;
+                while (end < a.size() && end < z.size() && a[end] == z[end]) ++end;
+                info.end = end;
+                m_nodes[index].label_offset = static_cast<std::uint32_t>(m_labels.size());
+                m_nodes[index].label_length = static_cast<std::uint32_t>(end - info.depth);
+                m_labels.append(a, info.depth, end - info.depth);
+            }
+            std::size_t at = info.lo;
+            while (at < info.hi && keys[at].first.size() == info.end) ++at;
+            info.terminals_end = at;
+            spans[index] = info;
+
+            m_nodes[index].first_child = static_cast<std::uint32_t>(m_nodes.size());
+            while (at < info.hi) {
+                const char lead = keys[at].first[info.end];
+                std::size_t group_end = at;
+                while (group_end < info.hi && keys[group_end].first[info.end] == lead) ++group_end;
+                m_nodes.push_back({});
+                spans.push_back({at, group_end, info.end, 0, 0});
+                ++m_nodes[index].child_count;
+                at = group_end;
+            }
+        }
+
+        // Children come after their parent, so a reverse pass sees them first.
+        // The best results of a subtree are its smallest entry indices.
+        std::vector<std::vector<std::uint32_t>> tops(m_nodes.size());
+        std::vector<std::uint32_t> merged;
+        for (std::size_t index = m_nodes.size(); index-- > 0;) {
+            merged.clear();
+            for (std::size_t k = spans[index].lo; k < spans[index].terminals_end; ++k) merged.push_back(keys[k].second);
+            const auto& n = m_nodes[index];
+            for (std::uint32_t c = n.first_child; c < n.first_child + n.child_count; ++c)
+                merged.insert(merged.end(), tops[c].begin(), tops[c].end());
+            std::sort(merged.begin(), merged.end());
+            merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+            if (merged.size() > max_results) merged.resize(max_results);
+            tops[index] = merged;
+        }
+        for (std::size_t index = 0; index < m_nodes.size(); ++index) {
+            m_nodes[index].top_offset = static_cast<std::uint32_t>(m_top.size());
+            m_nodes[index].top_count = static_cast<std::uint32_t>(tops[index].size());
+            m_top.insert(m_top.end(), tops[index].begin(), tops[index].end());
+        }
+        m_nodes.shrink_to_fit();
+        m_labels.shrink_to_fit();
+        m_top.shrink_to_fit();
+    }
+};
+
+inline derived_index<suggest_index>& get_book_suggest() {
+    static derived_index<suggest_index> instance{"book suggest index"};
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // SUGGEST_INDEX_HPP
@@ -0,0 +1,144 @@
+#ifndef TEXT_TOKENIZER_HPP
+#define TEXT_TOKENIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Tokenizer for book metadata, shared by indexing and queries so both sides
+// agree on terms.
+//
+//  - Latin text splits on anything that is not a letter or digit and is
+//    ASCII-lowercased; full-width ASCII (ＡＢＣ１２３) is folded to ASCII first.
+//  - Runs of CJK characters have no word boundaries, so they become
+//    overlapping bigrams ("深度学习" -> 深度 度学 学习); a lone CJK character
+//    stays a unigram.
+//  - Other non-ASCII letters are kept as part of the surrounding word.
+namespace geecodex::catalog {
+
+namespace detail {
+
+// Decodes one UTF-8 sequence at text[i]; invalid bytes decode as U+FFFD and
+// consume one byte.
+inline char32_t next_code_point(std::string_view text, std::size_t& i) {
+    const auto lead = static_cast<unsigned char>(text[i]);
+    std::size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xe ? 3 : (lead >> 3) == 0x1e ? 4 : 0;
+    if (length == 0 || i + length > text.size()) { ++i; return 0xfffd; }
+    char32_t cp = length == 1 ? lead : length == 2 ? (lead & 0x1f) : length == 3 ? (lead & 0x0f) : (lead & 0x07);
+    for (std::size_t k = 1; k < length; ++k) {
+        const auto c = static_cast<unsigned char>(text[i + k]);
+        if ((c & 0xc0) != 0x80) { ++i; return 0xfffd; }
+        cp = (cp << 6) | (c & 0x3f);
+    }
+    i += length;
+    return cp;
+}
+
+inline bool is_cjk(char32_t cp) {
+    return (cp >= 0x3040 && cp <= 0x30ff)       // kana
+        || (cp >= 0x3400 && cp <= 0x4dbf)       // CJK extension A
+        || (cp >= 0x4e00 && cp <= 0x9fff)       // CJK unified ideographs
+        || (cp >= 0xac00 && cp <= 0xd7af)       // hangul syllables
+        || (cp >= 0xf900 && cp <= 0xfaff)       // compatibility ideographs
+        || (cp >= 0x20000 && cp <= 0x2ffff);    // extensions B and later
+}
+
+// Non-ASCII code points that separate words: general punctuation, CJK
+// symbols and punctuation, full-width forms that are not letters or digits.
+inline bool is_separator(char32_t cp) {
+    return (cp >= 0x2000 && cp <= 0x206f) || (cp >= 0x3000 && cp <= 0x303f)
+        || (cp >= 0xff00 && cp <= 0xffef) || cp == 0xfffd || cp == 0x00a0;
+}
+
+}   // namespace detail
+
+// Calls `emit(std::string_view term)` for every term of `text`. The view is
+// only valid during the call.
+template <typename Emit>
+void for_each_term(std::string_view text, Emit&& emit) {
+    std::string word;
+    std::string run;                    // last one or two CJK characters, UTF-8
+    std::size_t run_chars = 0;          // length of the whole CJK run so far
+
+    auto flush_word = [&] {
+        if (!word.empty()) emit(std::string_view{word});
+        word.clear();
+    };
+    auto flush_run = [&] {
+        if (run_chars == 1) emit(std::string_view{run});
+        run.clear();
+        run_chars = 0;
+    };
+
+    for (std::size_t i = 0; i < text.size();) {
+        const std::size_t start = i;
+        char32_t cp = detail::next_code_point(text, i);
+
+        // Full-width ASCII letters and digits behave like their ASCII forms.
+        if (cp >= 0xff10 && cp <= 0xff5a) {
+            const char32_t ascii = cp - 0xfee0;
+            if ((ascii >= '0' && ascii <= '9') || (ascii >= 'A' && ascii <= 'Z') || (ascii >= 'a' && ascii <= 'z')) cp = ascii;
+        }
+
+        if (cp < 0x80) {
+            flush_run();
+            const char c = static_cast<char>(cp);
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) word.push_back(c);
+            else if (c >= 'A' && c <= 'Z') word.push_back(static_cast<char>(c - 'A' + 'a'));
+            else flush_word();
+        } else if (detail::is_cjk(cp)) {
+            flush_word();
+            const std::size_t previous_length = run.size();
+            run.append(text.substr(start, i - start));
+            if (++run_chars >= 2) {
+                emit(std::string_view{run});
+                run.erase(0, previous_length);      // keep the current character for the next bigram
+            }
+        } else if (detail::is_separator(cp)) {
+            flush_word();
+            flush_run();
+        } else {
+            flush_run();
+            word.append(text.substr(start, i - start));
+        }
+    }
+    flush_word();
+    flush_run();
+}
+
+// Text folded for prefix matching: same case and width folding as the
+// terms, separators collapsed to one space, trimmed. `word_starts` gets the
+// byte offsets where a word or a CJK character begins, i.e. where a
+// prefix typed by a user may start matching.
+inline std::string fold_for_prefix(std::string_view text, std::vector<std::size_t>* word_starts = nullptr) {
+    std::string out;
+    out.reserve(text.size());
+    bool in_word = false;
+    for (std::size_t i = 0; i < text.size();) {
+        const std::size_t start = i;
+        char32_t cp = detail::next_code_point(text, i);
+        if (cp >= 0xff10 && cp <= 0xff5a) {
+            const char32_t ascii = cp - 0xfee0;
+            if ((ascii >= '0' && ascii <= '9') || (ascii >= 'A' && ascii <= 'Z') || (ascii >= 'a' && ascii <= 'z')) cp = ascii;
+        }
+
+        const bool separator = cp < 0x80 ? !((cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z'))
+                                         : detail::is_separator(cp);
+        if (separator) {
+            in_word = false;
+            continue;
+        }
+        if (!in_word && !out.empty()) out.push_back(' ');
+        const bool cjk = detail::is_cjk(cp);
+        if (word_starts && (!in_word || cjk)) word_starts->push_back(out.size());
+        in_word = true;
+        if (cp < 0x80) out.push_back(cp >= 'A' && cp <= 'Z' ? static_cast<char>(cp - 'A' + 'a') : static_cast<char>(cp));
+        else out.append(text.substr(start, i - start));
+    }
+    return out;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // TEXT_TOKENIZER_HPP
@@ -0,0 +1,322 @@
+#ifndef TRENDING_BOOKS_HPP
+#define TRENDING_BOOKS_HPP
+
+#include <catalog/space_saving.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::catalog {
+namespace net = boost::asio;
+
+struct trending_config {
+    std::chrono::seconds refresh_interval{10};
+    std::size_t top_n = 100;                // books kept per window
+    std::size_t sketch_capacity = 512;      // heavy-hitter counters per time bucket
+
+    // GEECODEX_TRENDING_REFRESH_SECONDS, GEECODEX_TRENDING_TOP_N and
+    // GEECODEX_TRENDING_SKETCH_SIZE.
+    static trending_config from_env() {
+        trending_config config;
+        config.refresh_interval = std::chrono::seconds{std::max(1LL, utils::env_int("GEECODEX_TRENDING_REFRESH_SECONDS", config.refresh_interval.count()))};
+        config.top_n = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_TRENDING_TOP_N", static_cast<long long>(config.top_n))));
+        config.sketch_capacity = static_cast<std::size_t>(std::max(16LL, utils::env_int("GEECODEX_TRENDING_SKETCH_SIZE", static_cast<long long>(config.sketch_capacity))));
+        return config;
+    }
+};
+
+struct trending_window {
+    std::string_view name;
+    std::chrono::minutes span;
+};
+
+// Windows up to an hour are summed from one-minute buckets, longer ones from
+// one-hour buckets. Buckets align to the wall clock, so "1h" covers the
+// current, partial minute and the 59 before it.
+inline constexpr std::array<trending_window, 5> trending_windows{{
+    {"5m", std::chrono::minutes{5}},
+    {"15m", std::chrono::minutes{15}},
+    {"1h", std::chrono::minutes{60}},
+    {"6h", std::chrono::minutes{6 * 60}},
+    {"24h", std::chrono::minutes{24 * 60}},
+}};
+
+inline std::optional<std::size_t> parse_trending_window(std::string_view name) {
+    for (std::size_t i = 0; i < trending_windows.size(); ++i)
+        if (trending_windows[i].name == name) return i;
+    return std::nullopt;
+}
+
+struct trending_entry {
+    int book_id = 0;
+    std::uint64_t downloads = 0;    // estimate; at most `error` too high
+    std::uint64_t error = 0;
+};
+
+struct trending_snapshot {
+    std::chrono::system_clock::time_point computed_at;
+    std::array<std::vector<trending_entry>, trending_windows.size()> windows;      // most downloaded first
+};
+
+// Recent downloads per book, kept in memory only.
+//
+// record() is on the download path: it bumps a counter in the calling
+// thread's own table with a CAS, no lock and no shared cache line. Every
+// refresh_interval the timer drains those tables into the current minute
+// and hour buckets, each a Space-Saving sketch, so memory stays bounded
+// however many books are downloaded. It then sums the buckets of every
+// window and publishes the top books as one immutable snapshot, which is all
+// a request ever reads. Counts are lost on restart; `download_count` in the
+// database stays the lifetime total.
+class trending_books {
+public:
+    explicit trending_books(trending_config config = trending_config::from_env())
+        : m_config{config} {
+        for (auto& b: m_minutes) b.summary = space_saving{m_config.sketch_capacity};
+        for (auto& b: m_hours) b.summary = space_saving{m_config.sketch_capacity};
+    }
+
+    [[nodiscard]] const trending_config& config() const { return m_config; }
+
+    void record(int book_id) {
+        if (book_id <= 0) return;
+        if (local_shard().add(static_cast<std::uint32_t>(book_id))) return;
+
+        // This thread saw too many distinct books since the last drain.
+        m_overflowed.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        ++m_overflow[static_cast<std::uint32_t>(book_id)];
+    }
+
+    // Null until the first refresh.
+    [[nodiscard]] std::shared_ptr<const trending_snapshot> snapshot() const {
+        return m_current.load(std::memory_order_acquire);
+    }
+
+    // Refreshes on `executor`'s timer from now on. Call once.
+    void start(net::any_io_executor executor) {
+        m_timer = std::make_unique<net::steady_timer>(executor);
+        refresh();
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        out["recorded"] = m_recorded.load(std::memory_order_relaxed);
+        out["overflowed"] = m_overflowed.load(std::memory_order_relaxed);
+        out["refreshes"] = m_refreshes.load(std::memory_order_relaxed);
+        out["last_refresh_us"] = m_last_refresh_us.load(std::memory_order_relaxed);
+        out["refresh_interval_seconds"] = m_config.refresh_interval.count();
+        out["sketch_bytes"] = m_sketch_bytes.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_shards_mutex);
+            out["threads"] = m_shards.size();
+        }
+        return out;
+    }
+
+private:
+    // Pending counts of one thread. Slots pack (book id << 32 | count); the
+    // owning thread adds, the timer takes the counts and frees slots that
+    // stayed idle for a whole interval. A freed slot can leave a key in two
+    // slots of the probe chain, which the drain simply adds up.
+    class shard {
+    public:
+        bool add(std::uint32_t key) {
+            const std::size_t home = (key * 0x9e3779b1u) & (slot_count - 1);
+            for (std::size_t probe = 0; probe < max_probe; ++probe) {
+                auto& slot = m_slots[(home + probe) & (slot_count - 1)];
+                std::uint64_t value = slot.load(std::memory_order_relaxed);
+                for (;;) {
+                    if (value == 0) {
+                        if (slot.compare_exchange_weak(value, (std::uint64_t{key} << 32) | 1, std::memory_order_relaxed)) return true;
+                    } else if (value >> 32 != key) {
+                        break;
+                    } else if (slot.compare_exchange_weak(value, value + 1, std::memory_order_relaxed)) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        template <typename Sink>
+        void drain(Sink&& sink) {
+            for (auto& slot: m_slots) {
+                std::uint64_t value = slot.load(std::memory_order_relaxed);
+                while (value != 0) {
+                    const auto count = static_cast<std::uint32_t>(value);
+                    const std::uint64_t next = count == 0 ? 0 : value & ~std::uint64_t{0xffffffff};
+                    if (!slot.compare_exchange_weak(value, next, std::memory_order_relaxed)) continue;
+                    if (count != 0) sink(static_cast<std::uint32_t>(value >> 32), count);
+                    break;
+                }
+            }
+        }
+
+    private:
+        static constexpr std::size_t slot_count = 4096;     // 32 KiB per thread
+        static constexpr std::size_t max_probe = 32;
+        std::array<std::atomic<std::uint64_t>, slot_count> m_slots{};
+    };
+
+    struct bucket {
+        std::int64_t index = -1;        // minutes or hours since the epoch
+        space_saving summary;
+    };
+
+    trending_config m_config;
+    std::atomic<std::shared_ptr<const trending_snapshot>> m_current;
+    std::unique_ptr<net::steady_timer> m_timer;
+
+    mutable std::mutex m_shards_mutex;
+    std::vector<std::unique_ptr<shard>> m_shards;       // one per thread that ever recorded
+
+    std::mutex m_overflow_mutex;
+    std::unordered_map<std::uint32_t, std::uint64_t> m_overflow;
+
+    std::array<bucket, 60> m_minutes;                   // timer thread only
+    std::array<bucket, 24> m_hours;
+
+    std::atomic<std::uint64_t> m_recorded{0};            // as of the last drain
+    std::atomic<std::uint64_t> m_overflowed{0};
+    std::atomic<std::uint64_t> m_refreshes{0};
+    std::atomic<std::uint64_t> m_last_refresh_us{0};
+    std::atomic<std::uint64_t> m_sketch_bytes{0};
+
+    // One shard per thread, registered on its first download. The
+    // thread_local is shared by all instances; there is only ever one.
+    shard& local_shard() {
+        thread_local shard* mine = nullptr;
+        if (mine == nullptr) {
+            auto fresh = std::make_unique<shard>();
+            mine = fresh.get();
+            std::lock_guard<std::mutex> lock(m_shards_mutex);
+            m_shards.push_back(std::move(fresh));
+        }
+        return *mine;
+    }
+
+    template <std::size_t N>
+    static bucket& bucket_at(std::array<bucket, N>& ring, std::int64_t index) {
+        auto& b = ring[static_cast<std::size_t>(index % static_cast<std::int64_t>(N))];
+        if (b.index != index) {
+            b.summary.clear();
+            b.index = index;
+        }
+        return b;
+    }
+
+    void arm() {
+        m_timer->expires_after(m_config.refresh_interval);
+        m_timer->async_wait([this](boost::system::error_code ec) {
+            if (ec) return;
+            refresh();
+        });
+    }
+
+    void refresh() {
+        const auto started = std::chrono::steady_clock::now();
+        try {
+            const auto now = std::chrono::system_clock::now();
+            const std::int64_t minute = std::chrono::duration_cast<std::chrono::minutes>(now.time_since_epoch()).count();
+            const std::int64_t hour = minute / 60;
+
+            std::unordered_map<std::uint32_t, std::uint64_t> drained;
+            {
+                std::lock_guard<std::mutex> lock(m_shards_mutex);
+                for (auto& s: m_shards) s->drain([&](std::uint32_t key, std::uint32_t count) { drained[key] += count; });
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_overflow_mutex);
+                for (const auto& [key, count]: m_overflow) drained[key] += count;
+                m_overflow.clear();
+            }
+            std::uint64_t recorded = 0;
+            for (const auto& [key, count]: drained) recorded += count;
+            m_recorded.fetch_add(recorded, std::memory_order_relaxed);
+
+            auto& minute_bucket = bucket_at(m_minutes, minute);
+            auto& hour_bucket = bucket_at(m_hours, hour);
+            for (const auto& [key, count]: drained) {
+                minute_bucket.summary.add(key, count);
+                hour_bucket.summary.add(key, count);
+            }
+
+            auto next = std::make_shared<trending_snapshot>();
+            next->computed_at = now;
+            for (std::size_t w = 0; w < trending_windows.size(); ++w) {
+                const auto span = trending_windows[w].span.count();
+                next->windows[w] = span <= 60 ? top(m_minutes, minute - span, minute) : top(m_hours, hour - span / 60, hour);
+            }
+            m_current.store(std::move(next), std::memory_order_release);
+
+            std::size_t bytes = 0;
+            for (const auto& b: m_minutes) bytes += b.summary.bytes();
+            for (const auto& b: m_hours) bytes += b.summary.bytes();
+            m_sketch_bytes.store(bytes, std::memory_order_relaxed);
+            m_refreshes.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception& e) {
+            SPDLOG_WARN("Trending books refresh failed: {}", e.what());
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        m_last_refresh_us.store(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+        arm();
+    }
+
+    // Sums the buckets with after < index <= last. A book missing from a
+    // full bucket may still have had up to that bucket's floor() there, which
+    // is added to its error.
+    template <std::size_t N>
+    std::vector<trending_entry> top(const std::array<bucket, N>& ring, std::int64_t after, std::int64_t last) const {
+        struct sum { std::uint64_t count = 0, error = 0, covered = 0; };
+        std::unordered_map<std::uint32_t, sum> sums;
+        std::uint64_t floors = 0;
+        for (const auto& b: ring) {
+            if (b.index <= after || b.index > last) continue;
+            const auto bucket_floor = b.summary.floor();
+            floors += bucket_floor;
+            for (const auto& c: b.summary.counters()) {
+                auto& s = sums[c.key];
+                s.count += c.count;
+                s.error += c.error;
+                s.covered += bucket_floor;
+            }
+        }
+
+        std::vector<trending_entry> out;
+        out.reserve(sums.size());
+        for (const auto& [key, s]: sums)
+            out.push_back({static_cast<int>(key), s.count, s.error + floors - s.covered});
+        const auto keep = std::min(out.size(), m_config.top_n);
+        std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(keep), out.end(), [](const auto& x, const auto& y) {
+            if (x.downloads != y.downloads) return x.downloads > y.downloads;
+            return x.book_id < y.book_id;
+        });
+        out.resize(keep);
+        return out;
+    }
+};
+
+inline trending_books& get_trending_books() {
+    static trending_books instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::CATALOG
+#endif // TRENDING_BOOKS_HPP
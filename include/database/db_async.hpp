@@ -0,0 +1,103 @@
+#ifndef DB_ASYNC_HPP
+#define DB_ASYNC_HPP
+
+#include <database/db_conn.h>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include <pqxx/pqxx>
+
+namespace geecodex::database {
+namespace net = boost::asio;
+
+// Worker that runs statements off the I/O thread. One thread is enough:
+// every statement goes through the single shared connection anyway.
+inline net::thread_pool& get_db_thread_pool() {
+    static net::thread_pool pool{1};
+    return pool;
+}
+
+// Runs `query(pqxx::work&) -> pqxx::result` on the database worker and calls
+// `handler(std::exception_ptr, pqxx::result)` on `executor` afterwards.
+//
+// Emitting a cancellation on `slot` drops the statement if it has not started
+// yet (queued or waiting for the connection) and sends PQcancel if it is
+// running; the handler then receives an error.
+// The slot must be used from the thread that owns `executor`.
+template <typename Query, typename Handler>
+void async_execute( net::any_io_executor executor
+                  , net::cancellation_slot slot
+                  , Query query
+                  , Handler handler) {
+    enum : int { queued, running, finished, cancelled };
+    struct statement_state {
+        std::atomic<int> phase{queued};
+        std::atomic<std::uint64_t> token{0};
+    };
+    auto state = std::make_shared<statement_state>();
+
+    if (slot.is_connected()) {
+        slot.assign([state](net::cancellation_type) {
+            int expected = queued;
+            if (state->phase.compare_exchange_strong(expected, cancelled)) return;
+            if (expected == running) pg_connection::get_instance().cancel_statement(state->token.load());
+        });
+    }
+
+    net::post(get_db_thread_pool(), [ executor
+                                    , state
+                                    , query = std::move(query)
+                                    , handler = std::move(handler)]() mutable {
+        std::exception_ptr error;
+        pqxx::result result;
+
+        try {
+            auto& conn = pg_connection::get_instance();
+            if (!conn.is_initialized())
+                throw database_exception(std::string("Database connection not initialized"));
+            auto lock = conn.lock();
+            pqxx::work txn(conn.get_connection());
+            // The token is stored before the phase says running, so a
+            // cancellation that sees running always cancels this statement.
+            // Until then it can still drop it, including while it waits for
+            // the connection.
+            state->token = conn.begin_statement();
+            int expected = queued;
+            if (!state->phase.compare_exchange_strong(expected, running)) {
+                conn.end_statement();
+                throw database_exception(std::string("Statement cancelled before it started"));
+            }
+            try {
+                result = query(txn);
+            } catch (...) {
+                conn.end_statement();
+                throw;
+            }
+            conn.end_statement();
+            txn.commit();
+        } catch (const pqxx::sql_error& e) {
+            error = std::make_exception_ptr(database_exception("SQL error: " + std::string(e.what()) + ", Query: " + e.query()));
+        } catch (const database_exception&) {
+            error = std::current_exception();
+        } catch (const std::exception& e) {
+            error = std::make_exception_ptr(database_exception("Async query error: " + std::string(e.what())));
+        }
+        state->phase = finished;
+
+        net::post(executor, [error, result = std::move(result), handler = std::move(handler)]() mutable {
+            handler(error, std::move(result));
+        });
+    });
+}
+
+} // NAMESPACE GEECODEX::DATABASE
+#endif // DB_ASYNC_HPP
@@ -14,6 +14,7 @@
 #include <variant>
 #include <type_traits>
 #include <string_view>
+#include <cstdint>
 
 
 #include <pqxx/pqxx>
@@ -198,6 +199,36 @@ public:
     [[nodiscard]] const connection_config&
     get_config() const { return m_config; }
 
+    // The connection is shared by the I/O thread and the database worker;
+    // hold this lock for the whole lifetime of a transaction.
+    [[nodiscard]] std::unique_lock<std::mutex>
+    lock() { return std::unique_lock<std::mutex>{m_exec_mutex}; }
+
+    // Statement tokens let another thread cancel one specific statement
+    // (PQcancel) without hitting whatever the connection runs next.
+    std::uint64_t begin_statement() {
+        std::lock_guard<std::mutex> guard(m_cancel_mutex);
+        m_active_statement = ++m_statement_counter;
+        return m_active_statement;
+    }
+
+    void end_statement() {
+        std::lock_guard<std::mutex> guard(m_cancel_mutex);
+        m_active_statement = 0;
+    }
+
+    bool cancel_statement(std::uint64_t token) {
+        std::lock_guard<std::mutex> guard(m_cancel_mutex);
+        if (token == 0 || token != m_active_statement || !m_connection) return false;
+        try {
+            m_connection->cancel_query();
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to cancel running statement: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
 private:
     explicit connection_manager(const connection_config& config) 
         : m_config{config} 
@@ -218,6 +249,11 @@ private:
 
     connection_config m_config;
     std::unique_ptr<connection_type> m_connection;
+
+    std::mutex m_exec_mutex;
+    std::mutex m_cancel_mutex;
+    std::uint64_t m_statement_counter = 0;
+    std::uint64_t m_active_statement = 0;
 };
 
 using pg_connection = connection_manager<Db_Type::PostgreSQL>;
@@ -17,6 +17,7 @@ inline int execute_non_query(const std::string& sql) {
         auto& conn = pg_connection::get_instance();
         if (!conn.is_initialized()) 
             throw database_exception(std::string("Database connection not initialized"));
+        auto lock = conn.lock();
         pqxx::work txn(conn.get_connection());
         pqxx::result result = txn.exec(sql);
         txn.commit();
@@ -34,6 +35,7 @@ inline pqxx::result execute_query(const std::string& sql) {
         auto& conn = pg_connection::get_instance();
         if (!conn.is_initialized()) 
             throw database_exception(std::string("Database connection not initialized"));
+        auto lock = conn.lock();
         pqxx::work txn(conn.get_connection());
         pqxx::result result = txn.exec(sql);
         txn.commit();
@@ -54,6 +56,7 @@ inline pqxx::result execute_params( const std::string& sql
         auto& conn = pg_connection::get_instance();
         if (!conn.is_initialized()) 
             throw database_exception(std::string("Database connection not initialized"));
+        auto lock = conn.lock();
         pqxx::work txn(conn.get_connection());
         pqxx::result result = txn.exec_params(sql, std::forward<Args>(args)...);
         txn.commit();
@@ -72,6 +75,7 @@ execute_transaction(const std::function<void(pqxx::work&)>& transaction_func) {
         auto& conn = pg_connection::get_instance();
         if (!conn.is_initialized()) 
             throw database_exception(std::string("Database connection not initialized"));
+        auto lock = conn.lock();
         pqxx::work txn(conn.get_connection());
         try {
             transaction_func(txn);
@@ -101,6 +105,7 @@ batch_insert( const std::string& table
         auto& conn = pg_connection::get_instance();
         if (!conn.is_initialized())
             throw database_exception(std::string("Database connection not initialized"));
+        auto lock = conn.lock();
         pqxx::work txn(conn.get_connection());
 
         std::string column_list;
@@ -138,6 +143,7 @@ inline bool table_exists(const std::string& table_name) {
         auto& conn = pg_connection::get_instance();
         if (!conn.is_initialized()) 
             throw database_exception(std::string("Database connection not initialized"));
+        auto lock = conn.lock();
         pqxx::work txn{conn.get_connection()};
         pqxx::result result = txn.exec(
             "SELECT EXISTS (SELECT 1 FROM information_schema.tables) "
@@ -157,6 +163,7 @@ inline T get_scalar(const std::string& sql) {
         if (!conn.is_initialized()) 
             throw database_exception(std::string("Database connection not initialized"));
             
+        auto lock = conn.lock();
         pqxx::work txn{conn.get_connection()};
         pqxx::row row = txn.exec1(sql);
         txn.commit();
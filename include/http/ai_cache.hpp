@@ -0,0 +1,330 @@
+#ifndef AI_CACHE_HPP
+#define AI_CACHE_HPP
+
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <openssl/evp.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::http {
+namespace net = boost::asio;
+
+struct ai_cache_config {
+    std::chrono::seconds ttl{std::chrono::hours{6}};
+    std::size_t max_bytes = 64 * 1024 * 1024;
+    std::string disk_dir;   // empty: in-memory tier only
+
+    // GEECODEX_AI_CACHE_TTL (seconds, 0 disables the cache),
+    // GEECODEX_AI_CACHE_BYTES and GEECODEX_AI_CACHE_DIR.
+    static ai_cache_config from_env() {
+        ai_cache_config config;
+        config.ttl = std::chrono::seconds{utils::env_int("GEECODEX_AI_CACHE_TTL", config.ttl.count())};
+        config.max_bytes = static_cast<std::size_t>(utils::env_int("GEECODEX_AI_CACHE_BYTES", static_cast<long long>(config.max_bytes)));
+        config.disk_dir = utils::env_string("GEECODEX_AI_CACHE_DIR");
+        return config;
+    }
+};
+
+// Cache of finished (non-streaming) AI chat replies keyed by a canonical hash
+// of `model` + `messages`, with coalescing of identical in-flight requests:
+// the first caller (the leader) goes upstream, later callers with the same key
+// wait for its result instead of issuing their own call.
+//
+// The optional disk tier is only touched on the cache's own file thread and
+// never under m_mutex: a leader checks it with lead_from_disk() before going
+// upstream, and complete() queues the write.
+class ai_response_cache {
+public:
+    using clock  = std::chrono::steady_clock;
+    using waiter = std::function<void(const std::optional<std::string>& body)>;
+
+    explicit ai_response_cache(ai_cache_config config = ai_cache_config::from_env())
+        : m_config{std::move(config)} {
+        if (!m_config.disk_dir.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(m_config.disk_dir, ec);
+            if (ec) {
+                SPDLOG_WARN("AI cache disk tier disabled, cannot create '{}': {}", m_config.disk_dir, ec.message());
+                m_config.disk_dir.clear();
+            }
+        }
+    }
+
+    [[nodiscard]] bool enabled() const { return m_config.ttl.count() > 0 && m_config.max_bytes > 0; }
+    [[nodiscard]] bool disk_tier() const { return enabled() && !m_config.disk_dir.empty(); }
+
+    // nlohmann::json keeps object keys sorted, so dump() is already canonical.
+    static std::string make_key(const nlohmann::json& model, const nlohmann::json& messages) {
+        std::string canonical = model.dump() + '\n' + messages.dump();
+
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_len = 0;
+        EVP_Digest(canonical.data(), canonical.size(), digest, &digest_len, EVP_sha256(), nullptr);
+
+        static constexpr char hex[] = "0123456789abcdef";
+        std::string key;
+        key.reserve(digest_len * 2);
+        for (unsigned int i = 0; i < digest_len; ++i) {
+            key.push_back(hex[digest[i] >> 4]);
+            key.push_back(hex[digest[i] & 0x0f]);
+        }
+        return key;
+    }
+
+    // Memory tier only; with a disk tier the leader continues with
+    // lead_from_disk().
+    std::optional<std::string> get(const std::string& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_lookups;
+
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            if (it->second.expires_at > clock::now()) {
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+                ++m_hits;
+                m_saved_upstream_ms += it->second.upstream_ms;
+                return it->second.body;
+            }
+            erase_locked(it);
+        }
+        if (!disk_tier()) ++m_misses;
+        return std::nullopt;
+    }
+
+    // For the leader of `key` after a memory miss: reads the disk tier on the
+    // file thread. A hit is promoted to memory and answers the coalesced
+    // waiters. `handler(std::optional<std::string>)` then runs on `executor`
+    // with the body, or with nullopt when the leader has to go upstream and
+    // complete() the key as usual.
+    template <typename Handler>
+    void lead_from_disk(const std::string& key, net::any_io_executor executor, Handler handler) {
+        net::post(disk_pool(), [this, key, executor, handler = std::move(handler)]() mutable {
+            auto from_disk = load_from_disk(key);
+            std::optional<std::string> body;
+            std::vector<waiter> waiters;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (from_disk) {
+                    ++m_disk_hits;
+                    auto it = m_in_flight.find(key);
+                    if (it != m_in_flight.end()) {
+                        waiters = std::move(it->second);
+                        m_in_flight.erase(it);
+                    }
+                    m_saved_upstream_ms += from_disk->second * (waiters.size() + 1);
+                    body = from_disk->first;
+                    insert_locked(key, std::move(from_disk->first), from_disk->second);
+                } else ++m_misses;
+            }
+            notify(waiters, body);
+            net::post(executor, [handler = std::move(handler), body = std::move(body)]() mutable { handler(std::move(body)); });
+        });
+    }
+
+    // Returns true when the caller should perform the upstream request itself.
+    // Otherwise `on_ready` is queued and called once the leader completes.
+    bool join_or_lead(const std::string& key, waiter on_ready) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto [it, inserted] = m_in_flight.try_emplace(key);
+        if (inserted) return true;
+
+        it->second.push_back(std::move(on_ready));
+        ++m_coalesced;
+        return false;
+    }
+
+    bool has_waiters(const std::string& key) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_in_flight.find(key);
+        return it != m_in_flight.end() && !it->second.empty();
+    }
+
+    // Called by the leader exactly once; `body` is empty when the upstream
+    // call failed, in which case nothing is cached and waiters get an error.
+    void complete(const std::string& key, std::optional<std::string> body, std::chrono::milliseconds upstream_latency) {
+        std::vector<waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_in_flight.find(key);
+            if (it != m_in_flight.end()) {
+                waiters = std::move(it->second);
+                m_in_flight.erase(it);
+            }
+            if (body) {
+                m_upstream_calls_ms += static_cast<std::uint64_t>(upstream_latency.count());
+                ++m_upstream_calls;
+                m_saved_upstream_ms += static_cast<std::uint64_t>(upstream_latency.count()) * waiters.size();
+                insert_locked(key, *body, static_cast<std::uint64_t>(upstream_latency.count()));
+            }
+        }
+        if (body && disk_tier()) {
+            net::post(disk_pool(), [this, key, stored = *body, upstream_ms = static_cast<std::uint64_t>(upstream_latency.count())] {
+                store_to_disk(key, stored, upstream_ms);
+            });
+        }
+        notify(waiters, body);
+    }
+
+    nlohmann::json stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nlohmann::json out;
+        out["enabled"] = m_config.ttl.count() > 0 && m_config.max_bytes > 0;
+        out["entries"] = m_entries.size();
+        out["bytes"] = m_bytes;
+        out["max_bytes"] = m_config.max_bytes;
+        out["ttl_seconds"] = m_config.ttl.count();
+        out["disk_tier"] = !m_config.disk_dir.empty();
+        out["lookups"] = m_lookups;
+        out["hits"] = m_hits;
+        out["disk_hits"] = m_disk_hits;
+        out["misses"] = m_misses;
+        out["coalesced"] = m_coalesced;
+        out["evictions"] = m_evictions;
+        out["in_flight"] = m_in_flight.size();
+        const auto served = m_hits + m_disk_hits + m_coalesced;
+        out["hit_rate"] = (m_lookups == 0) ? 0.0 : static_cast<double>(served) / static_cast<double>(m_lookups);
+        out["saved_upstream_ms"] = m_saved_upstream_ms;
+        out["avg_upstream_ms"] = (m_upstream_calls == 0) ? 0.0 : static_cast<double>(m_upstream_calls_ms) / static_cast<double>(m_upstream_calls);
+        return out;
+    }
+
+private:
+    struct entry {
+        std::string body;
+        clock::time_point expires_at;
+        std::uint64_t upstream_ms = 0;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    ai_cache_config m_config;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, entry> m_entries;
+    std::list<std::string> m_lru;     // front: most recently used
+    std::unordered_map<std::string, std::vector<waiter>> m_in_flight;
+    std::size_t m_bytes = 0;
+
+    std::uint64_t m_lookups = 0;
+    std::uint64_t m_hits = 0;
+    std::uint64_t m_disk_hits = 0;
+    std::uint64_t m_misses = 0;
+    std::uint64_t m_coalesced = 0;
+    std::uint64_t m_evictions = 0;
+    std::uint64_t m_saved_upstream_ms = 0;
+    std::uint64_t m_upstream_calls = 0;
+    std::uint64_t m_upstream_calls_ms = 0;
+
+    // One thread, so a write queued by complete() lands before a later read.
+    static net::thread_pool& disk_pool() {
+        static net::thread_pool pool{1};
+        return pool;
+    }
+
+    static void notify(std::vector<waiter>& waiters, const std::optional<std::string>& body) {
+        for (auto& w: waiters) {
+            try {
+                w(body);
+            } catch (const std::exception& e) {
+                SPDLOG_ERROR("AI cache waiter threw: {}", e.what());
+            }
+        }
+    }
+
+    static std::size_t entry_cost(const std::string& key, const std::string& body) {
+        return key.size() * 2 + body.size() + sizeof(entry);
+    }
+
+    void erase_locked(std::unordered_map<std::string, entry>::iterator it) {
+        m_bytes -= entry_cost(it->first, it->second.body);
+        m_lru.erase(it->second.lru_pos);
+        m_entries.erase(it);
+    }
+
+    void insert_locked(const std::string& key, std::string body, std::uint64_t upstream_ms) {
+        if (!enabled()) return;
+        const auto cost = entry_cost(key, body);
+        if (cost > m_config.max_bytes) return;
+
+        if (auto it = m_entries.find(key); it != m_entries.end()) erase_locked(it);
+        while (m_bytes + cost > m_config.max_bytes && !m_lru.empty()) {
+            erase_locked(m_entries.find(m_lru.back()));
+            ++m_evictions;
+        }
+
+        m_lru.push_front(key);
+        m_entries.emplace(key, entry{std::move(body), clock::now() + m_config.ttl, upstream_ms, m_lru.begin()});
+        m_bytes += cost;
+    }
+
+    // Disk entries: "<unix_time> <upstream_ms>\n<body>" in <disk_dir>/<key>.
+    // Both run on disk_pool() only; m_config is not modified after construction.
+    std::optional<std::pair<std::string, std::uint64_t>> load_from_disk(const std::string& key) const {
+        if (!disk_tier()) return std::nullopt;
+        auto path = std::filesystem::path{m_config.disk_dir} / key;
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return std::nullopt;
+
+        std::int64_t created = 0;
+        std::uint64_t upstream_ms = 0;
+        in >> created >> upstream_ms;
+        in.get();
+        std::ostringstream body;
+        body << in.rdbuf();
+        if (!in.good() && !in.eof()) return std::nullopt;
+
+        auto age = std::chrono::system_clock::now().time_since_epoch() - std::chrono::seconds{created};
+        if (age > m_config.ttl) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            return std::nullopt;
+        }
+        return std::make_pair(body.str(), upstream_ms);
+    }
+
+    void store_to_disk(const std::string& key, const std::string& body, std::uint64_t upstream_ms) const {
+        if (!disk_tier()) return;
+        auto path = std::filesystem::path{m_config.disk_dir} / key;
+        auto tmp_path = path;
+        tmp_path += ".tmp";
+
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            SPDLOG_WARN("AI cache: cannot write '{}'", tmp_path.string());
+            return;
+        }
+        auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        out << now << ' ' << upstream_ms << '\n' << body;
+        out.close();
+
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec) SPDLOG_WARN("AI cache: cannot publish '{}': {}", path.string(), ec.message());
+    }
+};
+
+inline ai_response_cache& get_ai_response_cache() {
+    static ai_response_cache instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::HTTP
+#endif // AI_CACHE_HPP
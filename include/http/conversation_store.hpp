@@ -0,0 +1,245 @@
+#ifndef CONVERSATION_STORE_HPP
+#define CONVERSATION_STORE_HPP
+
+#include <database/db_async.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+#include <utils/random_id.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::http {
+namespace net = boost::asio;
+
+struct conversation_store_config {
+    std::size_t max_conversations = 10'000;
+    std::size_t max_bytes = 64 * 1024 * 1024;
+    std::size_t max_messages = 64;          // per conversation; oldest non-system turns are dropped
+    std::chrono::seconds idle_ttl{std::chrono::hours{24}};
+    bool spill_to_db = false;               // evicted conversations go to `ai_conversations`
+
+    // GEECODEX_CONVERSATION_MAX, GEECODEX_CONVERSATION_BYTES,
+    // GEECODEX_CONVERSATION_MAX_MESSAGES, GEECODEX_CONVERSATION_TTL (seconds)
+    // and GEECODEX_CONVERSATION_SPILL.
+    static conversation_store_config from_env() {
+        conversation_store_config config;
+        config.max_conversations = static_cast<std::size_t>(utils::env_int("GEECODEX_CONVERSATION_MAX", static_cast<long long>(config.max_conversations)));
+        config.max_bytes = static_cast<std::size_t>(utils::env_int("GEECODEX_CONVERSATION_BYTES", static_cast<long long>(config.max_bytes)));
+        config.max_messages = static_cast<std::size_t>(utils::env_int("GEECODEX_CONVERSATION_MAX_MESSAGES", static_cast<long long>(config.max_messages)));
+        config.idle_ttl = std::chrono::seconds{utils::env_int("GEECODEX_CONVERSATION_TTL", config.idle_ttl.count())};
+        config.spill_to_db = utils::env_flag("GEECODEX_CONVERSATION_SPILL", config.spill_to_db);
+        return config;
+    }
+};
+
+// Server-side chat histories, so a client only uploads the newest message of
+// each turn. Histories are kept in an LRU bounded by count and bytes; with
+// spilling enabled, evicted histories are written to Postgres on the database
+// worker and read back when the conversation resumes.
+//
+// A history is replaced as a whole once a turn succeeds, so a failed upstream
+// call never leaves a dangling user message behind. Two concurrent turns on
+// the same conversation both succeed; the one finishing last wins.
+class conversation_store {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit conversation_store(conversation_store_config config = conversation_store_config::from_env())
+        : m_config{config} {}
+
+    [[nodiscard]] bool spill_enabled() const { return m_config.spill_to_db; }
+
+    // 128 random bits, hex encoded.
+    static std::string new_id() { return utils::random_hex_id<16>(); }
+    static bool valid_id(std::string_view id) { return utils::is_hex_id<16>(id); }
+
+    // Copy of the stored messages, or nullopt when the id is unknown in memory
+    // (the caller may then try load_spilled()). An idle history that expires
+    // here is spilled like an evicted one, so the database never keeps an
+    // older copy of it for load_spilled() to resume from.
+    std::optional<nlohmann::json> get(const std::string& id) {
+        std::string expired;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(id);
+            if (it == m_entries.end()) {
+                ++m_misses;
+                return std::nullopt;
+            }
+            if (clock::now() - it->second.touched_at <= m_config.idle_ttl) {
+                it->second.touched_at = clock::now();
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+                ++m_hits;
+                return it->second.messages;
+            }
+            if (m_config.spill_to_db) expired = it->second.messages.dump();
+            erase_locked(it);
+            ++m_expired;
+            ++m_misses;
+        }
+        // The database worker runs statements in order, so a load_spilled()
+        // issued after this returns sees the spilled copy.
+        if (!expired.empty()) spill(id, std::move(expired));
+        return std::nullopt;
+    }
+
+    // Stores the complete history after a successful turn.
+    void put(const std::string& id, nlohmann::json messages) {
+        trim(messages);
+        std::string serialized = messages.dump();
+        std::vector<std::pair<std::string, std::string>> evicted;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (auto it = m_entries.find(id); it != m_entries.end()) erase_locked(it);
+
+            const auto cost = id.size() * 2 + serialized.size();
+            while (!m_lru.empty() &&
+                   (m_entries.size() >= m_config.max_conversations || m_bytes + cost > m_config.max_bytes)) {
+                auto victim = m_entries.find(m_lru.back());
+                if (m_config.spill_to_db) evicted.emplace_back(victim->first, victim->second.messages.dump());
+                erase_locked(victim);
+                ++m_evictions;
+            }
+
+            m_lru.push_front(id);
+            m_entries.emplace(id, entry{std::move(messages), cost, clock::now(), m_lru.begin()});
+            m_bytes += cost;
+            ++m_turns;
+        }
+        for (auto& [victim_id, victim_messages]: evicted) spill(std::move(victim_id), std::move(victim_messages));
+    }
+
+    // Reads a spilled history on the database worker; the turn that follows
+    // put()s it back into memory.
+    // `handler(std::optional<nlohmann::json>)` runs on `executor`.
+    template <typename Handler>
+    void load_spilled( net::any_io_executor executor
+                     , net::cancellation_slot slot
+                     , const std::string& id
+                     , Handler handler) {
+        database::async_execute(executor, slot,
+            [id](pqxx::work& txn) {
+                return txn.exec_params("SELECT messages::text FROM ai_conversations WHERE conversation_id = $1", id);
+            },
+            [this, id, handler = std::move(handler)](std::exception_ptr error, pqxx::result result) mutable {
+                std::optional<nlohmann::json> messages;
+                if (error) {
+                    try { std::rethrow_exception(error); }
+                    catch (const std::exception& e) { SPDLOG_WARN("Loading spilled conversation {} failed: {}", id, e.what()); }
+                } else if (!result.empty()) {
+                    auto parsed = nlohmann::json::parse(result[0][0].c_str(), nullptr, false);
+                    if (!parsed.is_discarded() && parsed.is_array()) messages = std::move(parsed);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (messages) ++m_restored;
+                }
+                handler(std::move(messages));
+            });
+    }
+
+    nlohmann::json stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nlohmann::json out;
+        out["conversations"] = m_entries.size();
+        out["max_conversations"] = m_config.max_conversations;
+        out["bytes"] = m_bytes;
+        out["max_bytes"] = m_config.max_bytes;
+        out["max_messages"] = m_config.max_messages;
+        out["idle_ttl_seconds"] = m_config.idle_ttl.count();
+        out["spill_to_db"] = m_config.spill_to_db;
+        out["hits"] = m_hits;
+        out["misses"] = m_misses;
+        out["expired"] = m_expired;
+        out["evictions"] = m_evictions;
+        out["spilled"] = m_spilled;
+        out["spill_failures"] = m_spill_failures;
+        out["restored"] = m_restored;
+        out["turns"] = m_turns;
+        return out;
+    }
+
+private:
+    struct entry {
+        nlohmann::json messages;
+        std::size_t cost = 0;
+        clock::time_point touched_at;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    conversation_store_config m_config;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, entry> m_entries;
+    std::list<std::string> m_lru;     // front: most recently used
+    std::size_t m_bytes = 0;
+
+    std::uint64_t m_hits = 0;
+    std::uint64_t m_misses = 0;
+    std::uint64_t m_expired = 0;
+    std::uint64_t m_evictions = 0;
+    std::uint64_t m_spilled = 0;
+    std::uint64_t m_spill_failures = 0;
+    std::uint64_t m_restored = 0;
+    std::uint64_t m_turns = 0;
+
+    void erase_locked(std::unordered_map<std::string, entry>::iterator it) {
+        m_bytes -= it->second.cost;
+        m_lru.erase(it->second.lru_pos);
+        m_entries.erase(it);
+    }
+
+    // Keeps leading system prompts and the newest `max_messages` others.
+    void trim(nlohmann::json& messages) const {
+        if (m_config.max_messages == 0 || messages.size() <= m_config.max_messages) return;
+        std::size_t system_prefix = 0;
+        while (system_prefix < messages.size() && messages[system_prefix].value("role", "") == "system") ++system_prefix;
+
+        std::size_t excess = messages.size() - m_config.max_messages;
+        std::size_t removable = messages.size() - system_prefix;
+        excess = std::min(excess, removable > 0 ? removable - 1 : 0);
+        messages.erase(messages.begin() + static_cast<std::ptrdiff_t>(system_prefix),
+                       messages.begin() + static_cast<std::ptrdiff_t>(system_prefix + excess));
+    }
+
+    void spill(std::string id, std::string messages) {
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [id, messages = std::move(messages)](pqxx::work& txn) {
+                return txn.exec_params(
+                    "INSERT INTO ai_conversations (conversation_id, messages, updated_at) "
+                    "VALUES ($1, $2::jsonb, NOW()) "
+                    "ON CONFLICT (conversation_id) DO UPDATE SET messages = EXCLUDED.messages, updated_at = NOW()",
+                    id, messages);
+            },
+            [this, id](std::exception_ptr error, pqxx::result) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!error) {
+                    ++m_spilled;
+                    return;
+                }
+                ++m_spill_failures;
+                try { std::rethrow_exception(error); }
+                catch (const std::exception& e) { SPDLOG_WARN("Spilling conversation {} failed: {}", id, e.what()); }
+            });
+    }
+};
+
+inline conversation_store& get_conversation_store() {
+    static conversation_store instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::HTTP
+#endif // CONVERSATION_STORE_HPP
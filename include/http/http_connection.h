@@ -5,6 +5,8 @@
 
 #include "http/router_defs.hpp"
 #include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/cancellation_type.hpp>
 #include <boost/asio/error.hpp>
 #include <boost/beast/core/bind_handler.hpp>
 #include <boost/beast/core/error.hpp>
@@ -30,8 +32,15 @@
 #include <cstddef>
 #include <database/db_conn.h>
 #include <database/db_ops.hpp>
+#include <database/db_async.hpp>
 #include <exception>
 #include <http/router.hpp>
+#include <http/sse_parser.hpp>
+#include <http/multipart.hpp>
+#include <http/query_params.hpp>
+#include <http/shared_body.hpp>
+#include <http/ai_cache.hpp>
+#include <http/upstream_guard.hpp>
 
 #include <pqxx/internal/statement_parameters.hxx>
 #include <pqxx/result.hxx>
@@ -46,6 +55,10 @@
 #include <iostream>
 #include <chrono>
 #include <random>
+#include <array>
+#include <functional>
+#include <optional>
+#include <vector>
 
 namespace geecodex::http {
 using json      = nlohmann::json;
@@ -88,6 +101,26 @@ public:
     http::response<http::string_body>& response() { return m_response; }
     bool response_sent() const { return m_response_sent; }
 
+    // Decoded multipart body for routes where streams_request_body() holds;
+    // nullptr otherwise (the body is then in request().body()).
+    multipart_upload* upload() { return m_upload ? &*m_upload : nullptr; }
+
+    // `:name` segments of the matched route, and the decoded query string.
+    std::string path_param(const std::string& name) const {
+        auto it = m_path_params.find(name);
+        return it == m_path_params.end() ? std::string{} : it->second;
+    }
+    const query_params& query() const { return m_query; }
+
+    // Work started on behalf of this request (upstream calls, DB statements)
+    // attaches to this slot; it fires once if the client disconnects first.
+    net::cancellation_slot cancellation_slot() { return m_cancel_signal.slot(); }
+    bool client_gone() const { return m_client_gone; }
+
+    // Handlers that finish asynchronously call this before returning so the
+    // default (empty) response is not written on their behalf.
+    void defer_response() { m_response_deferred = true; }
+
     void send(http::response<http::string_body>&& response) {
         send_response_impl(std::move(response), "string_body");
     }  
@@ -96,6 +129,55 @@ public:
         send_response_impl(std::move(response), "file_body");
     }
 
+    void send(http::response<shared_string_body>&& response) {
+        send_response_impl(std::move(response), "shared_string_body");
+    }
+
+    using write_handler = std::function<void(beast::error_code)>;
+
+    // Chunked responses (e.g. text/event-stream): the header goes out first,
+    // then every send_chunk() call is written as one HTTP chunk. Callers must
+    // wait for the previous handler before writing the next chunk.
+    void send_chunked_header(http::response<http::empty_body>&& header, write_handler handler) {
+        if (m_response_sent) {
+            std::cerr << "Error: Attempted to start chunked response when one was already sent" << std::endl;
+            if (handler) handler(net::error::already_started);
+            return;
+        }
+        m_response_sent = true;
+
+        auto self = shared_from_this();
+        m_stream_header = std::make_shared<http::response<http::empty_body>>(std::move(header));
+        m_stream_header->chunked(true);
+        m_stream_serializer = std::make_shared<http::response_serializer<http::empty_body>>(*m_stream_header);
+
+        http::async_write_header(m_socket, *m_stream_serializer, [self, handler = std::move(handler)](beast::error_code ec, std::size_t) {
+            if (ec) std::cerr << "Error writing chunked response header: " << ec.message() << '\n';
+            if (handler) handler(ec);
+        });
+    }
+
+    void send_chunk(std::string data, write_handler handler) {
+        auto self = shared_from_this();
+        auto payload = std::make_shared<std::string>(std::move(data));
+        net::async_write(m_socket, http::make_chunk(net::buffer(*payload)), [self, payload, handler = std::move(handler)](beast::error_code ec, std::size_t) {
+            if (ec) std::cerr << "Error writing response chunk: " << ec.message() << '\n';
+            if (handler) handler(ec);
+        });
+    }
+
+    void finish_chunked(write_handler handler = {}) {
+        auto self = shared_from_this();
+        net::async_write(m_socket, http::make_chunk_last(), [self, handler = std::move(handler)](beast::error_code ec, std::size_t) {
+            if (ec) std::cerr << "Error writing last response chunk: " << ec.message() << '\n';
+            beast::error_code shutdown_ec;
+            self->m_socket.shutdown(tcp::socket::shutdown_send, shutdown_ec);
+            if (shutdown_ec && shutdown_ec != beast::errc::not_connected)
+                std::cerr << "Error shutting down socket send: " << shutdown_ec.message() << '\n';
+            if (handler) handler(ec);
+        });
+    }
+
 private: 
     tcp::socket                         m_socket;
     beast::flat_buffer                  m_buffer{8192};
@@ -103,6 +185,42 @@ private:
     http::response<http::string_body>   m_response;
     bool                                m_response_sent;
     std::map<std::string, std::string>  m_path_params;
+    query_params                        m_query;
+
+    // The header is read first; the body then goes either into m_request via
+    // m_body_parser or, for streamed uploads, chunk by chunk into m_upload.
+    std::optional<http::request_parser<http::empty_body>>   m_header_parser;
+    std::optional<http::request_parser<http::string_body>>  m_body_parser;
+    std::optional<http::request_parser<http::buffer_body>>  m_upload_parser;
+    std::optional<multipart_upload>                         m_upload;
+    std::array<char, 8192>                                  m_upload_chunk{};
+
+    std::shared_ptr<http::response<http::empty_body>>               m_stream_header;
+    std::shared_ptr<http::response_serializer<http::empty_body>>    m_stream_serializer;
+
+    net::cancellation_signal            m_cancel_signal;
+    bool                                m_client_gone = false;
+    bool                                m_response_deferred = false;
+    std::array<char, 1>                 m_disconnect_probe{};
+
+    // While a handler is still pending, keep one read outstanding on the
+    // client socket: the client sends nothing more after its request, so
+    // completion with an error means it hung up. End of stream is not one:
+    // a client may half-close after its request and still read the reply.
+    // A client that closed completely is noticed when the reply is written.
+    void watch_for_disconnect() {
+        auto self = shared_from_this();
+        m_socket.async_read_some(net::buffer(m_disconnect_probe), [self](beast::error_code ec, std::size_t) {
+            if (!ec) {
+                if (!self->m_client_gone) self->watch_for_disconnect();
+                return;
+            }
+            if (ec == net::error::operation_aborted || ec == net::error::eof) return;
+            self->m_client_gone = true;
+            std::cout << "Client disconnected (" << ec.message() << "), cancelling pending work." << std::endl;
+            self->m_cancel_signal.emit(net::cancellation_type::terminal);
+        });
+    }
 
     template <class BodyType>
     void send_response_impl(http::response<BodyType>&& response_to_send, const char* response_description) {
@@ -150,16 +268,17 @@ private:
     
     void read_request() {
         auto self = shared_from_this();
+        m_header_parser.emplace();
                         
-        http::async_read( m_socket
-                        , m_buffer
-                        , m_request
-                        , [self]( beast::error_code ec
-                                        , std::size_t bytes_transferred) { 
+        http::async_read_header( m_socket
+                               , m_buffer
+                               , *m_header_parser
+                               , [self]( beast::error_code ec
+                                       , std::size_t bytes_transferred) { 
                                             boost::ignore_unused(bytes_transferred);
                                             try {
-                                                if (!ec) self->process_request();
-                                                else std::cerr << "Error reading request :" << ec.message() << "\n";    
+                                                if (!ec) self->on_request_header();
+                                                else std::cerr << "Error reading request header :" << ec.message() << "\n";    
                                             } catch (const std::exception& e) {
                                                 std::cerr << "Exception in read_request completion handler: " << e.what() << '\n';
                                             } catch (...) {
@@ -168,6 +287,141 @@ private:
                                         }); 
     }
 
+    void on_request_header() {
+        const auto& header = m_header_parser->get();
+        std::string_view target(header.target().data(), header.target().size());
+        auto route = get_global_route_table().find(target_path(target), enum2method(header.method())).route;
+
+        if (streams_request_body(route)) {
+            auto content_type = header[http::field::content_type];
+            if (auto boundary = multipart_boundary({content_type.data(), content_type.size()})) 
+                return start_upload(std::move(*boundary));
+        }
+
+        auto self = shared_from_this();
+        m_body_parser.emplace(std::move(*m_header_parser));
+        m_header_parser.reset();
+        http::async_read( m_socket
+                        , m_buffer
+                        , *m_body_parser
+                        , [self]( beast::error_code ec
+                                , std::size_t bytes_transferred) { 
+                                    boost::ignore_unused(bytes_transferred);
+                                    try {
+                                        if (ec) {
+                                            std::cerr << "Error reading request :" << ec.message() << "\n";
+                                            return;
+                                        }
+                                        self->m_request = self->m_body_parser->release();
+                                        self->m_body_parser.reset();
+                                        self->process_request();
+                                    } catch (const std::exception& e) {
+                                        std::cerr << "Exception in read_request completion handler: " << e.what() << '\n';
+                                    } catch (...) {
+                                        std::cerr << "Unknown exception in read_request completion handler" << '\n';
+                                    }
+                                }); 
+    }
+
+    // Streams a multipart body through m_upload_chunk into m_upload. Large
+    // parts are spilled to disk while they arrive; the file work runs on
+    // the upload file pool and the next chunk is read once it is done.
+    void start_upload(std::string boundary) {
+        const auto& limits = get_upload_limits();
+        m_upload_parser.emplace(std::move(*m_header_parser));
+        m_header_parser.reset();
+        m_upload_parser->body_limit(limits.max_total_bytes);
+        m_request.base() = m_upload_parser->get().base();
+        m_upload.emplace(std::move(boundary), limits);
+
+        // Refuse before a single body byte is transferred when we can.
+        auto declared = m_upload_parser->content_length();
+        if (declared && *declared > limits.max_total_bytes) 
+            return reject_upload(upload_error(http::status::payload_too_large, "Upload exceeds " + std::to_string(limits.max_total_bytes) + " bytes"));
+
+        auto expect = m_request[http::field::expect];
+        if (beast::iequals(expect, "100-continue")) {
+            auto self = shared_from_this();
+            static constexpr std::string_view continue_line = "HTTP/1.1 100 Continue\r\n\r\n";
+            net::async_write(m_socket, net::buffer(continue_line), [self](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    std::cerr << "Error writing 100 Continue: " << ec.message() << '\n';
+                    return;
+                }
+                self->read_upload_chunk();
+            });
+            return;
+        }
+        read_upload_chunk();
+    }
+
+    void read_upload_chunk() {
+        auto& body = m_upload_parser->get().body();
+        body.data = m_upload_chunk.data();
+        body.size = m_upload_chunk.size();
+
+        auto self = shared_from_this();
+        http::async_read_some(m_socket, m_buffer, *m_upload_parser, [self](beast::error_code ec, std::size_t) {
+            try {
+                if (ec == http::error::need_buffer) ec = {};
+                if (ec == http::error::body_limit) 
+                    return self->reject_upload(upload_error(http::status::payload_too_large, "Upload too large"));
+                if (ec) {
+                    std::cerr << "Error reading upload: " << ec.message() << '\n';
+                    return;
+                }
+
+                auto received = self->m_upload_chunk.size() - self->m_upload_parser->get().body().size;
+                self->m_upload->feed({self->m_upload_chunk.data(), received});
+
+                if (self->m_upload_parser->is_done()) {
+                    self->m_upload_parser.reset();
+                    return self->run_upload_file_work(&multipart_upload::finish, &http_connection::process_request);
+                }
+                if (self->m_upload->spill_due())
+                    return self->run_upload_file_work(&multipart_upload::write_spills, &http_connection::read_upload_chunk);
+                self->read_upload_chunk();
+            } catch (const upload_error& e) {
+                self->reject_upload(e);
+            } catch (const std::exception& e) {
+                std::cerr << "Exception reading upload: " << e.what() << '\n';
+                self->reject_upload(upload_error(http::status::internal_server_error, e.what()));
+            }
+        });
+    }
+
+    // Runs `work` on m_upload on the upload file pool, then `next` (or the
+    // rejection) back on this connection's executor. Nothing else touches
+    // m_upload meanwhile: no read is outstanding.
+    void run_upload_file_work(void (multipart_upload::*work)(), void (http_connection::*next)()) {
+        auto self = shared_from_this();
+        net::post(get_upload_file_pool(), [self, work, next] {
+            std::optional<upload_error> failed;
+            try {
+                ((*self->m_upload).*work)();
+            } catch (const upload_error& e) {
+                failed = e;
+            } catch (const std::exception& e) {
+                failed.emplace(http::status::internal_server_error, e.what());
+            }
+            net::post(self->m_socket.get_executor(), [self, next, failed = std::move(failed)] {
+                try {
+                    if (failed) return self->reject_upload(*failed);
+                    ((*self).*next)();
+                } catch (const std::exception& e) {
+                    std::cerr << "Exception after upload file work: " << e.what() << '\n';
+                }
+            });
+        });
+    }
+
+    void reject_upload(const upload_error& error) {
+        std::cerr << "Rejecting upload: " << error.what() << std::endl;
+        m_upload.reset();
+        m_upload_parser.reset();
+        send_json_error(*this, error.status(), "Upload rejected", error.what());
+    }
+
     void process_request() {
         try {
             m_response.version(m_request.version());
@@ -178,9 +432,10 @@ private:
                       << " " << target << std::endl;
 
             http_method method = enum2method(m_request.method());
-            auto match = get_global_route_table().find(target, method);
+            auto match = get_global_route_table().find(target_path(target), method);
             api_route route = match.route;
             this->m_path_params = match.params;
+            this->m_query = query_params{target};
             
             
             std::cout << "Route matched: " << geecodex::http::to_string(route) 
@@ -189,6 +444,10 @@ private:
             m_response.set(http::field::server, "GeeCodeX");
             dispatch_route(route);
         
+            if (m_response_deferred) {
+                if (!m_response_sent) watch_for_disconnect();
+                return;
+            }
             if (!m_response_sent) write_response();
 
         } catch (const std::exception& e) {
@@ -311,18 +570,41 @@ public:
                              , ssl::context& ctx
                              , std::shared_ptr<http_connection> org_conn
                              ):m_resolver(executor)
+                             , m_resolve_timer(executor)
                              , m_ssl_ctx(ctx)
                              , m_stream(executor, ctx)
                              , m_org_connection(org_conn)
+                             , m_limits(get_deepseek_guard().limits())
                              {
         if (!m_org_connection) throw std::invalid_argument("Original connection connot be null");
         std::cout << "deepseek session created." << std::endl;
     }
 
+    ~deepseek_session() { notify_complete(std::nullopt); }
+
+    // Invoked once with the client reply body on success, or std::nullopt when
+    // the upstream call failed. Streamed replies report the assembled
+    // `{"reply": ...}` once the stream has finished.
+    using completion_handler = std::function<void(std::optional<std::string> body, std::chrono::milliseconds upstream_latency)>;
+    void on_complete(completion_handler handler) { m_on_complete = std::move(handler); }
+
+    // Admission slot from get_deepseek_guard(); released when the session dies.
+    void attach_permit(upstream_guard::permit permit) { m_permit.emplace(std::move(permit)); }
+
+    // Extra header copied onto the reply sent to the client, e.g. X-Conversation-Id.
+    void add_reply_header(std::string name, std::string value) { m_reply_headers.emplace_back(std::move(name), std::move(value)); }
+
+    // Asked when the client disconnects: while it returns true (coalesced
+    // requests still wait for this reply) the upstream call keeps running.
+    void keep_running_if(std::function<bool()> still_needed) { m_still_needed = std::move(still_needed); }
+
     void run( const std::string& target
             , const std::string& body
-            , const std::string& api_key) {
+            , const std::string& api_key
+            , bool stream = false) {
         try{
+            m_streaming = stream;
+            m_started_at = std::chrono::steady_clock::now();
             m_request.method(http::verb::post);
             m_request.target(target);
             m_request.version(11);
@@ -330,6 +612,7 @@ public:
             m_request.set(http::field::user_agent, "GeeCodeX-Client/1.0");
             m_request.set(http::field::content_type, "application/json");
             m_request.set(http::field::authorization, "Bearer " + api_key);
+            if (m_streaming) m_request.set(http::field::accept, "text/event-stream");
             m_request.body() = body;
             m_request.prepare_payload();
 
@@ -339,7 +622,21 @@ public:
                 send_error_to_original_client("SSL Setup Error", "Failed to set SNI");       
             }
 
+            auto slot = m_org_connection->cancellation_slot();
+            if (slot.is_connected()) {
+                slot.assign([weak_self = weak_from_this()](net::cancellation_type) {
+                    if (auto self = weak_self.lock()) self->on_client_gone();
+                });
+            }
+
             std::cout << "Resolving Deepseek host: " << m_deepseek_host << std::endl;
+            // tcp::resolver has no deadline of its own; cancel it from a timer.
+            m_resolve_timer.expires_after(m_limits.resolve_timeout);
+            m_resolve_timer.async_wait([self = shared_from_this()](beast::error_code ec) {
+                if (ec) return;
+                self->m_resolve_timed_out = true;
+                self->m_resolver.cancel();
+            });
             m_resolver.async_resolve( m_deepseek_host, m_deepseek_port
                                     , beast::bind_front_handler(&deepseek_session::on_resolve, shared_from_this()));
 
@@ -353,56 +650,274 @@ public:
     }
 private:
     tcp::resolver m_resolver;
+    net::steady_timer m_resolve_timer;
+    bool m_resolve_timed_out = false;
     ssl::context& m_ssl_ctx;
     beast::ssl_stream<beast::tcp_stream> m_stream;
     beast::flat_buffer m_buffer;
     http::request<http::string_body> m_request;
     http::response<http::string_body> m_response;
     std::shared_ptr<http_connection> m_org_connection;
-    std::string m_deepseek_host = "api.deepseek.com";
-    std::string m_deepseek_port = "443";
+    // DEEPSEEK_API_HOST / DEEPSEEK_API_PORT point the proxy at another
+    // endpoint, e.g. the local geecodex_mock_llm server for benchmarks.
+    std::string m_deepseek_host = utils::env_string("DEEPSEEK_API_HOST", "api.deepseek.com");
+    std::string m_deepseek_port = utils::env_string("DEEPSEEK_API_PORT", "443");
 
-    void on_resolve(beast::error_code ec, tcp::resolver::results_type results) {
-        if (ec) {
-            std::cerr << "DeepSeek Resolve Error: " << ec.message() << std::endl;
-            return send_error_to_original_client("AI Service Network Error", "Could not resolve host");
+    // Streaming mode: the upstream body is pulled through a fixed buffer and
+    // each SSE event is forwarded as soon as the client took the previous one.
+    static constexpr std::size_t max_stream_error_body = 64 * 1024;
+    bool m_streaming = false;
+    bool m_stream_done = false;
+    std::optional<http::response_parser<http::buffer_body>> m_stream_parser;
+    std::array<char, 8192> m_stream_chunk{};
+    sse_parser m_sse;
+    std::string m_stream_error_body;    // non-200 body, kept up to max_stream_error_body for the report
+    std::string m_stream_reply;     // assembled deltas, only kept when someone awaits on_complete
+    std::vector<std::pair<std::string, std::string>> m_reply_headers;
+
+    completion_handler m_on_complete;
+    upstream_limits m_limits;
+    std::optional<upstream_guard::permit> m_permit;
+
+    std::function<bool()> m_still_needed;
+    bool m_cancelled = false;
+
+    void report_upstream(bool healthy) {
+        if (m_permit && !m_cancelled) m_permit->record(healthy);
+    }
+
+    // Nobody is waiting for the reply any more: abort whatever upstream
+    // operation is pending so no further tokens are generated or read.
+    void on_client_gone() {
+        if (m_still_needed && m_still_needed()) {
+            std::cout << "Client left, but coalesced requests still wait for this AI reply." << std::endl;
+            return;
+        }
+        std::cout << "Client left, cancelling DeepSeek request." << std::endl;
+        m_cancelled = true;
+        m_resolve_timer.cancel();
+        m_resolver.cancel();
+        beast::error_code ignored_ec;
+        beast::get_lowest_layer(m_stream).socket().shutdown(tcp::socket::shutdown_both, ignored_ec);
+        beast::get_lowest_layer(m_stream).close();
+    }
+
+    // Network failure while talking to DeepSeek: counts against the circuit
+    // breaker; deadline expiries are reported to the client as 504.
+    void fail_upstream(beast::error_code ec, const char* phase, const std::string& message) {
+        if (m_cancelled) {
+            std::cout << "DeepSeek " << phase << " aborted after client disconnect." << std::endl;
+            return notify_complete(std::nullopt);
+        }
+        report_upstream(false);
+        bool timed_out = ec == beast::error::timeout || (ec == net::error::operation_aborted && m_resolve_timed_out);
+        std::cerr << "DeepSeek " << phase << " Error: " << ec.message() << (timed_out ? " (deadline exceeded)" : "") << std::endl;
+        if (timed_out) send_error_to_original_client("AI Service Timeout", message + " (timed out)", http::status::gateway_timeout);
+        else send_error_to_original_client("AI Service Network Error", message, http::status::bad_gateway);
+    }
+
+    // 429 and 5xx mean the provider is struggling; other statuses do not.
+    static bool upstream_status_healthy(http::status status) {
+        auto code = static_cast<unsigned>(status);
+        return code != 429 && code < 500;
+    }
+    std::chrono::steady_clock::time_point m_started_at = std::chrono::steady_clock::now();
+
+    void notify_complete(std::optional<std::string> body) {
+        if (!m_on_complete) return;
+        auto handler = std::move(m_on_complete);
+        m_on_complete = nullptr;
+        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_started_at);
+        try {
+            handler(std::move(body), latency);
+        } catch (const std::exception& e) {
+            std::cerr << "Exception in deepseek_session completion handler: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Unknown exception in deepseek_session completion handler" << std::endl;
         }
+    }
+
+    void on_resolve(beast::error_code ec, tcp::resolver::results_type results) {
+        m_resolve_timer.cancel();
+        if (ec) return fail_upstream(ec, "Resolve", "Could not resolve host");
         
         std::cout << "Resolved DeepSeek host. Connecting..." << std::endl;
+        beast::get_lowest_layer(m_stream).expires_after(m_limits.connect_timeout);
         beast::get_lowest_layer(m_stream)
             .async_connect( results
                           , beast::bind_front_handler(&deepseek_session::on_connect, shared_from_this()));
     }
 
     void on_connect(beast::error_code ec, tcp::resolver::results_type::endpoint_type /* endpoint */) {
-        if (ec) {
-            std::cerr << "DeepSeek Connect Error: " << ec.message() << std::endl;
-            return send_error_to_original_client("AI Service Network Error", "Could not connect to host");
-        }
+        if (ec) return fail_upstream(ec, "Connect", "Could not connect to host");
         std::cout << "Connected to DeepSeek. Performing SSL handshake..." << std::endl;
+        beast::get_lowest_layer(m_stream).expires_after(m_limits.handshake_timeout);
         m_stream.async_handshake(ssl::stream_base::client, beast::bind_front_handler(&deepseek_session::on_handshake, shared_from_this()));
     }
 
     void on_handshake(beast::error_code ec) {
-        if (ec) {
-            std::cerr << "DeepSeek SSL Handshake Error: " << ec.message() << std::endl;
-            return send_error_to_original_client("AI Service Network Error", "SSL handshake failed");
-        }
+        if (ec) return fail_upstream(ec, "SSL Handshake", "SSL handshake failed");
         std::cout << "SSL Handshake successful. Sending request to DeepSeek..." << std::endl;
+        beast::get_lowest_layer(m_stream).expires_after(m_limits.write_timeout);
         http::async_write(m_stream, m_request, beast::bind_front_handler(&deepseek_session::on_write, shared_from_this()));
     }
 
     void on_write(beast::error_code ec, std::size_t bytes_transferred) {
         boost::ignore_unused(bytes_transferred);
-        if (ec) {
-            std::cerr << "DeepSeek Write Error: " << ec.message() << std::endl;
-            return send_error_to_original_client("AI Service Network Error", "Failed to send request");
-        }
+        if (ec) return fail_upstream(ec, "Write", "Failed to send request");
         
         std::cout << "Request sendt (" << bytes_transferred << " bytes). Reading response..." << std::endl;
+        if (m_streaming) {
+            beast::get_lowest_layer(m_stream).expires_after(m_limits.stream_idle_timeout);
+            m_stream_parser.emplace();
+            m_stream_parser->body_limit(boost::none);
+            http::async_read_header(m_stream, m_buffer, *m_stream_parser, beast::bind_front_handler(&deepseek_session::on_stream_header, shared_from_this()));
+            return;
+        }
+        beast::get_lowest_layer(m_stream).expires_after(m_limits.read_timeout);
         http::async_read(m_stream, m_buffer, m_response, beast::bind_front_handler(&deepseek_session::on_read, shared_from_this()));
     }
 
+    void on_stream_header(beast::error_code ec, std::size_t /* bytes_transferred */) {
+        if (ec) {
+            fail_upstream(ec, "Stream Header", "Failed to read response");
+            if (beast::get_lowest_layer(m_stream).socket().is_open()) do_shutdown();
+            return;
+        }
+
+        auto status = m_stream_parser->get().result();
+        std::cout << "Received DeepSeek Stream Status: " << static_cast<unsigned>(status) << std::endl;
+        report_upstream(upstream_status_healthy(status));
+        if (status != http::status::ok) return read_stream_chunk();    // drain the error body, reported in finish_stream()
+
+        http::response<http::empty_body> header{http::status::ok, m_org_connection->request().version()};
+        header.set(http::field::server, "GeeCodeX Server");
+        header.set(http::field::content_type, "text/event-stream; charset=utf-8");
+        header.set(http::field::cache_control, "no-cache");
+        header.set("X-Accel-Buffering", "no");
+        for (const auto& [name, value]: m_reply_headers) header.set(name, value);
+        header.keep_alive(false);
+
+        m_org_connection->send_chunked_header(std::move(header), [self = shared_from_this()](beast::error_code ec) {
+            if (ec) return self->do_shutdown();
+            self->read_stream_chunk();
+        });
+    }
+
+    void read_stream_chunk() {
+        if (m_stream_done || m_stream_parser->is_done()) return finish_stream();
+
+        auto& body = m_stream_parser->get().body();
+        body.data = m_stream_chunk.data();
+        body.size = m_stream_chunk.size();
+        beast::get_lowest_layer(m_stream).expires_after(m_limits.stream_idle_timeout);
+        http::async_read_some(m_stream, m_buffer, *m_stream_parser, beast::bind_front_handler(&deepseek_session::on_stream_read, shared_from_this()));
+    }
+
+    void on_stream_read(beast::error_code ec, std::size_t /* bytes_transferred */) {
+        if (ec == http::error::need_buffer) ec = {};
+        if (m_cancelled || m_org_connection->client_gone()) return do_shutdown();
+        if (ec && ec != http::error::end_of_stream) {
+            std::cerr << "DeepSeek Stream Read Error: " << ec.message() << std::endl;
+            report_upstream(false);
+            if (m_org_connection->response_sent()) {
+                json error_event;
+                error_event["error"] = "AI Service Network Error";
+                error_event["message"] = "Upstream stream interrupted";
+                m_org_connection->send_chunk("event: error\ndata: " + error_event.dump() + "\n\n", [self = shared_from_this()](beast::error_code) {
+                    self->m_org_connection->finish_chunked();
+                    self->do_shutdown();
+                });
+            } else {
+                send_error_to_original_client("AI Service Network Error", "Failed to read response");
+                do_shutdown();
+            }
+            return;
+        }
+
+        std::size_t received = m_stream_chunk.size() - m_stream_parser->get().body().size;
+        std::string_view data{m_stream_chunk.data(), received};
+
+        if (m_stream_parser->get().result() != http::status::ok) {
+            // Only the start of an error body is worth reporting; stop reading
+            // once it is full rather than buffering whatever upstream sends.
+            m_stream_error_body.append(data.substr(0, max_stream_error_body - m_stream_error_body.size()));
+            if (ec == http::error::end_of_stream || m_stream_error_body.size() >= max_stream_error_body) m_stream_done = true;
+            return read_stream_chunk();
+        }
+
+        std::string outgoing;
+        m_sse.feed(data, [this, &outgoing](std::string_view event_data) {
+            outgoing += translate_stream_event(event_data);
+        });
+        if (ec == http::error::end_of_stream) m_stream_done = true;
+
+        if (outgoing.empty()) return read_stream_chunk();
+        m_org_connection->send_chunk(std::move(outgoing), [self = shared_from_this()](beast::error_code ec) {
+            if (ec) {
+                std::cerr << "Client went away during AI stream: " << ec.message() << std::endl;
+                return self->do_shutdown();
+            }
+            self->read_stream_chunk();
+        });
+    }
+
+    // Maps one upstream chat.completion.chunk onto the client's event format:
+    // {"delta": "..."} per token batch, {"finish_reason", "usage"} at the end.
+    std::string translate_stream_event(std::string_view event_data) {
+        if (event_data == "[DONE]") {
+            m_stream_done = true;
+            return "data: [DONE]\n\n";
+        }
+
+        json upstream_event = json::parse(event_data, nullptr, false);
+        if (upstream_event.is_discarded()) {
+            std::cerr << "Skipping malformed DeepSeek stream event: " << event_data << std::endl;
+            return {};
+        }
+
+        json client_event = json::object();
+        if (upstream_event.contains("choices") && upstream_event["choices"].is_array() && !upstream_event["choices"].empty()) {
+            const auto& choice = upstream_event["choices"][0];
+            if (choice.contains("delta") && choice["delta"].is_object()) {
+                const auto& delta = choice["delta"];
+                if (delta.contains("content") && delta["content"].is_string() && !delta["content"].get_ref<const std::string&>().empty()) {
+                    client_event["delta"] = delta["content"];
+                    if (m_on_complete) m_stream_reply += delta["content"].get_ref<const std::string&>();
+                }
+            }
+            if (choice.contains("finish_reason") && choice["finish_reason"].is_string())
+                client_event["finish_reason"] = choice["finish_reason"];
+        }
+        if (upstream_event.contains("usage") && upstream_event["usage"].is_object())
+            client_event["usage"] = upstream_event["usage"];
+
+        if (client_event.empty()) return {};
+        return "data: " + client_event.dump() + "\n\n";
+    }
+
+    void finish_stream() {
+        if (m_stream_parser->get().result() != http::status::ok) {
+            std::cerr << "DeepSeek API Error Status " << m_stream_parser->get().result_int()
+                      << ", Body: " << m_stream_error_body << std::endl;
+            std::string error_message = "Received status: " + std::to_string(m_stream_parser->get().result_int()) + " from AI provider";
+            json error_json = json::parse(m_stream_error_body, nullptr, false);
+            if (!error_json.is_discarded() &&
+                error_json.contains("error") &&
+                error_json["error"].is_object() &&
+                error_json["error"].contains("message") &&
+                error_json["error"]["message"].is_string())
+                    error_message = "AI Provider Error: " + error_json["error"]["message"].get<std::string>();
+            send_error_to_original_client("AI Service Error", error_message);
+            return do_shutdown();
+        }
+
+        std::cout << "DeepSeek stream complete." << std::endl;
+        m_org_connection->finish_chunked();
+        if (m_on_complete) notify_complete(json{{"reply", std::move(m_stream_reply)}}.dump());
+        do_shutdown();
+    }
+
     void on_read(beast::error_code ec, std::size_t bytes_transferred) {
         boost::ignore_unused(bytes_transferred);
         std::cout << "Read finished. Error code: " << ec.message() << ", Bytes read: " << bytes_transferred << std::endl;
@@ -411,8 +926,7 @@ private:
             do_shutdown();
             return;    
         } if (ec) {
-            std::cerr << "DeepSeek Read Error: " << ec.message() << std::endl;
-            send_error_to_original_client("AI Service Network Error", "Failed to read response");
+            fail_upstream(ec, "Read", "Failed to read response");
             if (beast::get_lowest_layer(m_stream).socket().is_open()) do_shutdown();
             return;
         }
@@ -423,7 +937,9 @@ private:
 
     void do_shutdown() {
         beast::error_code ec;
+        if (!beast::get_lowest_layer(m_stream).socket().is_open()) return;
         
+        beast::get_lowest_layer(m_stream).expires_after(m_limits.shutdown_timeout);
         m_stream.async_shutdown(
             [self = shared_from_this()](beast::error_code ec) {
                 if (ec && ec != net::ssl::error::stream_truncated && ec != net::error::eof)
@@ -436,6 +952,7 @@ private:
     void process_deepseek_response() {
         try {
             std::cout << "Received DeepSeek Response Status: " << m_response.result_int() << std::endl;
+            report_upstream(upstream_status_healthy(m_response.result()));
             
             std::cout << "DeepSeek Headers: " << m_response.base() << std::endl;
             std::cout << "DeepSeek Body: " << m_response.body() << std::endl;
@@ -482,11 +999,15 @@ private:
             response_to_client.set(http::field::server, "GeeCodeX Server");
             response_to_client.set(http::field::content_type, "application/json");
             response_to_client.keep_alive(m_org_connection->request().keep_alive());
-            response_to_client.body() = client_response_body.dump();
+            std::string reply_body = client_response_body.dump();
+            response_to_client.set("X-Cache", "MISS");
+            for (const auto& [name, value]: m_reply_headers) response_to_client.set(name, value);
+            response_to_client.body() = reply_body;
             response_to_client.prepare_payload();
 
-            m_org_connection->send(std::move(response_to_client));
+            if (!m_org_connection->client_gone()) m_org_connection->send(std::move(response_to_client));
             std::cout << "Sent AI reply back to original client." << std::endl;
+            notify_complete(std::move(reply_body));
         } catch (const json::parse_error& e) {
             std::cerr << "Failed to parse DeepSeek JSON response: " << e.what() << std::endl;
             send_error_to_original_client("AI Service Error", "Failed to parse AI provider response");
@@ -499,13 +1020,17 @@ private:
         }
     }
 
-    void send_error_to_original_client(const std::string& error_type, const std::string& message) {
+    void send_error_to_original_client( const std::string& error_type
+                                      , const std::string& message
+                                      , http::status status = http::status::internal_server_error) {
+        notify_complete(std::nullopt);
+        if (m_org_connection->client_gone()) return;
         bool already_send = false;
         if (m_org_connection->response_sent()) already_send = true;
         
         if (!already_send) {
             try {
-                send_json_error(*m_org_connection, http::status::internal_server_error, error_type, message);
+                send_json_error(*m_org_connection, status, error_type, message);
                 std::cerr << "Sent error to original client: " << error_type << " - " << message << std::endl;
             } catch (const std::exception& e) {
                 std::cerr << "Failed to send error response back to original client: " << e.what() << std::endl;
@@ -5,6 +5,7 @@
 #include "database/db_ops.hpp"
 #include "http/router.hpp"
 #include <algorithm>
+#include <array>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/asio/ssl/verify_mode.hpp>
 #include <boost/beast/core/error.hpp>
@@ -29,6 +30,22 @@
 #include <ostream>
 #include <pqxx/pqxx>
 #include <http/http_connection.h>
+#include <http/conversation_store.hpp>
+#include <catalog/book_catalog.hpp>
+#include <catalog/book_comments.hpp>
+#include <catalog/book_readers.hpp>
+#include <catalog/catalog_export.hpp>
+#include <catalog/book_ratings.hpp>
+#include <catalog/facet_index.hpp>
+#include <catalog/search_index.hpp>
+#include <catalog/similar_index.hpp>
+#include <catalog/suggest_index.hpp>
+#include <catalog/trending_books.hpp>
+#include <recognition/batch_scheduler.hpp>
+#include <recognition/formula_engine.hpp>
+#include <recognition/formula_workers.hpp>
+#include <recognition/recognition_cache.hpp>
+#include <recognition/recognition_jobs.hpp>
 #include <filesystem>
 #include <boost/beast/http/file_body.hpp>
 #include <regex>
@@ -37,6 +54,7 @@
 #include <utility>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <charconv>
+#include <cmath>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -53,39 +71,44 @@ inline void handle_hello(http_connection& conn) {
     m_response.body() = "Hello C++";
 }    
     
-inline void handle_health_check(http_connection& conn) {
+inline recognition::recognition_jobs& get_recognition_jobs(net::any_io_executor executor);
+
+inline void handle_server_stats(http_connection& conn) {
     auto& m_response = conn.response();
-    try {
-        bool database_connected = false;
-        try {
-            pqxx::result result = execute_query("SELECT 1");
-            database_connected = !result.empty();
-        } catch (const std::exception& e) {
-            database_connected = false;
-        }
-    
-        nlohmann::json response_json;
-        response_json["status"] = "ok";
-        response_json["timestamp"] = std::time(nullptr);
-        response_json["service"] = "rtsp-monitor-server";
-        response_json["database_connected"] = database_connected;
-    
-        m_response.result(http::status::ok);
-        m_response.set(http::field::content_type, "application/json");
-        m_response.body() = response_json.dump();
-    
-        std::cout << "Health check request processed" << std::endl;
-    } catch (const std::exception& e) {
-        nlohmann::json error_json;
-        error_json["status"] = "error";
-        error_json["error"] = "Error processing health check: " + std::string(e.what());
-                
-        m_response.result(http::status::internal_server_error);
-        m_response.set(http::field::content_type, "application/json");
-        m_response.body() = error_json.dump();
-    
-        std::cerr << "Error during health check: " << e.what();
-    }
+    json stats;
+    stats["uptime_seconds"] = get_server_uptime();
+    stats["ai_cache"] = get_ai_response_cache().stats();
+    stats["ai_upstream"] = get_deepseek_guard().stats();
+    stats["ai_conversations"] = get_conversation_store().stats();
+    // Only report recognition parts that exist; stats must not load the model.
+    if (auto* engine = recognition::find_formula_engine()) stats["formula_engine"] = engine->stats();
+    else stats["formula_engine"] = {{"loaded", false}};
+    if (auto* batcher = recognition::find_formula_batcher()) stats["formula_batching"] = batcher->stats();
+    else stats["formula_batching"] = {{"started", false}};
+    stats["recognition_cache"] = recognition::get_recognition_cache().stats();
+    if (auto* workers = recognition::find_formula_worker_pool()) stats["formula_workers"] = workers->stats();
+    else stats["formula_workers"] = {{"started", false}};
+    stats["recognition_jobs"] = get_recognition_jobs(conn.socket().get_executor()).stats();
+    stats["book_catalog"] = catalog::get_book_catalog().stats();
+    stats["book_search"] = catalog::get_book_search().stats();
+    if (auto index = catalog::get_book_search().get()) stats["book_search"].update(index->stats());
+    stats["book_facets"] = catalog::get_book_facets().stats();
+    if (auto index = catalog::get_book_facets().get()) stats["book_facets"].update(index->stats());
+    stats["book_suggest"] = catalog::get_book_suggest().stats();
+    if (auto index = catalog::get_book_suggest().get()) stats["book_suggest"].update(index->stats());
+    stats["book_trending"] = catalog::get_trending_books().stats();
+    stats["book_similar"] = catalog::get_similar_books().stats();
+    stats["book_ratings"] = catalog::get_book_ratings().stats();
+    stats["book_comments"] = catalog::get_book_comments().stats();
+    stats["book_readers"] = catalog::get_book_readers().stats();
+    if (auto index = catalog::get_similar_books().get()) stats["book_similar"].update(index->stats());
+    stats["catalog_export"] = catalog::get_catalog_export().stats();
+    if (auto index = catalog::get_catalog_export().get()) stats["catalog_export"].update(index->stats());
+
+    m_response.result(http::status::ok);
+    m_response.set(http::field::content_type, "application/json");
+    m_response.set(http::field::cache_control, "no-store");
+    m_response.body() = stats.dump();
 }
 
 inline void handle_not_found(http_connection& conn) { 
@@ -116,12 +139,29 @@ inline void handle_not_found(http_connection& conn) {
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
+// Who is reading, for the unique reader counts: the client's X-Device-Id
+// when it sends one, otherwise the peer address. Empty if neither is known.
+inline std::string visitor_key(http_connection& conn) {
+    auto& request = conn.request();
+    if (auto it = request.find("X-Device-Id"); it != request.end() && !it->value().empty())
+        return "device:" + std::string{it->value()};
+    beast::error_code ec;
+    auto peer = conn.socket().remote_endpoint(ec);
+    if (ec) return {};
+    return "addr:" + peer.address().to_string();
+}
+
+inline void record_reader(http_connection& conn, int book_id) {
+    auto key = visitor_key(conn);
+    if (!key.empty()) catalog::get_book_readers().record(book_id, catalog::book_readers::visitor_hash(key));
+}
+
 inline void handle_download_pdf(http_connection& conn) {
     try {
         std::cout << "Handling PDF downloading request" << std::endl;
         auto& request = conn.request();
 
-        std::string target = std::string(request.target());
+        std::string target{target_path({request.target().data(), request.target().size()})};
         std::cout << "Target path: " << target << std::endl;
 
         std::regex id_pattern("/geecodex/books/(\\d+)(?:/pdf)?");
@@ -139,108 +179,95 @@ inline void handle_download_pdf(http_connection& conn) {
 
         int book_id = std::stoi(matches[1]);
         std::cout << "Book ID: " << book_id << std::endl;
- 
-        try {
-            pqxx::result result = execute_params(
-                "SELECT title, pdf_path, file_size_bytes, is_active, access_level "
-                "FROM codex_books WHERE id = $1",
-                book_id
-            );
-            
-            if (result.empty()) {
-                std::cout << "Book not found: ID " << book_id << std::endl;
-                http::response<http::string_body> response{http::status::not_found, request.version()};
-                response.set(http::field::content_type, "application/json");
-                response.body() = R"({"error": "Book not found"})";
-                conn.send(std::move(static_cast<http::response<http::string_body>&&>(response)));
-                return;
-            }
-
-            const auto& row = result[0];
-            std::string title = row["title"].as<std::string>();
-            std::string pdf_path = row["pdf_path"].as<std::string>();
-            bool is_active = row["is_active"].as<bool>();
-            int access_level = row["access_level"].as<int>();
-
-            std::cout << "Found book: " << title << ", Path: " << pdf_path << std::endl;
-        
-            if (!is_active) {
-                http::response<http::string_body> response{http::status::forbidden, request.version()};
-                response.set(http::field::content_type, "application/json");
-                response.body() = R"({"error": "This book is currently unavailable"})";
-                conn.send(std::move(response));
-                return;
-            }
-
-            /* Access Level */
-            
-            fs::path file_path(pdf_path);
-            if (!fs::exists(file_path) || !fs::is_regular_file(file_path)) {
-                std::cerr << "PDF file not found not server: " << pdf_path << std::endl;
-                http::response<http::string_body> response{http::status::not_found, request.version()};
-                response.set(http::field::content_type, "application/json");
-                response.body() = R"({"error": "PDF file not found on server"})";
-                conn.send(std::move(response));
-                return;
-            }
-
-            std::string safe_filename = title;
-            safe_filename = std::regex_replace(safe_filename, std::regex("[^a-zA-Z0-9_\\- ]"), "");
 
-            safe_filename = std::regex_replace(safe_filename, std::regex("\\s+"), "_");
-            safe_filename += ".pdf";
+        auto books = catalog::get_book_catalog().snapshot();
+        if (!books) {
+            http::response<http::string_body> response{http::status::service_unavailable, request.version()};
+            response.set(http::field::content_type, "application/json");
+            response.body() = R"({"error": "Book catalog is not loaded yet"})";
+            conn.send(std::move(response));
+            return;
+        }
 
-            std::cout << "Sending file: " << safe_filename << std::endl;
-           
-            try {
-                execute_params(
-                    "UPDATE codex_books SET download_count = download_count + 1 WHERE id = $1",
-                    book_id);
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to update download count: " << e.what() << std::endl;
-            }
+        auto book = books->find(book_id);
+        if (!book) {
+            std::cout << "Book not found: ID " << book_id << std::endl;
+            http::response<http::string_body> response{http::status::not_found, request.version()};
+            response.set(http::field::content_type, "application/json");
+            response.body() = R"({"error": "Book not found"})";
+            conn.send(std::move(response));
+            return;
+        }
 
-            beast::error_code ec;
-            http::file_body::value_type file;
-            file.open(file_path.string().c_str(), beast::file_mode::read, ec);
-    
-            if (ec) {
-                std::cerr << "Error opening file: " << ec.message() << std::endl;
-                http::response<http::string_body> response{http::status::internal_server_error, request.version()};
-                response.set(http::field::content_type, "application/json");
-                response.body() = R"({"error": "Failed to open file"})";
-                conn.send(std::move(response));
-                return;
-            }
+        std::cout << "Found book: " << book->title << ", Path: " << book->pdf_path.value_or("") << std::endl;
 
-            http::response<http::file_body> response{ std::piecewise_construct
-                                                    , std::make_tuple(std::move(file))
-                                                    , std::make_tuple(http::status::ok, request.version())
-                                                    };
+        if (!book->is_active) {
+            http::response<http::string_body> response{http::status::forbidden, request.version()};
+            response.set(http::field::content_type, "application/json");
+            response.body() = R"({"error": "This book is currently unavailable"})";
+            conn.send(std::move(response));
+            return;
+        }
 
-            response.set(http::field::server, "GeeCodeX Server");
-            response.set(http::field::content_type, "application/pdf");
-            response.set(http::field::content_disposition, "attachment; filename=\"" + safe_filename + "\"");
+        /* Access Level */
 
-            response.set(http::field::cache_control, "private, no-store, no-cache, must-revalidate, max-age=0");
-            response.set(http::field::pragma, "no-cache");
+        fs::path file_path(book->pdf_path.value_or(""));
+        if (!book->pdf_path || !fs::exists(file_path) || !fs::is_regular_file(file_path)) {
+            std::cerr << "PDF file not found not server: " << book->pdf_path.value_or("(null)") << std::endl;
+            http::response<http::string_body> response{http::status::not_found, request.version()};
+            response.set(http::field::content_type, "application/json");
+            response.body() = R"({"error": "PDF file not found on server"})";
+            conn.send(std::move(response));
+            return;
+        }
 
-            if (!row["file_size_bytes"].is_null()) response.content_length(row["file_size_bytes"].as<std::int64_t>());
-            else {
-                auto file_size = file.size();
-                response.content_length(file_size);
-            }
+        std::cout << "Sending file: " << book->safe_filename << std::endl;
+
+        catalog::get_trending_books().record(book_id);
+        record_reader(conn, book_id);
+        // Fire and forget on the database worker; the download does not wait for it.
+        // The catalog does not count this as an edit of the book (see book_catalog).
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [book_id](pqxx::work& txn) {
+                return txn.exec_params("UPDATE codex_books SET download_count = download_count + 1 WHERE id = $1", book_id);
+            },
+            [](std::exception_ptr error, pqxx::result) {
+                if (!error) return;
+                try { std::rethrow_exception(error); }
+                catch (const std::exception& e) { std::cerr << "Failed to update download count: " << e.what() << std::endl; }
+            });
 
-            conn.send(std::move(response));
-            std::cout << "File send successfully" << std::endl;
+        beast::error_code ec;
+        http::file_body::value_type file;
+        file.open(file_path.string().c_str(), beast::file_mode::read, ec);
 
-        } catch (const database::database_exception& e) {
-            std::cerr << "database error: " << e.what() << std::endl;
+        if (ec) {
+            std::cerr << "Error opening file: " << ec.message() << std::endl;
             http::response<http::string_body> response{http::status::internal_server_error, request.version()};
             response.set(http::field::content_type, "application/json");
-            response.body() = R"({"error": "Database error", "message:" ")" + std::string(e.what()) + R"("})";
+            response.body() = R"({"error": "Failed to open file"})";
             conn.send(std::move(response));
+            return;
         }
+
+        http::response<http::file_body> response{ std::piecewise_construct
+                                                , std::make_tuple(std::move(file))
+                                                , std::make_tuple(http::status::ok, request.version())
+                                                };
+
+        response.set(http::field::server, "GeeCodeX Server");
+        response.set(http::field::content_type, "application/pdf");
+        response.set(http::field::content_disposition, "attachment; filename=\"" + book->safe_filename + "\"");
+
+        response.set(http::field::cache_control, "private, no-store, no-cache, must-revalidate, max-age=0");
+        response.set(http::field::pragma, "no-cache");
+
+        // The catalog may lag a replaced file; the size on disk is what gets sent.
+        response.content_length(response.body().size());
+
+        conn.send(std::move(response));
+        std::cout << "File send successfully" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error in handle_download_pdf: " << e.what() << std::endl;
         
@@ -290,6 +317,47 @@ inline void send_json_error( http_connection& conn
     }
 }
 
+inline void send_json_reply(http_connection& conn, http::status status, std::string body,
+                            std::initializer_list<std::pair<std::string_view, std::string>> headers = {}) {
+    http::response<http::string_body> response{status, conn.request().version()};
+    response.set(http::field::server, "GeeCodeX Server");
+    response.set(http::field::content_type, "application/json");
+    for (const auto& [name, value]: headers) response.set(beast::string_view{name.data(), name.size()}, value);
+    response.keep_alive(false);
+    response.body() = std::move(body);
+    response.prepare_payload();
+    conn.send(std::move(response));
+}
+
+// The database probe runs on the database worker, so a health check queued
+// behind a long statement waits there instead of blocking the I/O thread.
+inline void handle_health_check(http_connection& conn) {
+    try {
+        auto waiting_conn = conn.shared_from_this();
+        conn.defer_response();
+        database::async_execute(conn.socket().get_executor(), conn.cancellation_slot(),
+            [](pqxx::work& txn) { return txn.exec("SELECT 1"); },
+            [waiting_conn](std::exception_ptr error, pqxx::result result) {
+                if (waiting_conn->client_gone()) return;
+                nlohmann::json response_json;
+                response_json["status"] = "ok";
+                response_json["timestamp"] = std::time(nullptr);
+                response_json["service"] = "rtsp-monitor-server";
+                response_json["database_connected"] = !error && !result.empty();
+                send_json_reply(*waiting_conn, http::status::ok, response_json.dump());
+
+                std::cout << "Health check request processed" << std::endl;
+            });
+    } catch (const std::exception& e) {
+        nlohmann::json error_json;
+        error_json["status"] = "error";
+        error_json["error"] = "Error processing health check: " + std::string(e.what());
+        send_json_reply(conn, http::status::internal_server_error, error_json.dump());
+
+        std::cerr << "Error during health check: " << e.what();
+    }
+}
+
 inline std::string guess_mime_type(const std::string& extension) {
     std::string ext_lower = boost::algorithm::to_lower_copy(extension);
     if (ext_lower == ".png") return "image/png";
@@ -309,7 +377,7 @@ inline void handle_fetch_pdf_cover(http_connection& conn) {
         std::cout << "Handling PDF cover request (from file path)" << std::endl;
         auto& request = conn.request();
 
-        std::string target = std::string(request.target());
+        std::string target{target_path({request.target().data(), request.target().size()})};
         std::cout << "Target path: " << target << std::endl;
         
         std::regex id_pattern("/geecodex/books/cover/(\\d+)");
@@ -333,52 +401,37 @@ inline void handle_fetch_pdf_cover(http_connection& conn) {
     
         std::cout << "Book ID: " << book_id << std::endl;
 
-        std::string cover_path_str;
-
-        bool is_active = false;
-
-        try {
-            pqxx::result result = execute_params(
-                "SELECT cover_path, is_active FROM codex_books WHERE id = $1",
-                book_id
-            );
-
-            if (result.empty()) {
-                std::cout << "Book not found for cover: ID " << book_id << std::endl;
-                send_json_error(conn, http::status::not_found, "Book not found");
-                return;
-            }
+        auto books = catalog::get_book_catalog().snapshot();
+        if (!books) {
+            send_json_error(conn, http::status::service_unavailable, "Book catalog is not loaded yet");
+            return;
+        }
 
-            const auto& row = result[0];
-            if (row["cover_path"].is_null()) {
-                std::cout << "Cover path is NULL for book ID: " << book_id << std::endl;
-                send_json_error(conn, http::status::not_found, "Cover image not available for this book");
-                return;
-            }
+        auto book = books->find(book_id);
+        if (!book) {
+            std::cout << "Book not found for cover: ID " << book_id << std::endl;
+            send_json_error(conn, http::status::not_found, "Book not found");
+            return;
+        }
 
-            cover_path_str = row["cover_path"].as<std::string>();
-            is_active = row["is_active"].as<bool>();
-            
-            std::cout << "Found book for cover. Path: " << cover_path_str 
-                      << ", Active: " << is_active << std::endl;
+        if (!book->cover_path) {
+            std::cout << "Cover path is NULL for book ID: " << book_id << std::endl;
+            send_json_error(conn, http::status::not_found, "Cover image not available for this book");
+            return;
+        }
 
-            if (!is_active) {
-                send_json_error(conn, http::status::forbidden, "This book is currently unavailable");
-                return;
-            }
+        const std::string& cover_path_str = *book->cover_path;
+        std::cout << "Found book for cover. Path: " << cover_path_str 
+                  << ", Active: " << book->is_active << std::endl;
 
-            if (cover_path_str.empty()) {
-                std::cout << "Cover path is empty for book ID: " << book_id << std::endl;
-                send_json_error(conn, http::status::not_found, "Cover image path is invalid");
-                return;
-            }
-        } catch (const database::database_exception& e) {
-            std::cerr << "Database error fetching book cover path: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database error", e.what());
+        if (!book->is_active) {
+            send_json_error(conn, http::status::forbidden, "This book is currently unavailable");
             return;
-        } catch (const std::exception& e) {
-            std::cerr << "Error during database query for cover path: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database query error", e.what());
+        }
+
+        if (cover_path_str.empty()) {
+            std::cout << "Cover path is empty for book ID: " << book_id << std::endl;
+            send_json_error(conn, http::status::not_found, "Cover image path is invalid");
             return;
         }
 
@@ -406,6 +459,7 @@ inline void handle_fetch_pdf_cover(http_connection& conn) {
         }
 
         const auto file_size = file_body.size();
+        record_reader(conn, book_id);
 
         http::response<http::file_body> response{
             std::piecewise_construct, 
@@ -429,101 +483,502 @@ inline void handle_fetch_pdf_cover(http_connection& conn) {
     }
 }
 
+// Book columns a listing may return, in output order. `?fields=` picks a
+// subset; category is only sent when asked for, the rest by default.
+enum class book_field : unsigned {
+    id, title, author, isbn, publisher, publish_date, language,
+    page_count, description, created_at, tags, download_count, category, rating,
+    unique_readers
+};
+
+inline constexpr std::array<std::string_view, 15> book_field_names{
+    "id", "title", "author", "isbn", "publisher", "publish_date", "language",
+    "page_count", "description", "created_at", "tags", "download_count", "category", "rating",
+    "unique_readers"
+};
+
+inline constexpr std::uint32_t book_field_bit(book_field f) { return 1u << static_cast<unsigned>(f); }
+inline constexpr std::uint32_t default_book_fields = ((1u << book_field_names.size()) - 1) & ~book_field_bit(book_field::category);
+
+// {"average", "count"}, plus the 1-5 star histogram when asked for.
+inline json rating_json(const catalog::rating_summary& rating, bool with_histogram = false) {
+    json out;
+    out["average"] = std::round(rating.average() * 100.0) / 100.0;
+    out["count"] = rating.count;
+    if (with_histogram) out["histogram"] = rating.histogram;
+    return out;
+}
+
+// `fields=id,title,author` as a mask; id is always included. Replies 400
+// itself and returns nullopt when a name is not in book_field_names.
+inline std::optional<std::uint32_t> requested_book_fields(http_connection& conn) {
+    auto list = conn.query().get("fields");
+    if (!list || list->empty()) return default_book_fields;
+
+    std::uint32_t mask = book_field_bit(book_field::id);
+    std::vector<std::string> names;
+    boost::split(names, *list, boost::is_any_of(","));
+    for (auto& name: names) {
+        boost::algorithm::trim(name);
+        if (name.empty()) continue;
+        auto it = std::find(book_field_names.begin(), book_field_names.end(), name);
+        if (it == book_field_names.end()) {
+            std::string allowed;
+            for (auto known: book_field_names) allowed += (allowed.empty() ? "" : ", ") + std::string{known};
+            send_json_error(conn, http::status::bad_request, "Unknown field '" + name + "'", "Allowed fields: " + allowed);
+            return std::nullopt;
+        }
+        mask |= 1u << static_cast<unsigned>(it - book_field_names.begin());
+    }
+    return mask;
+}
+
+// Canonical `fields=` value for a mask, e.g. for next-page links.
+inline std::string book_fields_param(std::uint32_t fields) {
+    std::string out;
+    for (std::size_t i = 0; i < book_field_names.size(); ++i)
+        if (fields & (1u << i)) out += (out.empty() ? "" : ",") + std::string{book_field_names[i]};
+    return out;
+}
+
+inline json book_summary_json(const catalog::book& book, std::uint32_t fields = default_book_fields) {
+    auto optional_json = [](const auto& value) -> json {
+        if (value) return *value;
+        return nullptr;
+    };
+    auto wanted = [fields](book_field f) { return (fields & book_field_bit(f)) != 0; };
+
+    json book_obj = json::object();
+    if (wanted(book_field::id)) book_obj["id"] = book.id;
+    if (wanted(book_field::title)) book_obj["title"] = book.title;
+    if (wanted(book_field::author)) book_obj["author"] = optional_json(book.author);
+    if (wanted(book_field::isbn)) book_obj["isbn"] = optional_json(book.isbn);
+    if (wanted(book_field::publisher)) book_obj["publisher"] = optional_json(book.publisher);
+    if (wanted(book_field::publish_date)) book_obj["publish_date"] = optional_json(book.publish_date);
+    if (wanted(book_field::language)) book_obj["language"] = optional_json(book.language);
+    if (wanted(book_field::page_count)) book_obj["page_count"] = optional_json(book.page_count);
+    if (wanted(book_field::description)) book_obj["description"] = optional_json(book.description);
+    if (wanted(book_field::created_at)) book_obj["created_at"] = optional_json(book.created_at);
+    if (wanted(book_field::tags)) book_obj["tags"] = book.tags;
+    if (wanted(book_field::download_count)) book_obj["download_count"] = book.download_count;
+    if (wanted(book_field::category)) book_obj["category"] = optional_json(book.category);
+    if (wanted(book_field::rating)) {
+        auto rating = catalog::get_book_ratings().summary(book.id);
+        book_obj["rating"] = rating ? rating_json(*rating) : json(nullptr);
+    }
+    if (wanted(book_field::unique_readers)) book_obj["unique_readers"] = catalog::get_book_readers().estimate(book.id);
+    return book_obj;
+}
+
+// GET /geecodex/books/latest?limit=&cursor=&fields=
+// One page of active books, newest first, as a JSON array (5 by default, at
+// most GEECODEX_BOOKS_PAGE_MAX). When more follow, X-Next-Cursor and a Link
+// rel="next" header carry the opaque cursor for the next page.
 inline void handle_fetch_latest_books(http_connection& conn) {
     try {
         std::cout << "Handling fetch latest books request" << std::endl;
         auto& request = conn.request();
+        const auto& query = conn.query();
 
-        std::string sql = 
-            "SELECT "
-            "   id, title, author, isbn, publisher, publish_date, language, "
-            "   page_count, description, created_at, tags, download_count "
-            "FROM "
-            "   codex_books "
-            "WHERE "
-            "   is_active = TRUE "
-            "   ORDER BY "
-            "   created_at DESC "
-            "LIMIT 5;";
-
-        pqxx::result result;
-        try {
-            result = execute_query(sql);
-            std::cout << "Fetched " << result.size() << " latest books from database." << std::endl;
-        } catch (const database::database_exception& e) {
-            std::cerr << "Database error fetching latest books: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database error", e.what());
-            return;
-        } catch (const std::exception& e) {
-            std::cerr << "Error during database query for latest books: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database query error", e.what());
+        auto fields = requested_book_fields(conn);
+        if (!fields) return;
+
+        auto& book_catalog = catalog::get_book_catalog();
+        const auto limit = static_cast<std::size_t>(query.get_int("limit", 5, 1, static_cast<long long>(book_catalog.config().max_page_size)));
+
+        std::optional<catalog::book_key> after;
+        if (auto cursor = query.get("cursor"); cursor && !cursor->empty()) {
+            after = catalog::keyset_cursor::decode(*cursor);
+            if (!after) {
+                send_json_error(conn, http::status::bad_request, "Invalid cursor", "Pass back the X-Next-Cursor value of the previous page");
+                return;
+            }
+        }
+
+        auto books = book_catalog.snapshot();
+        if (!books) {
+            send_json_error(conn, http::status::service_unavailable, "Book catalog is not loaded yet");
             return;
         }
 
+        auto page = books->page_after(after, limit);
         json json_response = json::array();
-        for (const auto& row: result) {
-            json book_obj;
+        for (const auto& book: page) json_response.push_back(book_summary_json(*book, *fields));
 
-            book_obj["id"] = row["id"].as<int>();
-            book_obj["title"] = row["title"].as<std::string>();
+        http::response<http::string_body> response{http::status::ok, request.version()};
+        response.set(http::field::server, "GeeCodeX Server");
+        response.set(http::field::content_type, "application/json");
+        const auto& newest = books->newest();
+        if (!page.empty() && page.data() + page.size() != newest.data() + newest.size()) {
+            auto next = catalog::keyset_cursor::encode(catalog::catalog::key_of(*page.back()));
+            response.set("X-Next-Cursor", next);
+            auto link = "</geecodex/books/latest?limit=" + std::to_string(limit) + "&cursor=" + next;
+            if (*fields != default_book_fields) link += "&fields=" + book_fields_param(*fields);
+            response.set(http::field::link, link + ">; rel=\"next\"");
+        }
+        response.keep_alive(false);
+        response.body() = json_response.dump();
+        response.prepare_payload();
+
+        conn.send(std::move(response));
+        std::cout << "Latest books response sent successfully." << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_fetch_latest_books: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    } catch (...) {
+        std::cerr << "Unknown exception in handle_fetch_latest_books" << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Unknown internal error");
+    }
+}
+
+// GET /geecodex/books/search?q=...&limit=&offset=&fields= over the in-memory search
+// index; books must contain every query term and come back best match first.
+inline void handle_search_books(http_connection& conn) {
+    try {
+        const auto& query = conn.query();
+        std::string text = boost::algorithm::trim_copy(query.get_or("q", ""));
+        if (text.empty()) {
+            send_json_error(conn, http::status::bad_request, "Missing search query", "Pass the search text as ?q=");
+            return;
+        }
+        auto fields = requested_book_fields(conn);
+        if (!fields) return;
+        const auto limit = static_cast<std::size_t>(query.get_int("limit", 20, 1, 100));
+        const auto offset = static_cast<std::size_t>(query.get_int("offset", 0, 0, 10000));
+
+        auto index = catalog::get_book_search().get();
+        if (!index) {
+            send_json_error(conn, http::status::service_unavailable, "Search index is not built yet");
+            return;
+        }
 
-            if (!row["author"].is_null()) book_obj["author"] = row["author"].as<std::string>();
-            else book_obj["author"] = nullptr;
+        const auto started = std::chrono::steady_clock::now();
+        auto result = index->search(text, offset, limit);
+        const auto took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
 
-            if (!row["isbn"].is_null()) book_obj["isbn"] = row["isbn"].as<std::string>();
-            else book_obj["isbn"] = nullptr;
+        json results = json::array();
+        for (const auto& hit: result.hits) {
+            json book_obj = book_summary_json(*hit.entry, *fields);
+            book_obj["score"] = hit.score;
+            results.push_back(std::move(book_obj));
+        }
+
+        json body;
+        body["query"] = text;
+        body["total"] = result.total;
+        body["offset"] = offset;
+        body["limit"] = limit;
+        body["took_us"] = took.count();
+        body["results"] = std::move(results);
+        send_json_reply(conn, http::status::ok, body.dump());
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_search_books: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
 
-            if (!row["publisher"].is_null()) book_obj["publisher"] = row["publisher"].as<std::string>();
-            else book_obj["publisher"] = nullptr;
+// GET /geecodex/books/suggest?prefix=...&limit= for search-as-you-type: the
+// best matching titles and authors, most downloaded first. A prefix matches
+// at the start of any word of a title or name, or at any CJK character.
+inline void handle_suggest_books(http_connection& conn) {
+    try {
+        const auto& query = conn.query();
+        if (!query.has("prefix")) {
+            send_json_error(conn, http::status::bad_request, "Missing prefix", "Pass the typed text as ?prefix=");
+            return;
+        }
+        const std::string prefix = query.get_or("prefix", "");
+        const auto limit = static_cast<std::size_t>(query.get_int("limit", 8, 1, static_cast<long long>(catalog::suggest_index::max_results)));
 
-            if (!row["publish_date"].is_null()) book_obj["publish_date"] = row["publish_date"].as<std::string>();
-            else book_obj["publish_date"] = nullptr;
+        auto index = catalog::get_book_suggest().get();
+        if (!index) {
+            send_json_error(conn, http::status::service_unavailable, "Suggest index is not built yet");
+            return;
+        }
 
-            if (!row["language"].is_null()) book_obj["language"] = row["language"].as<std::string>();
-            else book_obj["language"] = nullptr;
+        const auto started = std::chrono::steady_clock::now();
+        auto matches = index->suggest(prefix, limit);
+        const auto took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+
+        json suggestions = json::array();
+        for (const auto* match: matches) {
+            json item;
+            item["text"] = match->text;
+            item["type"] = catalog::to_string(match->type);
+            item["book_id"] = match->book_id;
+            item["score"] = match->score;
+            if (match->type == catalog::suggestion::kind::author) item["books"] = match->books;
+            suggestions.push_back(std::move(item));
+        }
 
-            if (!row["page_count"].is_null()) book_obj["page_count"] = row["page_count"].as<int>();
-            else book_obj["page_count"] = nullptr;
+        json body;
+        body["prefix"] = prefix;
+        body["took_us"] = took.count();
+        body["suggestions"] = std::move(suggestions);
+        // Short-lived: download counts and the catalog change underneath.
+        send_json_reply(conn, http::status::ok, body.dump(), {{"Cache-Control", "public, max-age=30"}});
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_suggest_books: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
 
-            if (!row["description"].is_null()) book_obj["description"] = row["description"].as<std::string>();
-            else book_obj["description"] = nullptr;
+// GET /geecodex/books/trending?window=1h&limit=&fields= from the last
+// precomputed trending snapshot. window is one of trending_windows.
+inline void handle_trending_books(http_connection& conn) {
+    try {
+        const auto& query = conn.query();
+        const std::string window_name = query.get_or("window", "1h");
+        auto window = catalog::parse_trending_window(window_name);
+        if (!window) {
+            std::string known;
+            for (const auto& w: catalog::trending_windows) known += (known.empty() ? "" : ", ") + std::string{w.name};
+            send_json_error(conn, http::status::bad_request, "Unknown trending window", "Use one of: " + known);
+            return;
+        }
+        auto fields = requested_book_fields(conn);
+        if (!fields) return;
+        auto& trending = catalog::get_trending_books();
+        const auto limit = static_cast<std::size_t>(query.get_int("limit", 20, 1, static_cast<long long>(trending.config().top_n)));
+
+        auto current = trending.snapshot();
+        auto books = catalog::get_book_catalog().snapshot();
+        if (!current || !books) {
+            send_json_error(conn, http::status::service_unavailable, "Trending books are not available yet");
+            return;
+        }
 
-            if (!row["created_at"].is_null()) book_obj["created_at"] = row["created_at"].as<std::string>();
-            else book_obj["created_at"] = nullptr;
+        json results = json::array();
+        for (const auto& entry: current->windows[*window]) {
+            if (results.size() >= limit) break;
+            auto book = books->find(entry.book_id);
+            if (!book || !book->is_active) continue;
+            json book_obj = book_summary_json(*book, *fields);
+            book_obj["recent_downloads"] = entry.downloads;
+            results.push_back(std::move(book_obj));
+        }
 
-            json tags_array = json::array();
-            if (!row["tags"].is_null()) {
-                pqxx::array_parser parser = row["tags"].as_array();
-                std::pair<pqxx::array_parser::juncture, std::string> elem;
-                do {
-                    elem = parser.get_next();
-                    if (elem.first == pqxx::array_parser::juncture::string_value) 
-                        tags_array.push_back(elem.second);
-                } while (elem.first != pqxx::array_parser::juncture::done);
-            } 
-            book_obj["tags"] = tags_array;
+        json body;
+        body["window"] = window_name;
+        body["computed_at"] = std::chrono::duration_cast<std::chrono::seconds>(current->computed_at.time_since_epoch()).count();
+        body["results"] = std::move(results);
+        send_json_reply(conn, http::status::ok, body.dump(),
+                        {{"Cache-Control", "public, max-age=" + std::to_string(trending.config().refresh_interval.count())}});
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_trending_books: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
 
-            if (!row["download_count"].is_null()) book_obj["download_count"] = row["download_count"].as<int>();
-            else book_obj["download_count"] = 0;
+// GET /geecodex/books/:id/similar?limit=&fields= from the precomputed
+// neighbour table; the most similar books come first.
+inline void handle_similar_books(http_connection& conn) {
+    try {
+        int book_id = 0;
+        const std::string id = conn.path_param("id");
+        auto [ptr, ec] = std::from_chars(id.data(), id.data() + id.size(), book_id);
+        if (ec != std::errc() || ptr != id.data() + id.size() || book_id <= 0) {
+            send_json_error(conn, http::status::bad_request, "Invalid book ID format");
+            return;
+        }
+        auto fields = requested_book_fields(conn);
+        if (!fields) return;
+        const auto limit = static_cast<std::size_t>(conn.query().get_int("limit", 10, 1, static_cast<long long>(catalog::similar_index::max_neighbours)));
+
+        auto books = catalog::get_book_catalog().snapshot();
+        auto index = catalog::get_similar_books().get();
+        if (!books || !index) {
+            send_json_error(conn, http::status::service_unavailable, "Similar books are not computed yet");
+            return;
+        }
+        auto book = books->find(book_id);
+        if (!book || !book->is_active) {
+            send_json_error(conn, http::status::not_found, "Book not found");
+            return;
+        }
 
-            json_response.push_back(book_obj);
+        json results = json::array();
+        for (const auto& match: index->similar(book_id, limit)) {
+            json book_obj = book_summary_json(*match.entry, *fields);
+            book_obj["similarity"] = match.similarity;
+            results.push_back(std::move(book_obj));
         }
 
-        http::response<http::string_body> response{http::status::ok, request.version()};
+        json body;
+        body["book_id"] = book_id;
+        body["results"] = std::move(results);
+        send_json_reply(conn, http::status::ok, body.dump(), {{"Cache-Control", "public, max-age=300"}});
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_similar_books: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
+
+// Whether Accept-Encoding lists `coding` without q=0.
+inline bool accepts_encoding(http_connection& conn, std::string_view coding) {
+    auto& request = conn.request();
+    auto it = request.find(http::field::accept_encoding);
+    if (it == request.end()) return false;
+    const std::string header{it->value()};
+    std::vector<std::string> entries;
+    boost::split(entries, header, boost::is_any_of(","));
+    for (auto& entry: entries) {
+        std::string name = entry.substr(0, entry.find(';'));
+        boost::algorithm::trim(name);
+        if (!boost::algorithm::iequals(name, coding)) continue;
+        const auto q = entry.find("q=");
+        return q == std::string::npos || std::strtod(entry.c_str() + q + 2, nullptr) > 0.0;
+    }
+    return false;
+}
+
+// GET /geecodex/books/snapshot
+// Every active book as {"version", "books"}, the blob prebuilt for the
+// current catalog snapshot; zstd-compressed when the client accepts it and
+// the server has it. Clients revalidate with If-None-Match and then keep
+// up through /geecodex/books/changes?since=<version>.
+inline void handle_catalog_snapshot(http_connection& conn) {
+    try {
+        auto current = catalog::get_catalog_export().get();
+        if (!current) {
+            send_json_error(conn, http::status::service_unavailable, "Book catalog is not loaded yet");
+            return;
+        }
+        const bool zstd = current->zstd() && accepts_encoding(conn, "zstd");
+        const std::string etag = "\"" + current->etag() + (zstd ? "-zstd" : "") + "\"";
+        const std::string version = std::to_string(current->version());
+
+        auto& request = conn.request();
+        if (auto match = request.find(http::field::if_none_match); match != request.end()) {
+            const std::string_view tags{match->value().data(), match->value().size()};
+            if (tags.find(etag) != std::string_view::npos || boost::algorithm::trim_copy(std::string{tags}) == "*") {
+                send_json_reply(conn, http::status::not_modified, {},
+                                {{"ETag", etag}, {"Vary", "Accept-Encoding"}, {"X-Catalog-Version", version}});
+                return;
+            }
+        }
+
+        // The blob is shared with the export, not copied into the response.
+        http::response<shared_string_body> response{http::status::ok, request.version()};
         response.set(http::field::server, "GeeCodeX Server");
         response.set(http::field::content_type, "application/json");
+        if (zstd) response.set(http::field::content_encoding, "zstd");
+        response.set(http::field::etag, etag);
+        response.set(http::field::vary, "Accept-Encoding");
+        response.set(http::field::cache_control, "no-cache");
+        response.set("X-Catalog-Version", version);
         response.keep_alive(false);
-        response.body() = json_response.dump(4);
+        response.body() = zstd ? current->zstd() : current->json();
         response.prepare_payload();
-        
         conn.send(std::move(response));
-        std::cout << "Latest books response sent successfully." << std::endl;
     } catch (const std::exception& e) {
-        std::cerr << "Error in handle_fetch_latest_books: " << e.what() << std::endl;
+        std::cerr << "Error in handle_catalog_snapshot: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
+
+// GET /geecodex/books/changes?since=<version>
+// {"version", "reset", "changed", "deleted"}: books added or updated since a
+// snapshot or earlier delta of that version, and ids to drop. The last
+// catalog refresh overlap before `since` is sent again, so a row committed
+// late is not skipped. "reset": true means there are too many changes and
+// the client should download the snapshot instead.
+inline void handle_catalog_changes(http_connection& conn) {
+    try {
+        const auto since_param = conn.query().get("since");
+        std::int64_t since = 0;
+        if (!since_param) {
+            send_json_error(conn, http::status::bad_request, "Missing 'since'", "Pass the version of the snapshot or last delta");
+            return;
+        }
+        auto [ptr, ec] = std::from_chars(since_param->data(), since_param->data() + since_param->size(), since);
+        if (ec != std::errc() || ptr != since_param->data() + since_param->size() || since < 0) {
+            send_json_error(conn, http::status::bad_request, "Invalid 'since'", "Expected a version from /geecodex/books/snapshot");
+            return;
+        }
+
+        auto current = catalog::get_catalog_export().get();
+        if (!current) {
+            send_json_error(conn, http::status::service_unavailable, "Book catalog is not loaded yet");
+            return;
+        }
+        if (!current->deletions_tracked()) {
+            send_json_error(conn, http::status::service_unavailable, "Catalog changes are not tracked",
+                            "Table codex_books_deleted is missing; use /geecodex/books/snapshot");
+            return;
+        }
+
+        const auto overlap = std::chrono::duration_cast<std::chrono::microseconds>(catalog::get_book_catalog().config().overlap).count();
+        auto changes = current->changes_since(std::max<std::int64_t>(0, since - overlap));
+
+        json body;
+        body["version"] = current->version();
+        body["reset"] = !changes;
+        if (changes) {
+            json changed = json::array();
+            for (const auto& book: changes->changed) changed.push_back(catalog::sync_book_json(*book));
+            body["changed"] = std::move(changed);
+            body["deleted"] = std::move(changes->deleted);
+        }
+        send_json_reply(conn, http::status::ok, body.dump(), {{"Cache-Control", "no-cache"}});
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_catalog_changes: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
+
+// GET /geecodex/books?category=&language=&tag=&access_level=&limit=&offset=&fields=
+// Repeating a parameter ORs its values; different parameters are ANDed.
+// Replies with the page of matching books, newest first, plus per-facet
+// value counts (facet_limit values per facet, 0 for none).
+inline void handle_browse_books(http_connection& conn) {
+    try {
+        const auto& query = conn.query();
+        std::vector<catalog::facet_filter> filters;
+        for (const auto& [key, value]: query.all()) {
+            auto which = catalog::parse_facet(key);
+            if (!which) continue;
+            auto it = std::find_if(filters.begin(), filters.end(), [&](const auto& f) { return f.which == *which; });
+            if (it == filters.end()) it = filters.insert(filters.end(), catalog::facet_filter{*which, {}});
+            it->values.push_back(value);
+        }
+        auto fields = requested_book_fields(conn);
+        if (!fields) return;
+        const auto limit = static_cast<std::size_t>(query.get_int("limit", 20, 1, 100));
+        const auto offset = static_cast<std::size_t>(query.get_int("offset", 0, 0, 100000));
+        const auto facet_limit = static_cast<std::size_t>(query.get_int("facet_limit", 20, 0, 100));
+
+        auto index = catalog::get_book_facets().get();
+        if (!index) {
+            send_json_error(conn, http::status::service_unavailable, "Facet index is not built yet");
+            return;
+        }
+
+        const auto started = std::chrono::steady_clock::now();
+        auto result = index->query(filters, offset, limit, facet_limit);
+        const auto took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+
+        json books = json::array();
+        for (const auto& book: result.books) books.push_back(book_summary_json(*book, *fields));
+
+        json facets = json::object();
+        for (std::size_t f = 0; f < catalog::facet_names.size(); ++f) {
+            json values = json::array();
+            for (const auto& count: result.counts[f]) values.push_back({{"value", count.value}, {"count", count.count}});
+            facets[std::string{catalog::facet_names[f]}] = std::move(values);
+        }
+
+        json body;
+        body["total"] = result.total;
+        body["offset"] = offset;
+        body["limit"] = limit;
+        body["took_us"] = took.count();
+        body["books"] = std::move(books);
+        body["facets"] = std::move(facets);
+        send_json_reply(conn, http::status::ok, body.dump());
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_browse_books: " << e.what() << std::endl;
         send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
-    } catch (...) {
-        std::cerr << "Unknown exception in handle_fetch_latest_books" << std::endl;
-        send_json_error(conn, http::status::internal_server_error, "Unknown internal error");
     }
 }
 
@@ -568,20 +1023,80 @@ struct semantic_version {
     }
 };
 
-inline void handle_app_update_check(http_connection &conn) {
-    try {
-        std::cout << "Handling app update check request" << std::endl;
-        auto& request = conn.request();
-
-
-        auto it = request.find(http::field::content_type);
-        if (it == request.end()) {
-            send_json_error( conn, http::status::unsupported_media_type
-                           , "Invalid Content-Type", "Expected application/json");
+// Answers an update check from the newest active release found for the platform.
+inline void reply_app_update_check( http_connection& conn
+                                  , const pqxx::result& db_result
+                                  , const std::string& platform
+                                  , const std::string& current_version_str
+                                  , const semantic_version& current_version) {
+    json json_response;
+    if (db_result.empty()) {
+        std::cout << "No active update found for platform: " << platform << std::endl;
+        json_response["update_available"] = false;
+    } else {
+        const auto& latest_row = db_result[0];
+        std::string latest_version_str = latest_row["version_name"].as<std::string>();
+        
+        auto latest_version_opt = semantic_version::from_string(latest_version_str);
+        if (!latest_version_opt) {
+            std::cerr << "CRITICAL: Invalid versions format ('" << latest_version_str 
+                      << "') found in database for platform '" << platform << "'!" << std::endl;
+            send_json_error( conn, http::status::internal_server_error
+                           , "Server configuration error", "Invalid version format in database.");
+            return;
+        }
+        semantic_version latest_version = *latest_version_opt;
+        
+        std::cout << "Latest DB version: " << latest_version_str 
+                  << " (" << latest_version.major 
+                  << "."  << latest_version.minor 
+                  << "."  << latest_version.patch << ")" 
+                  << std::endl;
+
+        std::cout << "Client Version: " << current_version_str 
+                  << " (" << current_version.major
+                  << "."  << current_version.minor
+                  << "."  << current_version.patch
+                  << std::endl;
+        
+        if (latest_version > current_version) {
+            std::cout << "Update available" << std::endl;
+            json_response["update_available"] = true;
+            json_response["latest_version"] = latest_version_str;
+            json_response["version_code"] = latest_row["version_code"].as<int>();
+            json_response["release_notes"] = latest_row["release_notes"].is_null() ? "" : latest_row["release_notes"].as<std::string>();
+            json_response["is_mandatory"] = latest_row["is_mandatory"].as<bool>();
+        } else {
+            std::cout << "No update needed (client version is current or newer)." << std::endl;
+            json_response["update_available"] = false;
+        }
+    }
+
+    http::response<http::string_body> response{http::status::ok, conn.request().version()};
+    response.set(http::field::server, "GeeCodeX Server");
+    response.set(http::field::content_type, "application/json");
+    response.keep_alive(false);
+    response.body() = json_response.dump();
+    response.prepare_payload();
+
+    conn.send(std::move(response));
+    std::cout << "App update check response send successfully." << std::endl;
+}
+
+inline void handle_app_update_check(http_connection &conn) {
+    try {
+        std::cout << "Handling app update check request" << std::endl;
+        auto& request = conn.request();
+
+
+        auto it = request.find(http::field::content_type);
+        if (it == request.end()) {
+            send_json_error( conn, http::status::unsupported_media_type
+                           , "Invalid Content-Type", "Expected application/json");
             return;
         }
 
-
+
         boost::string_view content_type_value = it->value();
         if (!boost::algorithm::istarts_with(content_type_value, "application/json")) {
             std::cerr << "Invalid Content-Type received: " << content_type_value << std::endl;
@@ -627,79 +1142,35 @@ inline void handle_app_update_check(http_connection &conn) {
         }
         semantic_version current_version = *current_version_opt;
 
-        pqxx::result db_result;
-        try {
-            std::cout << "Querying database for latest active version for platform: " << platform << std::endl;
-            db_result = execute_params(
-                "SELECT version_name, version_code, release_notes, is_mandatory "
-                "FROM app_updates "
-                "WHERE platform = $1 AND is_active = TRUE "
-                "ORDER BY version_code DESC "
-                "LIMIT 1",
-                platform
-            );
-        } catch (const database::database_exception& e) {
-            std::cerr << "Database error fetching latest app version: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database error", e.what());
-            return;
-        } catch (const std::exception& e) {
-            std::cerr << "Error during database query for latest app version: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database query error", e.what());
-            return;
-        }
-
-        json json_response;
-        if (db_result.empty()) {
-            std::cout << "No active update found for platform: " << platform << std::endl;
-            json_response["update_available"] = false;
-        } else {
-            const auto& latest_row = db_result[0];
-            std::string latest_version_str = latest_row["version_name"].as<std::string>();
-            
-            auto latest_version_opt = semantic_version::from_string(latest_version_str);
-            if (!latest_version_opt) {
-                std::cerr << "CRITICAL: Invalid versions format ('" << latest_version_str 
-                          << "') found in database for platform '" << platform << "'!" << std::endl;
-                send_json_error( conn, http::status::internal_server_error
-                               , "Server configuration error", "Invalid version format in database.");
-                return;
-            }
-            semantic_version latest_version = *latest_version_opt;
-            
-            std::cout << "Latest DB version: " << latest_version_str 
-                      << " (" << latest_version.major 
-                      << "."  << latest_version.minor 
-                      << "."  << latest_version.patch << ")" 
-                      << std::endl;
-
-            std::cout << "Client Version: " << current_version_str 
-                      << " (" << current_version.major
-                      << "."  << current_version.minor
-                      << "."  << current_version.patch
-                      << std::endl;
-            
-            if (latest_version > current_version) {
-                std::cout << "Update available" << std::endl;
-                json_response["update_available"] = true;
-                json_response["latest_version"] = latest_version_str;
-                json_response["version_code"] = latest_row["version_code"].as<int>();
-                json_response["release_notes"] = latest_row["release_notes"].is_null() ? "" : latest_row["release_notes"].as<std::string>();
-                json_response["is_mandatory"] = latest_row["is_mandatory"].as<bool>();
-            } else {
-                std::cout << "No update needed (client version is current or newer)." << std::endl;
-                json_response["update_available"] = false;
-            }
-
-            http::response<http::string_body> response{http::status::ok, request.version()};
-            response.set(http::field::server, "GeeCodeX Server");
-            response.set(http::field::content_type, "application/json");
-            response.keep_alive(false);
-            response.body() = json_response.dump();
-            response.prepare_payload();
-
-            conn.send(std::move(response));
-            std::cout << "App update check response send successfully." << std::endl;
-        }
+        std::cout << "Querying database for latest active version for platform: " << platform << std::endl;
+        auto waiting_conn = conn.shared_from_this();
+        conn.defer_response();
+        database::async_execute(conn.socket().get_executor(), conn.cancellation_slot(),
+            [platform](pqxx::work& txn) {
+                return txn.exec_params(
+                    "SELECT version_name, version_code, release_notes, is_mandatory "
+                    "FROM app_updates "
+                    "WHERE platform = $1 AND is_active = TRUE "
+                    "ORDER BY version_code DESC "
+                    "LIMIT 1",
+                    platform);
+            },
+            [waiting_conn, platform, current_version_str, current_version](std::exception_ptr error, pqxx::result db_result) {
+                if (waiting_conn->client_gone()) return;
+                try {
+                    if (error) std::rethrow_exception(error);
+                } catch (const std::exception& e) {
+                    std::cerr << "Database error fetching latest app version: " << e.what() << std::endl;
+                    send_json_error(*waiting_conn, http::status::internal_server_error, "Database error", e.what());
+                    return;
+                }
+                try {
+                    reply_app_update_check(*waiting_conn, db_result, platform, current_version_str, current_version);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error in handle_app_update_check: " << e.what() << std::endl;
+                    if (!waiting_conn->response_sent()) send_json_error(*waiting_conn, http::status::internal_server_error, "internal_server_error", e.what());
+                }
+            });
     } catch (const std::exception& e) {
         std::cerr << "Error in handle_app_update_check: " << e.what() << std::endl;
         try {
@@ -721,11 +1192,72 @@ inline void handle_app_update_check(http_connection &conn) {
     }
 }
 
+// Sends the package file of the newest active release found for the platform.
+inline void send_latest_app_package(http_connection& conn, const pqxx::result& db_result, const std::string& platform) {
+    if (db_result.empty()) {
+        std::cout << "No active package path found for platform: " << platform << std::endl;
+        send_json_error(conn, http::status::not_found, "Package not found", "No downloadable available for this platform");
+        return;
+    }
+
+    const auto& latest_row = db_result[0];
+    std::string package_path_str = latest_row["package_path"].as<std::string>();
+    std::string version_name = latest_row["version_name"].as<std::string>();
+
+    std::cout << "Found package_path: " << package_path_str << " for version " << version_name << std::endl;
+    fs::path package_file_path(package_path_str);
+    beast::error_code file_ec;
+
+    if (!fs::exists(package_file_path, file_ec) || !fs::is_regular_file(package_file_path, file_ec)) {
+        if (file_ec) std::cerr << "Filesystem error checking path '" << package_path_str << "': " << file_ec.message() << std::endl;
+        else std::cerr << "Package file not found or is not a regular file on server: " << package_path_str << std::endl;
+        send_json_error(conn, http::status::not_found, "Package file missing", "The application package file could not be found on server.");
+        return;
+    }
+
+    http::file_body::value_type file_body;
+    file_body.open(package_file_path.string().c_str(), beast::file_mode::read, file_ec);
+    
+    if (file_ec) {
+        std::cerr << "Error opening package file '" << package_path_str << ": " << file_ec.message() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "File access error", "Failed to open the package file");
+        return;
+    }
+
+    std::string file_extension = package_file_path.extension().string();
+    std::string mime_type = guess_mime_type(file_extension);
+
+    std::string download_filename = "GeeCodexApp-" + platform + "-" + version_name + file_extension;
+    download_filename = std::regex_replace(download_filename, std::regex("[^a-zA-Z0-9_.-]"), "_");
+    
+    std::cout << "Sending file: " << download_filename << " (MIME: " << mime_type << ")" << std::endl;
+
+    http::response<http::file_body> response {
+        std::piecewise_construct,
+        std::make_tuple(std::move(file_body)),
+        std::make_tuple(http::status::ok, conn.request().version())
+    };
+
+    response.set(http::field::server, "GeeCodeX Server");
+    response.set(http::field::content_type, mime_type);
+    response.content_length(response.body().size());
+    response.set(http::field::content_disposition, "attachment; filename=\"" + download_filename + "\"");
+
+    response.set(http::field::cache_control, "no-cache, no-store, must-revalidate");
+    response.set(http::field::pragma, "no-cache");
+    response.set(http::field::expires, "0");
+
+    response.keep_alive(false);
+    
+    conn.send(std::move(response));
+    std::cout << "Package file sent successfully: " << package_path_str << std::endl;
+}
+
 inline void handle_download_latest_app(http_connection& conn) {
     try {
         std::cout << "Handling latest app download request" << std::endl;
         auto& request = conn.request();
-        std::string target = std::string(request.target());
+        std::string target{target_path({request.target().data(), request.target().size()})};
 
         std::regex platform_regex("/geecodex/app/download/latest/([a-zA-Z0-9_\\-]+)");
         std::smatch match;
@@ -741,85 +1273,36 @@ inline void handle_download_latest_app(http_connection& conn) {
             return;
         }
 
-        pqxx::result db_result;
-        try {
-            std::cout << "Querying database for latest package path for platform: " << platform << std::endl;
-            db_result = execute_params(
-                "SELECT version_name, package_path "
-                "FROM app_updates "
-                "WHERE platform = $1 AND is_active = TRUE AND package_path IS NOT NULL AND package_path <> '' "
-                "ORDER BY version_code DESC "
-                "LIMIT 1",
-                platform
-            );
-            std::cout << "Database query returned " << db_result.size() << " rows for package path." << std::endl;
-        } catch (const database::database_exception& e) {
-            std::cerr << "Database error fetching package path: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database error", e.what());
-            return;
-        } catch (const std::exception& e) {
-            std::cerr << "Error during database query for package path: " << e.what() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "Database query error", e.what());
-            return;
-        }
-
-        if (db_result.empty()) {
-            std::cout << "No active package path found for platform: " << platform << std::endl;
-            send_json_error(conn, http::status::not_found, "Package not found", "No downloadable available for this platform");
-            return;
-        }
-
-        const auto& latest_row = db_result[0];
-        std::string package_path_str = latest_row["package_path"].as<std::string>();
-        std::string version_name = latest_row["version_name"].as<std::string>();
-
-        std::cout << "Found package_path: " << package_path_str << " for version " << version_name << std::endl;
-        fs::path package_file_path(package_path_str);
-        beast::error_code file_ec;
-
-        if (!fs::exists(package_file_path, file_ec) || !fs::is_regular_file(package_file_path, file_ec)) {
-            if (file_ec) std::cerr << "Filesystem error checking path '" << package_path_str << "': " << file_ec.message() << std::endl;
-            else std::cerr << "Package file not found or is not a regular file on server: " << package_path_str << std::endl;
-            send_json_error(conn, http::status::not_found, "Package file missing", "The application package file could not be found on server.");
-            return;
-        }
-
-        http::file_body::value_type file_body;
-        file_body.open(package_file_path.string().c_str(), beast::file_mode::read, file_ec);
-        
-        if (file_ec) {
-            std::cerr << "Error opening package file '" << package_path_str << ": " << file_ec.message() << std::endl;
-            send_json_error(conn, http::status::internal_server_error, "File access error", "Failed to open the package file");
-            return;
-        }
-
-        std::string file_extension = package_file_path.extension().string();
-        std::string mime_type = guess_mime_type(file_extension);
-
-        std::string download_filename = "GeeCodexApp-" + platform + "-" + version_name + file_extension;
-        download_filename = std::regex_replace(download_filename, std::regex("[^a-zA-Z0-9_.-]"), "_");
-        
-        std::cout << "Sending file: " << download_filename << " (MIME: " << mime_type << ")" << std::endl;
-
-        http::response<http::file_body> response {
-            std::piecewise_construct,
-            std::make_tuple(std::move(file_body)),
-            std::make_tuple(http::status::ok, request.version())
-        };
-
-        response.set(http::field::server, "GeeCodeX Server");
-        response.set(http::field::content_type, mime_type);
-        response.content_length(response.body().size());
-        response.set(http::field::content_disposition, "attachment; filename=\"" + download_filename + "\"");
-
-        response.set(http::field::cache_control, "no-cache, no-store, must-revalidate");
-        response.set(http::field::pragma, "no-cache");
-        response.set(http::field::expires, "0");
-
-        response.keep_alive(false);
-        
-        conn.send(std::move(response));
-        std::cout << "Package file sent successfully: " << package_path_str << std::endl;
+        std::cout << "Querying database for latest package path for platform: " << platform << std::endl;
+        auto waiting_conn = conn.shared_from_this();
+        conn.defer_response();
+        database::async_execute(conn.socket().get_executor(), conn.cancellation_slot(),
+            [platform](pqxx::work& txn) {
+                return txn.exec_params(
+                    "SELECT version_name, package_path "
+                    "FROM app_updates "
+                    "WHERE platform = $1 AND is_active = TRUE AND package_path IS NOT NULL AND package_path <> '' "
+                    "ORDER BY version_code DESC "
+                    "LIMIT 1",
+                    platform);
+            },
+            [waiting_conn, platform](std::exception_ptr error, pqxx::result db_result) {
+                if (waiting_conn->client_gone()) return;
+                try {
+                    if (error) std::rethrow_exception(error);
+                } catch (const std::exception& e) {
+                    std::cerr << "Database error fetching package path: " << e.what() << std::endl;
+                    send_json_error(*waiting_conn, http::status::internal_server_error, "Database error", e.what());
+                    return;
+                }
+                std::cout << "Database query returned " << db_result.size() << " rows for package path." << std::endl;
+                try {
+                    send_latest_app_package(*waiting_conn, db_result, platform);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error in handle_download_latest_app: " << e.what() << std::endl;
+                    if (!waiting_conn->response_sent()) send_json_error(*waiting_conn, http::status::internal_server_error, "Internal server error", e.what());
+                }
+            });
     } catch (const std::exception& e) {
         std::cerr << "Error in handle_download_latest_app: " << e.what() << std::endl;;
         try {
@@ -910,41 +1393,31 @@ inline void handle_fetch_client_feedback(http_connection &conn) {
                   << "', Feedback: '" << feedback_text.substr(0, 50) << "..."
                   << std::endl;
 
-        try {
-            const std::string sql = 
-                "INSERT INTO client_feedback (nickname, feedback_text) VALUES ($1, $2)";
-            
-            execute_transaction([&](pqxx::work& txn) {
-                txn.exec_params(sql, nickname, feedback_text);
+        auto waiting_conn = conn.shared_from_this();
+        conn.defer_response();
+        database::async_execute(conn.socket().get_executor(), conn.cancellation_slot(),
+            [nickname, feedback_text](pqxx::work& txn) {
+                return txn.exec_params("INSERT INTO client_feedback (nickname, feedback_text) VALUES ($1, $2)", nickname, feedback_text);
+            },
+            [waiting_conn, nickname](std::exception_ptr error, pqxx::result) {
+                if (waiting_conn->client_gone()) return;
+                try {
+                    if (error) std::rethrow_exception(error);
+                } catch (const std::exception& e) {
+                    std::cerr << "Database error storing feedback: " << e.what() << std::endl;
+                    send_json_error( *waiting_conn, http::status::internal_server_error
+                                   , "Database error", "Failed to store feedback.");
+                    return;
+                }
+                std::cout << "Feedback from " << nickname
+                          << "' stored successfully in the database." << std::endl;
+
+                json json_response;
+                json_response["status"] = "success";
+                json_response["message"] = "Feedback received successfully. Thank you!";
+                send_json_reply(*waiting_conn, http::status::ok, json_response.dump());
+                std::cout << "Client feedback success response sent." << std::endl;
             });
-
-            std::cout << "Feedback from " << nickname 
-                      << "' stored successfully in the database." << std::endl;
-        } catch (const database_exception& e) {
-            std::cerr << "Database error storing feedback: " << e.what() << std::endl;
-            send_json_error( conn, http::status::internal_server_error
-                           , "Database error", "Failed to store feedback.");
-            return;
-        } catch (const std::exception& e) {
-            std::cerr << "Error during database insert for feedback: " << e.what() << std::endl;
-            send_json_error( conn, http::status::internal_server_error
-                           , "Database insert error", "An unexpected error occurred when storing feedback.");
-            return;
-        }
-
-        json json_response;
-        json_response["status"] = "success";
-        json_response["message"] = "Feedback received successfully. Thank you!";
-
-        http::response<http::string_body> response{http::status::ok, request.version()};
-        response.set(http::field::server, "GeeCodeX Server");
-        response.set(http::field::content_type, "application/json");
-        response.keep_alive(false);
-        response.body() = json_response.dump();
-        response.prepare_payload();
-
-        conn.send(std::move(response));
-        std::cout << "Client feedback success response sent." << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error in handle_fetch_client_feedback: " << e.what() << std::endl;
         try {
@@ -978,6 +1451,11 @@ inline ssl::context& get_shared_ssl_context() {
         try {
             std::cout << "Initializing shared SSL context..." << std::endl;
             ssl_ctx.set_default_verify_paths();
+            // Extra trust anchor, e.g. the self-signed certificate of a local mock upstream.
+            if (auto ca_file = utils::env_string("DEEPSEEK_CA_FILE"); !ca_file.empty()) {
+                ssl_ctx.load_verify_file(ca_file);
+                std::cout << "Loaded extra CA file: " << ca_file << std::endl;
+            }
 
             ssl_ctx.set_verify_mode(ssl::verify_peer);
             std::cout << "Shared SSL context initialized successfully." << std::endl;
@@ -1000,6 +1478,178 @@ inline std::string get_deepseek_api_key() {
 }
 
 
+inline void send_ai_reply(http_connection& conn, std::string body, const char* cache_status, const std::string& conversation_id = {}) {
+    http::response<http::string_body> response{http::status::ok, conn.request().version()};
+    response.set(http::field::server, "GeeCodeX Server");
+    response.set(http::field::content_type, "application/json");
+    response.set("X-Cache", cache_status);
+    if (!conversation_id.empty()) response.set("X-Conversation-Id", conversation_id);
+    response.keep_alive(false);
+    response.body() = std::move(body);
+    response.prepare_payload();
+    conn.send(std::move(response));
+}
+
+inline void send_upstream_rejection(http_connection& conn, const upstream_guard& guard, upstream_guard::rejection why) {
+    bool circuit_open = why == upstream_guard::rejection::circuit_open;
+    std::cerr << "AI chat rejected: " << (circuit_open ? "circuit open" : "too many requests in flight") << std::endl;
+
+    json error_body;
+    error_body["error"] = "AI Service Unavailable";
+    error_body["message"] = circuit_open ? "AI provider is failing, try again later" : "Too many AI requests in progress";
+
+    http::response<http::string_body> response{http::status::service_unavailable, conn.request().version()};
+    response.set(http::field::server, "GeeCodeX Server");
+    response.set(http::field::content_type, "application/json");
+    response.set(http::field::retry_after, std::to_string(guard.retry_after().count()));
+    response.keep_alive(false);
+    response.body() = error_body.dump();
+    response.prepare_payload();
+    conn.send(std::move(response));
+}
+
+inline bool is_valid_chat_message(const json& msg) {
+    return msg.is_object() &&
+           msg.contains("role") && msg["role"].is_string() &&
+           msg.contains("content") && msg["content"].is_string();
+}
+
+// Appends the assistant reply (`{"reply": ...}` client body) to the turn's
+// messages and stores them as the conversation's new history.
+inline void remember_conversation_turn(const std::string& conversation_id, json messages, const std::string& reply_body) {
+    json reply = json::parse(reply_body, nullptr, false);
+    if (reply.is_discarded() || !reply.contains("reply") || !reply["reply"].is_string()) return;
+    messages.push_back({{"role", "assistant"}, {"content", reply["reply"]}});
+    get_conversation_store().put(conversation_id, std::move(messages));
+}
+
+inline void launch_ai_upstream( http_connection& conn
+                              , const json& deepseek_request_body
+                              , json messages
+                              , bool stream
+                              , const std::string& conversation_id
+                              , const std::string& cache_key);
+
+// Second half of handle_ai_chat, once the upstream `messages` are known:
+// cache lookup / coalescing, then launch_ai_upstream(). The leader of a
+// cacheable request checks the cache's disk tier first, off this thread.
+// `conversation_id` is empty for clients that upload the full history.
+// Throws on setup errors before anything has been sent.
+inline void launch_ai_chat( http_connection& conn
+                          , const json& model
+                          , json messages
+                          , bool stream
+                          , const std::string& conversation_id) {
+    json deepseek_request_body;
+    deepseek_request_body["model"] = model;
+    deepseek_request_body["messages"] = messages;
+    deepseek_request_body["stream"] = stream;
+    if (stream) deepseek_request_body["stream_options"] = {{"include_usage", true}};
+
+    auto& cache = get_ai_response_cache();
+    std::string cache_key;
+    if (!stream && cache.enabled()) {
+        cache_key = ai_response_cache::make_key(deepseek_request_body["model"], deepseek_request_body["messages"]);
+        if (auto cached = cache.get(cache_key)) {
+            std::cout << "AI chat served from cache." << std::endl;
+            if (!conversation_id.empty()) remember_conversation_turn(conversation_id, messages, *cached);
+            send_ai_reply(conn, std::move(*cached), "HIT", conversation_id);
+            return;
+        }
+
+        auto waiting_conn = conn.shared_from_this();
+        bool leader = cache.join_or_lead(cache_key, [waiting_conn, conversation_id, messages](const std::optional<std::string>& body) {
+            net::post(waiting_conn->socket().get_executor(), [waiting_conn, conversation_id, messages, body]() {
+                if (!body) return send_json_error(*waiting_conn, http::status::bad_gateway, "AI Service Error", "Upstream request failed");
+                if (!conversation_id.empty()) remember_conversation_turn(conversation_id, messages, *body);
+                send_ai_reply(*waiting_conn, *body, "COALESCED", conversation_id);
+            });
+        });
+        if (!leader) {
+            std::cout << "Identical AI chat request already in flight, waiting for its reply." << std::endl;
+            conn.defer_response();
+            return;
+        }
+
+        if (cache.disk_tier()) {
+            conn.defer_response();
+            auto leading_conn = conn.shared_from_this();
+            cache.lead_from_disk(cache_key, conn.socket().get_executor(),
+                [leading_conn, request_body = std::move(deepseek_request_body), messages = std::move(messages), stream, conversation_id, cache_key]
+                (std::optional<std::string> body) mutable {
+                    if (body) {
+                        std::cout << "AI chat served from the disk cache." << std::endl;
+                        if (!conversation_id.empty()) remember_conversation_turn(conversation_id, messages, *body);
+                        return send_ai_reply(*leading_conn, std::move(*body), "HIT", conversation_id);
+                    }
+                    try {
+                        launch_ai_upstream(*leading_conn, request_body, std::move(messages), stream, conversation_id, cache_key);
+                    } catch (const std::exception& e) {
+                        get_ai_response_cache().complete(cache_key, std::nullopt, std::chrono::milliseconds{0});
+                        std::cerr << "Error launching AI chat after the disk cache: " << e.what() << std::endl;
+                        if (!leading_conn->response_sent()) send_json_error(*leading_conn, http::status::internal_server_error, "Internal Server Error", e.what());
+                    }
+                });
+            return;
+        }
+    }
+    launch_ai_upstream(conn, deepseek_request_body, std::move(messages), stream, conversation_id, cache_key);
+}
+
+// Admission and the deepseek_session for a request that was not answered
+// from the cache. A non-empty `cache_key` means this request leads that key
+// and must complete() it whatever happens.
+inline void launch_ai_upstream( http_connection& conn
+                              , const json& deepseek_request_body
+                              , json messages
+                              , bool stream
+                              , const std::string& conversation_id
+                              , const std::string& cache_key) {
+    auto& cache = get_ai_response_cache();
+    std::string api_key;
+    try {
+        api_key = get_deepseek_api_key();
+    } catch (...) {
+        if (!cache_key.empty()) cache.complete(cache_key, std::nullopt, std::chrono::milliseconds{0});
+        throw;
+    }
+    
+    // Fail fast instead of queueing behind a saturated or failing provider.
+    upstream_guard::rejection why = upstream_guard::rejection::none;
+    auto permit = get_deepseek_guard().try_acquire(why);
+    if (!permit) {
+        if (!cache_key.empty()) cache.complete(cache_key, std::nullopt, std::chrono::milliseconds{0});
+        send_upstream_rejection(conn, get_deepseek_guard(), why);
+        return;
+    }
+
+    ssl::context& shared_ssl_ctx = get_shared_ssl_context();
+
+    std::cout << "Launching deepseek_session..." << std::endl;
+    auto session = std::make_shared<deepseek_session>(
+        conn.socket().get_executor(),
+        shared_ssl_ctx,
+        conn.shared_from_this()
+    );
+    if (!cache_key.empty() || !conversation_id.empty()) {
+        session->on_complete([cache_key, conversation_id, messages = std::move(messages)](std::optional<std::string> body, std::chrono::milliseconds latency) {
+            if (body && !conversation_id.empty()) remember_conversation_turn(conversation_id, messages, *body);
+            if (!cache_key.empty()) get_ai_response_cache().complete(cache_key, std::move(body), latency);
+        });
+    }
+    if (!cache_key.empty())
+        session->keep_running_if([cache_key]() { return get_ai_response_cache().has_waiters(cache_key); });
+    if (!conversation_id.empty()) session->add_reply_header("X-Conversation-Id", conversation_id);
+    conn.defer_response();
+    session->attach_permit(std::move(*permit));
+    session->run("/chat/completions", deepseek_request_body.dump(), api_key, stream);
+}
+
+// Two request shapes are accepted:
+//  {"messages": [...]}                                   full history every turn;
+//  {"conversation_id": "<id>", "message": {...}}         history kept server-side,
+//                                                        omit the id to start one.
+// Conversation replies carry the id in the X-Conversation-Id header.
 inline void handle_ai_chat(http_connection &conn) {
     bool response_sent_flag = false;
     
@@ -1021,6 +1671,64 @@ inline void handle_ai_chat(http_connection &conn) {
             return;
         }
 
+        if (request_body.contains("stream") && !request_body["stream"].is_boolean()) {
+            send_json_error(conn, http::status::bad_request, "Invalid request format", "'stream' must be a boolean");
+            response_sent_flag = true;
+            return;
+        }
+        // Chunked transfer encoding needs HTTP/1.1; older clients get the buffered reply.
+        bool stream = request_body.value("stream", false) && conn.request().version() >= 11;
+        json model = request_body.value("model", "deepseek-chat");
+
+        if (request_body.contains("message")) {
+            if (!is_valid_chat_message(request_body["message"])) {
+                send_json_error(conn, http::status::bad_request, "Invalid request format", "Invalid 'message' object");
+                response_sent_flag = true;
+                return;
+            }
+
+            auto& store = get_conversation_store();
+            std::string conversation_id;
+            json history = json::array();
+            if (request_body.contains("conversation_id")) {
+                if (!request_body["conversation_id"].is_string() ||
+                    !conversation_store::valid_id(request_body["conversation_id"].get_ref<const std::string&>())) {
+                    send_json_error(conn, http::status::bad_request, "Invalid request format", "Invalid 'conversation_id'");
+                    response_sent_flag = true;
+                    return;
+                }
+                conversation_id = request_body["conversation_id"].get<std::string>();
+                if (auto stored = store.get(conversation_id)) history = std::move(*stored);
+                else if (store.spill_enabled()) {
+                    conn.defer_response();
+                    response_sent_flag = true;
+                    auto waiting_conn = conn.shared_from_this();
+                    store.load_spilled(conn.socket().get_executor(), conn.cancellation_slot(), conversation_id,
+                        [waiting_conn, model, message = request_body["message"], stream, conversation_id](std::optional<json> spilled) mutable {
+                            if (waiting_conn->client_gone()) return;
+                            if (!spilled) return send_json_error(*waiting_conn, http::status::not_found, "Unknown conversation", "Conversation expired or does not exist");
+                            spilled->push_back(std::move(message));
+                            try {
+                                launch_ai_chat(*waiting_conn, model, std::move(*spilled), stream, conversation_id);
+                            } catch (const std::exception& e) {
+                                std::cerr << "Error resuming spilled AI conversation: " << e.what() << std::endl;
+                                if (!waiting_conn->response_sent()) send_json_error(*waiting_conn, http::status::internal_server_error, "Internal Server Error", e.what());
+                            }
+                        });
+                    return;
+                } else {
+                    send_json_error(conn, http::status::not_found, "Unknown conversation", "Conversation expired or does not exist");
+                    response_sent_flag = true;
+                    return;
+                }
+            } else conversation_id = conversation_store::new_id();
+
+            history.push_back(request_body["message"]);
+            launch_ai_chat(conn, model, std::move(history), stream, conversation_id);
+            std::cout << "Exiting handle_ai_chat handler function (conversation " << conversation_id << ")." << std::endl;
+            return;
+        }
+
         if (!request_body.contains("messages") ||
             !request_body["messages"].is_array() || 
             request_body["messages"].empty()) {
@@ -1030,43 +1738,25 @@ inline void handle_ai_chat(http_connection &conn) {
             }
         
         for (const auto& msg: request_body["messages"]) {
-            if (!msg.is_object() ||
-                !msg.contains("role") || 
-                !msg["role"].is_string() ||
-                !msg.contains("content") || 
-                !msg["content"].is_string()) {
+            if (!is_valid_chat_message(msg)) {
                     send_json_error(conn, http::status::bad_request, "Invalid request format", "Invalid structure within 'messages' array.");
                     response_sent_flag = true;
                     return;
                 }
         }
 
-        json deepseek_request_body;
-        deepseek_request_body["model"] = request_body.value("model", "deepseek-chat");
-        deepseek_request_body["messages"] = request_body["messages"];
-        deepseek_request_body["stream"] = false;
-
-        std::string api_key = get_deepseek_api_key();
-        
-        ssl::context& shared_ssl_ctx = get_shared_ssl_context();
-
-        std::cout << "Launching deepseek_session..." << std::endl;
-        std::make_shared<deepseek_session>(
-            conn.socket().get_executor(),
-            shared_ssl_ctx,
-            conn.shared_from_this()
-        )->run("/chat/completions", deepseek_request_body.dump(), api_key);
+        launch_ai_chat(conn, model, std::move(request_body["messages"]), stream, {});
         std::cout << "Exiting handle_ai_chat handler function (async request launched)." << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error in handle_ai_chat setup: " << e.what() << std::endl;
-        if (!response_sent_flag) {
+        if (!response_sent_flag && !conn.response_sent()) {
             try {
                 send_json_error(conn, http::status::internal_server_error, "Internal Server Error", e.what());
             } catch (...) { }
         }
     } catch (...) {
         std::cerr << "Unknown exception during handle_ai_chat setup" << std::endl;
-        if (!response_sent_flag) {
+        if (!response_sent_flag && !conn.response_sent()) {
             try {
                 send_json_error(conn, http::status::internal_server_error, "Unknown Internal Error");
             } catch (...) { }
@@ -1077,17 +1767,513 @@ inline void handle_ai_chat(http_connection &conn) {
 
 
 
+// Path id of /geecodex/books/score/<id> and /geecodex/books/comment/<id>;
+// 0 when it is not a positive integer.
+inline int book_id_from_path(http_connection& conn) {
+    int book_id = 0;
+    const std::string id = conn.path_param("filepath");
+    auto [ptr, ec] = std::from_chars(id.data(), id.data() + id.size(), book_id);
+    if (ec != std::errc() || ptr != id.data() + id.size() || book_id <= 0) return 0;
+    return book_id;
+}
+
+// Replies 503/404 itself unless `book_id` is an active book of the catalog.
+inline bool require_active_book(http_connection& conn, int book_id) {
+    auto books = catalog::get_book_catalog().snapshot();
+    if (!books) {
+        send_json_error(conn, http::status::service_unavailable, "Book catalog is not loaded yet");
+        return false;
+    }
+    auto book = books->find(book_id);
+    if (!book || !book->is_active) {
+        send_json_error(conn, http::status::not_found, "Book not found");
+        return false;
+    }
+    return true;
+}
+
+// POST /geecodex/books/score/<id> with {"user_id": "...", "score": 1-5}.
+// One rating per user and book; rating again replaces the earlier score.
+// user_id is any stable client identifier and is only kept hashed.
 inline void handle_score_book(http_connection &conn) {
+    try {
+        const int book_id = book_id_from_path(conn);
+        if (book_id == 0) {
+            send_json_error(conn, http::status::bad_request, "Invalid book ID format");
+            return;
+        }
 
+        json request_body;
+        try {
+            request_body = json::parse(conn.request().body());
+        } catch (const json::parse_error& e) {
+            send_json_error(conn, http::status::bad_request, "Invalid JSON format", e.what());
+            return;
+        }
+        if (!request_body.is_object() ||
+            !request_body.contains("user_id") || !request_body["user_id"].is_string() ||
+            !request_body.contains("score") || !request_body["score"].is_number_integer()) {
+            send_json_error(conn, http::status::bad_request, "Missing or invalid fields", "Requires 'user_id' (string) and 'score' (integer 1-5)");
+            return;
+        }
+        const std::string user = request_body["user_id"];
+        const auto score = request_body["score"].get<long long>();
+        if (user.empty() || user.size() > 128 || score < 1 || score > 5) {
+            send_json_error(conn, http::status::bad_request, "Missing or invalid fields", "'user_id' must be 1-128 characters and 'score' 1-5");
+            return;
+        }
+
+        if (!require_active_book(conn, book_id)) return;
+        if (book_id >= catalog::book_ratings::max_book_id) {
+            send_json_error(conn, http::status::not_found, "Book not found");
+            return;
+        }
+
+        auto& ratings = catalog::get_book_ratings();
+        const auto outcome = ratings.rate(book_id, user, static_cast<int>(score));
+        if (outcome == catalog::rating_outcome::rejected) {
+            send_json_error(conn, http::status::service_unavailable, "Too many ratings waiting to be saved", "Try again shortly");
+            return;
+        }
+
+        json body;
+        body["book_id"] = book_id;
+        body["score"] = score;
+        body["outcome"] = outcome == catalog::rating_outcome::added ? "added" : outcome == catalog::rating_outcome::changed ? "changed" : "unchanged";
+        auto rating = ratings.summary(book_id);
+        body["rating"] = rating ? rating_json(*rating, true) : json(nullptr);
+        send_json_reply(conn, http::status::ok, body.dump());
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_score_book: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
 }
 
+// POST /geecodex/books/comment/<id> with {"content": "...", "name": "..."}
+// (name optional). Answers 201 with the stored comment once the batch it
+// joined has committed.
 inline void handle_comment_book(http_connection &conn) {
+    try {
+        const int book_id = book_id_from_path(conn);
+        if (book_id == 0) {
+            send_json_error(conn, http::status::bad_request, "Invalid book ID format");
+            return;
+        }
+
+        json request_body;
+        try {
+            request_body = json::parse(conn.request().body());
+        } catch (const json::parse_error& e) {
+            send_json_error(conn, http::status::bad_request, "Invalid JSON format", e.what());
+            return;
+        }
+        if (!request_body.is_object() || !request_body.contains("content") || !request_body["content"].is_string() ||
+            (request_body.contains("name") && !request_body["name"].is_string() && !request_body["name"].is_null())) {
+            send_json_error(conn, http::status::bad_request, "Missing or invalid fields", "Requires 'content' (string); 'name' (string) is optional");
+            return;
+        }
+        std::string content = boost::algorithm::trim_copy(request_body["content"].get<std::string>());
+        std::optional<std::string> name;
+        if (request_body.contains("name") && request_body["name"].is_string())
+            name = boost::algorithm::trim_copy(request_body["name"].get<std::string>());
+        if (name && name->empty()) name.reset();
+        // Postgres text cannot hold NUL, and one such row would fail the whole batch.
+        if (content.empty() || content.size() > 4000 || (name && name->size() > 64) ||
+            content.find('\0') != std::string::npos || (name && name->find('\0') != std::string::npos)) {
+            send_json_error(conn, http::status::bad_request, "Missing or invalid fields", "'content' must be 1-4000 bytes and 'name' at most 64, without NUL characters");
+            return;
+        }
+        if (!require_active_book(conn, book_id)) return;
+
+        auto waiting_conn = conn.shared_from_this();
+        conn.defer_response();
+        const bool queued = catalog::get_book_comments().post(book_id, std::move(name), std::move(content),
+            [waiting_conn](std::exception_ptr error, const catalog::book_comment& comment) {
+                bool missing = false;
+                if (error) {
+                    try { std::rethrow_exception(error); }
+                    catch (const catalog::comment_book_missing&) { missing = true; }
+                    catch (...) {}
+                }
+                json body;
+                if (!error) {
+                    body["id"] = comment.id;
+                    body["book_id"] = comment.book_id;
+                    body["name"] = comment.name ? json(*comment.name) : json(nullptr);
+                    body["content"] = comment.content;
+                    body["created_at"] = comment.created_at;
+                }
+                net::post(waiting_conn->socket().get_executor(), [waiting_conn, failed = static_cast<bool>(error), missing, body = body.dump()]() mutable {
+                    if (missing) return send_json_error(*waiting_conn, http::status::not_found, "Book not found");
+                    if (failed) return send_json_error(*waiting_conn, http::status::internal_server_error, "Failed to save comment");
+                    send_json_reply(*waiting_conn, http::status::created, std::move(body));
+                });
+            });
+        if (!queued) send_json_error(conn, http::status::service_unavailable, "Too many comments waiting to be saved", "Try again shortly");
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_comment_book: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
+
+// GET /geecodex/books/comment/<id>?limit=&cursor= lists comments newest
+// first; next_cursor in the reply fetches the following page.
+inline void handle_list_book_comments(http_connection &conn) {
+    try {
+        const int book_id = book_id_from_path(conn);
+        if (book_id == 0) {
+            send_json_error(conn, http::status::bad_request, "Invalid book ID format");
+            return;
+        }
+        auto& comments = catalog::get_book_comments();
+        const auto& query = conn.query();
+        const auto limit = static_cast<std::size_t>(query.get_int("limit", static_cast<long long>(comments.config().page_size), 1,
+                                                                  static_cast<long long>(comments.config().max_page_size)));
+        std::optional<catalog::book_key> after;
+        if (auto cursor = query.get("cursor"); cursor && !cursor->empty()) {
+            after = catalog::keyset_cursor::decode(*cursor);
+            if (!after) {
+                send_json_error(conn, http::status::bad_request, "Invalid cursor", "Pass next_cursor from a previous reply unchanged");
+                return;
+            }
+        }
+        if (!require_active_book(conn, book_id)) return;
+
+        auto waiting_conn = conn.shared_from_this();
+        conn.defer_response();
+        comments.page(book_id, after, limit, [waiting_conn](std::exception_ptr error, std::shared_ptr<const std::string> body) {
+            net::post(waiting_conn->socket().get_executor(), [waiting_conn, error, body]() {
+                if (error || !body) return send_json_error(*waiting_conn, http::status::internal_server_error, "Failed to load comments");
+                send_json_reply(*waiting_conn, http::status::ok, *body);
+            });
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_list_book_comments: " << e.what() << std::endl;
+        send_json_error(conn, http::status::internal_server_error, "Internal server error", e.what());
+    }
+}
+
+
+// Outcome of one recognition, whoever asked for it: the HTTP status and JSON
+// body a synchronous request replies with, and whether the cache answered.
+struct recognition_outcome {
+    unsigned status = 200;
+    std::string body;
+    bool cached = false;
+};
+using recognition_done = std::function<void(recognition_outcome)>;
+
+inline std::string recognition_error_body(const std::string& error, const std::string& message) {
+    json body;
+    body["error"] = error;
+    if (!message.empty()) body["message"] = message;
+    return body.dump();
+}
+
+// Runs inference for a cache miss: the in-process engine when `workers` is
+// null, the formula_service workers otherwise. `done` runs on an inference
+// or worker-connection thread, or inline when the backend refuses the job.
+inline void infer_formula(recognition::formula_worker_pool* workers,
+                          recognition::image_key key,
+                          recognition::formula_worker_pool::upload upload,
+                          std::shared_ptr<std::atomic<bool>> abandoned,
+                          recognition_done done) {
+    auto started = std::chrono::steady_clock::now();
+    auto elapsed = [started] {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+    };
+
+    if (workers) {
+        auto shared_done = std::make_shared<recognition_done>(std::move(done));
+        bool queued = workers->submit(std::move(upload), std::move(abandoned), [shared_done, key = std::move(key), elapsed](recognition::worker_reply reply) {
+            if (reply.status == 200) recognition::get_recognition_cache().put(key, reply.body, elapsed());
+            (*shared_done)({reply.status == 0 ? 502u : reply.status, std::move(reply.body)});
+        });
+        if (!queued) (*shared_done)({503, recognition_error_body("Recognition Busy", "All recognition workers are busy")});
+        return;
+    }
+
+    auto shared_done = std::make_shared<recognition_done>(std::move(done));
+    try {
+        recognition::get_formula_batcher().submit(std::move(upload.image), std::move(abandoned),
+            [shared_done, key = std::move(key), elapsed](std::optional<std::string> latex, std::exception_ptr error) {
+                if (error) {
+                    unsigned status = 500;
+                    std::string message;
+                    try {
+                        std::rethrow_exception(error);
+                    } catch (const recognition::recognition_error& e) {
+                        using kind = recognition::recognition_error::kind;
+                        status = e.error_kind() == kind::bad_image ? 400 : e.error_kind() == kind::unavailable ? 503 : 500;
+                        message = e.what();
+                    } catch (const std::exception& e) {
+                        message = e.what();
+                    }
+                    return (*shared_done)({status, recognition_error_body("Recognition Failed", message)});
+                }
+                if (!latex || latex->empty()) return (*shared_done)({422, recognition_error_body("No formula recognized", "")});
+
+                json reply;
+                reply["latex_formulas"] = json::array({*latex});
+                std::string body = reply.dump();
+                recognition::get_recognition_cache().put(key, body, elapsed());
+                (*shared_done)({200, std::move(body)});
+            });
+    } catch (const recognition::recognition_error& e) {
+        (*shared_done)({503, recognition_error_body("Recognition Busy", e.what())});
+    }
+}
+
+// Cache (memory, then the database when enabled), then inference. The image
+// is hashed on the image hash pool; the rest continues on `executor`.
+inline void recognize_formula(net::any_io_executor executor,
+                              recognition::formula_worker_pool* workers,
+                              recognition::formula_worker_pool::upload upload,
+                              std::shared_ptr<std::atomic<bool>> abandoned,
+                              recognition_done done) {
+    net::post(recognition::get_image_hash_pool(),
+        [executor, workers, upload = std::move(upload), abandoned = std::move(abandoned), done = std::move(done)]() mutable {
+            auto& cache = recognition::get_recognition_cache();
+            recognition::image_key key;
+            std::optional<std::string> cached;
+            try {
+                key = cache.key_for(upload.image);
+                cached = cache.find(key, upload.image);
+            } catch (const std::exception& e) {
+                return done({500, recognition_error_body("Recognition Failed", e.what())});
+            }
+            net::post(executor,
+                [executor, workers, key = std::move(key), cached = std::move(cached), upload = std::move(upload),
+                 abandoned = std::move(abandoned), done = std::move(done)]() mutable {
+                    auto& cache = recognition::get_recognition_cache();
+                    if (cached) return done({200, std::move(*cached), true});
+                    if (!cache.db_enabled()) return infer_formula(workers, std::move(key), std::move(upload), std::move(abandoned), std::move(done));
+
+                    cache.load(executor, key,
+                        [workers, key, upload = std::move(upload), abandoned = std::move(abandoned), done = std::move(done)](std::optional<std::string> cached) mutable {
+                            if (cached) return done({200, std::move(*cached), true});
+                            if (abandoned && *abandoned) return;
+                            infer_formula(workers, std::move(key), std::move(upload), std::move(abandoned), std::move(done));
+                        });
+                });
+        });
+}
 
+// Picks the backend for new recognitions: false when there is none, else
+// `workers` is null for the in-process engine or the worker pool to use.
+inline bool select_recognition_backend(net::any_io_executor executor, recognition::formula_worker_pool*& workers) {
+    workers = nullptr;
+    if (recognition::get_formula_engine().available()) return true;
+    workers = &recognition::get_formula_worker_pool(std::move(executor));
+    return workers->enabled();
 }
 
+// The image of a recognition request: the `image_file` (or first file) part
+// of a multipart upload, or the raw body. Replies with an error and returns
+// false when there is no usable image.
+inline bool take_recognition_upload(http_connection& conn, recognition::formula_worker_pool::upload& out) {
+    if (auto* upload = conn.upload()) {
+        auto* part = upload->find("image_file");
+        if (!part) part = upload->find();
+        if (!part || part->size() == 0) {
+            send_json_error(conn, http::status::bad_request, "Invalid request", "Upload must contain an image file part");
+            return false;
+        }
+        if (!part->content_type.empty() && !part->content_type.starts_with("image/") && part->content_type != "application/octet-stream") {
+            send_json_error(conn, http::status::unsupported_media_type, "Invalid request", "Unsupported content type: " + part->content_type);
+            return false;
+        }
+        if (!part->filename.empty()) out.filename = part->filename;
+        if (!part->content_type.empty()) out.content_type = part->content_type;
+        out.image = part->take();
+    } else out.image = std::move(conn.request().body());
+
+    if (out.image.empty()) {
+        send_json_error(conn, http::status::bad_request, "Invalid request", "Request body must contain an image");
+        return false;
+    }
+    return true;
+}
 
+// POST /geecodex/recognize with the image either as the raw request body or
+// as the `image_file` (or first file) part of a multipart/form-data upload.
+// Replies {"latex_formulas": [...]} like formula_rec/formula_service.py did.
+// Uses the in-process engine when it is loaded, otherwise the formula_service
+// workers listed in GEECODEX_FORMULA_WORKERS. Images recognized before are
+// answered from the recognition cache.
 inline void handle_content_recognize(http_connection &conn) {
+    try {
+        std::cout << "Handling content recognize request" << std::endl;
+        recognition::formula_worker_pool* workers = nullptr;
+        if (!select_recognition_backend(conn.socket().get_executor(), workers)) {
+            send_json_error(conn, http::status::service_unavailable, "Recognition Unavailable", recognition::get_formula_engine().status());
+            return;
+        }
 
+        recognition::formula_worker_pool::upload upload;
+        if (!take_recognition_upload(conn, upload)) return;
+
+        // The client may leave while the job is queued; its batch then skips
+        // it. A request already sent to a worker is aborted.
+        auto abandoned = std::make_shared<std::atomic<bool>>(false);
+        auto slot = conn.cancellation_slot();
+        if (slot.is_connected()) slot.assign([abandoned, workers](net::cancellation_type) {
+            *abandoned = true;
+            if (workers) workers->cancel(abandoned);
+        });
+
+        auto waiting_conn = conn.shared_from_this();
+        conn.defer_response();
+        recognize_formula(conn.socket().get_executor(), workers, std::move(upload), abandoned,
+            [waiting_conn](recognition_outcome outcome) {
+                net::post(waiting_conn->socket().get_executor(), [waiting_conn, outcome = std::move(outcome)]() mutable {
+                    if (waiting_conn->client_gone()) return;
+                    send_json_reply(*waiting_conn, static_cast<http::status>(outcome.status), std::move(outcome.body),
+                                    {{"X-Recognition-Cache", outcome.cached ? "hit" : "miss"}});
+                });
+            });
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_content_recognize: " << e.what() << std::endl;
+        if (!conn.response_sent()) send_json_error(conn, http::status::internal_server_error, "Internal Server Error", e.what());
+    }
+}
+
+// Jobs run through the same cache -> engine / workers path as synchronous
+// recognitions; the backend is chosen when a job leaves the queue.
+inline recognition::recognition_jobs& get_recognition_jobs(net::any_io_executor executor) {
+    static recognition::recognition_jobs instance{
+        [executor](recognition::formula_worker_pool::upload upload, recognition::recognition_jobs::completion done) {
+            recognition::formula_worker_pool* workers = nullptr;
+            if (!select_recognition_backend(executor, workers)) {
+                done({503, recognition_error_body("Recognition Unavailable", recognition::get_formula_engine().status())});
+                return;
+            }
+            recognize_formula(executor, workers, std::move(upload), nullptr, [done = std::move(done)](recognition_outcome outcome) {
+                done({outcome.status, std::move(outcome.body)});
+            });
+        }};
+    return instance;
+}
+
+inline std::string recognition_job_json(const std::string& id, const recognition::recognition_jobs::snapshot& job) {
+    json body;
+    body["job_id"] = id;
+    body["priority"] = recognition::to_string(job.priority);
+    body["age_ms"] = job.age_ms;
+    if (!job.result) {
+        body["status"] = recognition::to_string(job.current);
+        if (job.current == recognition::recognition_jobs::state::queued) body["queue_position"] = job.queue_position;
+        return body.dump();
+    }
+    body["status"] = job.result->status == 200 ? "done" : "failed";
+    body["http_status"] = job.result->status;
+    body["run_ms"] = job.run_ms;
+    auto parsed = json::parse(job.result->body, nullptr, false);
+    body[job.result->status == 200 ? "result" : "error"] = parsed.is_discarded() ? json(job.result->body) : std::move(parsed);
+    return body.dump();
+}
+
+// POST /geecodex/recognize/jobs[?priority=high|normal|low] with the same body
+// as /geecodex/recognize. Answers 202 with the job id at once.
+inline void handle_recognize_job_submit(http_connection& conn) {
+    try {
+        std::cout << "Handling recognition job submit" << std::endl;
+        recognition::formula_worker_pool* workers = nullptr;
+        if (!select_recognition_backend(conn.socket().get_executor(), workers)) {
+            send_json_error(conn, http::status::service_unavailable, "Recognition Unavailable", recognition::get_formula_engine().status());
+            return;
+        }
+        auto priority = recognition::parse_job_priority(conn.query().get_or("priority", ""));
+        if (!priority) {
+            send_json_error(conn, http::status::bad_request, "Invalid request", "priority must be high, normal or low");
+            return;
+        }
+
+        recognition::formula_worker_pool::upload upload;
+        if (!take_recognition_upload(conn, upload)) return;
+
+        auto& jobs = get_recognition_jobs(conn.socket().get_executor());
+        auto id = jobs.submit(std::move(upload), *priority);
+        if (!id) {
+            send_json_reply(conn, http::status::service_unavailable,
+                            recognition_error_body("Recognition Busy", "Too many recognition jobs"), {{"Retry-After", "1"}});
+            return;
+        }
+
+        std::string location = "/geecodex/recognize/jobs/" + *id;
+        json body;
+        body["job_id"] = *id;
+        body["status"] = "queued";
+        body["poll"] = location;
+        send_json_reply(conn, http::status::accepted, body.dump(), {{"Location", location}});
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_recognize_job_submit: " << e.what() << std::endl;
+        if (!conn.response_sent()) send_json_error(conn, http::status::internal_server_error, "Internal Server Error", e.what());
+    }
+}
+
+// GET /geecodex/recognize/jobs/:id[?wait=seconds]. With `wait` (at most 30)
+// the reply is held until the job finishes or the wait runs out.
+inline void handle_recognize_job_status(http_connection& conn) {
+    try {
+        auto id = conn.path_param("id");
+        if (!utils::is_hex_id<16>(id)) {
+            send_json_error(conn, http::status::bad_request, "Invalid request", "Malformed job id");
+            return;
+        }
+        auto& jobs = get_recognition_jobs(conn.socket().get_executor());
+        auto job = jobs.find(id);
+        if (!job) {
+            send_json_error(conn, http::status::not_found, "Not Found", "Unknown or expired job");
+            return;
+        }
+        const auto wait = std::chrono::seconds{conn.query().get_int("wait", 0, 0, 30)};
+        if (job->result || wait.count() == 0) {
+            send_json_reply(conn, http::status::ok, recognition_job_json(id, *job));
+            return;
+        }
+
+        // Long poll: whichever of "job done" and "timer expired" comes first
+        // answers; both run on the connection's executor. Neither the job
+        // nor the timer keeps the connection alive (the disconnect watch does
+        // while the client is there); when the client leaves, the timer is
+        // cancelled and the waiter removed. A timed-out poll removes its
+        // waiter too.
+        auto executor = conn.socket().get_executor();
+        std::weak_ptr<http_connection> weak_conn = conn.shared_from_this();
+        auto answered = std::make_shared<bool>(false);
+        auto timer = std::make_shared<net::steady_timer>(executor, wait);
+        auto answer = [weak_conn, answered, timer, id] {
+            auto waiting = weak_conn.lock();
+            if (!waiting || *answered || waiting->client_gone()) return;
+            *answered = true;
+            timer->cancel();
+            auto latest = get_recognition_jobs(waiting->socket().get_executor()).find(id);
+            if (!latest) return send_json_error(*waiting, http::status::not_found, "Not Found", "Unknown or expired job");
+            send_json_reply(*waiting, http::status::ok, recognition_job_json(id, *latest));
+        };
+
+        conn.defer_response();
+        const auto token = jobs.on_done(id, [weak_conn, answer] {
+            if (auto waiting = weak_conn.lock()) net::post(waiting->socket().get_executor(), answer);
+        });
+        timer->async_wait([executor, answer, id, token](beast::error_code ec) {
+            if (ec == net::error::operation_aborted) return;
+            if (token != 0) get_recognition_jobs(executor).forget_waiter(id, token);
+            answer();
+        });
+        if (auto slot = conn.cancellation_slot(); slot.is_connected()) {
+            slot.assign([executor, answered, timer, id, token](net::cancellation_type) {
+                if (*answered) return;
+                *answered = true;
+                timer->cancel();
+                if (token != 0) get_recognition_jobs(executor).forget_waiter(id, token);
+            });
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error in handle_recognize_job_status: " << e.what() << std::endl;
+        if (!conn.response_sent()) send_json_error(conn, http::status::internal_server_error, "Internal Server Error", e.what());
+    }
 }
 
 
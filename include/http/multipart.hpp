@@ -0,0 +1,382 @@
+#ifndef MULTIPART_HPP
+#define MULTIPART_HPP
+
+#include <utils/env.hpp>
+
+#include <boost/asio/thread_pool.hpp>
+#include <boost/beast/http/status.hpp>
+
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+namespace geecodex::http {
+namespace beast = boost::beast;
+
+struct upload_limits {
+    std::size_t max_total_bytes = 16 * 1024 * 1024;
+    std::size_t max_part_bytes = 8 * 1024 * 1024;
+    std::size_t spill_threshold = 1024 * 1024;  // larger parts move to a temp file
+    std::size_t spill_write_bytes = 64 * 1024;  // buffered before a spill write is handed to the file thread
+    std::size_t max_header_bytes = 8 * 1024;
+    std::size_t max_parts = 16;
+    std::string spill_dir;                      // empty: std::filesystem::temp_directory_path()
+
+    // GEECODEX_UPLOAD_MAX_BYTES, GEECODEX_UPLOAD_MAX_PART_BYTES,
+    // GEECODEX_UPLOAD_SPILL_BYTES and GEECODEX_UPLOAD_DIR.
+    static upload_limits from_env() {
+        upload_limits limits;
+        limits.max_total_bytes = static_cast<std::size_t>(utils::env_int("GEECODEX_UPLOAD_MAX_BYTES", static_cast<long long>(limits.max_total_bytes)));
+        limits.max_part_bytes = static_cast<std::size_t>(utils::env_int("GEECODEX_UPLOAD_MAX_PART_BYTES", static_cast<long long>(limits.max_part_bytes)));
+        limits.spill_threshold = static_cast<std::size_t>(utils::env_int("GEECODEX_UPLOAD_SPILL_BYTES", static_cast<long long>(limits.spill_threshold)));
+        limits.spill_dir = utils::env_string("GEECODEX_UPLOAD_DIR");
+        return limits;
+    }
+};
+
+inline const upload_limits& get_upload_limits() {
+    static const upload_limits limits = upload_limits::from_env();
+    return limits;
+}
+
+// Thread the spill files are written and read back on, so a slow disk
+// never stalls the I/O threads.
+inline boost::asio::thread_pool& get_upload_file_pool() {
+    static boost::asio::thread_pool pool{1};
+    return pool;
+}
+
+// Rejection of a malformed or oversized upload; carries the reply status.
+class upload_error: public std::runtime_error {
+public:
+    upload_error(beast::http::status status, const std::string& message): std::runtime_error(message), m_status{status} {}
+    [[nodiscard]] beast::http::status status() const { return m_status; }
+
+private:
+    beast::http::status m_status;
+};
+
+// `boundary` parameter of a multipart/form-data Content-Type, or nullopt.
+inline std::optional<std::string> multipart_boundary(std::string_view content_type) {
+    auto semicolon = content_type.find(';');
+    std::string media{content_type.substr(0, semicolon)};
+    for (auto& c: media) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    while (!media.empty() && media.back() == ' ') media.pop_back();
+    if (media != "multipart/form-data" || semicolon == std::string_view::npos) return std::nullopt;
+
+    auto params = content_type.substr(semicolon + 1);
+    auto at = params.find("boundary=");
+    if (at == std::string_view::npos) return std::nullopt;
+    auto value = params.substr(at + 9);
+    value = value.substr(0, value.find(';'));
+    if (!value.empty() && value.front() == '"') {
+        value.remove_prefix(1);
+        value = value.substr(0, value.find('"'));
+    }
+    while (!value.empty() && value.back() == ' ') value.remove_suffix(1);
+    if (value.empty() || value.size() > 70) return std::nullopt;
+    return std::string{value};
+}
+
+// One received form field or file. Its bytes are copied once out of the
+// received chunks into a buffer. While the body arrives, a part above the
+// spill threshold is moved to a temp file in spill_write_bytes pieces by
+// write_spill(), so a slow client holding a large upload costs disk rather
+// than memory. finish() reads it back; handlers always see the whole part
+// in memory. File work happens only in write_spill() and finish(), which
+// the connection runs on get_upload_file_pool().
+class upload_part {
+public:
+    std::string name;
+    std::string filename;
+    std::string content_type;
+
+    upload_part() = default;
+    upload_part(upload_part&& other) noexcept { *this = std::move(other); }
+    upload_part& operator=(upload_part&& other) noexcept {
+        if (this == &other) return *this;
+        remove_spill();
+        name = std::move(other.name);
+        filename = std::move(other.filename);
+        content_type = std::move(other.content_type);
+        m_memory = std::move(other.m_memory);
+        m_spill_path = std::move(other.m_spill_path);
+        m_spill = std::move(other.m_spill);
+        m_size = other.m_size;
+        other.m_spill_path.clear();
+        return *this;
+    }
+    upload_part(const upload_part&) = delete;
+    upload_part& operator=(const upload_part&) = delete;
+    ~upload_part() { remove_spill(); }
+
+    [[nodiscard]] std::size_t size() const { return m_size; }
+    [[nodiscard]] bool spilled() const { return !m_spill_path.empty(); }
+
+    // Contents once the upload finished.
+    [[nodiscard]] std::string_view view() const { return m_memory; }
+
+    // Contents once the upload finished; moves them out of the part.
+    std::string take() { return std::move(m_memory); }
+
+    void append(std::string_view data, const upload_limits& limits) {
+        if (m_size + data.size() > limits.max_part_bytes)
+            throw upload_error(beast::http::status::payload_too_large, "Upload part exceeds " + std::to_string(limits.max_part_bytes) + " bytes");
+        m_memory.append(data);
+        m_size += data.size();
+    }
+
+    // Whether enough of a large part is buffered to hand to write_spill().
+    [[nodiscard]] bool spill_due(const upload_limits& limits) const {
+        return m_size > limits.spill_threshold && m_memory.size() >= limits.spill_write_bytes;
+    }
+
+    // Blocking: moves the buffered bytes of a large part to its spill file.
+    void write_spill(const upload_limits& limits) {
+        if (m_size <= limits.spill_threshold || m_memory.empty()) return;
+        const bool first = !spilled();
+        if (first) open_spill(limits);
+        m_spill.write(m_memory.data(), static_cast<std::streamsize>(m_memory.size()));
+        if (!m_spill) throw upload_error(beast::http::status::internal_server_error, "Cannot write upload spill file");
+        m_memory.clear();
+        if (first) {
+            m_memory.shrink_to_fit();       // drop the pre-spill buffer, keep one write's worth
+            m_memory.reserve(limits.spill_write_bytes);
+        }
+    }
+
+    // Blocking: writes what is still buffered and reads a spilled part back.
+    void finish() {
+        if (!spilled()) return;
+        m_spill.write(m_memory.data(), static_cast<std::streamsize>(m_memory.size()));
+        m_spill.close();
+        if (!m_spill) throw upload_error(beast::http::status::internal_server_error, "Cannot write upload spill file");
+
+        std::ifstream in(m_spill_path, std::ios::binary);
+        std::string data(m_size, '\0');
+        in.read(data.data(), static_cast<std::streamsize>(m_size));
+        if (!in) throw upload_error(beast::http::status::internal_server_error, "Cannot read spilled upload part");
+        m_memory = std::move(data);
+        remove_spill();
+    }
+
+private:
+    std::string m_memory;       // whole part, or the tail not yet spilled
+    std::filesystem::path m_spill_path;
+    std::ofstream m_spill;
+    std::size_t m_size = 0;
+
+    void open_spill(const upload_limits& limits) {
+        static std::atomic<std::uint64_t> sequence{0};
+        std::filesystem::path dir = limits.spill_dir.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path{limits.spill_dir};
+        m_spill_path = dir / ("geecodex_upload_" + std::to_string(::getpid()) + "_" + std::to_string(sequence++));
+        m_spill.open(m_spill_path, std::ios::binary | std::ios::trunc);
+        if (!m_spill) {
+            m_spill_path.clear();
+            throw upload_error(beast::http::status::internal_server_error, "Cannot create upload spill file");
+        }
+    }
+
+    void remove_spill() {
+        if (m_spill_path.empty()) return;
+        if (m_spill.is_open()) m_spill.close();
+        std::error_code ec;
+        std::filesystem::remove(m_spill_path, ec);
+        m_spill_path.clear();
+    }
+};
+
+// Incremental multipart/form-data decoder. feed() takes body bytes as they
+// arrive in arbitrary pieces and copies part data from the chunk into its
+// part; besides that only a possible partial delimiter (< boundary length
+// + 4 bytes) and the part headers are held. feed() never touches the disk:
+// when spill_due() holds the caller runs write_spills(), and finish(), on a
+// thread that may block. Limits are checked as bytes arrive, so an
+// oversized upload fails on its first excess chunk.
+class multipart_upload {
+public:
+    multipart_upload(std::string boundary, const upload_limits& limits)
+        : m_delimiter{"\r\n--" + std::move(boundary)}
+        , m_limits{limits}
+        , m_pending{"\r\n"} {}   // the first delimiter has no leading CRLF
+
+    void feed(std::string_view chunk) {
+        m_total += chunk.size();
+        if (m_total > m_limits.max_total_bytes)
+            throw upload_error(beast::http::status::payload_too_large, "Upload exceeds " + std::to_string(m_limits.max_total_bytes) + " bytes");
+
+        std::size_t i = 0;
+        while (i < chunk.size()) {
+            switch (m_state) {
+                case state::preamble:
+                case state::body:
+                    i = scan_body(chunk, i);
+                    break;
+                case state::after_delimiter: {
+                    m_line.push_back(chunk[i++]);
+                    if (m_line.size() < 2) break;
+                    if (m_line == "--") m_state = state::done;
+                    else if (m_line == "\r\n") {
+                        if (m_parts.size() >= m_limits.max_parts) throw upload_error(beast::http::status::payload_too_large, "Too many upload parts");
+                        m_parts.emplace_back();
+                        m_state = state::headers;
+                    } else throw upload_error(beast::http::status::bad_request, "Malformed multipart delimiter");
+                    m_line.clear();
+                    break;
+                }
+                case state::headers: {
+                    m_line.push_back(chunk[i++]);
+                    if (m_line.size() > m_limits.max_header_bytes) throw upload_error(beast::http::status::bad_request, "Multipart part headers too large");
+                    if (m_line.size() >= 4 && m_line.compare(m_line.size() - 4, 4, "\r\n\r\n") == 0) {
+                        parse_part_headers(m_line);
+                        m_line.clear();
+                        m_state = state::body;
+                    }
+                    break;
+                }
+                case state::done:
+                    return;     // epilogue is ignored
+            }
+        }
+    }
+
+    [[nodiscard]] bool spill_due() const {
+        return !m_parts.empty() && m_parts.back().spill_due(m_limits);
+    }
+
+    // Blocking: see upload_part::write_spill().
+    void write_spills() {
+        for (auto& part: m_parts) part.write_spill(m_limits);
+    }
+
+    // Blocking; call once the request body is complete. Afterwards every
+    // part is in memory.
+    void finish() {
+        if (m_state != state::done) throw upload_error(beast::http::status::bad_request, "Multipart body ended before the closing delimiter");
+        for (auto& part: m_parts) part.finish();
+    }
+
+    [[nodiscard]] std::vector<upload_part>& parts() { return m_parts; }
+    [[nodiscard]] std::size_t total_bytes() const { return m_total; }
+
+    // First part with the given form name, or the first file part when empty.
+    upload_part* find(std::string_view name = {}) {
+        for (auto& part: m_parts)
+            if (name.empty() ? !part.filename.empty() : part.name == name) return &part;
+        return nullptr;
+    }
+
+private:
+    enum class state { preamble, after_delimiter, headers, body, done };
+
+    std::string m_delimiter;
+    const upload_limits& m_limits;
+    state m_state = state::preamble;
+    std::string m_pending;      // tail that may be the start of a delimiter
+    std::string m_line;
+    std::vector<upload_part> m_parts;
+    std::size_t m_total = 0;
+
+    void emit(std::string_view data) {
+        if (m_state == state::body && !data.empty()) m_parts.back().append(data, m_limits);
+    }
+
+    // Longest suffix of `data` that is a proper prefix of the delimiter.
+    std::size_t partial_delimiter_suffix(std::string_view data) const {
+        std::size_t longest = std::min(data.size(), m_delimiter.size() - 1);
+        for (std::size_t len = longest; len > 0; --len)
+            if (m_delimiter.compare(0, len, data.substr(data.size() - len)) == 0) return len;
+        return 0;
+    }
+
+    std::size_t scan_body(std::string_view chunk, std::size_t i) {
+        std::string_view rest = chunk.substr(i);
+
+        // A delimiter may have started at the end of the previous chunk.
+        if (!m_pending.empty()) {
+            std::string_view pending{m_pending};
+            for (std::size_t k = 0; k < pending.size(); ++k) {
+                auto head = pending.substr(k);
+                if (m_delimiter.compare(0, head.size(), head) != 0) continue;
+                auto needed = m_delimiter.size() - head.size();
+                auto available = std::min(needed, rest.size());
+                if (m_delimiter.compare(head.size(), available, rest.substr(0, available)) != 0) continue;
+
+                emit(pending.substr(0, k));
+                if (available < needed) {
+                    m_pending = std::string{head} + std::string{rest};
+                    return chunk.size();
+                }
+                m_pending.clear();
+                m_state = state::after_delimiter;
+                return i + needed;
+            }
+            emit(pending);
+            m_pending.clear();
+        }
+
+        auto pos = rest.find(m_delimiter);
+        if (pos != std::string_view::npos) {
+            emit(rest.substr(0, pos));
+            m_state = state::after_delimiter;
+            return i + pos + m_delimiter.size();
+        }
+        auto keep = partial_delimiter_suffix(rest);
+        emit(rest.substr(0, rest.size() - keep));
+        m_pending.assign(rest.substr(rest.size() - keep));
+        return chunk.size();
+    }
+
+    static std::string header_param(std::string_view value, std::string_view key) {
+        std::string needle = std::string{key} + "=";
+        std::size_t at = 0;
+        while ((at = value.find(needle, at)) != std::string_view::npos) {
+            // Skip matches inside another parameter name (e.g. filename= for name=).
+            if (at > 0 && value[at - 1] != ' ' && value[at - 1] != ';') {
+                at += needle.size();
+                continue;
+            }
+            auto v = value.substr(at + needle.size());
+            if (!v.empty() && v.front() == '"') {
+                v.remove_prefix(1);
+                return std::string{v.substr(0, v.find('"'))};
+            }
+            return std::string{v.substr(0, v.find(';'))};
+        }
+        return {};
+    }
+
+    void parse_part_headers(std::string_view block) {
+        auto& part = m_parts.back();
+        std::size_t start = 0;
+        while (start < block.size()) {
+            auto end = block.find("\r\n", start);
+            if (end == std::string_view::npos || end == start) break;
+            auto line = block.substr(start, end - start);
+            start = end + 2;
+
+            auto colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            std::string field{line.substr(0, colon)};
+            for (auto& c: field) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            auto value = line.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+
+            if (field == "content-disposition") {
+                part.name = header_param(value, "name");
+                part.filename = header_param(value, "filename");
+            } else if (field == "content-type") part.content_type = std::string{value};
+        }
+    }
+};
+
+}   // NAMESPACE GEECODEX::HTTP
+#endif // MULTIPART_HPP
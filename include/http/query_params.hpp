@@ -0,0 +1,98 @@
+#ifndef QUERY_PARAMS_HPP
+#define QUERY_PARAMS_HPP
+
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace geecodex::http {
+
+// "/path?query" -> "/path". Routing only ever looks at the path.
+[[nodiscard]] inline std::string_view target_path(std::string_view target) {
+    return target.substr(0, target.find('?'));
+}
+
+// Decoded `key=value` pairs of a request target's query string, in order.
+// '+' is a space and %XX escapes are decoded; malformed escapes are kept as is.
+class query_params {
+public:
+    query_params() = default;
+
+    explicit query_params(std::string_view target) {
+        auto question = target.find('?');
+        if (question == std::string_view::npos) return;
+        auto query = target.substr(question + 1);
+        if (auto hash = query.find('#'); hash != std::string_view::npos) query = query.substr(0, hash);
+
+        while (!query.empty()) {
+            auto amp = query.find('&');
+            auto pair = query.substr(0, amp);
+            query = amp == std::string_view::npos ? std::string_view{} : query.substr(amp + 1);
+            if (pair.empty()) continue;
+            auto eq = pair.find('=');
+            if (eq == std::string_view::npos) m_params.emplace_back(decode(pair), std::string{});
+            else m_params.emplace_back(decode(pair.substr(0, eq)), decode(pair.substr(eq + 1)));
+        }
+    }
+
+    [[nodiscard]] bool empty() const { return m_params.empty(); }
+    [[nodiscard]] bool has(std::string_view key) const { return find(key) != nullptr; }
+
+    // First value for `key`.
+    [[nodiscard]] std::optional<std::string> get(std::string_view key) const {
+        if (const auto* value = find(key)) return *value;
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::string get_or(std::string_view key, std::string_view fallback) const {
+        if (const auto* value = find(key)) return *value;
+        return std::string{fallback};
+    }
+
+    // Integer value clamped to [lo, hi]; `fallback` when missing or malformed.
+    [[nodiscard]] long long get_int(std::string_view key, long long fallback, long long lo, long long hi) const {
+        const auto* value = find(key);
+        if (!value) return fallback;
+        long long parsed = 0;
+        auto [ptr, ec] = std::from_chars(value->data(), value->data() + value->size(), parsed);
+        if (ec != std::errc() || ptr != value->data() + value->size()) return fallback;
+        return parsed < lo ? lo : parsed > hi ? hi : parsed;
+    }
+
+    [[nodiscard]] const std::vector<std::pair<std::string, std::string>>& all() const { return m_params; }
+
+private:
+    std::vector<std::pair<std::string, std::string>> m_params;
+
+    [[nodiscard]] const std::string* find(std::string_view key) const {
+        for (const auto& [k, v]: m_params)
+            if (k == key) return &v;
+        return nullptr;
+    }
+
+    static int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static std::string decode(std::string_view text) {
+        std::string out;
+        out.reserve(text.size());
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '+') out.push_back(' ');
+            else if (text[i] == '%' && i + 2 < text.size() && hex_value(text[i + 1]) >= 0 && hex_value(text[i + 2]) >= 0) {
+                out.push_back(static_cast<char>(hex_value(text[i + 1]) * 16 + hex_value(text[i + 2])));
+                i += 2;
+            } else out.push_back(text[i]);
+        }
+        return out;
+    }
+};
+
+}   // NAMESPACE GEECODEX::HTTP
+#endif // QUERY_PARAMS_HPP
@@ -65,12 +65,20 @@ to_string(http_method m) {
 enum class api_route {
     HELLO,
     HEALTH_CHECK,
+    SERVER_STATS,
     
     DOWNLOAD_PDF,
     
     FETCH_ALL_PDF_INFO,
     FETCH_PDF_COVER,
     FETCH_LATEST_BOOKS,
+    SEARCH_BOOKS,
+    SUGGEST_BOOKS,
+    TRENDING_BOOKS,
+    SIMILAR_BOOKS,
+    CATALOG_SNAPSHOT,
+    CATALOG_CHANGES,
+    BROWSE_BOOKS,
 
     APP_UPDATE_CHECK,
     APP_DOWNLOAD_LATEST,
@@ -79,9 +87,12 @@ enum class api_route {
     AI_CHAT,
     
     COMMENT_BOOK,
+    LIST_BOOK_COMMENTS,
     SCORE_BOOK,
     
     CONTENT_RECOGNIZE,
+    RECOGNIZE_JOB_SUBMIT,
+    RECOGNIZE_JOB_STATUS,
     UNKNOWN
 };
 
@@ -114,6 +125,12 @@ struct route_info {
 
 using route_handler_func = std::function<void(http_connection&)>;
 
+// Routes whose multipart/form-data bodies are decoded while they arrive
+// (http_connection::upload()) instead of being buffered into request().body().
+[[nodiscard]] constexpr bool streams_request_body(api_route r) {
+    return r == api_route::CONTENT_RECOGNIZE || r == api_route::RECOGNIZE_JOB_SUBMIT;
+}
+
 
 }   // NAMESPACE GEECODEX::HTTP
 #endif // ROUTER_DEFS_HPP
\ No newline at end of file
@@ -13,14 +13,30 @@ namespace geecodex::http {
 void handle_download_pdf(http_connection &conn);
 void handle_fetch_pdf_cover(http_connection &conn);
 void handle_fetch_latest_books(http_connection &conn);
+void handle_search_books(http_connection &conn);
+void handle_suggest_books(http_connection &conn);
+void handle_trending_books(http_connection &conn);
+void handle_similar_books(http_connection &conn);
+void handle_catalog_snapshot(http_connection &conn);
+void handle_catalog_changes(http_connection &conn);
+void handle_browse_books(http_connection &conn);
 void handle_comment_book(http_connection &conn);
+void handle_list_book_comments(http_connection &conn);
 void handle_score_book(http_connection &conn);
 
 static constexpr route_info book_route_definitions_array[] = {
     {"/geecodex/books/latest",          http_method::GET,   api_route::FETCH_LATEST_BOOKS},
+    {"/geecodex/books/search",          http_method::GET,   api_route::SEARCH_BOOKS},
+    {"/geecodex/books/suggest",         http_method::GET,   api_route::SUGGEST_BOOKS},
+    {"/geecodex/books/trending",        http_method::GET,   api_route::TRENDING_BOOKS},
+    {"/geecodex/books/:id/similar",     http_method::GET,   api_route::SIMILAR_BOOKS},
+    {"/geecodex/books/snapshot",        http_method::GET,   api_route::CATALOG_SNAPSHOT},
+    {"/geecodex/books/changes",         http_method::GET,   api_route::CATALOG_CHANGES},
+    {"/geecodex/books",                 http_method::GET,   api_route::BROWSE_BOOKS},
     {"/geecodex/books/cover/",          http_method::GET,   api_route::FETCH_PDF_COVER,     route_match_type::PREFIX},
     {"/geecodex/books/",                http_method::GET,   api_route::DOWNLOAD_PDF,        route_match_type::PREFIX},
     {"/geecodex/books/comment/",        http_method::POST,  api_route::COMMENT_BOOK,        route_match_type::PREFIX},     
+    {"/geecodex/books/comment/",        http_method::GET,   api_route::LIST_BOOK_COMMENTS,  route_match_type::PREFIX},
     {"/geecodex/books/score/",          http_method::POST,  api_route::SCORE_BOOK,          route_match_type::PREFIX},
 };
 
@@ -32,7 +48,15 @@ inline void register_book_handlers(std::unordered_map<api_route, route_handler_f
     handlers[api_route::DOWNLOAD_PDF] = handle_download_pdf;
     handlers[api_route::FETCH_PDF_COVER] = handle_fetch_pdf_cover;
     handlers[api_route::FETCH_LATEST_BOOKS] = handle_fetch_latest_books;
+    handlers[api_route::SEARCH_BOOKS] = handle_search_books;
+    handlers[api_route::SUGGEST_BOOKS] = handle_suggest_books;
+    handlers[api_route::TRENDING_BOOKS] = handle_trending_books;
+    handlers[api_route::SIMILAR_BOOKS] = handle_similar_books;
+    handlers[api_route::CATALOG_SNAPSHOT] = handle_catalog_snapshot;
+    handlers[api_route::CATALOG_CHANGES] = handle_catalog_changes;
+    handlers[api_route::BROWSE_BOOKS] = handle_browse_books;
     handlers[api_route::COMMENT_BOOK] = handle_comment_book;
+    handlers[api_route::LIST_BOOK_COMMENTS] = handle_list_book_comments;
     handlers[api_route::SCORE_BOOK] = handle_score_book;
 }
 
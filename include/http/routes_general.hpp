@@ -14,16 +14,22 @@ namespace geecodex::http {
 
 void handle_hello(http_connection &conn);
 void handle_health_check(http_connection &conn);
+void handle_server_stats(http_connection &conn);
 void handle_fetch_client_feedback(http_connection &conn);
 void handle_ai_chat(http_connection &conn);
 void handle_content_recognize(http_connection &conn);
+void handle_recognize_job_submit(http_connection &conn);
+void handle_recognize_job_status(http_connection &conn);
 
 static constexpr route_info general_route_definitions_array[] = {
     {"/geecodex/hello", http_method::GET, api_route::HELLO},
     {"/geecodex/health", http_method::GET, api_route::HEALTH_CHECK},
+    {"/geecodex/stats", http_method::GET, api_route::SERVER_STATS},
     {"/geecodex/feedback", http_method::POST, api_route::CLIENT_FEEDBACK},
     {"/geecodex/ai/chat", http_method::POST, api_route::AI_CHAT},
     {"/geecodex/recognize", http_method::POST, api_route::CONTENT_RECOGNIZE, route_match_type::PREFIX},
+    {"/geecodex/recognize/jobs", http_method::POST, api_route::RECOGNIZE_JOB_SUBMIT},
+    {"/geecodex/recognize/jobs/:id", http_method::GET, api_route::RECOGNIZE_JOB_STATUS},
 };
 
 inline static std::span<const route_info> get_general_route_definitions() {
@@ -33,9 +39,12 @@ inline static std::span<const route_info> get_general_route_definitions() {
 inline void register_general_handlers(std::unordered_map<api_route, route_handler_func>& handlers) {
     handlers[api_route::HELLO] = handle_hello;
     handlers[api_route::HEALTH_CHECK] = handle_health_check;
+    handlers[api_route::SERVER_STATS] = handle_server_stats;
     handlers[api_route::CLIENT_FEEDBACK] = handle_fetch_client_feedback;
     handlers[api_route::AI_CHAT] = handle_ai_chat;
     handlers[api_route::CONTENT_RECOGNIZE] = handle_content_recognize;
+    handlers[api_route::RECOGNIZE_JOB_SUBMIT] = handle_recognize_job_submit;
+    handlers[api_route::RECOGNIZE_JOB_STATUS] = handle_recognize_job_status;
 }
 
 } // namespace geecodex::http
@@ -0,0 +1,47 @@
+#ifndef SHARED_BODY_HPP
+#define SHARED_BODY_HPP
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace geecodex::http {
+namespace beast = boost::beast;
+
+// Response body that points at an immutable string shared with others,
+// e.g. a prebuilt export blob: writing it copies nothing, and the string
+// lives until the last response using it is sent.
+struct shared_string_body {
+    using value_type = std::shared_ptr<const std::string>;
+
+    static std::uint64_t size(const value_type& body) { return body ? body->size() : 0; }
+
+    class writer {
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template <bool isRequest, class Fields>
+        writer(const beast::http::header<isRequest, Fields>&, const value_type& body)
+            : m_body{body} {}
+
+        void init(beast::error_code& ec) { ec = {}; }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            if (!m_body || m_body->empty()) return boost::none;
+            return {{const_buffers_type{m_body->data(), m_body->size()}, false}};
+        }
+
+    private:
+        const value_type& m_body;
+    };
+};
+
+}   // NAMESPACE GEECODEX::HTTP
+#endif // SHARED_BODY_HPP
@@ -0,0 +1,79 @@
+#ifndef SSE_PARSER_HPP
+#define SSE_PARSER_HPP
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace geecodex::http {
+
+// Incremental text/event-stream parser.
+// Bytes may arrive split at arbitrary positions; a partial line is carried
+// over to the next feed() call and every complete event's `data:` payload
+// is handed to the callback as soon as its terminating blank line is seen.
+class sse_parser {
+public:
+    template <typename Callback>
+    void feed(std::string_view chunk, Callback&& on_event) {
+        std::size_t start = 0;
+        while (start < chunk.size()) {
+            auto end = chunk.find('\n', start);
+            if (end == std::string_view::npos) {
+                m_line.append(chunk.substr(start));
+                return;
+            }
+
+            std::string_view line = chunk.substr(start, end - start);
+            if (!m_line.empty()) {
+                m_line.append(line);
+                process_line(m_line, on_event);
+                m_line.clear();
+            } else process_line(line, on_event);
+            start = end + 1;
+        }
+    }
+
+    void reset() {
+        m_line.clear();
+        m_data.clear();
+        m_has_data = false;
+    }
+
+private:
+    std::string m_line;     // partial line carried over from the previous chunk
+    std::string m_data;     // accumulated `data:` field of the current event
+    bool        m_has_data = false;
+
+    template <typename Callback>
+    void process_line(std::string_view line, Callback& on_event) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        if (line.empty()) {
+            if (m_has_data) {
+                on_event(std::string_view{m_data});
+                m_data.clear();
+                m_has_data = false;
+            }
+            return;
+        }
+        if (line.front() == ':') return;    // comment / keep-alive
+
+        auto colon = line.find(':');
+        std::string_view field = line.substr(0, colon);
+        std::string_view value;
+        if (colon != std::string_view::npos) {
+            value = line.substr(colon + 1);
+            if (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+        }
+
+        if (field == "data") {
+            if (m_has_data) m_data.push_back('\n');
+            m_data.append(value);
+            m_has_data = true;
+        }
+        // `event`, `id` and `retry` are not used by the AI provider.
+    }
+};
+
+}   // NAMESPACE GEECODEX::HTTP
+#endif // SSE_PARSER_HPP
@@ -0,0 +1,218 @@
+#ifndef UPSTREAM_GUARD_HPP
+#define UPSTREAM_GUARD_HPP
+
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::http {
+
+// Per-phase deadlines and admission limits for an upstream service.
+struct upstream_limits {
+    std::chrono::milliseconds resolve_timeout{5'000};
+    std::chrono::milliseconds connect_timeout{5'000};
+    std::chrono::milliseconds handshake_timeout{5'000};
+    std::chrono::milliseconds write_timeout{10'000};
+    std::chrono::milliseconds read_timeout{120'000};     // whole buffered reply
+    std::chrono::milliseconds stream_idle_timeout{30'000};  // gap between streamed chunks
+    std::chrono::milliseconds shutdown_timeout{3'000};
+
+    std::size_t max_in_flight = 32;
+    std::size_t failure_threshold = 5;      // consecutive failures before the breaker opens
+    std::chrono::seconds open_duration{30}; // how long to fail fast before probing again
+
+    // <prefix>_{RESOLVE,CONNECT,HANDSHAKE,WRITE,READ,STREAM_IDLE,SHUTDOWN}_TIMEOUT_MS,
+    // <prefix>_MAX_IN_FLIGHT, <prefix>_BREAKER_THRESHOLD and
+    // <prefix>_BREAKER_OPEN_SECONDS.
+    static upstream_limits from_env(std::string_view prefix) {
+        upstream_limits limits;
+        auto ms = [&](const char* name, std::chrono::milliseconds fallback) {
+            auto key = std::string{prefix} + name;
+            return std::chrono::milliseconds{utils::env_int(key.c_str(), fallback.count())};
+        };
+        limits.resolve_timeout = ms("_RESOLVE_TIMEOUT_MS", limits.resolve_timeout);
+        limits.connect_timeout = ms("_CONNECT_TIMEOUT_MS", limits.connect_timeout);
+        limits.handshake_timeout = ms("_HANDSHAKE_TIMEOUT_MS", limits.handshake_timeout);
+        limits.write_timeout = ms("_WRITE_TIMEOUT_MS", limits.write_timeout);
+        limits.read_timeout = ms("_READ_TIMEOUT_MS", limits.read_timeout);
+        limits.stream_idle_timeout = ms("_STREAM_IDLE_TIMEOUT_MS", limits.stream_idle_timeout);
+        limits.shutdown_timeout = ms("_SHUTDOWN_TIMEOUT_MS", limits.shutdown_timeout);
+
+        auto max_key = std::string{prefix} + "_MAX_IN_FLIGHT";
+        limits.max_in_flight = static_cast<std::size_t>(utils::env_int(max_key.c_str(), static_cast<long long>(limits.max_in_flight)));
+        auto threshold_key = std::string{prefix} + "_BREAKER_THRESHOLD";
+        limits.failure_threshold = static_cast<std::size_t>(utils::env_int(threshold_key.c_str(), static_cast<long long>(limits.failure_threshold)));
+        auto open_key = std::string{prefix} + "_BREAKER_OPEN_SECONDS";
+        limits.open_duration = std::chrono::seconds{utils::env_int(open_key.c_str(), limits.open_duration.count())};
+        return limits;
+    }
+};
+
+// Bounded concurrency plus a circuit breaker in front of one upstream.
+//  closed    - requests pass while fewer than max_in_flight are running;
+//  open      - after `failure_threshold` consecutive failures every request
+//              is rejected until `open_duration` has elapsed;
+//  half_open - one probe request is let through; its outcome closes or
+//              re-opens the breaker.
+class upstream_guard {
+public:
+    using clock = std::chrono::steady_clock;
+    enum class state { closed, open, half_open };
+    enum class rejection { none, saturated, circuit_open };
+
+    class permit {
+    public:
+        permit(permit&& other) noexcept
+            : m_guard{std::exchange(other.m_guard, nullptr)}
+            , m_probe{other.m_probe}
+            , m_reported{other.m_reported} {}
+        permit& operator=(permit&&) = delete;
+        permit(const permit&) = delete;
+        permit& operator=(const permit&) = delete;
+        ~permit() { if (m_guard) m_guard->release(m_probe, m_reported); }
+
+        // Outcome of the upstream call; only the first report counts.
+        void record(bool healthy) {
+            if (!m_guard || m_reported) return;
+            m_reported = true;
+            m_guard->on_result(healthy, m_probe);
+        }
+
+    private:
+        friend class upstream_guard;
+        permit(upstream_guard* guard, bool probe): m_guard{guard}, m_probe{probe} {}
+
+        upstream_guard* m_guard;
+        bool m_probe;
+        bool m_reported = false;
+    };
+
+    explicit upstream_guard(std::string name, upstream_limits limits)
+        : m_name{std::move(name)}, m_limits{limits} {}
+
+    [[nodiscard]] const upstream_limits& limits() const { return m_limits; }
+
+    std::optional<permit> try_acquire(rejection& why) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        why = rejection::none;
+
+        bool probe = false;
+        if (m_state == state::open) {
+            if (clock::now() - m_opened_at < m_limits.open_duration) {
+                why = rejection::circuit_open;
+                ++m_rejected_open;
+                return std::nullopt;
+            }
+            m_state = state::half_open;
+            SPDLOG_INFO("Upstream '{}' circuit half-open, probing", m_name);
+        }
+        if (m_state == state::half_open) {
+            if (m_probe_in_flight) {
+                why = rejection::circuit_open;
+                ++m_rejected_open;
+                return std::nullopt;
+            }
+            m_probe_in_flight = true;
+            probe = true;
+        }
+
+        if (m_in_flight >= m_limits.max_in_flight) {
+            if (probe) m_probe_in_flight = false;
+            why = rejection::saturated;
+            ++m_rejected_saturated;
+            return std::nullopt;
+        }
+        ++m_in_flight;
+        ++m_admitted;
+        return permit{this, probe};
+    }
+
+    // Seconds a rejected client should wait before retrying.
+    std::chrono::seconds retry_after() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_state != state::open) return std::chrono::seconds{1};
+        auto remaining = m_limits.open_duration - std::chrono::duration_cast<std::chrono::seconds>(clock::now() - m_opened_at);
+        return std::max(remaining, std::chrono::seconds{1});
+    }
+
+    nlohmann::json stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nlohmann::json out;
+        out["state"] = m_state == state::closed ? "closed" : m_state == state::open ? "open" : "half_open";
+        out["in_flight"] = m_in_flight;
+        out["max_in_flight"] = m_limits.max_in_flight;
+        out["admitted"] = m_admitted;
+        out["rejected_saturated"] = m_rejected_saturated;
+        out["rejected_circuit_open"] = m_rejected_open;
+        out["failures"] = m_failures;
+        out["consecutive_failures"] = m_consecutive_failures;
+        out["times_opened"] = m_times_opened;
+        return out;
+    }
+
+private:
+    std::string m_name;
+    upstream_limits m_limits;
+    mutable std::mutex m_mutex;
+
+    state m_state = state::closed;
+    clock::time_point m_opened_at{};
+    bool m_probe_in_flight = false;
+    std::size_t m_in_flight = 0;
+    std::size_t m_consecutive_failures = 0;
+
+    std::uint64_t m_admitted = 0;
+    std::uint64_t m_rejected_saturated = 0;
+    std::uint64_t m_rejected_open = 0;
+    std::uint64_t m_failures = 0;
+    std::uint64_t m_times_opened = 0;
+
+    void release(bool probe, bool reported) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_in_flight;
+        // An abandoned probe (e.g. the client went away) tells us nothing;
+        // let the next request probe instead.
+        if (probe && !reported) m_probe_in_flight = false;
+    }
+
+    void on_result(bool healthy, bool probe) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (probe) m_probe_in_flight = false;
+
+        if (healthy) {
+            m_consecutive_failures = 0;
+            if (m_state != state::closed) SPDLOG_INFO("Upstream '{}' circuit closed", m_name);
+            m_state = state::closed;
+            return;
+        }
+
+        ++m_failures;
+        ++m_consecutive_failures;
+        if (m_state == state::half_open ||
+            (m_state == state::closed && m_consecutive_failures >= m_limits.failure_threshold)) {
+            m_state = state::open;
+            m_opened_at = clock::now();
+            ++m_times_opened;
+            SPDLOG_WARN("Upstream '{}' circuit opened after {} consecutive failures", m_name, m_consecutive_failures);
+        }
+    }
+};
+
+// DEEPSEEK_* variables, e.g. DEEPSEEK_MAX_IN_FLIGHT, DEEPSEEK_READ_TIMEOUT_MS.
+inline upstream_guard& get_deepseek_guard() {
+    static upstream_guard instance{"deepseek", upstream_limits::from_env("DEEPSEEK")};
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::HTTP
+#endif // UPSTREAM_GUARD_HPP
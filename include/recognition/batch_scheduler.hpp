@@ -0,0 +1,278 @@
+#ifndef BATCH_SCHEDULER_HPP
+#define BATCH_SCHEDULER_HPP
+
+#include <json.hpp>
+#include <recognition/formula_engine.hpp>
+#include <utils/env.hpp>
+#include <utils/histogram.hpp>
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::recognition {
+
+struct batch_scheduler_config {
+    std::size_t max_batch = 8;
+    std::chrono::microseconds max_wait{10'000};
+    std::size_t max_queue = 256;
+
+    // GEECODEX_BATCH_MAX, GEECODEX_BATCH_MAX_WAIT_US and GEECODEX_BATCH_QUEUE_LIMIT.
+    static batch_scheduler_config from_env() {
+        batch_scheduler_config config;
+        config.max_batch = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_BATCH_MAX", static_cast<long long>(config.max_batch))));
+        config.max_wait = std::chrono::microseconds{utils::env_int("GEECODEX_BATCH_MAX_WAIT_US", config.max_wait.count())};
+        config.max_queue = static_cast<std::size_t>(utils::env_int("GEECODEX_BATCH_QUEUE_LIMIT", static_cast<long long>(config.max_queue)));
+        return config;
+    }
+};
+
+// Groups single-image recognition requests into batches for formula_engine.
+//
+// A batch is dispatched as soon as an inference worker is free, so a lone
+// request at low load runs immediately. The scheduler only holds requests
+// back (never longer than max_wait after the oldest arrived) when the recent
+// arrival rate says the batch would fill within that window; under load the
+// queue grows while every worker is busy and batches fill by themselves.
+class batch_scheduler {
+public:
+    using clock = std::chrono::steady_clock;
+    // Exactly one of `latex` / `error` is set.
+    using completion = std::function<void(std::optional<std::string> latex, std::exception_ptr error)>;
+
+    explicit batch_scheduler( formula_engine& engine
+                            , net::thread_pool& pool
+                            , std::size_t workers
+                            , batch_scheduler_config config = batch_scheduler_config::from_env())
+        : m_engine{engine}
+        , m_pool{pool}
+        , m_workers{std::max<std::size_t>(1, workers)}
+        , m_config{config}
+        , m_batch_sizes{batch_size_bounds(config.max_batch)}
+        , m_queue_wait_ms{{0.1, 0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000}}
+        , m_dispatcher{[this] { dispatch_loop(); }} {}
+
+    // Stops dispatching (queued jobs are failed) and waits for the batches
+    // already posted to the pool, which still run against this object.
+    ~batch_scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeup.notify_all();
+        if (m_dispatcher.joinable()) m_dispatcher.join();
+        m_pool.join();
+    }
+
+    batch_scheduler(const batch_scheduler&) = delete;
+    batch_scheduler& operator=(const batch_scheduler&) = delete;
+
+    // Queues one image; `done` runs on an inference worker. Jobs whose
+    // `abandoned` flag is set by the time their batch forms are dropped
+    // without calling `done`. Throws recognition_error(overloaded) when the
+    // queue is full.
+    void submit(std::string image, std::shared_ptr<std::atomic<bool>> abandoned, completion done) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_queue.size() >= m_config.max_queue) {
+                ++m_rejected;
+                throw recognition_error(recognition_error::kind::overloaded, "Recognition queue is full");
+            }
+            auto now = clock::now();
+            if (m_last_arrival != clock::time_point{}) {
+                // EWMA of the gap between arrivals, alpha = 1/8.
+                auto gap = std::chrono::duration_cast<std::chrono::microseconds>(now - m_last_arrival);
+                m_arrival_gap = m_arrival_gap == std::chrono::microseconds::zero() ? gap : (m_arrival_gap * 7 + gap) / 8;
+            }
+            m_last_arrival = now;
+            m_queue.push_back(job{std::move(image), std::move(abandoned), std::move(done), now});
+        }
+        m_wakeup.notify_one();
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            out["queued"] = m_queue.size();
+            out["busy_workers"] = m_busy;
+            out["workers"] = m_workers;
+            out["arrival_gap_us"] = m_arrival_gap.count();
+            out["rejected"] = m_rejected;
+            out["abandoned"] = m_abandoned;
+        }
+        out["max_batch"] = m_config.max_batch;
+        out["max_wait_us"] = m_config.max_wait.count();
+        out["max_queue"] = m_config.max_queue;
+        out["batch_size"] = m_batch_sizes.to_json();
+        out["queue_wait_ms"] = m_queue_wait_ms.to_json();
+        return out;
+    }
+
+private:
+    struct job {
+        std::string image;
+        std::shared_ptr<std::atomic<bool>> abandoned;
+        completion done;
+        clock::time_point enqueued_at;
+    };
+
+    formula_engine& m_engine;
+    net::thread_pool& m_pool;
+    const std::size_t m_workers;
+    const batch_scheduler_config m_config;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<job> m_queue;
+    std::size_t m_busy = 0;
+    bool m_stopping = false;
+    clock::time_point m_last_arrival{};
+    std::chrono::microseconds m_arrival_gap{0};
+    std::uint64_t m_rejected = 0;
+    std::uint64_t m_abandoned = 0;
+
+    utils::histogram m_batch_sizes;
+    utils::histogram m_queue_wait_ms;
+    std::thread m_dispatcher;   // last: started once everything above exists
+
+    static std::vector<double> batch_size_bounds(std::size_t max_batch) {
+        std::vector<double> bounds;
+        for (std::size_t size = 1; size <= max_batch; ++size) bounds.push_back(static_cast<double>(size));
+        return bounds;
+    }
+
+    // How long the oldest queued job may still wait for company.
+    std::chrono::microseconds fill_window_locked() const {
+        if (m_queue.size() >= m_config.max_batch || m_arrival_gap == std::chrono::microseconds::zero()) return {};
+        auto expected_fill = m_arrival_gap * static_cast<long long>(m_config.max_batch - m_queue.size());
+        if (expected_fill > m_config.max_wait) return {};
+        return m_config.max_wait;
+    }
+
+    void dispatch_loop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_wakeup.wait(lock, [this] { return m_stopping || (!m_queue.empty() && m_busy < m_workers); });
+            if (m_stopping) break;
+
+            auto deadline = m_queue.front().enqueued_at + fill_window_locked();
+            while (!m_stopping && m_queue.size() < m_config.max_batch && clock::now() < deadline) {
+                m_wakeup.wait_until(lock, deadline);
+                if (m_queue.empty()) break;
+                deadline = std::min(deadline, m_queue.front().enqueued_at + fill_window_locked());
+            }
+            if (m_stopping) break;
+            if (m_queue.empty()) continue;
+
+            std::vector<job> batch;
+            auto now = clock::now();
+            while (!m_queue.empty() && batch.size() < m_config.max_batch) {
+                auto& next = m_queue.front();
+                if (next.abandoned && *next.abandoned) ++m_abandoned;
+                else {
+                    m_queue_wait_ms.record(std::chrono::duration<double, std::milli>(now - next.enqueued_at).count());
+                    batch.push_back(std::move(next));
+                }
+                m_queue.pop_front();
+            }
+            if (batch.empty()) continue;
+
+            ++m_busy;
+            m_batch_sizes.record(static_cast<double>(batch.size()));
+            net::post(m_pool, [this, batch = std::move(batch)]() mutable {
+                run_batch(batch);
+                {
+                    std::lock_guard<std::mutex> done_lock(m_mutex);
+                    --m_busy;
+                }
+                m_wakeup.notify_one();
+            });
+        }
+
+        // Shutting down: fail whatever is still queued.
+        auto error = std::make_exception_ptr(recognition_error(recognition_error::kind::unavailable, "Recognition service stopping"));
+        for (auto& pending: m_queue) complete(pending, std::nullopt, error);
+        m_queue.clear();
+    }
+
+    // Answers one job exactly once; a throwing callback is logged and does
+    // not reach the other jobs of its batch.
+    static void complete(job& j, std::optional<std::string> latex, std::exception_ptr error) noexcept {
+        if (!j.done) return;
+        try {
+            j.done(std::move(latex), error);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("Recognition completion threw: {}", e.what());
+        } catch (...) {
+            SPDLOG_ERROR("Recognition completion threw an unknown exception");
+        }
+    }
+
+    void run_batch(std::vector<job>& batch) {
+        std::vector<formula_input> inputs;
+        std::vector<job*> runnable;
+        inputs.reserve(batch.size());
+        for (auto& j: batch) {
+            try {
+                inputs.push_back(m_engine.preprocess(j.image));
+                runnable.push_back(&j);
+            } catch (...) {
+                complete(j, std::nullopt, std::current_exception());
+            }
+        }
+        if (runnable.empty()) return;
+
+        std::vector<const formula_input*> views;
+        views.reserve(inputs.size());
+        for (const auto& in: inputs) views.push_back(&in);
+
+        std::vector<std::string> latex;
+        std::exception_ptr error;
+        try {
+            latex = m_engine.run(views);
+            if (latex.size() != runnable.size())
+                throw recognition_error(recognition_error::kind::inference, "Batch returned " + std::to_string(latex.size()) + " results for " + std::to_string(runnable.size()) + " images");
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (std::size_t i = 0; i < runnable.size(); ++i) {
+            if (error) complete(*runnable[i], std::nullopt, error);
+            else complete(*runnable[i], std::move(latex[i]), nullptr);
+        }
+    }
+};
+
+namespace detail {
+inline std::atomic<batch_scheduler*> formula_batcher_instance{nullptr};
+}
+
+inline batch_scheduler& get_formula_batcher() {
+    static batch_scheduler instance{ get_formula_engine()
+                                   , get_inference_thread_pool()
+                                   , static_cast<std::size_t>(get_formula_engine().config().inference_threads)};
+    detail::formula_batcher_instance.store(&instance, std::memory_order_release);
+    return instance;
+}
+
+// The batcher if a recognition request built it, else null.
+inline batch_scheduler* find_formula_batcher() {
+    return detail::formula_batcher_instance.load(std::memory_order_acquire);
+}
+
+}   // NAMESPACE GEECODEX::RECOGNITION
+#endif // BATCH_SCHEDULER_HPP
@@ -0,0 +1,273 @@
+#ifndef FORMULA_ENGINE_HPP
+#define FORMULA_ENGINE_HPP
+
+#include <json.hpp>
+#include <recognition/image_kernels.hpp>
+#include <recognition/latex_tokenizer.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef GEECODEX_WITH_ONNXRUNTIME
+#include <onnxruntime_cxx_api.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#endif
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::recognition {
+namespace net = boost::asio;
+
+struct formula_engine_config {
+    std::string model_path;         // exported PP-FormulaNet .onnx
+    std::string tokenizer_path;     // tokenizer.json; defaults to the model's directory
+    int input_size = 384;           // used when the model input has dynamic H/W
+    float mean = 0.7931f;           // grayscale normalisation of UniMERNetTestTransform
+    float stddev = 0.1738f;
+    int intra_op_threads = 0;       // 0: let ONNX Runtime decide
+    int inference_threads = 1;
+
+    // GEECODEX_FORMULA_MODEL, GEECODEX_FORMULA_TOKENIZER, GEECODEX_FORMULA_INPUT_SIZE,
+    // GEECODEX_FORMULA_THREADS and GEECODEX_INFERENCE_THREADS.
+    static formula_engine_config from_env() {
+        formula_engine_config config;
+        config.model_path = utils::env_string("GEECODEX_FORMULA_MODEL");
+        config.tokenizer_path = utils::env_string("GEECODEX_FORMULA_TOKENIZER");
+        if (config.tokenizer_path.empty() && !config.model_path.empty())
+            config.tokenizer_path = (std::filesystem::path{config.model_path}.parent_path() / "tokenizer.json").string();
+        config.input_size = static_cast<int>(utils::env_int("GEECODEX_FORMULA_INPUT_SIZE", config.input_size));
+        config.intra_op_threads = static_cast<int>(utils::env_int("GEECODEX_FORMULA_THREADS", config.intra_op_threads));
+        config.inference_threads = std::max(1, static_cast<int>(utils::env_int("GEECODEX_INFERENCE_THREADS", config.inference_threads)));
+        return config;
+    }
+};
+
+class recognition_error: public std::runtime_error {
+public:
+    enum class kind { bad_image, unavailable, overloaded, inference };
+
+    recognition_error(kind k, const std::string& message): std::runtime_error(message), m_kind{k} {}
+    [[nodiscard]] kind error_kind() const { return m_kind; }
+
+private:
+    kind m_kind;
+};
+
+// One decoded, resized and normalised image: channels x height x width floats.
+struct formula_input {
+    std::vector<float> pixels;
+};
+
+// In-process PP-FormulaNet on CPU. The model is exported with its greedy
+// decoding loop inside the graph, so one Run() maps a [N, C, H, W] image batch
+// to [N, max_len] token ids that latex_tokenizer turns into LaTeX.
+//
+// preprocess() and run() are safe to call from several threads; ONNX Runtime
+// sessions support concurrent Run() calls.
+class formula_engine {
+public:
+    explicit formula_engine(formula_engine_config config = formula_engine_config::from_env())
+        : m_config{std::move(config)} {
+#ifdef GEECODEX_WITH_ONNXRUNTIME
+        if (m_config.model_path.empty()) {
+            m_status = "GEECODEX_FORMULA_MODEL not set";
+            return;
+        }
+        try {
+            m_tokenizer = latex_tokenizer{m_config.tokenizer_path};
+
+            Ort::SessionOptions options;
+            if (m_config.intra_op_threads > 0) options.SetIntraOpNumThreads(m_config.intra_op_threads);
+            options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+            m_session = std::make_unique<Ort::Session>(m_env, m_config.model_path.c_str(), options);
+
+            Ort::AllocatorWithDefaultOptions allocator;
+            m_input_name = m_session->GetInputNameAllocated(0, allocator).get();
+            m_output_name = m_session->GetOutputNameAllocated(0, allocator).get();
+
+            auto shape = m_session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+            m_channels = (shape.size() == 4 && shape[1] > 0) ? static_cast<int>(shape[1]) : 1;
+            m_height = (shape.size() == 4 && shape[2] > 0) ? static_cast<int>(shape[2]) : m_config.input_size;
+            m_width = (shape.size() == 4 && shape[3] > 0) ? static_cast<int>(shape[3]) : m_config.input_size;
+
+            m_available = true;
+            m_status = "ready";
+            SPDLOG_INFO("Formula engine loaded '{}' (input {}x{}x{})", m_config.model_path, m_channels, m_height, m_width);
+        } catch (const std::exception& e) {
+            m_session.reset();
+            m_status = std::string("model load failed: ") + e.what();
+            SPDLOG_ERROR("Formula engine unavailable: {}", e.what());
+        }
+#else
+        m_status = "built without ONNX Runtime";
+#endif
+    }
+
+    [[nodiscard]] bool available() const { return m_available; }
+    [[nodiscard]] const std::string& status() const { return m_status; }
+    [[nodiscard]] const formula_engine_config& config() const { return m_config; }
+
+    // Decode -> grayscale -> crop the white margin -> fit into H x W keeping
+    // the aspect ratio -> normalise. Throws recognition_error(bad_image).
+    // Everything after the decode runs in image_kernels on per-thread scratch.
+    formula_input preprocess(std::string_view image_bytes) const {
+#ifdef GEECODEX_WITH_ONNXRUNTIME
+        auto started = std::chrono::steady_clock::now();
+        cv::Mat encoded(1, static_cast<int>(image_bytes.size()), CV_8UC1, const_cast<char*>(image_bytes.data()));
+        cv::Mat gray = cv::imdecode(encoded, cv::IMREAD_GRAYSCALE);
+        if (gray.empty()) throw recognition_error(recognition_error::kind::bad_image, "Cannot decode image");
+
+        thread_local kernels::preprocess_scratch scratch;
+        formula_input input;
+        const auto plane = static_cast<std::size_t>(m_height) * static_cast<std::size_t>(m_width);
+        input.pixels.resize(plane * static_cast<std::size_t>(m_channels));
+        kernels::fit_normalize({gray.data, gray.cols, gray.rows, static_cast<std::ptrdiff_t>(gray.step)},
+                               input.pixels.data(), m_width, m_height,
+                               1.0f / (255.0f * m_config.stddev), -m_config.mean / m_config.stddev, scratch);
+        for (int c = 1; c < m_channels; ++c)
+            std::copy_n(input.pixels.begin(), plane, input.pixels.begin() + static_cast<std::ptrdiff_t>(plane * static_cast<std::size_t>(c)));
+
+        m_preprocess_us += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+        return input;
+#else
+        (void)image_bytes;
+        throw recognition_error(recognition_error::kind::unavailable, m_status);
+#endif
+    }
+
+    // One forward pass over the whole batch; returns one LaTeX string per input.
+    std::vector<std::string> run(const std::vector<const formula_input*>& batch) {
+        if (batch.empty()) return {};
+        if (!m_available) throw recognition_error(recognition_error::kind::unavailable, m_status);
+#ifdef GEECODEX_WITH_ONNXRUNTIME
+        auto started = std::chrono::steady_clock::now();
+        const auto per_image = static_cast<std::size_t>(m_channels) * static_cast<std::size_t>(m_height) * static_cast<std::size_t>(m_width);
+        std::vector<float> tensor(per_image * batch.size());
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            if (batch[i]->pixels.size() != per_image)
+                throw recognition_error(recognition_error::kind::inference, "Preprocessed image has the wrong size");
+            std::copy(batch[i]->pixels.begin(), batch[i]->pixels.end(), tensor.begin() + static_cast<std::ptrdiff_t>(i * per_image));
+        }
+
+        std::vector<std::int64_t> dims{static_cast<std::int64_t>(batch.size()), m_channels, m_height, m_width};
+        auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        auto input = Ort::Value::CreateTensor<float>(memory_info, tensor.data(), tensor.size(), dims.data(), dims.size());
+
+        std::vector<std::string> latex;
+        try {
+            const char* input_names[] = {m_input_name.c_str()};
+            const char* output_names[] = {m_output_name.c_str()};
+            auto outputs = m_session->Run(Ort::RunOptions{nullptr}, input_names, &input, 1, output_names, 1);
+
+            auto info = outputs[0].GetTensorTypeAndShapeInfo();
+            auto shape = info.GetShape();
+            const auto rows = shape.empty() ? std::size_t{0} : static_cast<std::size_t>(shape[0]);
+            const auto cols = shape.size() < 2 ? std::size_t{1} : static_cast<std::size_t>(shape[1]);
+            if (rows != batch.size())
+                throw recognition_error(recognition_error::kind::inference, "Model returned an unexpected batch size");
+
+            std::vector<std::int64_t> ids(rows * cols);
+            if (info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64) {
+                const auto* data = outputs[0].GetTensorData<std::int64_t>();
+                std::copy(data, data + ids.size(), ids.begin());
+            } else if (info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32) {
+                const auto* data = outputs[0].GetTensorData<std::int32_t>();
+                std::copy(data, data + ids.size(), ids.begin());
+            } else throw recognition_error(recognition_error::kind::inference, "Model output is not a token id tensor");
+
+            latex.reserve(rows);
+            for (std::size_t row = 0; row < rows; ++row) latex.push_back(m_tokenizer.decode(ids.data() + row * cols, cols));
+        } catch (const Ort::Exception& e) {
+            ++m_failures;
+            throw recognition_error(recognition_error::kind::inference, std::string("Inference failed: ") + e.what());
+        }
+
+        m_images += batch.size();
+        ++m_batches;
+        m_inference_us += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+        return latex;
+#else
+        throw recognition_error(recognition_error::kind::unavailable, m_status);
+#endif
+    }
+
+    std::string recognize(std::string_view image_bytes) {
+        auto input = preprocess(image_bytes);
+        return run({&input}).front();
+    }
+
+    nlohmann::json stats() const {
+        nlohmann::json out;
+        out["available"] = m_available;
+        out["status"] = m_status;
+        out["input"] = {m_channels, m_height, m_width};
+        out["simd"] = kernels::isa_name();
+        out["images"] = m_images.load();
+        out["batches"] = m_batches.load();
+        out["failures"] = m_failures.load();
+        out["avg_preprocess_ms"] = m_images == 0 ? 0.0 : static_cast<double>(m_preprocess_us) / 1000.0 / static_cast<double>(m_images);
+        out["avg_inference_ms_per_batch"] = m_batches == 0 ? 0.0 : static_cast<double>(m_inference_us) / 1000.0 / static_cast<double>(m_batches);
+        return out;
+    }
+
+private:
+    formula_engine_config m_config;
+    bool m_available = false;
+    std::string m_status;
+    latex_tokenizer m_tokenizer;
+    int m_channels = 1;
+    int m_height = 0;
+    int m_width = 0;
+
+#ifdef GEECODEX_WITH_ONNXRUNTIME
+    Ort::Env m_env{ORT_LOGGING_LEVEL_WARNING, "geecodex_formula"};
+    std::unique_ptr<Ort::Session> m_session;
+    std::string m_input_name;
+    std::string m_output_name;
+#endif
+
+    std::atomic<std::uint64_t> m_images{0};
+    std::atomic<std::uint64_t> m_batches{0};
+    std::atomic<std::uint64_t> m_failures{0};
+    mutable std::atomic<std::uint64_t> m_preprocess_us{0};
+    std::atomic<std::uint64_t> m_inference_us{0};
+};
+
+namespace detail {
+inline std::atomic<formula_engine*> formula_engine_instance{nullptr};
+}
+
+// Loading the model takes a while, so main() builds the engine before the
+// server accepts connections; later calls only return it.
+inline formula_engine& get_formula_engine() {
+    static formula_engine instance;
+    detail::formula_engine_instance.store(&instance, std::memory_order_release);
+    return instance;
+}
+
+// The engine if it was built, else null; never loads the model.
+inline formula_engine* find_formula_engine() {
+    return detail::formula_engine_instance.load(std::memory_order_acquire);
+}
+
+// Inference runs here, never on the I/O threads.
+inline net::thread_pool& get_inference_thread_pool() {
+    static net::thread_pool pool{static_cast<std::size_t>(get_formula_engine().config().inference_threads)};
+    return pool;
+}
+
+}   // NAMESPACE GEECODEX::RECOGNITION
+#endif // FORMULA_ENGINE_HPP
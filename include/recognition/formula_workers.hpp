@@ -0,0 +1,461 @@
+#ifndef FORMULA_WORKERS_HPP
+#define FORMULA_WORKERS_HPP
+
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/http.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::recognition {
+namespace net   = boost::asio;
+namespace beast = boost::beast;
+namespace bhttp = beast::http;
+using tcp       = net::ip::tcp;
+
+struct worker_pool_config {
+    struct endpoint {
+        std::string host;
+        std::string port;
+    };
+    std::vector<endpoint> workers;
+    std::size_t max_in_flight_per_worker = 1;   // formula_service predicts synchronously
+    std::size_t max_idle_per_worker = 4;
+    std::size_t max_queue = 64;
+    std::size_t failure_threshold = 3;
+    std::chrono::milliseconds connect_timeout{2'000};
+    std::chrono::milliseconds request_timeout{60'000};
+    std::chrono::milliseconds probe_interval{2'000};
+
+    // GEECODEX_FORMULA_WORKERS="127.0.0.1:8001,127.0.0.1:8002",
+    // GEECODEX_FORMULA_WORKER_MAX_IN_FLIGHT, GEECODEX_FORMULA_PROXY_QUEUE,
+    // GEECODEX_FORMULA_WORKER_TIMEOUT_MS and GEECODEX_FORMULA_PROBE_INTERVAL_MS.
+    static worker_pool_config from_env() {
+        worker_pool_config config;
+        std::string list = utils::env_string("GEECODEX_FORMULA_WORKERS");
+        std::size_t start = 0;
+        while (start < list.size()) {
+            auto end = list.find(',', start);
+            if (end == std::string::npos) end = list.size();
+            std::string item = list.substr(start, end - start);
+            start = end + 1;
+            auto colon = item.rfind(':');
+            if (item.empty() || colon == std::string::npos) continue;
+            config.workers.push_back({item.substr(0, colon), item.substr(colon + 1)});
+        }
+        config.max_in_flight_per_worker = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_FORMULA_WORKER_MAX_IN_FLIGHT", static_cast<long long>(config.max_in_flight_per_worker))));
+        config.max_queue = static_cast<std::size_t>(utils::env_int("GEECODEX_FORMULA_PROXY_QUEUE", static_cast<long long>(config.max_queue)));
+        config.request_timeout = std::chrono::milliseconds{utils::env_int("GEECODEX_FORMULA_WORKER_TIMEOUT_MS", config.request_timeout.count())};
+        config.probe_interval = std::chrono::milliseconds{utils::env_int("GEECODEX_FORMULA_PROBE_INTERVAL_MS", config.probe_interval.count())};
+        return config;
+    }
+};
+
+// Reply of a formula_service worker; status 0 means no reply was received.
+struct worker_reply {
+    unsigned status = 0;
+    std::string body;
+};
+
+// Keep-alive client for a set of local formula_rec/formula_service.py
+// processes. Each request goes to the healthy worker with the fewest
+// outstanding requests that is below its concurrency cap, over a pooled
+// connection when one is idle. Requests that find every worker busy wait in a
+// bounded FIFO. Workers are probed on GET /health; repeated failures take a
+// worker out of rotation until a probe succeeds again. A request whose client
+// left is dropped from the queue, or, once sent, cancel() closes its
+// connection instead of holding a worker slot until the reply.
+class formula_worker_pool {
+public:
+    using clock      = std::chrono::steady_clock;
+    using completion = std::function<void(worker_reply)>;
+
+    struct upload {
+        std::string image;
+        std::string filename = "image.png";
+        std::string content_type = "image/png";
+    };
+
+    formula_worker_pool(net::any_io_executor executor, worker_pool_config config = worker_pool_config::from_env())
+        : m_executor{std::move(executor)}
+        , m_config{std::move(config)}
+        , m_probe_timer{m_executor} {
+        for (const auto& endpoint: m_config.workers) {
+            auto w = std::make_unique<worker>();
+            w->host = endpoint.host;
+            w->port = endpoint.port;
+            w->name = endpoint.host + ":" + endpoint.port;
+            m_workers.push_back(std::move(w));
+        }
+        if (enabled()) {
+            SPDLOG_INFO("Formula worker pool with {} worker(s)", m_workers.size());
+            schedule_probe(std::chrono::milliseconds{0});
+        }
+    }
+
+    [[nodiscard]] bool enabled() const { return !m_workers.empty(); }
+
+    // `done` runs on a worker connection's strand. Returns false (and does not
+    // call `done`) when the wait queue is full. Queued requests whose
+    // `abandoned` flag gets set are dropped silently; in-flight ones too once
+    // cancel() is called with the same flag.
+    bool submit(upload request, std::shared_ptr<std::atomic<bool>> abandoned, completion done) {
+        auto j = std::make_shared<job>(job{std::move(request), std::move(abandoned), std::move(done), clock::now()});
+        std::vector<std::shared_ptr<exchange>> ready;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_queue.size() >= m_config.max_queue) {
+                ++m_rejected;
+                return false;
+            }
+            m_queue.push_back(std::move(j));
+            drain_locked(ready);
+        }
+        for (auto& ex: ready) start(ex);
+        return true;
+    }
+
+    // Call after setting `abandoned`: aborts the request carrying that flag if
+    // a worker is working on it. Its `done` is not called unless the reply
+    // already arrived.
+    void cancel(const std::shared_ptr<std::atomic<bool>>& abandoned) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_in_flight.find(abandoned.get());
+        if (it == m_in_flight.end()) return;
+        auto ex = it->second.lock();
+        // Without a stream yet, send() sees the flag before writing anything.
+        if (!ex || !ex->stream) return;
+        ++m_cancelled;
+        net::post(ex->stream->get_executor(), [ex] {
+            if (ex->stream) ex->stream->cancel();
+        });
+    }
+
+    nlohmann::json stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nlohmann::json out;
+        out["enabled"] = enabled();
+        out["queued"] = m_queue.size();
+        out["rejected"] = m_rejected;
+        out["cancelled"] = m_cancelled;
+        out["max_in_flight_per_worker"] = m_config.max_in_flight_per_worker;
+        nlohmann::json workers = nlohmann::json::array();
+        for (const auto& w: m_workers) {
+            workers.push_back({
+                {"worker", w->name},
+                {"healthy", w->healthy},
+                {"outstanding", w->outstanding},
+                {"idle_connections", w->idle.size()},
+                {"requests", w->requests},
+                {"failures", w->failures},
+                {"new_connections", w->connects},
+                {"reused_connections", w->reuses}
+            });
+        }
+        out["workers"] = std::move(workers);
+        return out;
+    }
+
+private:
+    struct worker {
+        std::string host;
+        std::string port;
+        std::string name;
+        std::vector<std::unique_ptr<beast::tcp_stream>> idle;
+        std::size_t outstanding = 0;
+        bool healthy = true;            // optimistic until the first probe
+        std::size_t consecutive_failures = 0;
+        std::uint64_t requests = 0;
+        std::uint64_t failures = 0;
+        std::uint64_t connects = 0;
+        std::uint64_t reuses = 0;
+    };
+
+    struct job {
+        upload request;
+        std::shared_ptr<std::atomic<bool>> abandoned;
+        completion done;
+        clock::time_point enqueued_at;
+    };
+
+    // One request/response on one worker connection.
+    struct exchange {
+        std::shared_ptr<job> work;
+        worker* target = nullptr;
+        std::unique_ptr<beast::tcp_stream> stream;
+        bool reused = false;
+        bool retried = false;
+        std::string prefix;
+        std::string suffix;
+        bhttp::request<bhttp::empty_body> header;
+        std::unique_ptr<bhttp::request_serializer<bhttp::empty_body>> serializer;
+        beast::flat_buffer buffer;
+        bhttp::response<bhttp::string_body> response;
+    };
+
+    static constexpr std::string_view boundary = "----geecodexFormulaBoundary7MA4YWxkTrZu0gW";
+
+    net::any_io_executor m_executor;
+    worker_pool_config m_config;
+    net::steady_timer m_probe_timer;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<worker>> m_workers;
+    std::deque<std::shared_ptr<job>> m_queue;
+    // Sent requests that carry an `abandoned` flag, for cancel(). An exchange's
+    // `stream` pointer is only replaced under m_mutex, so cancel() may read it.
+    std::unordered_map<const std::atomic<bool>*, std::weak_ptr<exchange>> m_in_flight;
+    std::size_t m_next_worker = 0;      // rotates ties between equally loaded workers
+    std::uint64_t m_rejected = 0;
+    std::uint64_t m_cancelled = 0;
+
+    static bool abandoned(const exchange& ex) { return ex.work->abandoned && *ex.work->abandoned; }
+
+    worker* pick_worker_locked() {
+        worker* best = nullptr;
+        for (std::size_t n = 0; n < m_workers.size(); ++n) {
+            auto* w = m_workers[(m_next_worker + n) % m_workers.size()].get();
+            if (!w->healthy || w->outstanding >= m_config.max_in_flight_per_worker) continue;
+            if (!best || w->outstanding < best->outstanding) best = w;
+        }
+        if (best) m_next_worker = (m_next_worker + 1) % m_workers.size();
+        return best;
+    }
+
+    // Pairs queued jobs with free workers; the exchanges are started after
+    // the lock is released.
+    void drain_locked(std::vector<std::shared_ptr<exchange>>& ready) {
+        while (!m_queue.empty()) {
+            auto& front = m_queue.front();
+            if (front->abandoned && *front->abandoned) {
+                m_queue.pop_front();
+                continue;
+            }
+            auto* w = pick_worker_locked();
+            if (!w) return;
+
+            auto ex = std::make_shared<exchange>();
+            ex->work = std::move(front);
+            m_queue.pop_front();
+            ex->target = w;
+            ++w->outstanding;
+            ++w->requests;
+            if (!w->idle.empty()) {
+                ex->stream = std::move(w->idle.back());
+                w->idle.pop_back();
+                ex->reused = true;
+                ++w->reuses;
+            }
+            if (ex->work->abandoned) m_in_flight[ex->work->abandoned.get()] = ex;
+            ready.push_back(std::move(ex));
+        }
+    }
+
+    void start(std::shared_ptr<exchange> ex) {
+        const auto& req = ex->work->request;
+        std::string filename = req.filename;
+        std::erase(filename, '"');
+        ex->prefix = "--" + std::string{boundary} + "\r\n"
+                     "Content-Disposition: form-data; name=\"image_file\"; filename=\"" + filename + "\"\r\n"
+                     "Content-Type: " + req.content_type + "\r\n\r\n";
+        ex->suffix = "\r\n--" + std::string{boundary} + "--\r\n";
+
+        ex->header = {bhttp::verb::post, "/recognize_formula", 11};
+        ex->header.set(bhttp::field::host, ex->target->name);
+        ex->header.set(bhttp::field::user_agent, "GeeCodeX-Server");
+        ex->header.set(bhttp::field::content_type, "multipart/form-data; boundary=" + std::string{boundary});
+        ex->header.content_length(ex->prefix.size() + req.image.size() + ex->suffix.size());
+        ex->header.keep_alive(true);
+
+        if (ex->stream) return send(std::move(ex));
+        connect(std::move(ex));
+    }
+
+    void connect(std::shared_ptr<exchange> ex) {
+        ex->reused = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ex->stream = std::make_unique<beast::tcp_stream>(net::make_strand(m_executor));
+            ++ex->target->connects;
+        }
+        auto resolver = std::make_shared<tcp::resolver>(ex->stream->get_executor());
+        resolver->async_resolve(ex->target->host, ex->target->port, [this, ex, resolver](beast::error_code ec, tcp::resolver::results_type results) {
+            if (ec) return fail(ex, ec, "resolve");
+            if (abandoned(*ex)) return finish(ex, {}, false);
+            ex->stream->expires_after(m_config.connect_timeout);
+            ex->stream->async_connect(results, [this, ex](beast::error_code ec, const tcp::endpoint&) {
+                if (ec) return fail(ex, ec, "connect");
+                send(ex);
+            });
+        });
+    }
+
+    // Header, then prefix + image + suffix as one gathered write, so the
+    // multipart body is never assembled: the image is written from the job's
+    // own string (the upload part's bytes, moved rather than copied).
+    void send(std::shared_ptr<exchange> ex) {
+        if (abandoned(*ex)) return finish(std::move(ex), {}, false);
+        ex->stream->expires_after(m_config.request_timeout);
+        ex->serializer = std::make_unique<bhttp::request_serializer<bhttp::empty_body>>(ex->header);
+        bhttp::async_write_header(*ex->stream, *ex->serializer, [this, ex](beast::error_code ec, std::size_t) {
+            if (ec) return fail(ex, ec, "write");
+            std::array<net::const_buffer, 3> body{
+                net::buffer(ex->prefix), net::buffer(ex->work->request.image), net::buffer(ex->suffix)};
+            net::async_write(*ex->stream, body, [this, ex](beast::error_code ec, std::size_t) {
+                if (ec) return fail(ex, ec, "write");
+                ex->response = {};
+                bhttp::async_read(*ex->stream, ex->buffer, ex->response, [this, ex](beast::error_code ec, std::size_t) {
+                    if (ec) return fail(ex, ec, "read");
+                    ex->stream->expires_never();
+                    bool keep = ex->response.keep_alive();
+                    finish(ex, {ex->response.result_int(), std::move(ex->response.body())}, keep);
+                });
+            });
+        });
+    }
+
+    void fail(std::shared_ptr<exchange> ex, beast::error_code ec, const char* phase) {
+        if (abandoned(*ex)) return finish(std::move(ex), {}, false);
+        // A pooled connection may have been closed by the worker while idle;
+        // that is not the worker's fault, so retry once on a fresh one.
+        if (ex->reused && !ex->retried) {
+            ex->retried = true;
+            beast::error_code ignored;
+            ex->stream->socket().close(ignored);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ex->stream.reset();
+            }
+            return connect(std::move(ex));
+        }
+        SPDLOG_WARN("Formula worker {} {} failed: {}", ex->target->name, phase, ec.message());
+        nlohmann::json error_body;
+        error_body["error"] = "Recognition Worker Error";
+        error_body["message"] = std::string(phase) + " failed: " + ec.message();
+        finish(ex, {0, error_body.dump()}, false);
+    }
+
+    // A cancelled request (no reply and the client gone) releases its worker
+    // without counting against it and without calling `done`.
+    void finish(std::shared_ptr<exchange> ex, worker_reply reply, bool keep_connection) {
+        std::vector<std::shared_ptr<exchange>> ready;
+        const bool cancelled = reply.status == 0 && abandoned(*ex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto* w = ex->target;
+            --w->outstanding;
+            if (ex->work->abandoned) m_in_flight.erase(ex->work->abandoned.get());
+            if (cancelled) {}
+            else if (reply.status != 0 && reply.status < 500) w->consecutive_failures = 0;
+            else {
+                ++w->failures;
+                if (++w->consecutive_failures >= m_config.failure_threshold && w->healthy) {
+                    w->healthy = false;
+                    SPDLOG_WARN("Formula worker {} taken out of rotation", w->name);
+                }
+            }
+            if (keep_connection && ex->stream && w->idle.size() < m_config.max_idle_per_worker) w->idle.push_back(std::move(ex->stream));
+            drain_locked(ready);
+        }
+        for (auto& next: ready) start(next);
+        if (cancelled) return;
+
+        try {
+            ex->work->done(std::move(reply));
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("Formula worker completion threw: {}", e.what());
+        }
+    }
+
+    void schedule_probe(std::chrono::milliseconds delay) {
+        m_probe_timer.expires_after(delay);
+        m_probe_timer.async_wait([this](beast::error_code ec) {
+            if (ec) return;
+            for (auto& w: m_workers) probe(w.get());
+            schedule_probe(m_config.probe_interval);
+        });
+    }
+
+    void probe(worker* w) {
+        struct probe_state {
+            beast::tcp_stream stream;
+            tcp::resolver resolver;
+            bhttp::request<bhttp::empty_body> request;
+            beast::flat_buffer buffer;
+            bhttp::response<bhttp::string_body> response;
+            explicit probe_state(net::any_io_executor ex): stream{net::make_strand(ex)}, resolver{stream.get_executor()} {}
+        };
+        auto state = std::make_shared<probe_state>(m_executor);
+        state->request = {bhttp::verb::get, "/health", 11};
+        state->request.set(bhttp::field::host, w->name);
+        state->request.keep_alive(false);
+
+        auto report = [this, w](bool healthy) {
+            std::vector<std::shared_ptr<exchange>> ready;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (healthy != w->healthy) SPDLOG_INFO("Formula worker {} is {}", w->name, healthy ? "healthy" : "unhealthy");
+                w->healthy = healthy;
+                if (healthy) w->consecutive_failures = 0;
+                drain_locked(ready);
+            }
+            for (auto& next: ready) start(next);
+        };
+
+        state->resolver.async_resolve(w->host, w->port, [this, state, report](beast::error_code ec, tcp::resolver::results_type results) {
+            if (ec) return report(false);
+            state->stream.expires_after(m_config.connect_timeout);
+            state->stream.async_connect(results, [state, report](beast::error_code ec, const tcp::endpoint&) {
+                if (ec) return report(false);
+                bhttp::async_write(state->stream, state->request, [state, report](beast::error_code ec, std::size_t) {
+                    if (ec) return report(false);
+                    bhttp::async_read(state->stream, state->buffer, state->response, [state, report](beast::error_code ec, std::size_t) {
+                        report(!ec && state->response.result() == bhttp::status::ok);
+                        beast::error_code ignored;
+                        state->stream.socket().shutdown(tcp::socket::shutdown_both, ignored);
+                    });
+                });
+            });
+        });
+    }
+};
+
+namespace detail {
+inline std::atomic<formula_worker_pool*> formula_worker_pool_instance{nullptr};
+}
+
+// Lazily built on the first recognition request that needs it.
+inline formula_worker_pool& get_formula_worker_pool(net::any_io_executor executor) {
+    static formula_worker_pool instance{std::move(executor)};
+    detail::formula_worker_pool_instance.store(&instance, std::memory_order_release);
+    return instance;
+}
+
+// The pool if a request built it, else null; never builds it, so readers
+// such as the stats endpoint do not start connections and probes.
+inline formula_worker_pool* find_formula_worker_pool() {
+    return detail::formula_worker_pool_instance.load(std::memory_order_acquire);
+}
+
+}   // NAMESPACE GEECODEX::RECOGNITION
+#endif // FORMULA_WORKERS_HPP
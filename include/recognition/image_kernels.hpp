@@ -0,0 +1,564 @@
+#ifndef IMAGE_KERNELS_HPP
+#define IMAGE_KERNELS_HPP
+
+#include <utils/simd.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Preprocessing kernels for recognition input: colour -> grayscale, ink
+// bounding box, 2x box downscale, and a bilinear (downscale) or bicubic
+// (upscale) resize fused with the float normalisation. Every kernel writes
+// into caller-provided memory; the only buffers involved are the caller's
+// scratch structs, which grow to the largest image seen and are then reused.
+//
+// x86 picks AVX2 at run time, so the default build needs no -mavx2; aarch64
+// always has NEON. Each entry point has a scalar version in `scalar::` that
+// the SIMD paths must match bit for bit: float lanes use a separate multiply
+// and add in the scalar order, never a fused multiply-add, and the AVX2
+// functions are not compiled for FMA so the compiler cannot contract them
+// either. The preprocess benchmark fails when the outputs differ.
+namespace geecodex::recognition::kernels {
+
+// Read-only 8-bit single channel image; `stride` is in bytes.
+struct gray_view {
+    const std::uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    std::ptrdiff_t stride = 0;
+
+    [[nodiscard]] const std::uint8_t* row(int y) const { return data + y * stride; }
+    [[nodiscard]] gray_view crop(int x, int y, int w, int h) const { return {row(y) + x, w, h, stride}; }
+};
+
+struct rect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+struct resize_scratch {
+    std::vector<float> row;
+    std::vector<std::int32_t> x0;
+    std::vector<float> wx;
+    std::vector<float> rows;        // bicubic: every source row, resampled horizontally
+    std::vector<float> weights;     // bicubic: 4 tap weights per destination column
+};
+
+struct preprocess_scratch {
+    std::array<std::vector<std::uint8_t>, 2> half;     // ping-pong buffers for repeated halving
+    resize_scratch resize;
+};
+
+using utils::isa;
+using utils::active_isa;
+using utils::isa_name;
+
+// ITU-R BT.601 luma in 8.8 fixed point: (77 R + 150 G + 29 B + 128) >> 8.
+inline constexpr std::uint16_t luma_r = 77;
+inline constexpr std::uint16_t luma_g = 150;
+inline constexpr std::uint16_t luma_b = 29;
+
+namespace scalar {
+
+inline void rgb_to_gray_row(const std::uint8_t* src, int width, bool bgr, std::uint8_t* dst) {
+    const unsigned wr = bgr ? luma_b : luma_r;
+    const unsigned wb = bgr ? luma_r : luma_b;
+    for (int x = 0; x < width; ++x, src += 3)
+        dst[x] = static_cast<std::uint8_t>((wr * src[0] + luma_g * src[1] + wb * src[2] + 128) >> 8);
+}
+
+inline void halve_row(const std::uint8_t* r0, const std::uint8_t* r1, int dst_width, std::uint8_t* dst) {
+    for (int x = 0; x < dst_width; ++x)
+        dst[x] = static_cast<std::uint8_t>((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+}
+
+inline void blend_rows(const std::uint8_t* r0, const std::uint8_t* r1, float wy, int width, float* out) {
+    for (int x = 0; x < width; ++x) {
+        const float a = r0[x];
+        out[x] = a + (static_cast<float>(r1[x]) - a) * wy;
+    }
+}
+
+inline void sample_row(const float* row, const std::int32_t* x0, const float* wx, int width, float scale, float bias, float* out) {
+    for (int x = 0; x < width; ++x) {
+        const float a = row[x0[x]];
+        out[x] = (a + (row[x0[x] + 1] - a) * wx[x]) * scale + bias;
+    }
+}
+
+inline void minmax_row(const std::uint8_t* row, int width, std::uint8_t& lo, std::uint8_t& hi) {
+    for (int x = 0; x < width; ++x) {
+        lo = std::min(lo, row[x]);
+        hi = std::max(hi, row[x]);
+    }
+}
+
+// Index of the first / last pixel below `cutoff`; width / -1 when none.
+inline int first_below(const std::uint8_t* row, int width, std::uint8_t cutoff) {
+    int x = 0;
+    while (x < width && row[x] >= cutoff) ++x;
+    return x;
+}
+
+inline int last_below(const std::uint8_t* row, int width, std::uint8_t cutoff) {
+    int x = width - 1;
+    while (x >= 0 && row[x] >= cutoff) --x;
+    return x;
+}
+
+}   // namespace scalar
+
+#if defined(GEECODEX_SIMD_X86)
+namespace avx2 {
+
+// Byte shuffles pulling channel `k` of 16 interleaved RGB pixels out of the
+// three 16-byte loads a, b, c; -1 lanes are zeroed by pshufb.
+constexpr std::array<std::int8_t, 16> deinterleave_mask(int channel, int part) {
+    std::array<std::int8_t, 16> mask{};
+    for (int i = 0; i < 16; ++i) {
+        const int src = 3 * i + channel;
+        mask[static_cast<std::size_t>(i)] = (src >= 16 * part && src < 16 * (part + 1)) ? static_cast<std::int8_t>(src - 16 * part) : std::int8_t{-1};
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+inline __m128i gather_channel(__m128i a, __m128i b, __m128i c, int channel) {
+    static constexpr std::array<std::array<std::array<std::int8_t, 16>, 3>, 3> masks{{
+        {deinterleave_mask(0, 0), deinterleave_mask(0, 1), deinterleave_mask(0, 2)},
+        {deinterleave_mask(1, 0), deinterleave_mask(1, 1), deinterleave_mask(1, 2)},
+        {deinterleave_mask(2, 0), deinterleave_mask(2, 1), deinterleave_mask(2, 2)}}};
+    const auto& m = masks[static_cast<std::size_t>(channel)];
+    __m128i out = _mm_shuffle_epi8(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(m[0].data())));
+    out = _mm_or_si128(out, _mm_shuffle_epi8(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(m[1].data()))));
+    return _mm_or_si128(out, _mm_shuffle_epi8(c, _mm_loadu_si128(reinterpret_cast<const __m128i*>(m[2].data()))));
+}
+
+__attribute__((target("avx2")))
+inline void rgb_to_gray_row(const std::uint8_t* src, int width, bool bgr, std::uint8_t* dst) {
+    const __m256i w0 = _mm256_set1_epi16(static_cast<short>(bgr ? luma_b : luma_r));
+    const __m256i w1 = _mm256_set1_epi16(static_cast<short>(luma_g));
+    const __m256i w2 = _mm256_set1_epi16(static_cast<short>(bgr ? luma_r : luma_b));
+    const __m256i round = _mm256_set1_epi16(128);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const auto* p = reinterpret_cast<const __m128i*>(src + 3 * x);
+        const __m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1), c = _mm_loadu_si128(p + 2);
+        // Sums stay below 2^16 (255 * 256 + 128), so 16-bit lanes suffice.
+        __m256i sum = _mm256_mullo_epi16(_mm256_cvtepu8_epi16(gather_channel(a, b, c, 0)), w0);
+        sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(gather_channel(a, b, c, 1)), w1));
+        sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(gather_channel(a, b, c, 2)), w2));
+        sum = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 8);
+        const __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+    }
+    scalar::rgb_to_gray_row(src + 3 * x, width - x, bgr, dst + x);
+}
+
+__attribute__((target("avx2")))
+inline void halve_row(const std::uint8_t* r0, const std::uint8_t* r1, int dst_width, std::uint8_t* dst) {
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi16(2);
+    int x = 0;
+    for (; x + 32 <= dst_width; x += 32) {
+        // maddubs against ones adds horizontal byte pairs into 16-bit lanes.
+        const auto* a = reinterpret_cast<const __m256i*>(r0 + 2 * x);
+        const auto* b = reinterpret_cast<const __m256i*>(r1 + 2 * x);
+        const __m256i sum_lo = _mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(a), ones), _mm256_maddubs_epi16(_mm256_loadu_si256(b), ones));
+        const __m256i sum_hi = _mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(a + 1), ones), _mm256_maddubs_epi16(_mm256_loadu_si256(b + 1), ones));
+        const __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(sum_lo, two), 2);
+        const __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(sum_hi, two), 2);
+        // packus works per 128-bit lane; restore the linear order.
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packed);
+    }
+    scalar::halve_row(r0 + 2 * x, r1 + 2 * x, dst_width - x, dst + x);
+}
+
+__attribute__((target("avx2")))
+inline void blend_rows(const std::uint8_t* r0, const std::uint8_t* r1, float wy, int width, float* out) {
+    const __m256 w = _mm256_set1_ps(wy);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r0 + x))));
+        const __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r1 + x))));
+        _mm256_storeu_ps(out + x, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), w)));
+    }
+    scalar::blend_rows(r0 + x, r1 + x, wy, width - x, out + x);
+}
+
+__attribute__((target("avx2")))
+inline void sample_row(const float* row, const std::int32_t* x0, const float* wx, int width, float scale, float bias, float* out) {
+    const __m256 s = _mm256_set1_ps(scale);
+    const __m256 o = _mm256_set1_ps(bias);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x0 + x));
+        const __m256 a = _mm256_i32gather_ps(row, idx, 4);
+        const __m256 b = _mm256_i32gather_ps(row + 1, idx, 4);
+        const __m256 v = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), _mm256_loadu_ps(wx + x)));
+        _mm256_storeu_ps(out + x, _mm256_add_ps(_mm256_mul_ps(v, s), o));
+    }
+    scalar::sample_row(row, x0 + x, wx + x, width - x, scale, bias, out + x);
+}
+
+__attribute__((target("avx2")))
+inline void minmax_row(const std::uint8_t* row, int width, std::uint8_t& lo, std::uint8_t& hi) {
+    __m256i vlo = _mm256_set1_epi8(static_cast<char>(lo));
+    __m256i vhi = _mm256_set1_epi8(static_cast<char>(hi));
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        vlo = _mm256_min_epu8(vlo, v);
+        vhi = _mm256_max_epu8(vhi, v);
+    }
+    alignas(32) std::uint8_t lanes_lo[32], lanes_hi[32];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes_lo), vlo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes_hi), vhi);
+    for (int i = 0; i < 32; ++i) {
+        lo = std::min(lo, lanes_lo[i]);
+        hi = std::max(hi, lanes_hi[i]);
+    }
+    scalar::minmax_row(row + x, width - x, lo, hi);
+}
+
+// Bit i set when byte i of `v` is below `cutoff` (cutoff >= 1).
+__attribute__((target("avx2")))
+inline std::uint32_t below_mask(__m256i v, __m256i limit) {
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v)));
+}
+
+__attribute__((target("avx2")))
+inline int first_below(const std::uint8_t* row, int width, std::uint8_t cutoff) {
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(cutoff - 1));
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        if (auto mask = below_mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x)), limit))
+            return x + __builtin_ctz(mask);
+    }
+    return x + scalar::first_below(row + x, width - x, cutoff);
+}
+
+__attribute__((target("avx2")))
+inline int last_below(const std::uint8_t* row, int width, std::uint8_t cutoff) {
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(cutoff - 1));
+    int end = width;
+    for (; end >= 32; end -= 32) {
+        if (auto mask = below_mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + end - 32)), limit))
+            return end - 1 - __builtin_clz(mask);
+    }
+    return scalar::last_below(row, end, cutoff);
+}
+
+}   // namespace avx2
+#endif
+
+#if defined(GEECODEX_SIMD_NEON)
+namespace neon {
+
+inline void rgb_to_gray_row(const std::uint8_t* src, int width, bool bgr, std::uint8_t* dst) {
+    const uint8x8_t w0 = vdup_n_u8(static_cast<std::uint8_t>(bgr ? luma_b : luma_r));
+    const uint8x8_t w1 = vdup_n_u8(static_cast<std::uint8_t>(luma_g));
+    const uint8x8_t w2 = vdup_n_u8(static_cast<std::uint8_t>(bgr ? luma_r : luma_b));
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x3_t px = vld3q_u8(src + 3 * x);
+        uint16x8_t lo = vmull_u8(vget_low_u8(px.val[0]), w0);
+        lo = vmlal_u8(lo, vget_low_u8(px.val[1]), w1);
+        lo = vmlal_u8(lo, vget_low_u8(px.val[2]), w2);
+        uint16x8_t hi = vmull_u8(vget_high_u8(px.val[0]), w0);
+        hi = vmlal_u8(hi, vget_high_u8(px.val[1]), w1);
+        hi = vmlal_u8(hi, vget_high_u8(px.val[2]), w2);
+        vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+    scalar::rgb_to_gray_row(src + 3 * x, width - x, bgr, dst + x);
+}
+
+inline void halve_row(const std::uint8_t* r0, const std::uint8_t* r1, int dst_width, std::uint8_t* dst) {
+    int x = 0;
+    for (; x + 8 <= dst_width; x += 8) {
+        uint16x8_t sum = vpaddlq_u8(vld1q_u8(r0 + 2 * x));
+        sum = vpadalq_u8(sum, vld1q_u8(r1 + 2 * x));
+        vst1_u8(dst + x, vrshrn_n_u16(sum, 2));
+    }
+    scalar::halve_row(r0 + 2 * x, r1 + 2 * x, dst_width - x, dst + x);
+}
+
+inline void blend_rows(const std::uint8_t* r0, const std::uint8_t* r1, float wy, int width, float* out) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const uint16x8_t a16 = vmovl_u8(vld1_u8(r0 + x));
+        const uint16x8_t b16 = vmovl_u8(vld1_u8(r1 + x));
+        const float32x4_t a_lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(a16)));
+        const float32x4_t a_hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(a16)));
+        const float32x4_t b_lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(b16)));
+        const float32x4_t b_hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(b16)));
+        vst1q_f32(out + x, vaddq_f32(a_lo, vmulq_n_f32(vsubq_f32(b_lo, a_lo), wy)));
+        vst1q_f32(out + x + 4, vaddq_f32(a_hi, vmulq_n_f32(vsubq_f32(b_hi, a_hi), wy)));
+    }
+    scalar::blend_rows(r0 + x, r1 + x, wy, width - x, out + x);
+}
+
+inline void minmax_row(const std::uint8_t* row, int width, std::uint8_t& lo, std::uint8_t& hi) {
+    uint8x16_t vlo = vdupq_n_u8(lo);
+    uint8x16_t vhi = vdupq_n_u8(hi);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16_t v = vld1q_u8(row + x);
+        vlo = vminq_u8(vlo, v);
+        vhi = vmaxq_u8(vhi, v);
+    }
+    lo = vminvq_u8(vlo);
+    hi = vmaxvq_u8(vhi);
+    scalar::minmax_row(row + x, width - x, lo, hi);
+}
+
+inline int first_below(const std::uint8_t* row, int width, std::uint8_t cutoff) {
+    const uint8x16_t limit = vdupq_n_u8(cutoff);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        if (vmaxvq_u8(vcltq_u8(vld1q_u8(row + x), limit)))
+            return x + scalar::first_below(row + x, 16, cutoff);
+    }
+    return x + scalar::first_below(row + x, width - x, cutoff);
+}
+
+inline int last_below(const std::uint8_t* row, int width, std::uint8_t cutoff) {
+    const uint8x16_t limit = vdupq_n_u8(cutoff);
+    int end = width;
+    for (; end >= 16; end -= 16) {
+        if (vmaxvq_u8(vcltq_u8(vld1q_u8(row + end - 16), limit)))
+            return end - 16 + scalar::last_below(row + end - 16, 16, cutoff);
+    }
+    return scalar::last_below(row, end, cutoff);
+}
+
+}   // namespace neon
+#endif
+
+// Converts interleaved 8-bit RGB (or BGR, as OpenCV decodes) to gray.
+inline void rgb_to_gray(const std::uint8_t* src, std::ptrdiff_t src_stride, int width, int height, bool bgr,
+                        std::uint8_t* dst, std::ptrdiff_t dst_stride, isa which = active_isa()) {
+    for (int y = 0; y < height; ++y) {
+        const auto* in = src + y * src_stride;
+        auto* out = dst + y * dst_stride;
+#if defined(GEECODEX_SIMD_X86)
+        if (which == isa::avx2) { avx2::rgb_to_gray_row(in, width, bgr, out); continue; }
+#elif defined(GEECODEX_SIMD_NEON)
+        if (which == isa::neon) { neon::rgb_to_gray_row(in, width, bgr, out); continue; }
+#endif
+        scalar::rgb_to_gray_row(in, width, bgr, out);
+    }
+    (void)which;
+}
+
+// Bounding box of the "ink": pixels that would fall below 200 after
+// stretching the image to the full 0..255 range. A blank image (or one
+// without a single light pixel) keeps its full extent.
+inline rect ink_bounds(const gray_view& image, isa which = active_isa()) {
+    auto minmax_row  = scalar::minmax_row;
+    auto first_below = scalar::first_below;
+    auto last_below  = scalar::last_below;
+#if defined(GEECODEX_SIMD_X86)
+    if (which == isa::avx2) { minmax_row = avx2::minmax_row; first_below = avx2::first_below; last_below = avx2::last_below; }
+#elif defined(GEECODEX_SIMD_NEON)
+    if (which == isa::neon) { minmax_row = neon::minmax_row; first_below = neon::first_below; last_below = neon::last_below; }
+#endif
+    (void)which;
+
+    rect full{0, 0, image.width, image.height};
+    std::uint8_t lo = 255, hi = 0;
+    for (int y = 0; y < image.height; ++y) minmax_row(image.row(y), image.width, lo, hi);
+    if (hi <= lo) return full;
+
+    // (p - lo) * 255 / (hi - lo) rounds below 200 iff (p - lo) * 510 < 399 * (hi - lo).
+    const int span = hi - lo;
+    int cutoff = lo;
+    while (cutoff <= hi && (cutoff - lo) * 510 < 399 * span) ++cutoff;
+    const auto limit = static_cast<std::uint8_t>(cutoff);
+
+    int top = image.height, bottom = -1, left = image.width, right = -1;
+    for (int y = 0; y < image.height; ++y) {
+        const auto* row = image.row(y);
+        const int first = first_below(row, image.width, limit);
+        if (first == image.width) continue;
+        const int last = last_below(row, image.width, limit);
+        top = std::min(top, y);
+        bottom = y;
+        left = std::min(left, first);
+        right = std::max(right, last);
+    }
+    if (bottom < 0) return full;
+    return {left, top, right - left + 1, bottom - top + 1};
+}
+
+// 2x2 box average; `dst` receives (width / 2) x (height / 2) pixels.
+inline void halve(const gray_view& src, std::uint8_t* dst, std::ptrdiff_t dst_stride, isa which = active_isa()) {
+    const int dst_width = src.width / 2;
+    const int dst_height = src.height / 2;
+    for (int y = 0; y < dst_height; ++y) {
+        const auto* r0 = src.row(2 * y);
+        const auto* r1 = src.row(2 * y + 1);
+        auto* out = dst + y * dst_stride;
+#if defined(GEECODEX_SIMD_X86)
+        if (which == isa::avx2) { avx2::halve_row(r0, r1, dst_width, out); continue; }
+#elif defined(GEECODEX_SIMD_NEON)
+        if (which == isa::neon) { neon::halve_row(r0, r1, dst_width, out); continue; }
+#endif
+        scalar::halve_row(r0, r1, dst_width, out);
+    }
+    (void)which;
+}
+
+// Bilinear resize (pixel-centre aligned, like cv::INTER_LINEAR) to
+// dst_width x dst_height, writing `pixel * scale + bias` as floats.
+// `dst_stride` is in floats.
+inline void resize_normalize(const gray_view& src, float* dst, std::ptrdiff_t dst_stride, int dst_width, int dst_height,
+                             float scale, float bias, resize_scratch& scratch, isa which = active_isa()) {
+    if (src.width <= 0 || src.height <= 0 || dst_width <= 0 || dst_height <= 0) return;
+
+    // One spare float so the right neighbour of the last column is readable.
+    scratch.row.resize(static_cast<std::size_t>(src.width) + 1);
+    scratch.x0.resize(static_cast<std::size_t>(dst_width));
+    scratch.wx.resize(static_cast<std::size_t>(dst_width));
+
+    const float ratio_x = static_cast<float>(src.width) / static_cast<float>(dst_width);
+    for (int x = 0; x < dst_width; ++x) {
+        const float fx = std::clamp((static_cast<float>(x) + 0.5f) * ratio_x - 0.5f, 0.0f, static_cast<float>(src.width - 1));
+        const auto x0 = static_cast<std::int32_t>(fx);
+        scratch.x0[static_cast<std::size_t>(x)] = x0;
+        scratch.wx[static_cast<std::size_t>(x)] = fx - static_cast<float>(x0);
+    }
+
+    const float ratio_y = static_cast<float>(src.height) / static_cast<float>(dst_height);
+    for (int y = 0; y < dst_height; ++y) {
+        const float fy = std::clamp((static_cast<float>(y) + 0.5f) * ratio_y - 0.5f, 0.0f, static_cast<float>(src.height - 1));
+        const int y0 = static_cast<int>(fy);
+        const int y1 = std::min(y0 + 1, src.height - 1);
+        const float wy = fy - static_cast<float>(y0);
+        float* row = scratch.row.data();
+        float* out = dst + y * dst_stride;
+
+#if defined(GEECODEX_SIMD_X86)
+        if (which == isa::avx2) {
+            avx2::blend_rows(src.row(y0), src.row(y1), wy, src.width, row);
+            row[src.width] = row[src.width - 1];
+            avx2::sample_row(row, scratch.x0.data(), scratch.wx.data(), dst_width, scale, bias, out);
+            continue;
+        }
+#elif defined(GEECODEX_SIMD_NEON)
+        if (which == isa::neon) {
+            neon::blend_rows(src.row(y0), src.row(y1), wy, src.width, row);
+            row[src.width] = row[src.width - 1];
+            scalar::sample_row(row, scratch.x0.data(), scratch.wx.data(), dst_width, scale, bias, out);
+            continue;
+        }
+#endif
+        scalar::blend_rows(src.row(y0), src.row(y1), wy, src.width, row);
+        row[src.width] = row[src.width - 1];
+        scalar::sample_row(row, scratch.x0.data(), scratch.wx.data(), dst_width, scale, bias, out);
+    }
+    (void)which;
+}
+
+// Catmull-Rom weights with a = -0.75, as cv::INTER_CUBIC, for a sample at
+// fraction `t` past the second of four taps.
+inline void cubic_weights(float t, float* w) {
+    constexpr float a = -0.75f;
+    const float t1 = t + 1.0f, u = 1.0f - t;
+    w[0] = ((a * t1 - 5.0f * a) * t1 + 8.0f * a) * t1 - 4.0f * a;
+    w[1] = ((a + 2.0f) * t - (a + 3.0f)) * t * t + 1.0f;
+    w[2] = ((a + 2.0f) * u - (a + 3.0f)) * u * u + 1.0f;
+    w[3] = 1.0f - w[0] - w[1] - w[2];
+}
+
+// Bicubic resize (pixel-centre aligned, edge pixels replicated, like
+// cv::INTER_CUBIC) for enlarging, writing `pixel * scale + bias` as floats.
+// Each result is rounded and clamped to 0..255 first, as the 8-bit resize it
+// replaces did, so overshoot at sharp strokes does not leave the pixel range.
+// Upscaled sources are at most the output size, so this stays scalar.
+inline void resize_cubic_normalize(const gray_view& src, float* dst, std::ptrdiff_t dst_stride, int dst_width, int dst_height,
+                                   float scale, float bias, resize_scratch& scratch) {
+    if (src.width <= 0 || src.height <= 0 || dst_width <= 0 || dst_height <= 0) return;
+
+    scratch.x0.resize(static_cast<std::size_t>(dst_width));
+    scratch.weights.resize(static_cast<std::size_t>(dst_width) * 4);
+    scratch.rows.resize(static_cast<std::size_t>(src.height) * static_cast<std::size_t>(dst_width));
+
+    auto clamp_x = [&](int x) { return std::clamp(x, 0, src.width - 1); };
+    auto clamp_y = [&](int y) { return std::clamp(y, 0, src.height - 1); };
+
+    const float ratio_x = static_cast<float>(src.width) / static_cast<float>(dst_width);
+    for (int x = 0; x < dst_width; ++x) {
+        const float fx = (static_cast<float>(x) + 0.5f) * ratio_x - 0.5f;
+        const float sx = std::floor(fx);
+        scratch.x0[static_cast<std::size_t>(x)] = static_cast<std::int32_t>(sx) - 1;
+        cubic_weights(fx - sx, &scratch.weights[static_cast<std::size_t>(x) * 4]);
+    }
+    for (int y = 0; y < src.height; ++y) {
+        const auto* in = src.row(y);
+        float* out = &scratch.rows[static_cast<std::size_t>(y) * static_cast<std::size_t>(dst_width)];
+        for (int x = 0; x < dst_width; ++x) {
+            const int x0 = scratch.x0[static_cast<std::size_t>(x)];
+            const float* w = &scratch.weights[static_cast<std::size_t>(x) * 4];
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) sum += w[k] * static_cast<float>(in[clamp_x(x0 + k)]);
+            out[x] = sum;
+        }
+    }
+
+    const float ratio_y = static_cast<float>(src.height) / static_cast<float>(dst_height);
+    for (int y = 0; y < dst_height; ++y) {
+        const float fy = (static_cast<float>(y) + 0.5f) * ratio_y - 0.5f;
+        const float sy = std::floor(fy);
+        float w[4];
+        cubic_weights(fy - sy, w);
+        const float* taps[4];
+        for (int k = 0; k < 4; ++k)
+            taps[k] = &scratch.rows[static_cast<std::size_t>(clamp_y(static_cast<int>(sy) - 1 + k)) * static_cast<std::size_t>(dst_width)];
+        float* out = dst + y * dst_stride;
+        for (int x = 0; x < dst_width; ++x) {
+            const float v = w[0] * taps[0][x] + w[1] * taps[1][x] + w[2] * taps[2][x] + w[3] * taps[3][x];
+            out[x] = std::clamp(std::nearbyint(v), 0.0f, 255.0f) * scale + bias;
+        }
+    }
+}
+
+// The whole recognition preprocessing after decode: crop to the ink, fit
+// into out_width x out_height keeping the aspect ratio, centred on black
+// (`bias`), normalised. Large downscales are first halved with a box filter
+// so bilinear sampling does not alias; enlargements are bicubic.
+inline void fit_normalize(gray_view image, float* out, int out_width, int out_height,
+                          float scale, float bias, preprocess_scratch& scratch, isa which = active_isa()) {
+    const auto box = ink_bounds(image, which);
+    image = image.crop(box.x, box.y, box.width, box.height);
+
+    const double fit = std::min(static_cast<double>(out_width) / image.width, static_cast<double>(out_height) / image.height);
+    const int resized_w = std::clamp(static_cast<int>(image.width * fit + 0.5), 1, out_width);
+    const int resized_h = std::clamp(static_cast<int>(image.height * fit + 0.5), 1, out_height);
+
+    std::size_t target = 0;
+    while (image.width >= 2 * resized_w && image.height >= 2 * resized_h) {
+        auto& half = scratch.half[target];
+        const int half_w = image.width / 2;
+        const int half_h = image.height / 2;
+        half.resize(static_cast<std::size_t>(half_w) * static_cast<std::size_t>(half_h));
+        halve(image, half.data(), half_w, which);
+        image = {half.data(), half_w, half_h, half_w};
+        target ^= 1;
+    }
+
+    std::fill_n(out, static_cast<std::size_t>(out_width) * static_cast<std::size_t>(out_height), bias);
+    float* region = out + static_cast<std::ptrdiff_t>((out_height - resized_h) / 2) * out_width + (out_width - resized_w) / 2;
+    if (fit >= 1.0) resize_cubic_normalize(image, region, out_width, resized_w, resized_h, scale, bias, scratch.resize);
+    else resize_normalize(image, region, out_width, resized_w, resized_h, scale, bias, scratch.resize, which);
+}
+
+}   // NAMESPACE GEECODEX::RECOGNITION::KERNELS
+#endif // IMAGE_KERNELS_HPP
@@ -0,0 +1,140 @@
+#ifndef LATEX_TOKENIZER_HPP
+#define LATEX_TOKENIZER_HPP
+
+#include <json.hpp>
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace geecodex::recognition {
+
+// Turns PP-FormulaNet output token ids back into LaTeX.
+// Reads the HuggingFace `tokenizer.json` exported next to the model
+// (byte-level BPE, as used by UniMERNet / PP-FormulaNet).
+class latex_tokenizer {
+public:
+    latex_tokenizer() = default;
+
+    explicit latex_tokenizer(const std::string& tokenizer_json_path) {
+        std::ifstream in(tokenizer_json_path);
+        if (!in) throw std::runtime_error("Cannot open tokenizer file: " + tokenizer_json_path);
+        load(nlohmann::json::parse(in));
+    }
+
+    void load(const nlohmann::json& tokenizer) {
+        if (!tokenizer.contains("model") || !tokenizer["model"].contains("vocab") || !tokenizer["model"]["vocab"].is_object())
+            throw std::runtime_error("tokenizer.json has no model.vocab");
+
+        for (const auto& [token, id]: tokenizer["model"]["vocab"].items()) set_token(id.get<std::int64_t>(), token);
+
+        if (tokenizer.contains("added_tokens") && tokenizer["added_tokens"].is_array()) {
+            for (const auto& added: tokenizer["added_tokens"]) {
+                auto id = added.value("id", std::int64_t{-1});
+                auto content = added.value("content", std::string{});
+                if (id < 0) continue;
+                set_token(id, content);
+                if (added.value("special", false)) m_special.insert(id);
+                if (content == "</s>") m_eos_id = id;
+            }
+        }
+    }
+
+    [[nodiscard]] bool empty() const { return m_id_to_token.empty(); }
+
+    // Stops at </s>, drops special tokens, undoes the byte-level encoding and
+    // normalises whitespace the way PaddleX's UniMERNetDecode does.
+    std::string decode(const std::int64_t* ids, std::size_t count) const {
+        std::string pieces;
+        for (std::size_t i = 0; i < count; ++i) {
+            auto id = ids[i];
+            if (id == m_eos_id) break;
+            if (id < 0 || static_cast<std::size_t>(id) >= m_id_to_token.size() || m_special.contains(id)) continue;
+            pieces += m_id_to_token[static_cast<std::size_t>(id)];
+        }
+        return normalize(byte_level_decode(pieces));
+    }
+
+    // Whitespace only survives between two letters (`\alpha x`) or as an
+    // escaped space (`\ `); everything else is glued together.
+    static std::string normalize(std::string_view text) {
+        std::string out;
+        out.reserve(text.size());
+        std::size_t i = 0;
+        while (i < text.size()) {
+            if (!std::isspace(static_cast<unsigned char>(text[i]))) {
+                out.push_back(text[i++]);
+                continue;
+            }
+            while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) ++i;
+            if (out.empty() || i == text.size()) continue;
+
+            char before = out.back();
+            char after = text[i];
+            if (before == '\\' || (std::isalpha(static_cast<unsigned char>(before)) && std::isalpha(static_cast<unsigned char>(after))))
+                out.push_back(' ');
+        }
+        return out;
+    }
+
+private:
+    std::vector<std::string> m_id_to_token;
+    std::unordered_set<std::int64_t> m_special;
+    std::int64_t m_eos_id = 2;
+
+    void set_token(std::int64_t id, const std::string& token) {
+        if (id < 0) return;
+        if (static_cast<std::size_t>(id) >= m_id_to_token.size()) m_id_to_token.resize(static_cast<std::size_t>(id) + 1);
+        m_id_to_token[static_cast<std::size_t>(id)] = token;
+    }
+
+    // Inverse of GPT-2's bytes_to_unicode(): printable bytes map to
+    // themselves, the remaining 68 bytes to code points 256..323.
+    static const std::array<int, 324>& unicode_to_byte() {
+        static const std::array<int, 324> table = [] {
+            std::array<int, 324> t{};
+            t.fill(-1);
+            int extra = 0;
+            for (int b = 0; b < 256; ++b) {
+                bool printable = (b >= 33 && b <= 126) || (b >= 161 && b <= 172) || (b >= 174 && b <= 255);
+                if (printable) t[static_cast<std::size_t>(b)] = b;
+                else t[static_cast<std::size_t>(256 + extra++)] = b;
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    static std::string byte_level_decode(std::string_view utf8) {
+        const auto& table = unicode_to_byte();
+        std::string out;
+        out.reserve(utf8.size());
+        for (std::size_t i = 0; i < utf8.size();) {
+            auto lead = static_cast<unsigned char>(utf8[i]);
+            std::uint32_t cp = lead;
+            std::size_t len = 1;
+            if (lead >= 0xC0 && lead < 0xE0 && i + 1 < utf8.size()) {
+                cp = ((lead & 0x1Fu) << 6) | (static_cast<unsigned char>(utf8[i + 1]) & 0x3Fu);
+                len = 2;
+            } else if (lead >= 0xE0 && lead < 0xF0 && i + 2 < utf8.size()) {
+                cp = ((lead & 0x0Fu) << 12) | ((static_cast<unsigned char>(utf8[i + 1]) & 0x3Fu) << 6)
+                   | (static_cast<unsigned char>(utf8[i + 2]) & 0x3Fu);
+                len = 3;
+            }
+
+            if (cp < table.size() && table[cp] >= 0) out.push_back(static_cast<char>(table[cp]));
+            else out.append(utf8.substr(i, len));   // not byte-level encoded, keep as is
+            i += len;
+        }
+        return out;
+    }
+};
+
+}   // NAMESPACE GEECODEX::RECOGNITION
+#endif // LATEX_TOKENIZER_HPP
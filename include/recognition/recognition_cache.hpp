@@ -0,0 +1,384 @@
+#ifndef RECOGNITION_CACHE_HPP
+#define RECOGNITION_CACHE_HPP
+
+#include <database/db_async.hpp>
+#include <json.hpp>
+#include <utils/env.hpp>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef GEECODEX_WITH_ONNXRUNTIME
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#endif
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::recognition {
+namespace net = boost::asio;
+
+struct recognition_cache_config {
+    std::size_t max_entries = 16'384;
+    bool perceptual = false;        // also match near-duplicate photos by dHash
+    int max_distance = 4;           // Hamming distance still treated as the same image, 0-15
+    bool use_db = false;            // read through / write through `formula_cache`
+    std::chrono::seconds hits_flush_interval{10};   // database hit counters are batched this long
+
+    // GEECODEX_RECOGNITION_CACHE_MAX, GEECODEX_RECOGNITION_CACHE_PHASH,
+    // GEECODEX_RECOGNITION_CACHE_PHASH_DISTANCE and GEECODEX_RECOGNITION_CACHE_DB.
+    static recognition_cache_config from_env() {
+        recognition_cache_config config;
+        config.max_entries = static_cast<std::size_t>(utils::env_int("GEECODEX_RECOGNITION_CACHE_MAX", static_cast<long long>(config.max_entries)));
+        config.perceptual = utils::env_flag("GEECODEX_RECOGNITION_CACHE_PHASH", config.perceptual);
+        config.max_distance = static_cast<int>(std::clamp(utils::env_int("GEECODEX_RECOGNITION_CACHE_PHASH_DISTANCE", config.max_distance), 0LL, 15LL));
+        config.use_db = utils::env_flag("GEECODEX_RECOGNITION_CACHE_DB", config.use_db);
+        return config;
+    }
+};
+
+// Identity of an uploaded image: BLAKE2s-256 of the bytes, plus a 64-bit
+// difference hash of the picture once a perceptual lookup computed one.
+struct image_key {
+    std::string digest;
+    std::optional<std::uint64_t> dhash;
+};
+
+// Thread uploads are hashed (and decoded for the dHash) on, instead of the
+// I/O thread that received them or the inference threads.
+inline net::thread_pool& get_image_hash_pool() {
+    static net::thread_pool pool{2};
+    return pool;
+}
+
+// Recognition results by image. The cached value is the JSON reply body, so
+// a hit is answered without touching the engine or the workers. key_for()
+// and find() hash and may decode the image: call them on get_image_hash_pool().
+//
+// Exact hits need the identical file. With perceptual matching enabled, a
+// miss decodes the image once more to compare its dHash against the cached
+// ones, which catches re-encoded or re-scaled copies of the same photo. The
+// dHashes are indexed by max_distance + 1 disjoint bit ranges: two hashes
+// within that distance agree exactly on at least one range, so a lookup only
+// compares the entries sharing one of its ranges instead of every entry.
+// The database tier only stores exact digests; its hit counters are summed
+// in memory and written in one statement per hits_flush_interval, along
+// with the next database lookup or store.
+class recognition_cache {
+public:
+    explicit recognition_cache(recognition_cache_config config = recognition_cache_config::from_env())
+        : m_config{config} {
+#ifndef GEECODEX_WITH_ONNXRUNTIME
+        m_config.perceptual = false;    // needs OpenCV to decode
+#endif
+    }
+
+    [[nodiscard]] bool enabled() const { return m_config.max_entries > 0; }
+    [[nodiscard]] bool db_enabled() const { return m_config.use_db; }
+
+    static image_key key_for(std::string_view image) {
+        unsigned char digest[32];
+        unsigned int length = 0;
+        if (EVP_Digest(image.data(), image.size(), digest, &length, EVP_blake2s256(), nullptr) != 1)
+            throw std::runtime_error("EVP_Digest(blake2s256) failed");
+        static constexpr char hex[] = "0123456789abcdef";
+        image_key key;
+        key.digest.reserve(length * 2);
+        for (unsigned int i = 0; i < length; ++i) {
+            key.digest.push_back(hex[digest[i] >> 4]);
+            key.digest.push_back(hex[digest[i] & 0x0f]);
+        }
+        return key;
+    }
+
+    // Reply body for the image, or nullopt. Fills key.dhash when the
+    // perceptual pass ran, so put() can store it without decoding again.
+    std::optional<std::string> find(image_key& key, std::string_view image) {
+        if (!enabled()) return std::nullopt;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (auto it = m_entries.find(key.digest); it != m_entries.end()) {
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+                ++m_exact_hits;
+                return it->second.reply;
+            }
+        }
+        if (m_config.perceptual) {
+            key.dhash = dhash(image);
+            if (key.dhash) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                slot* best = nullptr;
+                int best_distance = m_config.max_distance + 1;
+                for (int part = 0; part < dhash_parts(); ++part) {
+                    auto [first, last] = m_dhash_index.equal_range(dhash_part_key(*key.dhash, part));
+                    for (auto it = first; it != last; ++it) {
+                        const int distance = std::popcount(*it->second->second.dhash ^ *key.dhash);
+                        if (distance < best_distance) {
+                            best = it->second;
+                            best_distance = distance;
+                        }
+                    }
+                }
+                if (best) {
+                    m_lru.splice(m_lru.begin(), m_lru, best->second.lru_pos);
+                    ++m_near_hits;
+                    return best->second.reply;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_misses;
+        return std::nullopt;
+    }
+
+    // Looks the digest up in `formula_cache` on the database worker and
+    // promotes a hit into memory. `handler(std::optional<std::string>)` runs
+    // on `executor`.
+    template <typename Handler>
+    void load(net::any_io_executor executor, const image_key& key, Handler handler) {
+        flush_hits_if_due();
+        database::async_execute(executor, net::cancellation_slot{},
+            [digest = key.digest](pqxx::work& txn) {
+                return txn.exec_params("SELECT reply::text FROM formula_cache WHERE content_hash = $1", digest);
+            },
+            [this, key, handler = std::move(handler)](std::exception_ptr error, pqxx::result result) mutable {
+                std::optional<std::string> reply;
+                if (error) {
+                    try { std::rethrow_exception(error); }
+                    catch (const std::exception& e) { SPDLOG_WARN("Recognition cache lookup failed: {}", e.what()); }
+                } else if (!result.empty()) {
+                    reply = result[0][0].c_str();
+                }
+                if (reply) {
+                    insert(key, *reply);
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    ++m_db_hits;
+                    --m_misses;     // find() counted it
+                    ++m_pending_hits[key.digest];
+                }
+                handler(std::move(reply));
+            });
+    }
+
+    // Remembers a successful reply; `inference_time` is what the hit will save.
+    void put(const image_key& key, std::string reply, std::chrono::microseconds inference_time) {
+        if (!enabled()) return;
+        m_inference_us += static_cast<std::uint64_t>(inference_time.count());
+        m_inferences.fetch_add(1, std::memory_order_relaxed);
+        if (m_config.use_db) {
+            flush_hits_if_due();
+            store(key, reply);
+        }
+        insert(key, std::move(reply));
+    }
+
+    nlohmann::json stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nlohmann::json out;
+        const auto hits = m_exact_hits + m_near_hits + m_db_hits;
+        const auto inferences = m_inferences.load(std::memory_order_relaxed);
+        const double avg_inference_ms = inferences == 0 ? 0.0 : static_cast<double>(m_inference_us.load()) / 1000.0 / static_cast<double>(inferences);
+        out["entries"] = m_entries.size();
+        out["max_entries"] = m_config.max_entries;
+        out["perceptual"] = m_config.perceptual;
+        out["db"] = m_config.use_db;
+        out["exact_hits"] = m_exact_hits;
+        out["near_hits"] = m_near_hits;
+        out["db_hits"] = m_db_hits;
+        out["misses"] = m_misses;
+        out["hit_ratio"] = hits + m_misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + m_misses);
+        out["evictions"] = m_evictions;
+        out["avg_inference_ms"] = avg_inference_ms;
+        out["saved_inference_ms"] = avg_inference_ms * static_cast<double>(hits);
+        out["db_write_failures"] = m_db_write_failures;
+        out["db_hits_pending"] = m_pending_hits.size();
+        return out;
+    }
+
+private:
+    struct entry {
+        std::string reply;
+        std::optional<std::uint64_t> dhash;
+        std::list<std::string>::iterator lru_pos;
+    };
+    using slot = std::unordered_map<std::string, entry>::value_type;
+
+    recognition_cache_config m_config;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, entry> m_entries;
+    std::list<std::string> m_lru;     // front: most recently used
+    // dhash_part_key() of every part of every entry's dHash -> the entry.
+    // Map nodes never move, so the pointers stay valid until the erase.
+    std::unordered_multimap<std::uint64_t, slot*> m_dhash_index;
+    std::unordered_map<std::string, std::uint64_t> m_pending_hits;     // database hits not yet written
+    std::chrono::steady_clock::time_point m_hits_flushed_at = std::chrono::steady_clock::now();
+
+    std::uint64_t m_exact_hits = 0;
+    std::uint64_t m_near_hits = 0;
+    std::uint64_t m_db_hits = 0;
+    std::uint64_t m_misses = 0;
+    std::uint64_t m_evictions = 0;
+    std::uint64_t m_db_write_failures = 0;
+    std::atomic<std::uint64_t> m_inference_us{0};
+    std::atomic<std::uint64_t> m_inferences{0};
+
+    [[nodiscard]] int dhash_parts() const { return m_config.max_distance + 1; }
+
+    // Index key of bit range `part` of `dhash`. Unrelated ranges may share a
+    // key; find() compares the whole hash anyway.
+    [[nodiscard]] std::uint64_t dhash_part_key(std::uint64_t dhash, int part) const {
+        const int begin = part * 64 / dhash_parts(), end = (part + 1) * 64 / dhash_parts();
+        const std::uint64_t bits = end - begin == 64 ? dhash : (dhash >> begin) & ((std::uint64_t{1} << (end - begin)) - 1);
+        return bits ^ (static_cast<std::uint64_t>(part) << 59);
+    }
+
+    void index_locked(slot& s) {
+        if (!s.second.dhash) return;
+        for (int part = 0; part < dhash_parts(); ++part) m_dhash_index.emplace(dhash_part_key(*s.second.dhash, part), &s);
+    }
+
+    void unindex_locked(slot& s) {
+        if (!s.second.dhash) return;
+        for (int part = 0; part < dhash_parts(); ++part) {
+            auto [first, last] = m_dhash_index.equal_range(dhash_part_key(*s.second.dhash, part));
+            for (auto it = first; it != last; ++it) {
+                if (it->second != &s) continue;
+                m_dhash_index.erase(it);
+                break;
+            }
+        }
+    }
+
+    void insert(const image_key& key, std::string reply) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto it = m_entries.find(key.digest); it != m_entries.end()) {
+            it->second.reply = std::move(reply);
+            if (key.dhash && it->second.dhash != key.dhash) {
+                unindex_locked(*it);
+                it->second.dhash = key.dhash;
+                index_locked(*it);
+            }
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+            return;
+        }
+        while (!m_lru.empty() && m_entries.size() >= m_config.max_entries) {
+            auto victim = m_entries.find(m_lru.back());
+            unindex_locked(*victim);
+            m_entries.erase(victim);
+            m_lru.pop_back();
+            ++m_evictions;
+        }
+        m_lru.push_front(key.digest);
+        auto [it, inserted] = m_entries.emplace(key.digest, entry{std::move(reply), key.dhash, m_lru.begin()});
+        index_locked(*it);
+    }
+
+    // Writes the summed database hits once hits_flush_interval has passed.
+    void flush_hits_if_due() {
+        std::unordered_map<std::string, std::uint64_t> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const auto now = std::chrono::steady_clock::now();
+            if (m_pending_hits.empty() || now - m_hits_flushed_at < m_config.hits_flush_interval) return;
+            m_hits_flushed_at = now;
+            pending.swap(m_pending_hits);
+        }
+        std::string digests = "{", counts = "{";
+        for (const auto& [digest, count]: pending) {
+            if (digests.size() > 1) {
+                digests += ',';
+                counts += ',';
+            }
+            digests += digest;      // hex, needs no quoting
+            counts += std::to_string(count);
+        }
+        digests += '}';
+        counts += '}';
+
+        auto& pool = database::get_db_thread_pool();
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [digests = std::move(digests), counts = std::move(counts)](pqxx::work& txn) {
+                return txn.exec_params(
+                    "UPDATE formula_cache f SET hits = f.hits + t.n, last_hit_at = NOW() "
+                    "FROM unnest($1::text[], $2::bigint[]) AS t(content_hash, n) "
+                    "WHERE f.content_hash = t.content_hash",
+                    digests, counts);
+            },
+            [this, written = pending.size()](std::exception_ptr error, pqxx::result) {
+                if (!error) return;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    ++m_db_write_failures;
+                }
+                try { std::rethrow_exception(error); }
+                catch (const std::exception& e) { SPDLOG_WARN("Writing {} recognition cache hit counters failed: {}", written, e.what()); }
+            });
+    }
+
+    void store(const image_key& key, const std::string& reply) {
+        auto& pool = database::get_db_thread_pool();
+        std::optional<long long> dhash;
+        if (key.dhash) dhash = static_cast<long long>(*key.dhash);
+        database::async_execute(pool.get_executor(), net::cancellation_slot{},
+            [digest = key.digest, dhash, reply](pqxx::work& txn) {
+                return txn.exec_params(
+                    "INSERT INTO formula_cache (content_hash, dhash, reply) VALUES ($1, $2, $3::jsonb) "
+                    "ON CONFLICT (content_hash) DO UPDATE SET reply = EXCLUDED.reply",
+                    digest, dhash, reply);
+            },
+            [this](std::exception_ptr error, pqxx::result) {
+                if (!error) return;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    ++m_db_write_failures;
+                }
+                try { std::rethrow_exception(error); }
+                catch (const std::exception& e) { SPDLOG_WARN("Storing recognition result failed: {}", e.what()); }
+            });
+    }
+
+    // 64-bit dHash: 9x8 grayscale thumbnail, one bit per horizontal gradient.
+    static std::optional<std::uint64_t> dhash(std::string_view image) {
+#ifdef GEECODEX_WITH_ONNXRUNTIME
+        cv::Mat encoded(1, static_cast<int>(image.size()), CV_8UC1, const_cast<char*>(image.data()));
+        cv::Mat gray = cv::imdecode(encoded, cv::IMREAD_REDUCED_GRAYSCALE_2);
+        if (gray.empty()) return std::nullopt;
+        cv::Mat thumb;
+        cv::resize(gray, thumb, {9, 8}, 0, 0, cv::INTER_AREA);
+        std::uint64_t bits = 0;
+        for (int y = 0; y < 8; ++y) {
+            const auto* row = thumb.ptr<std::uint8_t>(y);
+            for (int x = 0; x < 8; ++x) bits = (bits << 1) | (row[x] < row[x + 1] ? 1u : 0u);
+        }
+        return bits;
+#else
+        (void)image;
+        return std::nullopt;
+#endif
+    }
+};
+
+inline recognition_cache& get_recognition_cache() {
+    static recognition_cache instance;
+    return instance;
+}
+
+}   // NAMESPACE GEECODEX::RECOGNITION
+#endif // RECOGNITION_CACHE_HPP
@@ -0,0 +1,322 @@
+#ifndef RECOGNITION_JOBS_HPP
+#define RECOGNITION_JOBS_HPP
+
+#include <json.hpp>
+#include <recognition/formula_workers.hpp>
+#include <utils/env.hpp>
+#include <utils/random_id.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace geecodex::recognition {
+
+struct recognition_jobs_config {
+    std::size_t max_jobs = 1024;        // queued + running + finished-but-not-expired
+    std::size_t max_bytes = 128 * 1024 * 1024;  // queued uploads + kept results
+    std::size_t max_running = 8;        // jobs handed to the engine / workers at once
+    std::chrono::seconds result_ttl{300};
+
+    // GEECODEX_RECOGNITION_JOBS_MAX, GEECODEX_RECOGNITION_JOBS_BYTES,
+    // GEECODEX_RECOGNITION_JOBS_CONCURRENCY and GEECODEX_RECOGNITION_JOB_TTL
+    // (seconds).
+    static recognition_jobs_config from_env() {
+        recognition_jobs_config config;
+        config.max_jobs = static_cast<std::size_t>(utils::env_int("GEECODEX_RECOGNITION_JOBS_MAX", static_cast<long long>(config.max_jobs)));
+        config.max_bytes = static_cast<std::size_t>(std::max(0LL, utils::env_int("GEECODEX_RECOGNITION_JOBS_BYTES", static_cast<long long>(config.max_bytes))));
+        config.max_running = static_cast<std::size_t>(std::max(1LL, utils::env_int("GEECODEX_RECOGNITION_JOBS_CONCURRENCY", static_cast<long long>(config.max_running))));
+        config.result_ttl = std::chrono::seconds{utils::env_int("GEECODEX_RECOGNITION_JOB_TTL", config.result_ttl.count())};
+        return config;
+    }
+};
+
+enum class job_priority { high = 0, normal = 1, low = 2 };
+
+inline std::optional<job_priority> parse_job_priority(std::string_view text) {
+    if (text == "high") return job_priority::high;
+    if (text == "normal" || text.empty()) return job_priority::normal;
+    if (text == "low") return job_priority::low;
+    return std::nullopt;
+}
+
+// Final HTTP status and JSON body a synchronous request would have received.
+struct job_result {
+    unsigned status = 0;
+    std::string body;
+};
+
+// Recognition jobs submitted without holding a connection open. Jobs wait in
+// a priority queue (FIFO within a priority) and at most max_running of them
+// are handed to the runner at a time, so a burst queues here instead of
+// overflowing the batcher or the worker pool. Finished results are kept for
+// result_ttl and then dropped; the table as a whole is bounded by max_jobs
+// and by max_bytes of queued uploads plus kept results.
+class recognition_jobs {
+public:
+    using clock      = std::chrono::steady_clock;
+    using completion = std::function<void(job_result)>;
+    using runner     = std::function<void(formula_worker_pool::upload, completion)>;
+
+    enum class state { queued, running, done };
+
+    struct snapshot {
+        state current = state::queued;
+        job_priority priority = job_priority::normal;
+        std::size_t queue_position = 0;     // jobs ahead of this one, while queued
+        double age_ms = 0.0;
+        double run_ms = 0.0;                // queue exit to finish, once done
+        std::optional<job_result> result;
+    };
+
+    explicit recognition_jobs(runner run, recognition_jobs_config config = recognition_jobs_config::from_env())
+        : m_run{std::move(run)}
+        , m_config{config} {}
+
+    // Id of the new job, or nullopt when the table is full.
+    std::optional<std::string> submit(formula_worker_pool::upload upload, job_priority priority) {
+        std::vector<std::shared_ptr<job>> ready;
+        std::string id = utils::random_hex_id<16>();
+        const auto cost = upload_cost(upload);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            sweep_locked(clock::now());
+            if (m_jobs.size() >= m_config.max_jobs || m_bytes + cost > m_config.max_bytes) {
+                ++m_rejected;
+                return std::nullopt;
+            }
+            auto j = std::make_shared<job>();
+            j->id = id;
+            j->priority = priority;
+            j->sequence = m_next_sequence++;
+            j->upload = std::move(upload);
+            j->bytes = cost;
+            j->submitted_at = clock::now();
+            m_bytes += cost;
+            m_jobs.emplace(id, j);
+            m_queue.push(j);
+            ++m_submitted;
+            drain_locked(ready);
+        }
+        start(ready);
+        return id;
+    }
+
+    std::optional<snapshot> find(const std::string& id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto now = clock::now();
+        sweep_locked(now);
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end()) return std::nullopt;
+        const auto& j = *it->second;
+
+        snapshot out;
+        out.current = j.current;
+        out.priority = j.priority;
+        out.age_ms = std::chrono::duration<double, std::milli>(now - j.submitted_at).count();
+        if (j.current == state::queued) out.queue_position = position_locked(j);
+        if (j.current == state::done) {
+            out.run_ms = std::chrono::duration<double, std::milli>(j.finished_at - j.started_at).count();
+            out.result = j.result;
+        }
+        return out;
+    }
+
+    // Calls `notify` once the job is done: right away (on this thread) when it
+    // already is, otherwise on the thread that finishes it. Returns a token
+    // for forget_waiter() while `notify` is queued, 0 when it already ran or
+    // the id is unknown or expired.
+    std::uint64_t on_done(const std::string& id, std::function<void()> notify) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_jobs.find(id);
+            if (it == m_jobs.end()) return 0;
+            if (it->second->current != state::done) {
+                const auto token = ++m_next_waiter;
+                it->second->waiters.emplace_back(token, std::move(notify));
+                return token;
+            }
+        }
+        notify();
+        return 0;
+    }
+
+    // Drops a waiter that is no longer interested, e.g. a long poll that
+    // timed out, so it does not stay queued until the job finishes.
+    void forget_waiter(const std::string& id, std::uint64_t token) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end()) return;
+        std::erase_if(it->second->waiters, [token](const auto& w) { return w.first == token; });
+    }
+
+    nlohmann::json stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nlohmann::json out;
+        out["jobs"] = m_jobs.size();
+        out["queued"] = m_queue.size();
+        out["running"] = m_running;
+        out["max_jobs"] = m_config.max_jobs;
+        out["bytes"] = m_bytes;
+        out["max_bytes"] = m_config.max_bytes;
+        out["max_running"] = m_config.max_running;
+        out["result_ttl_seconds"] = m_config.result_ttl.count();
+        out["submitted"] = m_submitted;
+        out["completed"] = m_completed;
+        out["rejected"] = m_rejected;
+        out["expired"] = m_expired;
+        return out;
+    }
+
+private:
+    struct job {
+        std::string id;
+        job_priority priority = job_priority::normal;
+        std::uint64_t sequence = 0;
+        state current = state::queued;
+        formula_worker_pool::upload upload;     // released once handed to the runner
+        std::size_t bytes = 0;                  // of upload, then of result; counted in m_bytes
+        clock::time_point submitted_at;
+        clock::time_point started_at;
+        clock::time_point finished_at;
+        job_result result;
+        std::vector<std::pair<std::uint64_t, std::function<void()>>> waiters;
+    };
+
+    struct later_first {
+        bool operator()(const std::shared_ptr<job>& a, const std::shared_ptr<job>& b) const {
+            if (a->priority != b->priority) return a->priority > b->priority;
+            return a->sequence > b->sequence;
+        }
+    };
+
+    runner m_run;
+    recognition_jobs_config m_config;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<job>> m_jobs;
+    std::priority_queue<std::shared_ptr<job>, std::vector<std::shared_ptr<job>>, later_first> m_queue;
+    std::size_t m_running = 0;
+    std::size_t m_bytes = 0;
+    std::uint64_t m_next_sequence = 0;
+    std::uint64_t m_next_waiter = 0;
+    clock::time_point m_last_sweep{};
+
+    std::uint64_t m_submitted = 0;
+    std::uint64_t m_completed = 0;
+    std::uint64_t m_rejected = 0;
+    std::uint64_t m_expired = 0;
+
+    static std::size_t upload_cost(const formula_worker_pool::upload& upload) {
+        return upload.image.size() + upload.filename.size() + upload.content_type.size();
+    }
+
+    // Queued jobs that run before `j`. Linear, but only asked for by pollers
+    // of queued jobs and bounded by max_jobs.
+    std::size_t position_locked(const job& j) const {
+        std::size_t ahead = 0;
+        for (const auto& [id, other]: m_jobs) {
+            if (other->current != state::queued || other.get() == &j) continue;
+            if (other->priority < j.priority || (other->priority == j.priority && other->sequence < j.sequence)) ++ahead;
+        }
+        return ahead;
+    }
+
+    // Drops finished jobs past their TTL, at most once a second.
+    void sweep_locked(clock::time_point now) {
+        if (now - m_last_sweep < std::chrono::seconds{1}) return;
+        m_last_sweep = now;
+        std::erase_if(m_jobs, [&](const auto& entry) {
+            const auto& j = *entry.second;
+            if (j.current != state::done || now - j.finished_at < m_config.result_ttl) return false;
+            m_bytes -= j.bytes;
+            ++m_expired;
+            return true;
+        });
+    }
+
+    void drain_locked(std::vector<std::shared_ptr<job>>& ready) {
+        while (m_running < m_config.max_running && !m_queue.empty()) {
+            auto next = m_queue.top();
+            m_queue.pop();
+            next->current = state::running;
+            next->started_at = clock::now();
+            ++m_running;
+            ready.push_back(std::move(next));
+        }
+    }
+
+    void start(std::vector<std::shared_ptr<job>>& ready) {
+        for (auto& j: ready) {
+            auto upload = std::move(j->upload);
+            j->upload = {};
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_bytes -= j->bytes;
+                j->bytes = 0;
+            }
+            try {
+                m_run(std::move(upload), [this, j](job_result result) { finish(j, std::move(result)); });
+            } catch (const std::exception& e) {
+                nlohmann::json error_body;
+                error_body["error"] = "Recognition Failed";
+                error_body["message"] = e.what();
+                finish(j, {500, error_body.dump()});
+            }
+        }
+    }
+
+    void finish(const std::shared_ptr<job>& j, job_result result) {
+        std::vector<std::shared_ptr<job>> ready;
+        std::vector<std::pair<std::uint64_t, std::function<void()>>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            j->current = state::done;
+            j->finished_at = clock::now();
+            j->result = std::move(result);
+            // A result that would overflow the budget still finishes the job;
+            // it only makes new submissions wait for older results to expire.
+            j->bytes = j->result.body.size();
+            m_bytes += j->bytes;
+            waiters.swap(j->waiters);
+            --m_running;
+            ++m_completed;
+            drain_locked(ready);
+        }
+        for (auto& [token, notify]: waiters) notify();
+        start(ready);
+    }
+};
+
+inline std::string_view to_string(recognition_jobs::state s) {
+    switch (s) {
+        case recognition_jobs::state::queued:  return "queued";
+        case recognition_jobs::state::running: return "running";
+        case recognition_jobs::state::done:    return "done";
+    }
+    return "unknown";
+}
+
+inline std::string_view to_string(job_priority p) {
+    switch (p) {
+        case job_priority::high:   return "high";
+        case job_priority::normal: return "normal";
+        case job_priority::low:    return "low";
+    }
+    return "normal";
+}
+
+}   // NAMESPACE GEECODEX::RECOGNITION
+#endif // RECOGNITION_JOBS_HPP
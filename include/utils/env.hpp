@@ -0,0 +1,37 @@
+#ifndef ENV_HPP
+#define ENV_HPP
+
+#include <charconv>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+namespace geecodex::utils {
+
+// Runtime tunables come from the environment, like DEEPSEEK_API_KEY.
+// Unset, empty or malformed values fall back to the given default.
+inline std::string env_string(const char* name, std::string_view fallback = {}) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0') return std::string{fallback};
+    return value;
+}
+
+inline long long env_int(const char* name, long long fallback) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0') return fallback;
+
+    long long parsed = 0;
+    std::string_view text{value};
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (ec != std::errc() || ptr != text.data() + text.size()) return fallback;
+    return parsed;
+}
+
+inline bool env_flag(const char* name, bool fallback) {
+    std::string value = env_string(name);
+    if (value.empty()) return fallback;
+    return value == "1" || value == "true" || value == "on" || value == "yes";
+}
+
+}   // NAMESPACE GEECODEX::UTILS
+#endif // ENV_HPP
@@ -0,0 +1,73 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <json.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace geecodex::utils {
+
+// Fixed-bucket histogram with lock-free recording, for /geecodex/stats.
+// `bounds` are inclusive upper edges in ascending order; one overflow
+// bucket is added after the last bound.
+class histogram {
+public:
+    explicit histogram(std::vector<double> bounds)
+        : m_bounds{std::move(bounds)}
+        , m_counts{std::make_unique<std::atomic<std::uint64_t>[]>(m_bounds.size() + 1)} {}
+
+    void record(double value) {
+        std::size_t bucket = 0;
+        while (bucket < m_bounds.size() && value > m_bounds[bucket]) ++bucket;
+        m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_total.fetch_add(1, std::memory_order_relaxed);
+        // Sum kept in thousandths so it stays an integer atomic.
+        m_sum_milli.fetch_add(static_cast<std::uint64_t>(value * 1000.0), std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::uint64_t count() const { return m_total.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-quantile (0 < q <= 1).
+    [[nodiscard]] double quantile(double q) const {
+        const auto total = count();
+        if (total == 0) return 0.0;
+        const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(total) + 0.5);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < m_bounds.size(); ++i) {
+            seen += m_counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return m_bounds[i];
+        }
+        return m_bounds.empty() ? 0.0 : m_bounds.back();
+    }
+
+    nlohmann::json to_json() const {
+        nlohmann::json buckets = nlohmann::json::array();
+        for (std::size_t i = 0; i <= m_bounds.size(); ++i) {
+            buckets.push_back({
+                {"le", i < m_bounds.size() ? nlohmann::json(m_bounds[i]) : nlohmann::json("inf")},
+                {"count", m_counts[i].load(std::memory_order_relaxed)}
+            });
+        }
+        const auto total = count();
+        nlohmann::json out;
+        out["count"] = total;
+        out["mean"] = total == 0 ? 0.0 : static_cast<double>(m_sum_milli.load(std::memory_order_relaxed)) / 1000.0 / static_cast<double>(total);
+        out["p50"] = quantile(0.50);
+        out["p99"] = quantile(0.99);
+        out["buckets"] = std::move(buckets);
+        return out;
+    }
+
+private:
+    std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_counts;
+    std::atomic<std::uint64_t> m_total{0};
+    std::atomic<std::uint64_t> m_sum_milli{0};
+};
+
+}   // NAMESPACE GEECODEX::UTILS
+#endif // HISTOGRAM_HPP
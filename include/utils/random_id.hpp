@@ -0,0 +1,38 @@
+#ifndef RANDOM_ID_HPP
+#define RANDOM_ID_HPP
+
+#include <openssl/rand.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace geecodex::utils {
+
+// `Bytes` random bytes from OpenSSL, hex encoded: unguessable ids for
+// conversations, jobs and the like.
+template <std::size_t Bytes = 16>
+inline std::string random_hex_id() {
+    unsigned char bytes[Bytes];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1) throw std::runtime_error("RAND_bytes failed");
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string id;
+    id.reserve(Bytes * 2);
+    for (unsigned char b: bytes) {
+        id.push_back(hex[b >> 4]);
+        id.push_back(hex[b & 0x0f]);
+    }
+    return id;
+}
+
+template <std::size_t Bytes = 16>
+inline bool is_hex_id(std::string_view id) {
+    if (id.size() != Bytes * 2) return false;
+    for (char c: id)
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    return true;
+}
+
+}   // NAMESPACE GEECODEX::UTILS
+#endif // RANDOM_ID_HPP
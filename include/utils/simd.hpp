@@ -0,0 +1,40 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GEECODEX_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define GEECODEX_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace geecodex::utils {
+
+// Instruction set the SIMD kernels dispatch on. x86 picks AVX2 at run time
+// (kernels use target attributes, so the default build needs no -mavx2);
+// aarch64 always has NEON.
+enum class isa { scalar, avx2, neon };
+
+inline isa active_isa() {
+#if defined(GEECODEX_SIMD_X86)
+    static const isa detected = __builtin_cpu_supports("avx2") ? isa::avx2 : isa::scalar;
+    return detected;
+#elif defined(GEECODEX_SIMD_NEON)
+    return isa::neon;
+#else
+    return isa::scalar;
+#endif
+}
+
+inline const char* isa_name(isa which = active_isa()) {
+    switch (which) {
+        case isa::avx2: return "avx2";
+        case isa::neon: return "neon";
+        case isa::scalar: break;
+    }
+    return "scalar";
+}
+
+}   // NAMESPACE GEECODEX::UTILS
+#endif // SIMD_HPP
@@ -0,0 +1,158 @@
+// Microbenchmark for the recognition preprocessing kernels.
+//
+// Runs RGB -> gray -> ink crop -> fit -> normalise on a synthetic formula
+// photo three ways: a naive per-pixel float implementation (what the Python
+// service does, stage by stage with a fresh buffer each time), the kernels
+// forced to scalar, and the kernels on the best ISA of this machine. Also
+// reports how far each result is from the naive one, and exits with 1 when
+// the SIMD output is not identical to the scalar one.
+//
+//   geecodex_preprocess_bench [width height [iterations [out_size]]]
+
+#include <recognition/image_kernels.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace kernels = geecodex::recognition::kernels;
+
+namespace {
+
+constexpr float mean = 0.7931f;
+constexpr float stddev = 0.1738f;
+
+// Light, noisy paper with a band of dark strokes in the middle.
+std::vector<std::uint8_t> synthetic_photo(int width, int height) {
+    std::vector<std::uint8_t> rgb(static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 3);
+    std::uint32_t state = 12345;
+    auto next = [&state] { state = state * 1664525u + 1013904223u; return state >> 24; };
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const bool ink = y > height * 2 / 5 && y < height * 3 / 5 && x > width / 6 && x < width * 5 / 6 && ((x / 7 + y / 11) % 5 == 0);
+            const int base = ink ? 40 : 215;
+            auto* px = &rgb[(static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x)) * 3];
+            px[0] = static_cast<std::uint8_t>(base + static_cast<int>(next() % 24));
+            px[1] = static_cast<std::uint8_t>(base + static_cast<int>(next() % 24));
+            px[2] = static_cast<std::uint8_t>(base + static_cast<int>(next() % 24));
+        }
+    }
+    return rgb;
+}
+
+std::vector<float> naive_preprocess(const std::vector<std::uint8_t>& rgb, int width, int height, int out_size) {
+    std::vector<float> gray(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+    for (std::size_t i = 0; i < gray.size(); ++i)
+        gray[i] = 0.299f * rgb[i * 3] + 0.587f * rgb[i * 3 + 1] + 0.114f * rgb[i * 3 + 2];
+
+    const auto [lo, hi] = std::minmax_element(gray.begin(), gray.end());
+    std::vector<float> stretched(gray.size());
+    for (std::size_t i = 0; i < gray.size(); ++i) stretched[i] = (gray[i] - *lo) * 255.0f / (*hi - *lo);
+
+    int top = height, bottom = -1, left = width, right = -1;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            if (stretched[static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x)] < 200.0f) {
+                top = std::min(top, y); bottom = std::max(bottom, y);
+                left = std::min(left, x); right = std::max(right, x);
+            }
+    if (bottom < 0) { top = 0; left = 0; bottom = height - 1; right = width - 1; }
+    const int crop_w = right - left + 1, crop_h = bottom - top + 1;
+    std::vector<float> cropped(static_cast<std::size_t>(crop_w) * static_cast<std::size_t>(crop_h));
+    for (int y = 0; y < crop_h; ++y)
+        for (int x = 0; x < crop_w; ++x)
+            cropped[static_cast<std::size_t>(y) * static_cast<std::size_t>(crop_w) + static_cast<std::size_t>(x)] =
+                gray[static_cast<std::size_t>(y + top) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x + left)];
+
+    const double fit = std::min(static_cast<double>(out_size) / crop_w, static_cast<double>(out_size) / crop_h);
+    const int rw = std::clamp(static_cast<int>(crop_w * fit + 0.5), 1, out_size);
+    const int rh = std::clamp(static_cast<int>(crop_h * fit + 0.5), 1, out_size);
+    // Area average over each destination pixel's footprint.
+    std::vector<float> resized(static_cast<std::size_t>(rw) * static_cast<std::size_t>(rh));
+    for (int y = 0; y < rh; ++y) {
+        const int y0 = y * crop_h / rh, y1 = std::max(y0 + 1, (y + 1) * crop_h / rh);
+        for (int x = 0; x < rw; ++x) {
+            const int x0 = x * crop_w / rw, x1 = std::max(x0 + 1, (x + 1) * crop_w / rw);
+            double sum = 0;
+            for (int sy = y0; sy < y1; ++sy)
+                for (int sx = x0; sx < x1; ++sx) sum += cropped[static_cast<std::size_t>(sy) * static_cast<std::size_t>(crop_w) + static_cast<std::size_t>(sx)];
+            resized[static_cast<std::size_t>(y) * static_cast<std::size_t>(rw) + static_cast<std::size_t>(x)] = static_cast<float>(sum / ((y1 - y0) * (x1 - x0)));
+        }
+    }
+
+    std::vector<float> canvas(static_cast<std::size_t>(out_size) * static_cast<std::size_t>(out_size), 0.0f);
+    for (int y = 0; y < rh; ++y)
+        for (int x = 0; x < rw; ++x)
+            canvas[static_cast<std::size_t>(y + (out_size - rh) / 2) * static_cast<std::size_t>(out_size) + static_cast<std::size_t>(x + (out_size - rw) / 2)] =
+                resized[static_cast<std::size_t>(y) * static_cast<std::size_t>(rw) + static_cast<std::size_t>(x)];
+
+    std::vector<float> normalised(canvas.size());
+    for (std::size_t i = 0; i < canvas.size(); ++i) normalised[i] = (canvas[i] / 255.0f - mean) / stddev;
+    return normalised;
+}
+
+struct kernel_pipeline {
+    std::vector<std::uint8_t> gray;
+    kernels::preprocess_scratch scratch;
+
+    void run(const std::vector<std::uint8_t>& rgb, int width, int height, int out_size, float* out, kernels::isa which) {
+        gray.resize(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+        kernels::rgb_to_gray(rgb.data(), width * 3, width, height, false, gray.data(), width, which);
+        kernels::fit_normalize({gray.data(), width, height, width}, out, out_size, out_size,
+                               1.0f / (255.0f * stddev), -mean / stddev, scratch, which);
+    }
+};
+
+double time_us(int iterations, const std::function<void()>& body) {
+    body();     // warm caches and scratch buffers
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) body();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count() / iterations;
+}
+
+double mean_abs_diff(const std::vector<float>& a, const std::vector<float>& b) {
+    double sum = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) sum += std::fabs(a[i] - b[i]);
+    return sum / static_cast<double>(a.size());
+}
+
+}   // namespace
+
+int main(int argc, char** argv) {
+    const int width = argc > 2 ? std::atoi(argv[1]) : 3024;
+    const int height = argc > 2 ? std::atoi(argv[2]) : 1512;
+    const int iterations = argc > 3 ? std::atoi(argv[3]) : 20;
+    const int out_size = argc > 4 ? std::atoi(argv[4]) : 384;
+    if (width < 2 || height < 2 || iterations < 1 || out_size < 1) {
+        std::fprintf(stderr, "usage: %s [width height [iterations [out_size]]]\n", argv[0]);
+        return 1;
+    }
+
+    const auto rgb = synthetic_photo(width, height);
+    const auto plane = static_cast<std::size_t>(out_size) * static_cast<std::size_t>(out_size);
+
+    std::vector<float> naive;
+    std::vector<float> scalar_out(plane), simd_out(plane);
+    kernel_pipeline pipeline;
+
+    const double naive_us = time_us(iterations, [&] { naive = naive_preprocess(rgb, width, height, out_size); });
+    const double scalar_us = time_us(iterations, [&] { pipeline.run(rgb, width, height, out_size, scalar_out.data(), kernels::isa::scalar); });
+    const auto best = kernels::active_isa();
+    const double simd_us = time_us(iterations, [&] { pipeline.run(rgb, width, height, out_size, simd_out.data(), best); });
+
+    std::printf("input %dx%d RGB -> %dx%d, %d iterations\n", width, height, out_size, out_size, iterations);
+    std::printf("%-8s %10.1f us/image\n", "naive", naive_us);
+    std::printf("%-8s %10.1f us/image  %5.1fx  mean |diff| vs naive %.4f\n", "scalar", scalar_us, naive_us / scalar_us, mean_abs_diff(scalar_out, naive));
+    std::printf("%-8s %10.1f us/image  %5.1fx  mean |diff| vs naive %.4f, vs scalar %.6f\n",
+                kernels::isa_name(best), simd_us, naive_us / simd_us, mean_abs_diff(simd_out, naive), mean_abs_diff(simd_out, scalar_out));
+    if (simd_out != scalar_out) {
+        std::fprintf(stderr, "%s output differs from scalar\n", kernels::isa_name(best));
+        return 1;
+    }
+    return 0;
+}
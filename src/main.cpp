@@ -8,6 +8,16 @@
 
 #include "spdlog/spdlog.h"
 #include <csignal>
+#include <catalog/book_catalog.hpp>
+#include <catalog/book_readers.hpp>
+#include <catalog/catalog_export.hpp>
+#include <catalog/book_ratings.hpp>
+#include <catalog/facet_index.hpp>
+#include <catalog/search_index.hpp>
+#include <catalog/similar_index.hpp>
+#include <catalog/suggest_index.hpp>
+#include <catalog/trending_books.hpp>
+#include <recognition/formula_engine.hpp>
 #include <database/db_ops.hpp>
 #include <http/http_server.h>
 #include <database/db_conn.h>
@@ -66,11 +76,43 @@ int main(int argc, char* argv[]) {
         }
         SPDLOG_INFO("Database connection initialized successfully");
 
+        auto& books = geecodex::catalog::get_book_catalog();
+        geecodex::catalog::get_book_search();      // rebuilt on every catalog publish from here on
+        geecodex::catalog::get_book_facets();
+        geecodex::catalog::get_book_suggest();
+        geecodex::catalog::get_similar_books();
+        geecodex::catalog::get_catalog_export();
+        try {
+            books.load();
+        } catch (const std::exception& e) {
+            // The refresh timer keeps retrying; book routes answer 503 until then.
+            SPDLOG_ERROR("Initial book catalog load failed: {}", e.what());
+        }
+        try {
+            geecodex::catalog::get_book_ratings().load();
+        } catch (const std::exception& e) {
+            // Ratings still work from here on; earlier ones are missing from the averages.
+            SPDLOG_ERROR("Loading book ratings failed: {}", e.what());
+        }
+        try {
+            geecodex::catalog::get_book_readers().load();
+        } catch (const std::exception& e) {
+            // Counting goes on; a book's earlier readers come back when its next flush merges the stored sketch.
+            SPDLOG_ERROR("Loading book reader sketches failed: {}", e.what());
+        }
+        // Load the formula model now rather than on the I/O thread when the
+        // first recognition request arrives; failures only disable the engine.
+        SPDLOG_INFO("Formula engine: {}", geecodex::recognition::get_formula_engine().status());
+
         auto const address = geecodex::http::net::ip::make_address(argv[1]);
         unsigned short port = static_cast<unsigned short>(std::atoi(argv[2]));
 
         net::io_context ioc{2}; // Concurrenct Hint
         http_server server{ioc, {address, port}};
+        books.start(ioc.get_executor());
+        geecodex::catalog::get_book_ratings().start(ioc.get_executor());
+        geecodex::catalog::get_book_readers().start(ioc.get_executor());
+        geecodex::catalog::get_trending_books().start(geecodex::catalog::get_index_thread_pool().get_executor());
         
         SPDLOG_INFO("HTTP server started at {}:{}", argv[1], argv[2]);
         SPDLOG_INFO("Press Ctrl+C to stop the server");
@@ -0,0 +1,472 @@
+// |------- Geecodex Mock LLM --------|
+// |  Local stand-in for the DeepSeek |
+// |  /chat/completions endpoint used |
+// |  to benchmark deepseek_session.  |
+// |----------------------------------|
+
+/*** Launch Params
+ *   --address <ip>             listen address                     (default: 127.0.0.1)
+ *   --port <port>              listen port                        (default: 8443)
+ *   --threads <n>              io threads                         (default: 1)
+ *   --tls-cert <pem>           certificate chain                  (required)
+ *   --tls-key <pem>            private key for --tls-cert         (required)
+ *   --latency <dist>           fixed | uniform | normal | lognormal (default: fixed)
+ *   --latency-ms <ms>          mean time to first byte            (default: 200)
+ *   --latency-jitter-ms <ms>   spread (uniform half-width / stddev) (default: 50)
+ *   --tokens <n>               tokens per reply                   (default: 64)
+ *   --token-rate <n>           streamed tokens per second, 0 = no pacing (default: 50)
+ *   --error-rate <p>           fraction answered with 500         (default: 0)
+ *   --rate-limit-rate <p>      fraction answered with 429         (default: 0)
+ *   --hang-rate <p>            fraction never answered            (default: 0)
+ *   --drop-rate <p>            fraction whose connection is closed mid-reply (default: 0)
+ *
+ *   deepseek_session only speaks HTTPS, so the mock always serves TLS. E.g.
+ *    openssl req -x509 -newkey rsa:2048 -nodes -days 30 -subj "/CN=localhost" \
+ *        -addext "subjectAltName=DNS:localhost,IP:127.0.0.1" -keyout mock.key -out mock.crt
+ *    ./geecodex_mock_llm --port 8443 --tls-cert mock.crt --tls-key mock.key --latency lognormal
+ *    DEEPSEEK_API_HOST=localhost DEEPSEEK_API_PORT=8443 DEEPSEEK_CA_FILE=mock.crt \
+ *    DEEPSEEK_API_KEY=mock ./inf_qwq_backend ...
+ *
+ *   GET /stats returns connection/request counters, so connection reuse is
+ *   visible as requests / connections.
+ */
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace geecodex::mock_llm {
+namespace beast = boost::beast;
+namespace http  = beast::http;
+namespace net   = boost::asio;
+namespace ssl   = net::ssl;
+using tcp       = net::ip::tcp;
+using json      = nlohmann::json;
+
+enum class latency_dist { fixed, uniform, normal, lognormal };
+
+struct mock_config {
+    std::string address = "127.0.0.1";
+    unsigned short port = 8443;
+    int threads = 1;
+    std::string tls_cert;
+    std::string tls_key;
+
+    latency_dist latency = latency_dist::fixed;
+    double latency_ms = 200.0;
+    double latency_jitter_ms = 50.0;
+    int tokens = 64;
+    double token_rate = 50.0;
+
+    double error_rate = 0.0;
+    double rate_limit_rate = 0.0;
+    double hang_rate = 0.0;
+    double drop_rate = 0.0;
+
+    static std::optional<mock_config> parse(int argc, char* argv[]) {
+        mock_config config;
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return std::nullopt;
+            }
+            std::string value = argv[++i];
+
+            if (arg == "--address") config.address = value;
+            else if (arg == "--port") config.port = static_cast<unsigned short>(std::atoi(value.c_str()));
+            else if (arg == "--threads") config.threads = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--tls-cert") config.tls_cert = value;
+            else if (arg == "--tls-key") config.tls_key = value;
+            else if (arg == "--latency") {
+                if (value == "fixed") config.latency = latency_dist::fixed;
+                else if (value == "uniform") config.latency = latency_dist::uniform;
+                else if (value == "normal") config.latency = latency_dist::normal;
+                else if (value == "lognormal") config.latency = latency_dist::lognormal;
+                else {
+                    std::cerr << "Unknown latency distribution: " << value << std::endl;
+                    return std::nullopt;
+                }
+            }
+            else if (arg == "--latency-ms") config.latency_ms = std::atof(value.c_str());
+            else if (arg == "--latency-jitter-ms") config.latency_jitter_ms = std::atof(value.c_str());
+            else if (arg == "--tokens") config.tokens = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--token-rate") config.token_rate = std::atof(value.c_str());
+            else if (arg == "--error-rate") config.error_rate = std::atof(value.c_str());
+            else if (arg == "--rate-limit-rate") config.rate_limit_rate = std::atof(value.c_str());
+            else if (arg == "--hang-rate") config.hang_rate = std::atof(value.c_str());
+            else if (arg == "--drop-rate") config.drop_rate = std::atof(value.c_str());
+            else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return std::nullopt;
+            }
+        }
+        if (config.tls_cert.empty() || config.tls_key.empty()) {
+            std::cerr << "--tls-cert and --tls-key are required" << std::endl;
+            return std::nullopt;
+        }
+        return config;
+    }
+};
+
+struct mock_stats {
+    std::atomic<std::uint64_t> connections{0};
+    std::atomic<std::uint64_t> requests{0};
+    std::atomic<std::uint64_t> streamed{0};
+    std::atomic<std::uint64_t> injected_errors{0};
+    std::atomic<std::uint64_t> injected_rate_limits{0};
+    std::atomic<std::uint64_t> injected_hangs{0};
+    std::atomic<std::uint64_t> injected_drops{0};
+
+    json to_json() const {
+        json out;
+        out["connections"] = connections.load();
+        out["requests"] = requests.load();
+        out["streamed"] = streamed.load();
+        out["requests_per_connection"] = connections == 0 ? 0.0 : static_cast<double>(requests) / static_cast<double>(connections);
+        out["injected_errors"] = injected_errors.load();
+        out["injected_rate_limits"] = injected_rate_limits.load();
+        out["injected_hangs"] = injected_hangs.load();
+        out["injected_drops"] = injected_drops.load();
+        return out;
+    }
+};
+
+inline std::mt19937_64& random_engine() {
+    thread_local std::mt19937_64 engine{std::random_device{}()};
+    return engine;
+}
+
+inline std::chrono::microseconds sample_latency(const mock_config& config) {
+    double ms = config.latency_ms;
+    auto& rng = random_engine();
+    switch (config.latency) {
+        case latency_dist::fixed: break;
+        case latency_dist::uniform:
+            ms = std::uniform_real_distribution<double>{config.latency_ms - config.latency_jitter_ms,
+                                                        config.latency_ms + config.latency_jitter_ms}(rng);
+            break;
+        case latency_dist::normal:
+            ms = std::normal_distribution<double>{config.latency_ms, config.latency_jitter_ms}(rng);
+            break;
+        case latency_dist::lognormal: {
+            // Parameterised so the distribution's mean/stddev match latency_ms/jitter.
+            double mean = std::max(config.latency_ms, 1.0);
+            double variance = config.latency_jitter_ms * config.latency_jitter_ms;
+            double sigma2 = std::log1p(variance / (mean * mean));
+            ms = std::lognormal_distribution<double>{std::log(mean) - sigma2 / 2.0, std::sqrt(sigma2)}(rng);
+            break;
+        }
+    }
+    return std::chrono::microseconds{static_cast<long long>(std::max(ms, 0.0) * 1000.0)};
+}
+
+enum class fault { none, error, rate_limit, hang, drop };
+
+inline fault roll_fault(const mock_config& config) {
+    double roll = std::uniform_real_distribution<double>{0.0, 1.0}(random_engine());
+    if ((roll -= config.error_rate) < 0) return fault::error;
+    if ((roll -= config.rate_limit_rate) < 0) return fault::rate_limit;
+    if ((roll -= config.hang_rate) < 0) return fault::hang;
+    if ((roll -= config.drop_rate) < 0) return fault::drop;
+    return fault::none;
+}
+
+inline std::string mock_token(int index) {
+    static constexpr std::string_view words[] = {
+        "Let", " us", " solve", " the", " equation", " step", " by", " step", ".",
+        " First", ",", " move", " x", " to", " one", " side", " and", " simplify", "."
+    };
+    return std::string{words[static_cast<std::size_t>(index) % std::size(words)]};
+}
+
+class mock_session: public std::enable_shared_from_this<mock_session> {
+public:
+    mock_session(const mock_config& config, mock_stats& stats, tcp::socket socket, ssl::context& ssl_ctx)
+        : m_config{config}
+        , m_stats{stats}
+        , m_stream{std::move(socket), ssl_ctx}
+        , m_timer{m_stream.get_executor()} {}
+
+    void run() {
+        m_stats.connections++;
+        beast::get_lowest_layer(m_stream).expires_after(std::chrono::seconds{10});
+        m_stream.async_handshake(ssl::stream_base::server, [self = shared_from_this()](beast::error_code ec) {
+            if (ec) return;
+            self->do_read();
+        });
+    }
+
+private:
+    const mock_config& m_config;
+    mock_stats& m_stats;
+    beast::ssl_stream<beast::tcp_stream> m_stream;
+    net::steady_timer m_timer;
+    beast::flat_buffer m_buffer;
+    http::request<http::string_body> m_request;
+
+    std::shared_ptr<http::response<http::empty_body>> m_stream_header;
+    std::shared_ptr<http::response_serializer<http::empty_body>> m_stream_serializer;
+    int m_token_index = 0;
+    int m_drop_after = -1;
+    std::string m_model;
+
+    void do_read() {
+        m_request = {};
+        beast::get_lowest_layer(m_stream).expires_after(std::chrono::seconds{60});
+        http::async_read(m_stream, m_buffer, m_request, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return self->close();
+            beast::get_lowest_layer(self->m_stream).expires_never();
+            self->handle_request();
+        });
+    }
+
+    void handle_request() {
+        m_stats.requests++;
+        std::string_view target{m_request.target().data(), m_request.target().size()};
+
+        if (m_request.method() == http::verb::get && target == "/stats")
+            return send_json(http::status::ok, m_stats.to_json());
+
+        if (m_request.method() != http::verb::post ||
+            (target != "/chat/completions" && target != "/v1/chat/completions"))
+            return send_json(http::status::not_found, {{"error", {{"message", "Unknown endpoint"}}}});
+
+        json body = json::parse(m_request.body(), nullptr, false);
+        if (body.is_discarded() || !body.contains("messages") || !body["messages"].is_array())
+            return send_json(http::status::bad_request, {{"error", {{"message", "Invalid request body"}}}});
+        m_model = body.value("model", "deepseek-chat");
+        bool stream = body.value("stream", false);
+
+        fault injected = roll_fault(m_config);
+        switch (injected) {
+            case fault::error:
+                m_stats.injected_errors++;
+                return send_after_latency(http::status::internal_server_error, {{"error", {{"message", "Injected upstream error"}}}});
+            case fault::rate_limit:
+                m_stats.injected_rate_limits++;
+                return send_after_latency(http::status::too_many_requests, {{"error", {{"message", "Injected rate limit"}}}});
+            case fault::hang:
+                m_stats.injected_hangs++;
+                return wait_for_close();
+            case fault::drop:
+                m_stats.injected_drops++;
+                m_drop_after = std::uniform_int_distribution<int>{0, m_config.tokens - 1}(random_engine());
+                if (!stream) return close();
+                break;
+            case fault::none:
+                m_drop_after = -1;
+                break;
+        }
+
+        m_timer.expires_after(sample_latency(m_config));
+        m_timer.async_wait([self = shared_from_this(), stream](beast::error_code ec) {
+            if (ec) return;
+            if (stream) self->start_stream();
+            else self->send_json(http::status::ok, self->completion_body());
+        });
+    }
+
+    json completion_body() const {
+        std::string content;
+        for (int i = 0; i < m_config.tokens; ++i) content += mock_token(i);
+        return {
+            {"id", "mock-completion"},
+            {"object", "chat.completion"},
+            {"model", m_model},
+            {"choices", json::array({{{"index", 0},
+                                      {"message", {{"role", "assistant"}, {"content", content}}},
+                                      {"finish_reason", "stop"}}})},
+            {"usage", usage()}
+        };
+    }
+
+    json usage() const {
+        return {{"prompt_tokens", 16}, {"completion_tokens", m_config.tokens}, {"total_tokens", 16 + m_config.tokens}};
+    }
+
+    void send_after_latency(http::status status, json body) {
+        m_timer.expires_after(sample_latency(m_config));
+        m_timer.async_wait([self = shared_from_this(), status, body = std::move(body)](beast::error_code ec) {
+            if (!ec) self->send_json(status, body);
+        });
+    }
+
+    void send_json(http::status status, const json& body) {
+        auto response = std::make_shared<http::response<http::string_body>>(status, m_request.version());
+        response->set(http::field::server, "GeeCodeX Mock LLM");
+        response->set(http::field::content_type, "application/json");
+        response->keep_alive(m_request.keep_alive());
+        response->body() = body.dump();
+        response->prepare_payload();
+
+        http::async_write(m_stream, *response, [self = shared_from_this(), response](beast::error_code ec, std::size_t) {
+            if (ec || !response->keep_alive()) return self->close();
+            self->do_read();
+        });
+    }
+
+    void start_stream() {
+        m_stats.streamed++;
+        m_token_index = 0;
+        m_stream_header = std::make_shared<http::response<http::empty_body>>(http::status::ok, m_request.version());
+        m_stream_header->set(http::field::server, "GeeCodeX Mock LLM");
+        m_stream_header->set(http::field::content_type, "text/event-stream");
+        m_stream_header->set(http::field::cache_control, "no-cache");
+        m_stream_header->keep_alive(m_request.keep_alive());
+        m_stream_header->chunked(true);
+        m_stream_serializer = std::make_shared<http::response_serializer<http::empty_body>>(*m_stream_header);
+
+        http::async_write_header(m_stream, *m_stream_serializer, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return self->close();
+            self->write_token();
+        });
+    }
+
+    void write_token() {
+        if (m_token_index == m_drop_after) return close();
+
+        json event;
+        event["id"] = "mock-completion";
+        event["object"] = "chat.completion.chunk";
+        event["model"] = m_model;
+        std::string payload;
+        if (m_token_index < m_config.tokens) {
+            event["choices"] = json::array({{{"index", 0}, {"delta", {{"content", mock_token(m_token_index)}}}, {"finish_reason", nullptr}}});
+            payload = "data: " + event.dump() + "\n\n";
+        } else {
+            event["choices"] = json::array({{{"index", 0}, {"delta", json::object()}, {"finish_reason", "stop"}}});
+            event["usage"] = usage();
+            payload = "data: " + event.dump() + "\n\ndata: [DONE]\n\n";
+        }
+        ++m_token_index;
+
+        auto data = std::make_shared<std::string>(std::move(payload));
+        net::async_write(m_stream, http::make_chunk(net::buffer(*data)), [self = shared_from_this(), data](beast::error_code ec, std::size_t) {
+            if (ec) return self->close();
+            if (self->m_token_index > self->m_config.tokens) return self->finish_stream();
+            if (self->m_config.token_rate <= 0) return self->write_token();
+
+            self->m_timer.expires_after(std::chrono::microseconds{static_cast<long long>(1'000'000.0 / self->m_config.token_rate)});
+            self->m_timer.async_wait([self](beast::error_code ec) {
+                if (!ec) self->write_token();
+            });
+        });
+    }
+
+    void finish_stream() {
+        net::async_write(m_stream, http::make_chunk_last(), [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec || !self->m_stream_header->keep_alive()) return self->close();
+            self->do_read();
+        });
+    }
+
+    // Simulates a provider that accepted the request and went silent.
+    void wait_for_close() {
+        auto probe = std::make_shared<std::array<char, 1>>();
+        m_stream.async_read_some(net::buffer(*probe), [self = shared_from_this(), probe](beast::error_code ec, std::size_t) {
+            if (ec) return self->close();
+            self->wait_for_close();
+        });
+    }
+
+    void close() {
+        beast::error_code ec;
+        beast::get_lowest_layer(m_stream).socket().shutdown(tcp::socket::shutdown_both, ec);
+        beast::get_lowest_layer(m_stream).close();
+    }
+};
+
+class mock_listener: public std::enable_shared_from_this<mock_listener> {
+public:
+    mock_listener(net::io_context& ioc, const mock_config& config, mock_stats& stats, ssl::context& ssl_ctx)
+        : m_ioc{ioc}, m_acceptor{ioc}, m_config{config}, m_stats{stats}, m_ssl_ctx{ssl_ctx} {
+        tcp::endpoint endpoint{net::ip::make_address(config.address), config.port};
+        m_acceptor.open(endpoint.protocol());
+        m_acceptor.set_option(net::socket_base::reuse_address(true));
+        m_acceptor.bind(endpoint);
+        m_acceptor.listen(net::socket_base::max_listen_connections);
+    }
+
+    void run() { do_accept(); }
+
+private:
+    net::io_context& m_ioc;
+    tcp::acceptor m_acceptor;
+    const mock_config& m_config;
+    mock_stats& m_stats;
+    ssl::context& m_ssl_ctx;
+
+    void do_accept() {
+        m_acceptor.async_accept(net::make_strand(m_ioc), [self = shared_from_this()](beast::error_code ec, tcp::socket socket) {
+            if (!ec) {
+                socket.set_option(tcp::no_delay(true), ec);
+                std::make_shared<mock_session>(self->m_config, self->m_stats, std::move(socket), self->m_ssl_ctx)->run();
+            }
+            self->do_accept();
+        });
+    }
+};
+
+}   // NAMESPACE GEECODEX::MOCK_LLM
+
+int main(int argc, char* argv[]) {
+    using namespace geecodex::mock_llm;
+
+    auto config = mock_config::parse(argc, argv);
+    if (!config) {
+        std::cerr << "Usage: " << argv[0] << " --tls-cert pem --tls-key pem [--address ip] [--port n] [--threads n]\n"
+                  << "       [--latency fixed|uniform|normal|lognormal] [--latency-ms ms] [--latency-jitter-ms ms]\n"
+                  << "       [--tokens n] [--token-rate n] [--error-rate p] [--rate-limit-rate p] [--hang-rate p] [--drop-rate p]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        net::io_context ioc{config->threads};
+        mock_stats stats;
+
+        ssl::context ssl_ctx{ssl::context::tls_server};
+        ssl_ctx.use_certificate_chain_file(config->tls_cert);
+        ssl_ctx.use_private_key_file(config->tls_key, ssl::context::pem);
+
+        std::make_shared<mock_listener>(ioc, *config, stats, ssl_ctx)->run();
+
+        net::signal_set signals{ioc, SIGINT, SIGTERM};
+        signals.async_wait([&](beast::error_code, int) {
+            std::cout << "Mock LLM stats: " << stats.to_json().dump() << std::endl;
+            ioc.stop();
+        });
+
+        std::cout << "Mock LLM listening on https://" << config->address << ":" << config->port << std::endl;
+
+        std::vector<std::thread> workers;
+        for (int i = 1; i < config->threads; ++i) workers.emplace_back([&ioc] { ioc.run(); });
+        ioc.run();
+        for (auto& worker: workers) worker.join();
+    } catch (const std::exception& e) {
+        std::cerr << "Mock LLM failed: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}